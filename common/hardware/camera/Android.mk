@@ -56,7 +56,18 @@ LOCAL_SRC_FILES := \
 	PreviewWindow.cpp \
 	CallbackNotifier.cpp \
 	JpegCompressor.cpp \
+	StripeJpegEncoder.cpp \
 	CCameraConfig.cpp \
+	YUYVConverters.cpp \
+	FrameRing.cpp \
+	FrameTracer.cpp \
+	FrameScheduler.cpp \
+	YUVScaler.cpp \
+	StreamSplitter.cpp \
+	CameraCapsCache.cpp \
+	V4L2Backend.cpp \
+	FakeV4L2Backend.cpp \
+	RecordingBufferManager.cpp \
 	OSAL_Mutex.c \
 	OSAL_Queue.c
 	
@@ -74,6 +85,8 @@ LOCAL_MODULE := camera.$(TARGET_BOARD_PLATFORM)
 LOCAL_MODULE_TAGS := optional
 include $(BUILD_SHARED_LIBRARY)
 
+include $(call all-makefiles-under,$(LOCAL_PATH))
+
 #-------------------------------------------------------------------------------
 # 
 #-------------------------------------------------------------------------------
@@ -1,9 +1,193 @@
 // #define LOG_NDEBUG 0
 #define LOG_TAG "CCameraConfig"
 #include <utils/Log.h>
+#include <utils/Timers.h>
+#include <pthread.h>
 
 #include "CCameraConfig.h"
 
+// camera.cfg is parsed once per process, in one pass, into a hash table per
+// "camera_id" section. The table is shared by all CCameraConfig objects and
+// kept until the process exits.
+#define CONFIG_HASH_SIZE		64		// buckets per section, power of 2
+#define CONFIG_MAX_SECTIONS		8		// the first one holds the keys before any camera_id
+
+typedef struct config_entry_t
+{
+	const char *	key;
+	const char *	value;
+	int				next;				// next entry of the bucket, -1 for none
+}config_entry_t;
+
+typedef struct config_section_t
+{
+	int				camera_id;
+	int				bucket[CONFIG_HASH_SIZE];
+}config_section_t;
+
+typedef struct config_table_t
+{
+	char *				text;			// file contents, keys and values point in it
+	config_entry_t *	entries;
+	int					entry_count;
+	config_section_t	sections[CONFIG_MAX_SECTIONS];
+	int					section_count;
+}config_table_t;
+
+static pthread_mutex_t gConfigLock = PTHREAD_MUTEX_INITIALIZER;
+static config_table_t * gConfigTable = NULL;
+
+static unsigned int hashKey(const char * key)
+{
+	unsigned int hash = 5381;
+	while (*key)
+	{
+		hash = hash * 33 + (unsigned char)*key++;
+	}
+	return hash;
+}
+
+static bool isBlank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static const char * findSectionKey(const config_table_t * table, int section, const char * key)
+{
+	const config_section_t * sec = &table->sections[section];
+	int i = sec->bucket[hashKey(key) & (CONFIG_HASH_SIZE - 1)];
+	while (i >= 0)
+	{
+		if (!strcmp(table->entries[i].key, key))
+		{
+			return table->entries[i].value;
+		}
+		i = table->entries[i].next;
+	}
+	return NULL;
+}
+
+static void newSection(config_table_t * table, int camera_id)
+{
+	config_section_t * sec = &table->sections[table->section_count++];
+	sec->camera_id = camera_id;
+	for (int i = 0; i < CONFIG_HASH_SIZE; i++)
+	{
+		sec->bucket[i] = -1;
+	}
+}
+
+static config_table_t * loadConfigTable(const char * path)
+{
+	nsecs_t start = systemTime();
+
+	FILE * file = ::fopen(path, "rb");
+	if (file == NULL)
+	{
+		LOGV("open file %s failed", path);
+		return NULL;
+	}
+
+	fseek(file, 0L, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0L, SEEK_SET);
+
+	config_table_t * table = (config_table_t *)::calloc(1, sizeof(config_table_t));
+	char * text = (char *)::malloc(size + 1);
+	if (table == NULL || text == NULL || size < 0
+		|| fread(text, 1, size, file) != (size_t)size)
+	{
+		LOGE("read file %s failed", path);
+		::fclose(file);
+		::free(text);
+		::free(table);
+		return NULL;
+	}
+	::fclose(file);
+	text[size] = 0;
+
+	// one entry at most per line
+	int lines = 1;
+	for (long i = 0; i < size; i++)
+	{
+		if (text[i] == '\n')
+		{
+			lines++;
+		}
+	}
+	table->entries = (config_entry_t *)::malloc(lines * sizeof(config_entry_t));
+	if (table->entries == NULL)
+	{
+		::free(text);
+		::free(table);
+		return NULL;
+	}
+	table->text = text;
+	newSection(table, -1);
+
+	char * line = text;
+	while (line != NULL && *line)
+	{
+		char * end = strchr(line, '\n');
+		if (end != NULL)
+		{
+			*end++ = 0;
+		}
+
+		// "key = value", the value loses all its blanks; comments start with ';'
+		char * eq = strchr(line, '=');
+		if (eq != NULL && *line != ';' && !isBlank(*line) && eq != line)
+		{
+			char * key_end = eq;
+			while (key_end > line && isBlank(key_end[-1]))
+			{
+				key_end--;
+			}
+			*key_end = 0;
+
+			char * value = eq + 1;
+			char * out = value;
+			for (char * in = value; *in; in++)
+			{
+				if (!isBlank(*in))
+				{
+					*out++ = *in;
+				}
+			}
+			*out = 0;
+
+			if (!strcmp(line, "camera_id"))
+			{
+				if (table->section_count < CONFIG_MAX_SECTIONS)
+				{
+					newSection(table, atoi(value));
+				}
+				else
+				{
+					LOGW("too many camera sections in %s", path);
+				}
+			}
+			else if (findSectionKey(table, table->section_count - 1, line) == NULL)
+			{
+				// the first definition of a key in a section wins
+				config_section_t * sec = &table->sections[table->section_count - 1];
+				int * bucket = &sec->bucket[hashKey(line) & (CONFIG_HASH_SIZE - 1)];
+				config_entry_t * entry = &table->entries[table->entry_count];
+				entry->key = line;
+				entry->value = value;
+				entry->next = *bucket;
+				*bucket = table->entry_count++;
+			}
+		}
+
+		line = end;
+	}
+
+	LOGV("parsed %s: %d keys in %d sections, %lld us", path,
+		table->entry_count, table->section_count, (systemTime() - start) / 1000);
+	return table;
+}
+
 #define READ_KEY_VALUE(key, val)						\
 	val = (char*)::malloc(KEY_LENGTH);					\
 	if (val == 0){										\
@@ -18,7 +202,7 @@
 	memcpy(mUsed##key, "0\0", 2);										\
 	mSupport##key##Value = 0;											\
 	mDefault##key##Value = 0;											\
-	if (readKey(kUSED_##KEY, mUsed##key))								\
+	if (readKey(kUSED_##KEY, mUsed##key, sizeof(mUsed##key)))			\
 	{                                                                   \
 		if (usedKey(mUsed##key))                                        \
 		{                                                               \
@@ -75,27 +259,40 @@ MEMBER_FUNCTION(SceneMode)
 MEMBER_FUNCTION(WhiteBalance)
 
 CCameraConfig::CCameraConfig(int id)
-	:mhKeyFile(0)
+	:mConfigTable(0)
 	,mCurCameraId(id)
 	,mNumberOfCamera(0)
 	,mCameraFacing(0)
 	,mOrientation(0)
 	,mDeviceID(0)
+	,mScreenID(0)
 {
-	mhKeyFile = ::fopen(CAMERA_KEY_CONFIG_PATH, "rb");
-	if (mhKeyFile <= 0)
+	mSupportPreviewSizeValue = mDefaultPreviewSizeValue = 0;
+	mSupportPictureSizeValue = mDefaultPictureSizeValue = 0;
+	mSupportFlashModeValue = mDefaultFlashModeValue = 0;
+	mSupportColorEffectValue = mDefaultColorEffectValue = 0;
+	mSupportFrameRateValue = mDefaultFrameRateValue = 0;
+	mSupportFocusModeValue = mDefaultFocusModeValue = 0;
+	mSupportSceneModeValue = mDefaultSceneModeValue = 0;
+	mSupportWhiteBalanceValue = mDefaultWhiteBalanceValue = 0;
+
+	pthread_mutex_lock(&gConfigLock);
+	if (gConfigTable == NULL)
 	{
-		LOGV("open file %s failed", CAMERA_KEY_CONFIG_PATH);
-		return;
+		gConfigTable = loadConfigTable(CAMERA_KEY_CONFIG_PATH);
 	}
-	else
+	mConfigTable = gConfigTable;
+	pthread_mutex_unlock(&gConfigLock);
+
+	if (mConfigTable == 0)
 	{
-		LOGV("open file %s OK", CAMERA_KEY_CONFIG_PATH);
+		LOGV("open file %s failed", CAMERA_KEY_CONFIG_PATH);
+		return;
 	}
 
 	// get number of camera
 	char numberOfCamera[2];
-	if(readKey(kNUMBER_OF_CAMERA, numberOfCamera))
+	if(readKey(kNUMBER_OF_CAMERA, numberOfCamera, sizeof(numberOfCamera)))
 	{
 		mNumberOfCamera = atoi(numberOfCamera);
 		LOGV("read number: %d", mNumberOfCamera);
@@ -103,7 +300,7 @@ CCameraConfig::CCameraConfig(int id)
 
 	// get camera facing
 	char cameraFacing[2];
-	if(readKey(kCAMERA_FACING, cameraFacing))
+	if(readKey(kCAMERA_FACING, cameraFacing, sizeof(cameraFacing)))
 	{
 		mCameraFacing = atoi(cameraFacing);
 		LOGV("camera facing %s", (mCameraFacing == 0) ? "back" : "front");
@@ -111,14 +308,14 @@ CCameraConfig::CCameraConfig(int id)
 
 	// get camera device driver
 	memset(mCameraDevice, 0, sizeof(mCameraDevice));
-	if(readKey(kCAMERA_DEVICE, mCameraDevice))
+	if(readKey(kCAMERA_DEVICE, mCameraDevice, sizeof(mCameraDevice)))
 	{
 		LOGV("camera device %s", mCameraDevice);
 	}
 
 	// get device id
 	char deviceID[2];
-	if(readKey(kDEVICE_ID, deviceID))
+	if(readKey(kDEVICE_ID, deviceID, sizeof(deviceID)))
 	{
 		mDeviceID = atoi(deviceID);
 		LOGV("camera device id %d", mDeviceID);
@@ -126,29 +323,33 @@ CCameraConfig::CCameraConfig(int id)
 	
 	// get camera orientation
 	char str[4];
-	if(readKey(kCAMERA_ORIENTATION, str))
+	if(readKey(kCAMERA_ORIENTATION, str, sizeof(str)))
 	{
 		mOrientation = atoi(str);
 		LOGV("camera orientation %d", mOrientation);
 	}
+
+	// get screen of the preview layer, two cameras streaming at once may
+	// show on different screens
+	if(readKey(kSCREEN_ID, str, sizeof(str)))
+	{
+		mScreenID = atoi(str);
+		LOGV("camera screen id %d", mScreenID);
+	}
 }
 
 CCameraConfig::~CCameraConfig()
 {	
-	if (mhKeyFile != 0)
-	{
-		CHECK_FREE_POINTER(PreviewSize)
-		CHECK_FREE_POINTER(PictureSize)
-		CHECK_FREE_POINTER(FlashMode)
-		CHECK_FREE_POINTER(ColorEffect)
-		CHECK_FREE_POINTER(FrameRate)
-		CHECK_FREE_POINTER(FocusMode)
-		CHECK_FREE_POINTER(SceneMode)
-		CHECK_FREE_POINTER(WhiteBalance)
-		
-		::fclose(mhKeyFile);
-		mhKeyFile = 0;
-	}
+	CHECK_FREE_POINTER(PreviewSize)
+	CHECK_FREE_POINTER(PictureSize)
+	CHECK_FREE_POINTER(FlashMode)
+	CHECK_FREE_POINTER(ColorEffect)
+	CHECK_FREE_POINTER(FrameRate)
+	CHECK_FREE_POINTER(FocusMode)
+	CHECK_FREE_POINTER(SceneMode)
+	CHECK_FREE_POINTER(WhiteBalance)
+
+	mConfigTable = 0;
 }
 
 bool CCameraConfig::usedKey(char *value)
@@ -158,12 +359,21 @@ bool CCameraConfig::usedKey(char *value)
 
 void CCameraConfig::initParameters()
 {	
-	if (mhKeyFile == 0)
+	if (mConfigTable == 0)
 	{
 		LOGW("invalid camera config file hadle");
 		return ;
 	}
 
+	CHECK_FREE_POINTER(PreviewSize)
+	CHECK_FREE_POINTER(PictureSize)
+	CHECK_FREE_POINTER(FlashMode)
+	CHECK_FREE_POINTER(ColorEffect)
+	CHECK_FREE_POINTER(FrameRate)
+	CHECK_FREE_POINTER(FocusMode)
+	CHECK_FREE_POINTER(SceneMode)
+	CHECK_FREE_POINTER(WhiteBalance)
+
 	INIT_PARAMETER(PREVIEW_SIZE, PreviewSize)
 	INIT_PARAMETER(PICTURE_SIZE, PictureSize)
 	INIT_PARAMETER(FLASH_MODE, FlashMode)
@@ -179,14 +389,14 @@ void CCameraConfig::initParameters()
 	memset(mMinExposureCompensation, 0, 4);
 	memset(mStepExposureCompensation, 0, 4);
 	memset(mDefaultExposureCompensation, 0, 4);
-	if (readKey(kUSED_EXPOSURE_COMPENSATION, mUsedExposureCompensation))	
+	if (readKey(kUSED_EXPOSURE_COMPENSATION, mUsedExposureCompensation, sizeof(mUsedExposureCompensation)))	
 	{
 		if (usedKey(mUsedExposureCompensation)) 
 		{
-			readKey(kMIN_EXPOSURE_COMPENSATION, mMinExposureCompensation);
-			readKey(kMAX_EXPOSURE_COMPENSATION, mMaxExposureCompensation);
-			readKey(kSTEP_EXPOSURE_COMPENSATION, mStepExposureCompensation);
-			readKey(kDEFAULT_EXPOSURE_COMPENSATION, mDefaultExposureCompensation);
+			readKey(kMIN_EXPOSURE_COMPENSATION, mMinExposureCompensation, sizeof(mMinExposureCompensation));
+			readKey(kMAX_EXPOSURE_COMPENSATION, mMaxExposureCompensation, sizeof(mMaxExposureCompensation));
+			readKey(kSTEP_EXPOSURE_COMPENSATION, mStepExposureCompensation, sizeof(mStepExposureCompensation));
+			readKey(kDEFAULT_EXPOSURE_COMPENSATION, mDefaultExposureCompensation, sizeof(mDefaultExposureCompensation));
 		}
 		else
 		{
@@ -201,15 +411,15 @@ void CCameraConfig::initParameters()
 	memset(mZoomRatios, 0, KEY_LENGTH);
 	memset(mMaxZoom, 0, 4);
 	memset(mDefaultZoom, 0, 4);
-	if (readKey(kUSED_ZOOM, mUsedZoom))	
+	if (readKey(kUSED_ZOOM, mUsedZoom, sizeof(mUsedZoom)))	
 	{
 		if (usedKey(mUsedZoom)) 
 		{
-			readKey(kZOOM_SUPPORTED, mZoomSupported);
-			readKey(kSMOOTH_ZOOM_SUPPORTED, mSmoothZoomSupported);
-			readKey(kZOOM_RATIOS, mZoomRatios);
-			readKey(kMAX_ZOOM, mMaxZoom);
-			readKey(kDEFAULT_ZOOM, mDefaultZoom);
+			readKey(kZOOM_SUPPORTED, mZoomSupported, sizeof(mZoomSupported));
+			readKey(kSMOOTH_ZOOM_SUPPORTED, mSmoothZoomSupported, sizeof(mSmoothZoomSupported));
+			readKey(kZOOM_RATIOS, mZoomRatios, sizeof(mZoomRatios));
+			readKey(kMAX_ZOOM, mMaxZoom, sizeof(mMaxZoom));
+			readKey(kDEFAULT_ZOOM, mDefaultZoom, sizeof(mDefaultZoom));
 		}
 		else
 		{
@@ -220,7 +430,7 @@ void CCameraConfig::initParameters()
 
 void CCameraConfig::dumpParameters()
 {
-	if (mhKeyFile == 0)
+	if (mConfigTable == 0)
 	{
 		LOGW("invalid camera config file hadle");
 		return ;
@@ -255,82 +465,56 @@ void CCameraConfig::dumpParameters()
 	LOGV("/*------------------------------------------------------*/");
 }
 
-void CCameraConfig::getValue(char *line, char *value)
+bool CCameraConfig::readKey(const char *key, char *value, int size)
 {
-	char * ptemp = line;
-	while(*ptemp)
-	{
-		if (*ptemp++ == '=')
-		{
-			break;
-		}
-	}
-
-	char *pval = ptemp;
-	char *seps = " \n\r\t";
-	int offset = 0;
-	pval = strtok(pval, seps);
-	while (pval != NULL)
-	{
-		strncpy(value + offset, pval, strlen(pval));
-		offset += strlen(pval);
-		pval = strtok(NULL, seps);
-	}
-	*(value + offset) = 0;
-}
-
-bool CCameraConfig::readKey(char *key, char *value)
-{
-	bool bRet = false;
-	bool bFlagBegin = false;
-	char strId[2];
-	char str[KEY_LENGTH];
-
-	if (key == 0 || value == 0)
+	if (key == 0 || value == 0 || size <= 0)
 	{
 		LOGV("error input para");
 		return false;
 	}
 
-	if (mhKeyFile == 0)
+	if (mConfigTable == 0)
 	{
 		LOGV("error key file handle");
 		return false;
 	}
 
-	fseek(mhKeyFile, 0L, SEEK_SET);
+	const config_table_t * table = (const config_table_t *)mConfigTable;
 
-	memset(str, 0, KEY_LENGTH);
-	while (fgets(str, KEY_LENGTH , mhKeyFile))
+	// the number of cameras comes before any camera section; other keys are
+	// looked up from the section of this camera on, as the file is read
+	int first = -1;
+	if (!strcmp(key, kNUMBER_OF_CAMERA))
 	{
-		if (!strcmp(key, "number_of_camera"))
-		{
-			bFlagBegin = true;
-		}
-
-		if (!bFlagBegin)
+		first = 0;
+	}
+	else
+	{
+		for (int i = 1; i < table->section_count; i++)
 		{
-			if (!strncmp(str, "camera_id", strlen("camera_id")))
+			if (table->sections[i].camera_id == mCurCameraId)
 			{
-				getValue(str, strId);
-				if (atoi(strId) == mCurCameraId)
-				{
-					bFlagBegin = true;
-				}
+				first = i;
+				break;
 			}
-			continue;
 		}
+	}
 
-		if (!strncmp(key, str, strlen(key)))
-		{
-			getValue(str, value);
+	if (first < 0)
+	{
+		return false;
+	}
 
-			bRet = true;
-			break;
+	for (int i = first; i < table->section_count; i++)
+	{
+		const char * found = findSectionKey(table, i, key);
+		if (found != NULL)
+		{
+			strncpy(value, found, size - 1);
+			value[size - 1] = 0;
+			return true;
 		}
-		memset(str, 0, KEY_LENGTH);
-	}	
+	}
 
-	return bRet;
+	return false;
 }
-
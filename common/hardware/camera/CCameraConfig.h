@@ -5,7 +5,9 @@
 #include <stdio.h>
 #include <string.h>
 
+#ifndef CAMERA_KEY_CONFIG_PATH
 #define CAMERA_KEY_CONFIG_PATH	"/system/etc/camera.cfg"
+#endif
 
 #define KEY_LENGTH	256
 
@@ -14,6 +16,7 @@
 #define kCAMERA_ORIENTATION					"camera_orientation"
 #define kCAMERA_DEVICE						"camera_device"
 #define kDEVICE_ID							"device_id"
+#define kSCREEN_ID							"screen_id"			// screen of the preview layer
 
 #define kUSED_PREVIEW_SIZE					"used_preview_size"
 #define kSUPPORT_PREVIEW_SIZE				"key_support_preview_size"
@@ -99,6 +102,11 @@ public:
 		return mDeviceID;
 	}
 
+	int getScreenID()
+	{
+		return mScreenID;
+	}
+
 	bool supportPreviewSize();
 	char * supportPreviewSizeValue();
 	char * defaultPreviewSizeValue();
@@ -189,11 +197,10 @@ public:
 	}
 
 private:
-	bool readKey(char *key, char *value);
-	void getValue(char *line, char *value);
+	bool readKey(const char *key, char *value, int size = KEY_LENGTH);
 	bool usedKey(char *value);
 
-	FILE * mhKeyFile;
+	void * mConfigTable;		// parsed camera.cfg, shared by all instances
 
 	int mCurCameraId;
 	int mNumberOfCamera;
@@ -201,6 +208,7 @@ private:
 	int mOrientation;
 	char mCameraDevice[64];
 	int mDeviceID;
+	int mScreenID;
 
 	MEMBER_DEF(PreviewSize)
 	MEMBER_DEF(PictureSize)
@@ -87,22 +87,6 @@ static void PrintMessages(uint32_t msg)
     }
 }
 
-static void NV12_down_scale(const void* src, void* dst, int src_width, int src_height, int dst_width, int dst_height)
-{
-	char * p_src_y = (char *)src;
-	char * p_dst_y = (char *)dst;
-	int scale = src_width / dst_width;
-	
-	int w = 0, h = 0;
-	for (h = 0; h < dst_height; h++)
-	{
-		for (w = 0; w < dst_width; w++)
-		{
-			*(p_dst_y + h * dst_width + w) = *(p_src_y + h * scale * src_width + w * scale);
-		}
-	}
-}
-
 CallbackNotifier::CallbackNotifier()
     : mNotifyCB(NULL),
       mDataCB(NULL),
@@ -115,6 +99,7 @@ CallbackNotifier::CallbackNotifier()
       mJpegQuality(90),
       mVideoRecEnabled(false),
       mTakingPicture(false),
+      mPicturesRemaining(0),
       mUseMetaDataBufferMode(false),
       mGpsLatitude(0.0),
 	  mGpsLongitude(0.0),
@@ -123,14 +108,23 @@ CallbackNotifier::CallbackNotifier()
 	  mThumbWidth(0),
 	  mThumbHeight(0),
 	  mFocalLength(0.0),
-	  mWhiteBalance(0)
+	  mWhiteBalance(0),
+	  mJpegBuf(NULL),
+	  mJpegBufSize(0),
+	  mStreamFormat(0),
+	  mPreviewCbFormat(0),
+	  mPreviewCbInterval(0),
+	  mVideoFormat(0)
 {
+	memset(mStreamIntervals, 0, sizeof(mStreamIntervals));
+	memset(mStreamFormats, 0, sizeof(mStreamFormats));
 	memset(mGpsMethod, 0, sizeof(mGpsMethod));
 	memset(mCallingProcessName, 0, sizeof(mCallingProcessName));
 }
 
 CallbackNotifier::~CallbackNotifier()
 {
+	freeJpegBuffer();
 }
 
 /****************************************************************************
@@ -234,6 +228,14 @@ void CallbackNotifier::cleanupCBNotifier()
     mJpegQuality = 90;
     mVideoRecEnabled = false;
     mTakingPicture = false;
+    mPicturesRemaining = 0;
+
+	freeJpegBuffer();
+	mSplitter.reset();
+	mStreamFormat = 0;
+	mPreviewCbFormat = 0;
+	mPreviewCbInterval = 0;
+	mVideoFormat = 0;
 }
 
 void CallbackNotifier::onNextFrameAvailable(const void* frame,
@@ -258,17 +260,20 @@ void CallbackNotifier::onNextFrameHW(const void* frame,
 	if (isMessageEnabled(CAMERA_MSG_VIDEO_FRAME) && isVideoRecordingEnabled() &&
             isNewVideoFrameTime(timestamp)) 
 	{
-        camera_memory_t* cam_buff = mGetMemoryCB(-1, sizeof(V4L2BUF_t), 1, NULL);
+		// the encoder holds the frame until releaseRecordingFrame
+		const void* video = camera_dev->lendRecordingFrame(frame);
+        camera_memory_t* cam_buff = (video != NULL) ? mGetMemoryCB(-1, sizeof(V4L2BUF_t), 1, NULL) : NULL;
         if (NULL != cam_buff && NULL != cam_buff->data) 
 		{
-            memcpy(cam_buff->data, frame, sizeof(V4L2BUF_t));
+            memcpy(cam_buff->data, video, sizeof(V4L2BUF_t));
             mDataCBTimestamp(timestamp, CAMERA_MSG_VIDEO_FRAME,
                                cam_buff, 0, mCallbackCookie);
 			cam_buff->release(cam_buff);
         } 
-		else 
+		else if (video != NULL)
 		{
             LOGE("%s: Memory failure in CAMERA_MSG_VIDEO_FRAME", __FUNCTION__);
+			camera_dev->releaseRecordingFrame(((const V4L2BUF_t*)video)->index);
         }
     }
 
@@ -288,47 +293,124 @@ void CallbackNotifier::onNextFrameHW(const void* frame,
     }
 }
 
+// The rate of a stream from a period in ns, in the us of the V4L2 frame
+// timestamps, with room for their jitter so that a consumer at the capture
+// rate gets every frame.
+static nsecs_t streamInterval(nsecs_t period)
+{
+	const nsecs_t us = period / 1000;
+	return us - us / 4;
+}
+
+// The format a consumer asked for if the splitter can make it, else the one
+// of the frame.
+static uint32_t streamFormat(uint32_t format, uint32_t frame_fmt)
+{
+	if (format == V4L2_PIX_FMT_NV12 || format == V4L2_PIX_FMT_NV21)
+	{
+		return format;
+	}
+	return frame_fmt;
+}
+
+bool CallbackNotifier::configureStreams(V4L2Camera* camera_dev)
+{
+	const int frame_w = camera_dev->getFrameWidth();
+	const int frame_h = camera_dev->getFrameHeight();
+	const uint32_t frame_fmt = camera_dev->getOriginalPixelFormat();
+	if (frame_fmt != V4L2_PIX_FMT_NV12 && frame_fmt != V4L2_PIX_FMT_NV21)
+	{
+		return false;
+	}
+
+	// face unlock only looks at a small frame
+	int cb_w = frame_w;
+	int cb_h = frame_h;
+	if (strcmp(mCallingProcessName, "com.android.facelock") == 0)
+	{
+		cb_w = 160;
+		cb_h = 120;
+	}
+
+	uint32_t formats[2];
+	nsecs_t intervals[2];
+	{
+		Mutex::Autolock locker(&mObjectLock);
+		formats[STREAM_VIDEO] = streamFormat(mVideoFormat, frame_fmt);
+		formats[STREAM_PREVIEW_CB] = streamFormat(mPreviewCbFormat, frame_fmt);
+		intervals[STREAM_VIDEO] = streamInterval(mFrameRefreshFreq);
+		intervals[STREAM_PREVIEW_CB] = streamInterval(mPreviewCbInterval);
+	}
+
+	if (mSplitter.getWidth(STREAM_VIDEO) != frame_w
+		|| mSplitter.getHeight(STREAM_VIDEO) != frame_h
+		|| mSplitter.getWidth(STREAM_PREVIEW_CB) != cb_w
+		|| mSplitter.getHeight(STREAM_PREVIEW_CB) != cb_h
+		|| mStreamFormat != frame_fmt
+		|| memcmp(mStreamFormats, formats, sizeof(formats)) != 0
+		|| memcmp(mStreamIntervals, intervals, sizeof(intervals)) != 0)
+	{
+		LOGV("%s: video %dx%d %.4s, preview callback %dx%d %.4s", __FUNCTION__,
+			 frame_w, frame_h, reinterpret_cast<const char*>(&formats[STREAM_VIDEO]),
+			 cb_w, cb_h, reinterpret_cast<const char*>(&formats[STREAM_PREVIEW_CB]));
+		if (mSplitter.setStream(STREAM_VIDEO, frame_w, frame_h,
+								formats[STREAM_VIDEO], intervals[STREAM_VIDEO]) != NO_ERROR
+			|| mSplitter.setStream(STREAM_PREVIEW_CB, cb_w, cb_h,
+								   formats[STREAM_PREVIEW_CB], intervals[STREAM_PREVIEW_CB]) != NO_ERROR)
+		{
+			return false;
+		}
+		mStreamFormat = frame_fmt;
+		memcpy(mStreamFormats, formats, sizeof(formats));
+		memcpy(mStreamIntervals, intervals, sizeof(intervals));
+	}
+	return true;
+}
+
 void CallbackNotifier::onNextFrameSW(const void* frame,
 		                               nsecs_t timestamp,
 		                               V4L2Camera* camera_dev)
 {
-	if (isMessageEnabled(CAMERA_MSG_VIDEO_FRAME) && isVideoRecordingEnabled() &&
-            isNewVideoFrameTime(timestamp)) {
-        camera_memory_t* cam_buff =
-            mGetMemoryCB(-1, camera_dev->getFrameBufferSize(), 1, NULL);
-        if (NULL != cam_buff && NULL != cam_buff->data) {
-            memcpy(cam_buff->data, frame, camera_dev->getFrameBufferSize());
-            mDataCBTimestamp(timestamp, CAMERA_MSG_VIDEO_FRAME,
-                               cam_buff, 0, mCallbackCookie);
-			cam_buff->release(cam_buff);		// star add
-        } else {
-            LOGE("%s: Memory failure in CAMERA_MSG_VIDEO_FRAME", __FUNCTION__);
-        }
-    }
+	const bool video = isMessageEnabled(CAMERA_MSG_VIDEO_FRAME) && isVideoRecordingEnabled() &&
+            isNewVideoFrameTime(timestamp);
+	const bool preview = isMessageEnabled(CAMERA_MSG_PREVIEW_FRAME);
+	if (!video && !preview)
+	{
+		return;
+	}
 
-    if (isMessageEnabled(CAMERA_MSG_PREVIEW_FRAME)) {
-		if (strcmp(mCallingProcessName, "com.android.facelock") == 0)
-		{
-			int frame_w = camera_dev->getFrameWidth();
-			int frame_h = camera_dev->getFrameHeight();
-			camera_memory_t* cam_buff =
-	            mGetMemoryCB(-1, 160 * 120 * 3 / 2, 1, NULL);
+	// derive the callback streams from the frame, planar or RGB frames are
+	// passed as they are
+	const bool split = configureStreams(camera_dev);
+	if (split)
+	{
+		mSplitter.beginFrame(frame, camera_dev->getFrameWidth(), camera_dev->getFrameHeight(),
+							 mStreamFormat, timestamp);
+	}
+
+	if (video) {
+		const void* out = split ? mSplitter.getFrame(STREAM_VIDEO) : frame;
+		size_t size = split ? mSplitter.getFrameSize(STREAM_VIDEO) : camera_dev->getFrameBufferSize();
+		if (out != NULL) {
+	        camera_memory_t* cam_buff = mGetMemoryCB(-1, size, 1, NULL);
 	        if (NULL != cam_buff && NULL != cam_buff->data) {
-				NV12_down_scale(frame, cam_buff->data, 
-								frame_w, frame_h,
-								160, 120);
-	            mDataCB(CAMERA_MSG_PREVIEW_FRAME, cam_buff, 0, NULL, mCallbackCookie);
-	            cam_buff->release(cam_buff);
+	            memcpy(cam_buff->data, out, size);
+	            mDataCBTimestamp(timestamp, CAMERA_MSG_VIDEO_FRAME,
+	                               cam_buff, 0, mCallbackCookie);
+				cam_buff->release(cam_buff);		// star add
 	        } else {
-	            LOGE("%s: Memory failure in CAMERA_MSG_PREVIEW_FRAME", __FUNCTION__);
+	            LOGE("%s: Memory failure in CAMERA_MSG_VIDEO_FRAME", __FUNCTION__);
 	        }
 		}
-		else
-		{
-	        camera_memory_t* cam_buff =
-	            mGetMemoryCB(-1, camera_dev->getFrameBufferSize(), 1, NULL);
+    }
+
+    if (preview) {
+		const void* out = split ? mSplitter.getFrame(STREAM_PREVIEW_CB) : frame;
+		size_t size = split ? mSplitter.getFrameSize(STREAM_PREVIEW_CB) : camera_dev->getFrameBufferSize();
+		if (out != NULL) {
+	        camera_memory_t* cam_buff = mGetMemoryCB(-1, size, 1, NULL);
 	        if (NULL != cam_buff && NULL != cam_buff->data) {
-	            memcpy(cam_buff->data, frame, camera_dev->getFrameBufferSize());
+	            memcpy(cam_buff->data, out, size);
 	            mDataCB(CAMERA_MSG_PREVIEW_FRAME, cam_buff, 0, NULL, mCallbackCookie);
 	            cam_buff->release(cam_buff);
 	        } else {
@@ -376,8 +458,12 @@ void CallbackNotifier::takePictureHW(const void* frame, V4L2Camera* camera_dev)
 	}
 	
 	LOGV("%s, taking photo begin", __FUNCTION__);
-    /* This happens just once. */
-    mTakingPicture = false;
+    /* This happens once per picture of the burst. */
+    const bool last_picture = (--mPicturesRemaining <= 0);
+    if (last_picture)
+    {
+        mTakingPicture = false;
+    }
     /* The sequence of callbacks during picture taking is:
      *  - CAMERA_MSG_SHUTTER
      *  - CAMERA_MSG_RAW_IMAGE_NOTIFY
@@ -455,7 +541,10 @@ void CallbackNotifier::takePictureHW(const void* frame, V4L2Camera* camera_dev)
 			jpeg_enc.gps_altitude		= mGpsAltitude;
 			jpeg_enc.gps_timestamp		= mGpsTimestamp;
 			strcpy(jpeg_enc.gps_processing_method, mGpsMethod);
-			memset(mGpsMethod, 0, sizeof(mGpsMethod));
+			if (last_picture)
+			{
+				memset(mGpsMethod, 0, sizeof(mGpsMethod));
+			}
 		}
 		else
 		{
@@ -491,7 +580,8 @@ void CallbackNotifier::takePictureHW(const void* frame, V4L2Camera* camera_dev)
 			jpeg_enc.crop_w,
 			jpeg_enc.crop_h);
 		
-		pOutBuf = (void *)malloc(jpeg_enc.pic_w * jpeg_enc.pic_h << 2);
+		// JpegEnc does not know the size of its output buffer, keep it large
+		pOutBuf = getJpegBuffer(jpeg_enc.pic_w * jpeg_enc.pic_h << 2);
 		if (pOutBuf == NULL)
 		{
 			LOGE("malloc picture memory failed");
@@ -518,12 +608,6 @@ void CallbackNotifier::takePictureHW(const void* frame, V4L2Camera* camera_dev)
 		{
 			LOGE("%s: Memory failure in CAMERA_MSG_COMPRESSED_IMAGE", __FUNCTION__);
 		}
-
-		if(pOutBuf != NULL)
-		{
-			free(pOutBuf);
-			pOutBuf = NULL;
-		}
     }
 
 	if (isMessageEnabled(CAMERA_MSG_POSTVIEW_FRAME) )
@@ -554,8 +638,11 @@ void CallbackNotifier::takePictureSW(const void* frame, V4L2Camera* camera_dev)
 	}
 	
 	LOGV("%s, taking photo begin", __FUNCTION__);
-    /* This happens just once. */
-    mTakingPicture = false;
+    /* This happens once per picture of the burst. */
+    if (--mPicturesRemaining <= 0)
+    {
+        mTakingPicture = false;
+    }
     /* The sequence of callbacks during picture taking is:
      *  - CAMERA_MSG_SHUTTER
      *  - CAMERA_MSG_RAW_IMAGE_NOTIFY
@@ -591,6 +678,33 @@ void CallbackNotifier::takePictureSW(const void* frame, V4L2Camera* camera_dev)
     }
 }
 
+void * CallbackNotifier::getJpegBuffer(int size)
+{
+	if (mJpegBuf != NULL && mJpegBufSize == size)
+	{
+		return mJpegBuf;
+	}
+
+	freeJpegBuffer();
+	mJpegBuf = malloc(size);
+	if (mJpegBuf != NULL)
+	{
+		mJpegBufSize = size;
+		LOGV("jpeg buffer size: %d", size);
+	}
+	return mJpegBuf;
+}
+
+void CallbackNotifier::freeJpegBuffer()
+{
+	if (mJpegBuf != NULL)
+	{
+		free(mJpegBuf);
+		mJpegBuf = NULL;
+	}
+	mJpegBufSize = 0;
+}
+
 void CallbackNotifier::onCameraDeviceError(int err)
 {
     if (isMessageEnabled(CAMERA_MSG_ERROR) && mNotifyCB != NULL) {
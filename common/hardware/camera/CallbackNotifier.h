@@ -22,6 +22,8 @@
  * via set_callbacks, enable_msg_type, and disable_msg_type camera HAL API.
  */
 
+#include "StreamSplitter.h"
+
 namespace android {
 
 class V4L2Camera;
@@ -177,10 +179,15 @@ public:
     /* Sets, or resets taking picture state.
      * This state control whether or not to notify the framework about compressed
      * image, shutter, and other picture related events.
+     * Param:
+     *  taking - Taking picture state.
+     *  count - Number of pictures to deliver before the state is reset, more
+     *      than one for a burst.
      */
-    void setTakingPicture(bool taking)
+    void setTakingPicture(bool taking, int count = 1)
     {
         mTakingPicture = taking;
+        mPicturesRemaining = taking ? count : 0;
     }
 
     /* Sets JPEG quality used to compress frame during picture taking. */
@@ -236,6 +243,9 @@ protected:
     /* Picture taking status. */
     bool                            mTakingPicture;
 
+    /* Pictures left to deliver in the current burst. */
+    int                             mPicturesRemaining;
+
 	// -------------------------------------------------------------------------
 	// extended interfaces here <***** star *****>
 	// -------------------------------------------------------------------------
@@ -298,12 +308,33 @@ public:
 		strcpy(mCallingProcessName, str);
 	}
 
+	// Sets what the preview callbacks and the SW recording callbacks get: a
+	// V4L2 pixel format each, and the preview callback rate, 0 for every
+	// frame. The recording rate is the one of enableVideoRecording().
+	inline void setStreamFormats(uint32_t preview_format, int preview_fps, uint32_t video_format)
+	{
+		Mutex::Autolock locker(&mObjectLock);
+		mPreviewCbFormat = preview_format;
+		mPreviewCbInterval = preview_fps > 0 ? 1000000000LL / preview_fps : 0;
+		mVideoFormat = video_format;
+	}
+
 	status_t autoFocus(bool success);
 	status_t faceDetection(camera_frame_metadata_t *face);
 
 	void takePicture(const void* frame, V4L2Camera* camera_dev, bool bUseMataData);
 	void takePictureHW(const void* frame, V4L2Camera* camera_dev);
 	void takePictureSW(const void* frame, V4L2Camera* camera_dev);
+
+protected:
+	// Returns the output buffer of the HW jpeg encoder, it is kept between
+	// pictures and only reallocated when the picture size changes.
+	void * getJpegBuffer(int size);
+	void freeJpegBuffer();
+
+	// Sets the callback streams up for the current frame geometry, returns
+	// false if the frame format can not be split.
+	bool configureStreams(V4L2Camera* camera_dev);
 	
 protected:
 	bool 							mUseMetaDataBufferMode;
@@ -325,6 +356,23 @@ protected:
 	int 		mWhiteBalance;
 
 	char		mCallingProcessName[128];
+
+	void *		mJpegBuf;
+	int			mJpegBufSize;
+
+	// Callback streams derived from the SW frames: full size for recording,
+	// reduced for the preview callbacks when the client does not need more.
+	enum {
+		STREAM_VIDEO = 0,
+		STREAM_PREVIEW_CB,
+	};
+	StreamSplitter	mSplitter;
+	uint32_t		mStreamFormat;		// of the frames split
+	uint32_t		mPreviewCbFormat;
+	nsecs_t			mPreviewCbInterval;
+	uint32_t		mVideoFormat;
+	nsecs_t			mStreamIntervals[2];	// the splitter was set up with
+	uint32_t		mStreamFormats[2];
 };
 
 }; /* namespace android */
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Contains implementation of a class CameraCapsCache that keeps the probed
+ * capabilities of a V4L2 sensor on disk.
+ */
+
+#define LOG_TAG "Camera_CapsCache"
+#include "CameraDebug.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "CameraCapsCache.h"
+
+namespace android {
+
+/* "CAPS", bumped with the layout of Caps through its size. */
+static const uint32_t kCapsMagic = 0x53504143;
+
+CameraCapsCache::CameraCapsCache()
+{
+    memset(&mCaps, 0, sizeof(mCaps));
+    mPath[0] = 0;
+}
+
+void CameraCapsCache::setDevice(const char* device, int input,
+                                const struct v4l2_capability* cap)
+{
+    memset(&mCaps, 0, sizeof(mCaps));
+    mCaps.magic = kCapsMagic;
+    mCaps.size = sizeof(mCaps);
+    strncpy(mCaps.driver, (const char*)cap->driver, sizeof(mCaps.driver) - 1);
+    strncpy(mCaps.card, (const char*)cap->card, sizeof(mCaps.card) - 1);
+    strncpy(mCaps.bus_info, (const char*)cap->bus_info, sizeof(mCaps.bus_info) - 1);
+    mCaps.version = cap->version;
+    mCaps.input = input;
+
+    // "/dev/video0", input 1 -> "/data/camera/caps-video0-1"
+    const char* name = strrchr(device, '/');
+    name = (name != NULL) ? name + 1 : device;
+    snprintf(mPath, sizeof(mPath), "%s/caps-%s-%d", CAMERA_CAPS_CACHE_DIR, name, input);
+}
+
+bool CameraCapsCache::load()
+{
+    if (mPath[0] == 0)
+    {
+        return false;
+    }
+
+    const int fd = open(mPath, O_RDONLY);
+    if (fd < 0)
+    {
+        LOGV("%s: no cache %s", __FUNCTION__, mPath);
+        return false;
+    }
+
+    Caps caps;
+    const ssize_t n = read(fd, &caps, sizeof(caps));
+    close(fd);
+
+    if (n != (ssize_t)sizeof(caps)
+        || caps.magic != mCaps.magic
+        || caps.size != mCaps.size
+        || strncmp(caps.driver, mCaps.driver, sizeof(caps.driver))
+        || strncmp(caps.card, mCaps.card, sizeof(caps.card))
+        || strncmp(caps.bus_info, mCaps.bus_info, sizeof(caps.bus_info))
+        || caps.version != mCaps.version
+        || caps.input != mCaps.input
+        || caps.format_count < 0 || caps.format_count > MAX_FORMATS)
+    {
+        LOGD("%s: %s is stale", __FUNCTION__, mPath);
+        return false;
+    }
+
+    caps.sizes[SIZES_LENGTH - 1] = 0;
+    mCaps = caps;
+    return true;
+}
+
+status_t CameraCapsCache::store()
+{
+    if (mPath[0] == 0)
+    {
+        return NO_INIT;
+    }
+
+    // written aside and renamed, a reader never sees half a file
+    char tmp[sizeof(mPath) + 4];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", mPath);
+    const int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        LOGW("%s: Unable to create %s: %s", __FUNCTION__, tmp, strerror(errno));
+        return -errno;
+    }
+
+    const ssize_t n = write(fd, &mCaps, sizeof(mCaps));
+    close(fd);
+    if (n != (ssize_t)sizeof(mCaps) || rename(tmp, mPath) != 0)
+    {
+        LOGW("%s: Unable to write %s: %s", __FUNCTION__, mPath, strerror(errno));
+        unlink(tmp);
+        return UNKNOWN_ERROR;
+    }
+
+    LOGV("%s: %s", __FUNCTION__, mPath);
+    return NO_ERROR;
+}
+
+void CameraCapsCache::addFormat(uint32_t format)
+{
+    if (mCaps.format_count < MAX_FORMATS && !hasFormat(format))
+    {
+        mCaps.formats[mCaps.format_count++] = format;
+    }
+}
+
+bool CameraCapsCache::hasFormat(uint32_t format) const
+{
+    for (int i = 0; i < mCaps.format_count; i++)
+    {
+        if (mCaps.formats[i] == format)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void CameraCapsCache::setSizes(uint32_t format, const char* sizes)
+{
+    mCaps.sizes_format = format;
+    strncpy(mCaps.sizes, sizes, SIZES_LENGTH - 1);
+    mCaps.sizes[SIZES_LENGTH - 1] = 0;
+}
+
+const char* CameraCapsCache::getSizes(uint32_t format) const
+{
+    return (mCaps.sizes_format == format) ? mCaps.sizes : "";
+}
+
+}; /* namespace android */
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HW_EMULATOR_CAMERA_CAMERA_CAPS_CACHE_H
+#define HW_EMULATOR_CAMERA_CAMERA_CAPS_CACHE_H
+
+/*
+ * Contains declaration of a class CameraCapsCache that keeps the probed
+ * capabilities of a V4L2 sensor on disk, so that opening the camera does not
+ * have to enumerate them again.
+ */
+
+#include <stdint.h>
+#include <videodev2.h>
+#include <utils/Errors.h>
+
+/* Directory of the cache files, created by init.rc. */
+#define CAMERA_CAPS_CACHE_DIR   "/data/camera"
+
+namespace android {
+
+/* One file per device node and input, named after both. A file is used only
+ * if the driver name, card, bus and driver version it was probed with match
+ * what VIDIOC_QUERYCAP reports now; otherwise the capabilities are probed
+ * again and the file is rewritten.
+ */
+class CameraCapsCache
+{
+public:
+    enum { MAX_FORMATS = 12, SIZES_LENGTH = 256 };
+
+    CameraCapsCache();
+
+    /* Sets the device the capabilities belong to and drops the current ones.
+     * 'cap' is the result of VIDIOC_QUERYCAP on the opened device. */
+    void setDevice(const char* device, int input, const struct v4l2_capability* cap);
+
+    /* Reads the cache file of the device. Returns true if it holds the
+     * capabilities of this driver. */
+    bool load();
+
+    /* Writes the current capabilities to the cache file of the device. */
+    status_t store();
+
+    /* Probed capabilities. */
+    void addFormat(uint32_t format);
+    bool hasFormat(uint32_t format) const;
+    void setSizes(uint32_t format, const char* sizes);
+
+    /* Frame sizes of 'format' as "WxH,WxH,...", empty if not probed. */
+    const char* getSizes(uint32_t format) const;
+
+private:
+    struct Caps {
+        uint32_t    magic;
+        uint32_t    size;                   // sizeof(Caps)
+        char        driver[16];
+        char        card[32];
+        char        bus_info[32];
+        uint32_t    version;
+        int32_t     input;
+        int32_t     format_count;
+        uint32_t    formats[MAX_FORMATS];
+        uint32_t    sizes_format;           // format 'sizes' were probed for
+        char        sizes[SIZES_LENGTH];
+    };
+
+    Caps        mCaps;
+    char        mPath[96];
+};
+
+}; /* namespace android */
+
+#endif  /* HW_EMULATOR_CAMERA_CAMERA_CAPS_CACHE_H */
@@ -41,6 +41,9 @@
 /* Defines whether we should trace parameter changes. */
 #define DEBUG_PARAM 0
 
+/* Max pictures taken by one burst shot. */
+#define MAX_BURST_NUM 8
+
 namespace android {
 
 #if DEBUG_PARAM
@@ -65,6 +68,26 @@ static void PrintParamDiff(const CameraParameters& current, const char* new_par)
  */
 static char* AddValue(const char* param, const char* val);
 
+/* A value changed between two flattened parameter strings. */
+struct ParamChange {
+    const char* key;        // not terminated, see key_len
+    size_t      key_len;
+    const char* value;      // terminated with ';' or '\0'
+};
+
+/* Compares two flattened parameter strings key by key, without allocation.
+ * Param:
+ *  old_par, new_par - Flattened parameters, in the order CameraParameters
+ *      flattens them.
+ *  changes - Receives the values that differ, pointing into new_par.
+ *  max - Size of the 'changes' array.
+ * Return:
+ *  Number of changed values, or -1 if the keys differ, or if more than 'max'
+ *  values changed.
+ */
+static int DiffParams(const char* old_par, const char* new_par,
+                      ParamChange* changes, int max);
+
 static int faceNotifyCb(int cmd,void * data,void * user);
 
 CameraHardware::CameraHardware(int cameraId, struct hw_module_t* module)
@@ -75,7 +98,14 @@ CameraHardware::CameraHardware(int cameraId, struct hw_module_t* module)
           mDefaultPreviewWidth(640),
 		  mDefaultPreviewHeight(480),
           bPixFmtNV12(false),
-          mFirstSetParameters(true)
+          mFirstSetParameters(true),
+          mParamCache(NULL),
+          mParamCacheSize(0),
+          mParamCacheValid(false),
+          mConnectResult(NO_INIT),
+          mOpenStart(0),
+          mInitTime(0),
+          mConnectTime(0)
 {
     /*
      * Initialize camera_device descriptor for this object.
@@ -101,6 +131,9 @@ CameraHardware::CameraHardware(int cameraId, struct hw_module_t* module)
 	mCameraConfig->initParameters();
 	mCameraConfig->dumpParameters();
 
+	// preview layer of this camera, on its own screen if configured
+	mPreviewWindow.setScreenID(mCameraConfig->getScreenID());
+
 	memset(&mRectCrop, 0, sizeof(mRectCrop));
 
 	OSAL_QueueCreate(&mQueueCommand, CMD_QUEUE_MAX);
@@ -141,6 +174,12 @@ CameraHardware::~CameraHardware()
 		pthread_mutex_destroy(&mAutoFocusMutex);
 		pthread_cond_destroy(&mAutoFocusCond);
 	}
+
+	if (mParamCache != NULL)
+	{
+		free(mParamCache);
+		mParamCache = NULL;
+	}
 }
 
 /****************************************************************************
@@ -293,7 +332,12 @@ bool CameraHardware::commandThread()
 		{
 			int width = 0, height = 0;
 			LOGV("CMD_QUEUE_START_FACE_DETECTE");
-			mParameters.getPreviewSize(&width, &height);
+			getCameraDevice()->setFaceDetection(true);
+			getCameraDevice()->getFaceFrameSize(&width, &height);
+			if (width == 0 || height == 0)
+			{
+				mParameters.getPreviewSize(&width, &height);
+			}
 			mFaceDetection->ioctrl(mFaceDetection, FACE_OPS_CMD_START, width, height);
 			break;
 		}
@@ -301,6 +345,7 @@ bool CameraHardware::commandThread()
 		{
 			LOGV("CMD_QUEUE_STOP_FACE_DETECTE");
 			mFaceDetection->ioctrl(mFaceDetection, FACE_OPS_CMD_STOP, 0, 0);
+			getCameraDevice()->setFaceDetection(false);
 			break;
 		}
 		default:
@@ -314,6 +359,7 @@ bool CameraHardware::commandThread()
 status_t CameraHardware::Initialize()
 {
 	F_LOG;
+	nsecs_t start = systemTime();
 
 	if (mCameraConfig == NULL)
 	{
@@ -352,6 +398,8 @@ status_t CameraHardware::Initialize()
 
 	initDefaultParameters();
 
+	mInitTime = systemTime() - start;
+
     return NO_ERROR;
 }
 
@@ -367,7 +415,7 @@ static int faceNotifyCb(int cmd, void * data, void *user)
 			return camera_hw->faceDetection((camera_frame_metadata_t*)data);
 			break;
 		case FACE_NOTITY_CMD_POSITION:
-			return camera_hw->setAutoFocusCtrl(V4L2_AF_WIN_XY, data);
+			return camera_hw->setFaceFocusPosition(data);
 			break;
 		default:
 			break;
@@ -633,6 +681,19 @@ void CameraHardware::initDefaultParameters()
 	// record hint
 	p.set(CameraParameters::KEY_RECORDING_HINT, "false");
 
+	// zero shutter lag, apps opt in
+	parameterString = CameraHardware::ZSL_OFF;
+	parameterString.append(",");
+	parameterString.append(CameraHardware::ZSL_ON);
+	p.set(CameraHardware::ZSL_VALUES_KEY, parameterString.string());
+	p.set(CameraHardware::ZSL_KEY, CameraHardware::ZSL_OFF);
+	getCameraDevice()->setZsl(false);
+
+	// burst capture, one picture per shot by default, interval in ms
+	p.set(CameraHardware::MAX_BURST_NUM_KEY, MAX_BURST_NUM);
+	p.set(CameraHardware::BURST_NUM_KEY, 1);
+	p.set(CameraHardware::BURST_INTERVAL_KEY, 0);
+
 	// rotation
 	p.set(CameraParameters::KEY_ROTATION, 0);
 		
@@ -654,6 +715,7 @@ void CameraHardware::initDefaultParameters()
 	mParameters = p;
 
 	mFirstSetParameters = true;
+	mParamCacheValid = false;
 
 	LOGV("CameraHardware::initDefaultParameters ok");
 }
@@ -732,8 +794,24 @@ status_t CameraHardware::connectCamera(hw_device_t** device)
     LOGE_IF(camera_dev == NULL, "%s: No camera device instance.", __FUNCTION__);
 
     if (camera_dev != NULL) {
-        /* Connect to the camera device. */
-        res = getCameraDevice()->connectDevice();
+        nsecs_t start = systemTime();
+        res = NO_INIT;
+        if (mConnectThread != NULL) {
+            /* Connected in the background since startConnectCamera(). */
+            mConnectThread->stopThread();
+            mConnectThread.clear();
+            res = mConnectResult;
+        } else {
+            mOpenStart = start;
+            mInitTime = 0;
+        }
+        if (res == NO_INIT) {
+            /* No connect thread, or it was told to exit before it ran. */
+            res = getCameraDevice()->connectDevice();
+            mConnectTime = systemTime() - start;
+        }
+        nsecs_t wait = systemTime() - start;
+
         if (res == NO_ERROR) {
             *device = &common;
 			
@@ -751,11 +829,56 @@ status_t CameraHardware::connectCamera(hw_device_t** device)
 			}
         }
 		setAutoFocusCtrl(V4L2_AF_INIT, NULL);
+
+		LOGD("%s: camera %d opened in %lld us: initialize %lld us, connect %lld us, "
+			"waited %lld us for the connect", __FUNCTION__, mCameraID,
+			(systemTime() - mOpenStart) / 1000, mInitTime / 1000,
+			mConnectTime / 1000, wait / 1000);
     }
 
     return -res;
 }
 
+void CameraHardware::startConnectCamera()
+{
+	mOpenStart = systemTime();
+	mInitTime = 0;
+	mConnectResult = NO_INIT;
+
+	mConnectThread = new DoConnectThread(this);
+	if (mConnectThread == NULL || mConnectThread->startThread() != NO_ERROR)
+	{
+		// connectCamera() will connect in line
+		LOGW("%s: Unable to start the connect thread", __FUNCTION__);
+		mConnectThread.clear();
+	}
+}
+
+bool CameraHardware::connectThread()
+{
+	nsecs_t start = systemTime();
+	mConnectResult = getCameraDevice()->connectDevice();
+	mConnectTime = systemTime() - start;
+
+	// one shot
+	return false;
+}
+
+void CameraHardware::abortConnectCamera()
+{
+	if (mConnectThread == NULL)
+	{
+		return;
+	}
+
+	mConnectThread->stopThread();
+	mConnectThread.clear();
+	if (mConnectResult == NO_ERROR)
+	{
+		getCameraDevice()->disconnectDevice();
+	}
+}
+
 status_t CameraHardware::closeCamera()
 {
     LOGV("%s", __FUNCTION__);
@@ -1071,6 +1194,45 @@ status_t CameraHardware::takePicture()
         jpeg_rotate = 0;  /* Fall back to default. */
     }
 
+	/* Get burst, one picture if not set. */
+	int burst_num = mParameters.getInt(CameraHardware::BURST_NUM_KEY);
+	if (burst_num <= 0) {
+		burst_num = 1;
+	}
+	int burst_interval = mParameters.getInt(CameraHardware::BURST_INTERVAL_KEY);
+
+    /*
+     * In zero shutter lag mode, encode the recent preview frame closest to now
+     * and keep the preview running. The preview frame is not scaled up, a
+     * larger picture than zsl-max-picture-size is taken with preview stopped.
+     */
+
+	bool zsl = burst_num == 1
+		&& mPreviewWindow.isPreviewEnabled()
+		&& getCameraDevice()->isZslActive();
+	if (zsl
+		&& (pic_width > getCameraDevice()->getFrameWidth()
+			|| pic_height > getCameraDevice()->getFrameHeight()))
+	{
+		LOGD("%s: picture %dx%d is larger than the zsl frame %dx%d, take it with preview stopped",
+			__FUNCTION__, pic_width, pic_height,
+			getCameraDevice()->getFrameWidth(), getCameraDevice()->getFrameHeight());
+		zsl = false;
+	}
+	if (zsl)
+	{
+	    mCallbackNotifier.setJpegQuality(jpeg_quality);
+		mCallbackNotifier.setJpegRotate(jpeg_rotate);
+	    mCallbackNotifier.setTakingPicture(true);
+		res = getCameraDevice()->takeZslPicture();
+		if (res == NO_ERROR)
+		{
+			return NO_ERROR;
+		}
+		mCallbackNotifier.setTakingPicture(false);
+		LOGW("%s: no zsl frame, take picture with preview stopped", __FUNCTION__);
+	}
+
     /*
      * Make sure preview is not running, and device is stopped before taking
      * picture.
@@ -1098,6 +1260,7 @@ status_t CameraHardware::takePicture()
 	// mPreviewWindow.showLayer(false);
 	
 	camera_dev->setTakingPicture(true);
+	getCameraDevice()->setBurst(burst_num, burst_interval);
     /* Start camera device for the picture frame. */
     LOGD("Starting camera for picture: %.4s(%s)[%dx%d]",
          reinterpret_cast<const char*>(&org_fmt), pix_fmt, frame_width, frame_height);
@@ -1109,10 +1272,10 @@ status_t CameraHardware::takePicture()
         return res;
     }
 	
-    /* Deliver one frame only. */
+    /* Deliver burst_num frames, one by default. */
     mCallbackNotifier.setJpegQuality(jpeg_quality);
 	mCallbackNotifier.setJpegRotate(jpeg_rotate);
-    mCallbackNotifier.setTakingPicture(true);
+    mCallbackNotifier.setTakingPicture(true, burst_num);
     // res = camera_dev->startDeliveringFrames(true);	
 	res = camera_dev->startDeliveringFrames(false);		// star modify
     if (res != NO_ERROR) {
@@ -1172,6 +1335,21 @@ int CameraHardware::setAutoFocusCtrl(int ctrl, void *data)
 	return OK;
 }
 
+int CameraHardware::setFaceFocusPosition(void * data)
+{
+	// the detector works on the reduced face frame, the focus window is
+	// given in frame coordinates
+	struct v4l2_pix_size pos = *(struct v4l2_pix_size *)data;
+	int face_w = 0, face_h = 0;
+	getCameraDevice()->getFaceFrameSize(&face_w, &face_h);
+	if (face_w > 0 && face_h > 0)
+	{
+		pos.width = pos.width * getCameraDevice()->getFrameWidth() / face_w;
+		pos.height = pos.height * getCameraDevice()->getFrameHeight() / face_h;
+	}
+	return setAutoFocusCtrl(V4L2_AF_WIN_XY, (void*)&pos);
+}
+
 int CameraHardware::getCurrentFaceFrame(void * frame)
 {
 	return getCameraDevice()->getCurrentFaceFrame(frame);
@@ -1196,6 +1374,16 @@ status_t CameraHardware::setParameters(const char* p)
 	
     PrintParamDiff(mParameters, p);
 
+	// only a few cheap keys changed since the last call, e.g. zoom steps
+	if (applyChangedParameters(p))
+	{
+		return NO_ERROR;
+	}
+
+	// mParameters no longer matches the cache if we fail halfway
+	mParamCacheValid = false;
+	bool cacheable = true;
+
     CameraParameters params;
 	String8 str8_param(p);
     params.unflatten(str8_param);
@@ -1280,6 +1468,33 @@ status_t CameraHardware::setParameters(const char* p)
         mParameters.set(CameraParameters::KEY_RECORDING_HINT, bPixFmtNV12 ? "true" : "false");
     }
 
+	// zero shutter lag, takes effect on the next preview start
+	const char * new_zsl_str = params.get(CameraHardware::ZSL_KEY);
+	if (new_zsl_str != NULL)
+	{
+		bool zsl = (strcmp(new_zsl_str, CameraHardware::ZSL_ON) == 0);
+		LOGV("ZSL_KEY: %s", new_zsl_str);
+		mParameters.set(CameraHardware::ZSL_KEY, zsl ? CameraHardware::ZSL_ON : CameraHardware::ZSL_OFF);
+		pV4L2Device->setZsl(zsl);
+	}
+
+	// burst capture, used by the next takePicture
+	int new_burst_num = params.getInt(CameraHardware::BURST_NUM_KEY);
+	if (new_burst_num > 0)
+	{
+		if (new_burst_num > MAX_BURST_NUM)
+		{
+			LOGW("burst num %d is too large, use %d", new_burst_num, MAX_BURST_NUM);
+			new_burst_num = MAX_BURST_NUM;
+		}
+		mParameters.set(CameraHardware::BURST_NUM_KEY, new_burst_num);
+	}
+	int new_burst_interval = params.getInt(CameraHardware::BURST_INTERVAL_KEY);
+	if (new_burst_interval >= 0)
+	{
+		mParameters.set(CameraHardware::BURST_INTERVAL_KEY, new_burst_interval);
+	}
+
 	// frame rate
 	int new_min_frame_rate, new_max_frame_rate;
 	params.getPreviewFpsRange(&new_min_frame_rate, &new_max_frame_rate);
@@ -1477,8 +1692,13 @@ status_t CameraHardware::setParameters(const char* p)
 			OSAL_QueueSetElem(&mQueueCommand, &mQueueElement[CMD_QUEUE_SET_FOCUS_MODE]);
 		}
 		
-		if (getCameraDevice()->getThreadRunning()
-			&& strcmp(now_focus_areas_str, new_focus_areas_str))
+		if (strcmp(now_focus_areas_str, new_focus_areas_str)
+			&& !getCameraDevice()->getThreadRunning())
+		{
+			// applied by a later call once preview runs, do not skip it
+			cacheable = false;
+		}
+		else if (strcmp(now_focus_areas_str, new_focus_areas_str))
 		{
 			mParameters.set(CameraParameters::KEY_FOCUS_AREAS, new_focus_areas_str);
 
@@ -1557,10 +1777,118 @@ status_t CameraHardware::setParameters(const char* p)
 
 	mFirstSetParameters = false;
 	pthread_cond_signal(&mCommamdCond);
+
+	if (cacheable)
+	{
+		storeParameterCache(p);
+	}
 	
     return NO_ERROR;
 }
 
+bool CameraHardware::applyChangedParameters(const char* p)
+{
+	if (!mParamCacheValid || mFirstSetParameters)
+	{
+		return false;
+	}
+
+	ParamChange changes[FAST_PARAM_MAX];
+	int count = DiffParams(mParamCache, p, changes, FAST_PARAM_MAX);
+	if (count < 0)
+	{
+		return false;
+	}
+
+	// check everything first, the full path reports errors
+	int values[FAST_PARAM_MAX];
+	int keys[FAST_PARAM_MAX];
+	for (int i = 0; i < count; i++)
+	{
+		keys[i] = -1;
+		for (int k = 0; k < FAST_PARAM_MAX; k++)
+		{
+			const char* key = mFastParamKeys[k];
+			if (strncmp(key, changes[i].key, changes[i].key_len) == 0
+				&& key[changes[i].key_len] == '\0')
+			{
+				keys[i] = k;
+				break;
+			}
+		}
+		values[i] = atoi(changes[i].value);
+
+		switch (keys[i])
+		{
+		case FAST_PARAM_ZOOM:
+			if (!mCameraConfig->supportZoom()
+				|| values[i] < 0
+				|| values[i] > mParameters.getInt(CameraParameters::KEY_MAX_ZOOM))
+			{
+				return false;
+			}
+			break;
+		case FAST_PARAM_ROTATION:
+			if (values[i] < 0)
+			{
+				return false;
+			}
+			break;
+		case FAST_PARAM_JPEG_QUALITY:
+			if (values[i] < 1 || values[i] > 100)
+			{
+				return false;
+			}
+			break;
+		default:
+			return false;
+		}
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		switch (keys[i])
+		{
+		case FAST_PARAM_ZOOM:
+			LOGV("new_zoom: %d", values[i]);
+			mParameters.set(CameraParameters::KEY_ZOOM, values[i]);
+			getCameraDevice()->setCrop(values[i], mParameters.getInt(CameraParameters::KEY_MAX_ZOOM));
+			break;
+		case FAST_PARAM_ROTATION:
+			mParameters.set(CameraParameters::KEY_ROTATION, values[i]);
+			break;
+		case FAST_PARAM_JPEG_QUALITY:
+			mParameters.set(CameraParameters::KEY_JPEG_QUALITY, values[i]);
+			break;
+		}
+	}
+
+	if (count > 0)
+	{
+		storeParameterCache(p);
+	}
+
+	return true;
+}
+
+void CameraHardware::storeParameterCache(const char* p)
+{
+	int size = strlen(p) + 1;
+	if (size > mParamCacheSize)
+	{
+		char * cache = (char *)realloc(mParamCache, size);
+		if (cache == NULL)
+		{
+			mParamCacheValid = false;
+			return;
+		}
+		mParamCache = cache;
+		mParamCacheSize = size;
+	}
+	memcpy(mParamCache, p, size);
+	mParamCacheValid = true;
+}
+
 /* A dumb variable indicating "no params" / error on the exit from
  * CameraHardware::getParameters(). */
 static char lNoParam = '\0';
@@ -1633,8 +1961,9 @@ status_t CameraHardware::dumpCamera(int fd)
 {
     LOGV("%s", __FUNCTION__);
 
-    /* TODO: Future enhancements. */
-    return -EINVAL;
+    getCameraDevice()->dump(fd);
+
+    return NO_ERROR;
 }
 
 /****************************************************************************
@@ -1715,12 +2044,17 @@ status_t CameraHardware::doStartPreview()
 
     /* Convert framework's pixel format to the FOURCC one. */
     uint32_t org_fmt;
+    uint32_t video_fmt = 0; // what the SW recording callbacks get
     if (strcmp(pix_fmt, CameraParameters::PIXEL_FORMAT_YUV420P) == 0) {
         org_fmt = V4L2_PIX_FMT_YUV420;
     } else if (strcmp(pix_fmt, CameraParameters::PIXEL_FORMAT_RGBA8888) == 0) {
         org_fmt = V4L2_PIX_FMT_RGB32;
     } else if (strcmp(pix_fmt, CameraParameters::PIXEL_FORMAT_YUV420SP) == 0) {
-    	if (bPixFmtNV12) {
+		// zsl frames go to the HW jpeg encoder as they are, it wants NV12,
+		// preview callbacks still get NV21, see setStreamFormats below
+		const char * zsl = mParameters.get(CameraHardware::ZSL_KEY);
+    	if (bPixFmtNV12
+			|| (zsl != NULL && strcmp(zsl, CameraHardware::ZSL_ON) == 0)) {
 			LOGV("============== DISP_SEQ_UVUV");
 			mPreviewWindow.setLayerFormat(DISP_SEQ_UVUV);
         	org_fmt = V4L2_PIX_FMT_NV12;		// for HW encoder
@@ -1729,12 +2063,22 @@ status_t CameraHardware::doStartPreview()
 			mPreviewWindow.setLayerFormat(DISP_SEQ_VUVU);
         	org_fmt = V4L2_PIX_FMT_NV21;		// for some apps
     	}
+		video_fmt = bPixFmtNV12 ? V4L2_PIX_FMT_NV12 : V4L2_PIX_FMT_NV21;
     } else {
         LOGE("%s: Unsupported pixel format %s", __FUNCTION__, pix_fmt);
         mPreviewWindow.stopPreview();
         return EINVAL;
     }
 	
+    /* The preview callbacks get the format the app asked for, yuv420sp is
+     * NV21 whatever the capture is; recording gets what the encoder takes. */
+    if (org_fmt == V4L2_PIX_FMT_NV12 || org_fmt == V4L2_PIX_FMT_NV21) {
+        mCallbackNotifier.setStreamFormats(V4L2_PIX_FMT_NV21,
+                                           mParameters.getPreviewFrameRate(), video_fmt);
+    } else {
+        mCallbackNotifier.setStreamFormats(org_fmt, mParameters.getPreviewFrameRate(), org_fmt);
+    }
+
     LOGD("Starting camera: %dx%d -> %.4s(%s)",
          width, height, reinterpret_cast<const char*>(&org_fmt), pix_fmt);
     res = camera_dev->startDevice(width, height, org_fmt);
@@ -1743,6 +2087,17 @@ status_t CameraHardware::doStartPreview()
         return res;
     }
 
+    /* Zsl pictures are encoded from the capture frame, they can not be larger. */
+    const char * zsl = mParameters.get(CameraHardware::ZSL_KEY);
+    if (zsl != NULL && strcmp(zsl, CameraHardware::ZSL_ON) == 0) {
+        char zsl_size[32];
+        snprintf(zsl_size, sizeof(zsl_size), "%dx%d",
+                 camera_dev->getFrameWidth(), camera_dev->getFrameHeight());
+        mParameters.set(CameraHardware::ZSL_MAX_PICTURE_SIZE_KEY, zsl_size);
+    } else {
+        mParameters.remove(CameraHardware::ZSL_MAX_PICTURE_SIZE_KEY);
+    }
+
     res = camera_dev->startDeliveringFrames(false);
     if (res != NO_ERROR) {
         camera_dev->stopDevice();
@@ -1795,6 +2150,7 @@ status_t CameraHardware::cleanupCamera()
 	mParameters.set(CameraParameters::KEY_JPEG_THUMBNAIL_HEIGHT, 240);
 
 	mParameters.set(CameraParameters::KEY_ZOOM, 0);
+	mParamCacheValid = false;
 	
     /* If preview is running - stop it. */
     res = doStopPreview();
@@ -2188,6 +2544,19 @@ camera_device_ops_t CameraHardware::mDeviceOps = {
 const char CameraHardware::FACING_KEY[]         = "prop-facing";
 const char CameraHardware::ORIENTATION_KEY[]    = "prop-orientation";
 const char CameraHardware::RECORDING_HINT_KEY[] = "recording-hint";
+const char CameraHardware::ZSL_KEY[]            = "zsl";
+const char CameraHardware::ZSL_VALUES_KEY[]     = "zsl-values";
+const char CameraHardware::ZSL_MAX_PICTURE_SIZE_KEY[] = "zsl-max-picture-size";
+const char CameraHardware::BURST_NUM_KEY[]      = "burst-num";
+const char CameraHardware::MAX_BURST_NUM_KEY[]  = "max-burst-num";
+const char CameraHardware::BURST_INTERVAL_KEY[] = "burst-interval";
+
+/* Keys applied by applyChangedParameters(), indexed by FAST_PARAM_XXX. */
+const char* const CameraHardware::mFastParamKeys[FAST_PARAM_MAX] = {
+    CameraParameters::KEY_ZOOM,
+    CameraParameters::KEY_ROTATION,
+    CameraParameters::KEY_JPEG_QUALITY
+};
 
 /****************************************************************************
  * Common string values
@@ -2195,6 +2564,8 @@ const char CameraHardware::RECORDING_HINT_KEY[] = "recording-hint";
 
 const char CameraHardware::FACING_BACK[]      = "back";
 const char CameraHardware::FACING_FRONT[]     = "front";
+const char CameraHardware::ZSL_ON[]           = "on";
+const char CameraHardware::ZSL_OFF[]          = "off";
 
 /****************************************************************************
  * Helper routines
@@ -2215,6 +2586,53 @@ static char* AddValue(const char* param, const char* val)
     return ret;
 }
 
+static const char* ParamEnd(const char* s)
+{
+    while (*s != '\0' && *s != ';') {
+        s++;
+    }
+    return s;
+}
+
+static int DiffParams(const char* old_par, const char* new_par,
+                      ParamChange* changes, int max)
+{
+    int count = 0;
+    while (*old_par != '\0' && *new_par != '\0') {
+        const char* old_end = ParamEnd(old_par);
+        const char* new_end = ParamEnd(new_par);
+        const char* old_val = reinterpret_cast<const char*>(
+                memchr(old_par, '=', old_end - old_par));
+        const char* new_val = reinterpret_cast<const char*>(
+                memchr(new_par, '=', new_end - new_par));
+        if (old_val == NULL || new_val == NULL) {
+            return -1;
+        }
+
+        const size_t key_len = new_val - new_par;
+        if ((size_t)(old_val - old_par) != key_len
+            || memcmp(old_par, new_par, key_len) != 0) {
+            return -1;
+        }
+
+        if (old_end - old_val != new_end - new_val
+            || memcmp(old_val, new_val, new_end - new_val) != 0) {
+            if (count == max) {
+                return -1;
+            }
+            changes[count].key = new_par;
+            changes[count].key_len = key_len;
+            changes[count].value = new_val + 1;
+            count++;
+        }
+
+        old_par = (*old_end != '\0') ? old_end + 1 : old_end;
+        new_par = (*new_end != '\0') ? new_end + 1 : new_end;
+    }
+
+    return (*old_par == '\0' && *new_par == '\0') ? count : -1;
+}
+
 /****************************************************************************
  * Parameter debugging helpers
  ***************************************************************************/
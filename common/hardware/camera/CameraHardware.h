@@ -422,6 +422,12 @@ public:
     static const char FACING_KEY[];
     static const char ORIENTATION_KEY[];
     static const char RECORDING_HINT_KEY[];
+    static const char ZSL_KEY[];
+    static const char ZSL_VALUES_KEY[];
+    static const char ZSL_MAX_PICTURE_SIZE_KEY[];
+    static const char BURST_NUM_KEY[];
+    static const char MAX_BURST_NUM_KEY[];
+    static const char BURST_INTERVAL_KEY[];
 
      /****************************************************************************
      * Common string values
@@ -431,6 +437,10 @@ public:
     static const char FACING_BACK[];
     static const char FACING_FRONT[];
 
+    /* Possible values for ZSL_KEY */
+    static const char ZSL_ON[];
+    static const char ZSL_OFF[];
+
 	// -------------------------------------------------------------------------
 	// extended interfaces here <***** star *****>
 	// -------------------------------------------------------------------------
@@ -443,6 +453,7 @@ public:
 	void setCrop(Rect * rect, int new_zoom);
 	int setAutoFocusMode();
 	int setAutoFocusCtrl(int af_ctrl, void *areas);
+	int setFaceFocusPosition(void * data);
 	int getCurrentFaceFrame(void * frame);
 	int faceDetection(camera_frame_metadata_t *face);
     
@@ -450,6 +461,20 @@ public:
 
 	bool commandThread();
 	bool autoFocusThread();
+	bool connectThread();
+
+	// V4L2 device node of this camera, cameras on the same node share a CSI
+	inline const char * getDeviceName()
+	{
+		return mCameraConfig->cameraDevice();
+	}
+
+	// opening the camera: the V4L2 device is connected in the background from
+	// startConnectCamera() while Initialize() sets the default parameters,
+	// connectCamera() then waits for it. abortConnectCamera() undoes it when
+	// Initialize() fails.
+	void startConnectCamera();
+	void abortConnectCamera();
 
 protected:
 	CCameraConfig * mCameraConfig;
@@ -461,6 +486,24 @@ protected:
 
 	bool mFirstSetParameters;
 
+	// setParameters() is called for every zoom step, when only these keys
+	// changed since the last call they are applied without a full parse
+	enum {
+		FAST_PARAM_ZOOM,
+		FAST_PARAM_ROTATION,
+		FAST_PARAM_JPEG_QUALITY,
+		FAST_PARAM_MAX
+	};
+	static const char* const mFastParamKeys[FAST_PARAM_MAX];
+
+	bool applyChangedParameters(const char* p);
+	void storeParameterCache(const char* p);
+
+	// last parameters fully applied, compared with the next ones
+	char * mParamCache;
+	int mParamCacheSize;
+	bool mParamCacheValid;
+
 	char mCallingProcessName[128];
 
 	FaceDetectionDev * mFaceDetection;
@@ -533,6 +576,31 @@ protected:
         }
     };
 	sp<DoAutoFocusThread>			mAutoFocusThread;
+
+	class DoConnectThread : public Thread {
+        CameraHardware* mCameraHardware;
+    public:
+        DoConnectThread(CameraHardware* hw) :
+			Thread(false),
+			mCameraHardware(hw) {
+		}
+        status_t startThread() {
+			return run("CameraConnectThread", PRIORITY_NORMAL);
+        }
+		void stopThread() {
+			requestExitAndWait();
+        }
+        virtual bool threadLoop() {
+			return mCameraHardware->connectThread();
+        }
+    };
+	sp<DoConnectThread>				mConnectThread;
+	status_t						mConnectResult;
+
+	// phases of the last open, for the timing report of connectCamera()
+	nsecs_t							mOpenStart;
+	nsecs_t							mInitTime;			// Initialize()
+	nsecs_t							mConnectTime;		// connectDevice()
 	
 	pthread_mutex_t 				mAutoFocusMutex;
 	pthread_cond_t					mAutoFocusCond;
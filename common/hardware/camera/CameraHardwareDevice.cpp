@@ -75,8 +75,12 @@ status_t CameraHardwareDevice::Initialize()
 	mV4L2CameraDevice->setV4L2DeviceID(deviceId);
 	mV4L2CameraDevice->setCameraFacing(cameraFacing);
 
+	// the device is opened and probed while the default parameters are set
+	startConnectCamera();
+
     res = CameraHardware::Initialize();
     if (res != NO_ERROR) {
+        abortConnectCamera();
         return res;
     }
 
@@ -95,7 +99,7 @@ V4L2CameraDevice* CameraHardwareDevice::getCameraDevice()
 
 void CameraHardwareDevice::releaseRecordingFrame(const void* opaque)
 {
-	mV4L2CameraDevice->releasePreviewFrame(*(int*)opaque);
+	mV4L2CameraDevice->releaseRecordingFrame(*(int*)opaque);
 }
 
 };  /* namespace android */
@@ -21,10 +21,305 @@
 #define LOG_TAG "Camera_Converter"
 #include "CameraDebug.h"
 
+#include <string.h>
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
 #include "Converters.h"
+#include "YUYVConverters.h"
 
 namespace android {
 
+/* Converts one or two rows sharing the same chroma row. 'Y1' and 'rgb1' are
+ * NULL for the last row of an image of odd height.
+ */
+static void _RowPairToRGB565_C(const uint8_t* Y0, const uint8_t* Y1,
+                               const uint8_t* U, const uint8_t* V, int dUV,
+                               uint16_t* rgb0, uint16_t* rgb1, int width)
+{
+    for (int x = 0; x < width; x += 2, U += dUV, V += dUV) {
+        const uint8_t nU = *U;
+        const uint8_t nV = *V;
+        rgb0[x] = YUVToRGB565(Y0[x], nU, nV);
+        rgb0[x + 1] = YUVToRGB565(Y0[x + 1], nU, nV);
+        if (Y1 != NULL) {
+            rgb1[x] = YUVToRGB565(Y1[x], nU, nV);
+            rgb1[x + 1] = YUVToRGB565(Y1[x + 1], nU, nV);
+        }
+    }
+}
+
+static void _RowPairToRGB32_C(const uint8_t* Y0, const uint8_t* Y1,
+                              const uint8_t* U, const uint8_t* V, int dUV,
+                              uint32_t* rgb0, uint32_t* rgb1, int width)
+{
+    for (int x = 0; x < width; x += 2, U += dUV, V += dUV) {
+        const uint8_t nU = *U;
+        const uint8_t nV = *V;
+        rgb0[x] = YUVToRGB32(Y0[x], nU, nV);
+        rgb0[x + 1] = YUVToRGB32(Y0[x + 1], nU, nV);
+        if (Y1 != NULL) {
+            rgb1[x] = YUVToRGB32(Y1[x], nU, nV);
+            rgb1[x + 1] = YUVToRGB32(Y1[x + 1], nU, nV);
+        }
+    }
+}
+
+#if defined(__ARM_NEON__) && __BYTE_ORDER == __LITTLE_ENDIAN
+/* NEON versions of the above, bit-exact, 16 pixels of both rows per
+ * iteration. The per-chroma terms of the YUV2xO macros are computed once
+ * for the 2x2 pixels that share them; the sums need 32 bits since 298 * C
+ * does not fit in 16.
+ */
+struct ChromaTerms {
+    int32x4_t   r[4];   // 409 * E + 128, per pixel of a row
+    int32x4_t   g[4];   // -100 * D - 208 * E + 128
+    int32x4_t   b[4];   // 516 * D + 128
+};
+
+static inline void _LoadChroma(const uint8_t* U, const uint8_t* V, int dUV,
+                               ChromaTerms* t)
+{
+    uint8x8_t u8, v8;
+    if (dUV == 2) {
+        /* U and V are interleaved, in either order. */
+        const uint8_t* uv = U < V ? U : V;
+        uint8x8x2_t p = vld2_u8(uv);
+        u8 = U < V ? p.val[0] : p.val[1];
+        v8 = U < V ? p.val[1] : p.val[0];
+    } else {
+        u8 = vld1_u8(U);
+        v8 = vld1_u8(V);
+    }
+
+    const int16x8_t D = vreinterpretq_s16_u16(vsubl_u8(u8, vdup_n_u8(128)));
+    const int16x8_t E = vreinterpretq_s16_u16(vsubl_u8(v8, vdup_n_u8(128)));
+    const int32x4_t round = vdupq_n_s32(128);
+    const int16x4_t half_d[2] = { vget_low_s16(D), vget_high_s16(D) };
+    const int16x4_t half_e[2] = { vget_low_s16(E), vget_high_s16(E) };
+
+    for (int h = 0; h < 2; h++) {
+        int32x4_t r = vmlal_n_s16(round, half_e[h], 409);
+        int32x4_t g = vmlal_n_s16(round, half_d[h], -100);
+        g = vmlal_n_s16(g, half_e[h], -208);
+        int32x4_t b = vmlal_n_s16(round, half_d[h], 516);
+
+        /* Each chroma sample covers two pixels. */
+        int32x4x2_t z = vzipq_s32(r, r);
+        t->r[2 * h] = z.val[0]; t->r[2 * h + 1] = z.val[1];
+        z = vzipq_s32(g, g);
+        t->g[2 * h] = z.val[0]; t->g[2 * h + 1] = z.val[1];
+        z = vzipq_s32(b, b);
+        t->b[2 * h] = z.val[0]; t->b[2 * h + 1] = z.val[1];
+    }
+}
+
+/* (298 * C + term) >> 8 for 8 pixels, clamped to 0..255. */
+static inline uint8x8_t _Channel(int32x4_t c0, int32x4_t c1,
+                                 int32x4_t t0, int32x4_t t1)
+{
+    const int16x4_t lo = vshrn_n_s32(vaddq_s32(c0, t0), 8);
+    const int16x4_t hi = vshrn_n_s32(vaddq_s32(c1, t1), 8);
+    return vqmovun_s16(vcombine_s16(lo, hi));
+}
+
+/* Converts 16 pixels of a row into R, G, and B bytes. */
+static inline void _Row16(const uint8_t* Y, const ChromaTerms* t,
+                          uint8x16_t* r, uint8x16_t* g, uint8x16_t* b)
+{
+    const uint8x16_t y = vld1q_u8(Y);
+    const int16x8_t C[2] = {
+        vreinterpretq_s16_u16(vsubl_u8(vget_low_u8(y), vdup_n_u8(16))),
+        vreinterpretq_s16_u16(vsubl_u8(vget_high_u8(y), vdup_n_u8(16)))
+    };
+    uint8x8_t rr[2], gg[2], bb[2];
+
+    for (int h = 0; h < 2; h++) {
+        const int32x4_t c0 = vmull_n_s16(vget_low_s16(C[h]), 298);
+        const int32x4_t c1 = vmull_n_s16(vget_high_s16(C[h]), 298);
+        rr[h] = _Channel(c0, c1, t->r[2 * h], t->r[2 * h + 1]);
+        gg[h] = _Channel(c0, c1, t->g[2 * h], t->g[2 * h + 1]);
+        bb[h] = _Channel(c0, c1, t->b[2 * h], t->b[2 * h + 1]);
+    }
+    *r = vcombine_u8(rr[0], rr[1]);
+    *g = vcombine_u8(gg[0], gg[1]);
+    *b = vcombine_u8(bb[0], bb[1]);
+}
+
+static inline uint16x8_t _Pack565(uint8x8_t r, uint8x8_t g, uint8x8_t b)
+{
+    uint16x8_t out = vshll_n_u8(b, 8);
+    out = vsriq_n_u16(out, vshll_n_u8(g, 8), 5);
+    return vsriq_n_u16(out, vshll_n_u8(r, 8), 11);
+}
+
+static void _RowPairToRGB565_NEON(const uint8_t* Y0, const uint8_t* Y1,
+                                  const uint8_t* U, const uint8_t* V, int dUV,
+                                  uint16_t* rgb0, uint16_t* rgb1, int width)
+{
+    const int n16 = width & ~15;
+    ChromaTerms t;
+    uint8x16_t r, g, b;
+
+    for (int x = 0; x < n16; x += 16) {
+        _LoadChroma(U + (x / 2) * dUV, V + (x / 2) * dUV, dUV, &t);
+
+        _Row16(Y0 + x, &t, &r, &g, &b);
+        vst1q_u16(rgb0 + x, _Pack565(vget_low_u8(r), vget_low_u8(g), vget_low_u8(b)));
+        vst1q_u16(rgb0 + x + 8, _Pack565(vget_high_u8(r), vget_high_u8(g), vget_high_u8(b)));
+        if (Y1 != NULL) {
+            _Row16(Y1 + x, &t, &r, &g, &b);
+            vst1q_u16(rgb1 + x, _Pack565(vget_low_u8(r), vget_low_u8(g), vget_low_u8(b)));
+            vst1q_u16(rgb1 + x + 8, _Pack565(vget_high_u8(r), vget_high_u8(g), vget_high_u8(b)));
+        }
+    }
+
+    if (n16 < width) {
+        _RowPairToRGB565_C(Y0 + n16, Y1 != NULL ? Y1 + n16 : NULL,
+                           U + (n16 / 2) * dUV, V + (n16 / 2) * dUV, dUV,
+                           rgb0 + n16, rgb1 != NULL ? rgb1 + n16 : NULL,
+                           width - n16);
+    }
+}
+
+static void _RowPairToRGB32_NEON(const uint8_t* Y0, const uint8_t* Y1,
+                                 const uint8_t* U, const uint8_t* V, int dUV,
+                                 uint32_t* rgb0, uint32_t* rgb1, int width)
+{
+    const int n16 = width & ~15;
+    ChromaTerms t;
+    uint8x16x4_t px;
+    px.val[3] = vdupq_n_u8(0xff);
+
+    for (int x = 0; x < n16; x += 16) {
+        _LoadChroma(U + (x / 2) * dUV, V + (x / 2) * dUV, dUV, &t);
+
+        _Row16(Y0 + x, &t, &px.val[0], &px.val[1], &px.val[2]);
+        vst4q_u8(reinterpret_cast<uint8_t*>(rgb0 + x), px);
+        if (Y1 != NULL) {
+            _Row16(Y1 + x, &t, &px.val[0], &px.val[1], &px.val[2]);
+            vst4q_u8(reinterpret_cast<uint8_t*>(rgb1 + x), px);
+        }
+    }
+
+    if (n16 < width) {
+        _RowPairToRGB32_C(Y0 + n16, Y1 != NULL ? Y1 + n16 : NULL,
+                          U + (n16 / 2) * dUV, V + (n16 / 2) * dUV, dUV,
+                          rgb0 + n16, rgb1 != NULL ? rgb1 + n16 : NULL,
+                          width - n16);
+    }
+}
+#endif
+
+typedef void (*row_pair_565_t)(const uint8_t*, const uint8_t*,
+                               const uint8_t*, const uint8_t*, int,
+                               uint16_t*, uint16_t*, int);
+typedef void (*row_pair_32_t)(const uint8_t*, const uint8_t*,
+                              const uint8_t*, const uint8_t*, int,
+                              uint32_t*, uint32_t*, int);
+
+static void _YUV420ToRGB565(row_pair_565_t convert,
+                            const uint8_t* y, int y_stride,
+                            const uint8_t* u, const uint8_t* v,
+                            int uv_stride, int uv_step,
+                            void* rgb, int rgb_stride,
+                            int width, int height)
+{
+    uint8_t* out = reinterpret_cast<uint8_t*>(rgb);
+    for (int row = 0; row < height; row += 2) {
+        const bool pair = row + 1 < height;
+        convert(y, pair ? y + y_stride : NULL, u, v, uv_step,
+                reinterpret_cast<uint16_t*>(out),
+                pair ? reinterpret_cast<uint16_t*>(out + rgb_stride) : NULL,
+                width);
+        y += 2 * y_stride;
+        u += uv_stride;
+        v += uv_stride;
+        out += 2 * rgb_stride;
+    }
+}
+
+static void _YUV420ToRGB32(row_pair_32_t convert,
+                           const uint8_t* y, int y_stride,
+                           const uint8_t* u, const uint8_t* v,
+                           int uv_stride, int uv_step,
+                           void* rgb, int rgb_stride,
+                           int width, int height)
+{
+    uint8_t* out = reinterpret_cast<uint8_t*>(rgb);
+    for (int row = 0; row < height; row += 2) {
+        const bool pair = row + 1 < height;
+        convert(y, pair ? y + y_stride : NULL, u, v, uv_step,
+                reinterpret_cast<uint32_t*>(out),
+                pair ? reinterpret_cast<uint32_t*>(out + rgb_stride) : NULL,
+                width);
+        y += 2 * y_stride;
+        u += uv_stride;
+        v += uv_stride;
+        out += 2 * rgb_stride;
+    }
+}
+
+void YUV420ToRGB565(const uint8_t* y, int y_stride,
+                    const uint8_t* u, const uint8_t* v,
+                    int uv_stride, int uv_step,
+                    void* rgb, int rgb_stride,
+                    int width, int height)
+{
+#if defined(__ARM_NEON__) && __BYTE_ORDER == __LITTLE_ENDIAN
+    if (cpuHasNeon()) {
+        _YUV420ToRGB565(_RowPairToRGB565_NEON, y, y_stride, u, v, uv_stride,
+                        uv_step, rgb, rgb_stride, width, height);
+        return;
+    }
+#endif
+    _YUV420ToRGB565(_RowPairToRGB565_C, y, y_stride, u, v, uv_stride,
+                    uv_step, rgb, rgb_stride, width, height);
+}
+
+void YUV420ToRGB32(const uint8_t* y, int y_stride,
+                   const uint8_t* u, const uint8_t* v,
+                   int uv_stride, int uv_step,
+                   void* rgb, int rgb_stride,
+                   int width, int height)
+{
+#if defined(__ARM_NEON__) && __BYTE_ORDER == __LITTLE_ENDIAN
+    if (cpuHasNeon()) {
+        _YUV420ToRGB32(_RowPairToRGB32_NEON, y, y_stride, u, v, uv_stride,
+                       uv_step, rgb, rgb_stride, width, height);
+        return;
+    }
+#endif
+    _YUV420ToRGB32(_RowPairToRGB32_C, y, y_stride, u, v, uv_stride,
+                   uv_step, rgb, rgb_stride, width, height);
+}
+
+void YUV420ToRGB565_C(const uint8_t* y, int y_stride,
+                      const uint8_t* u, const uint8_t* v,
+                      int uv_stride, int uv_step,
+                      void* rgb, int rgb_stride,
+                      int width, int height)
+{
+    _YUV420ToRGB565(_RowPairToRGB565_C, y, y_stride, u, v, uv_stride,
+                    uv_step, rgb, rgb_stride, width, height);
+}
+
+void YUV420ToRGB32_C(const uint8_t* y, int y_stride,
+                     const uint8_t* u, const uint8_t* v,
+                     int uv_stride, int uv_step,
+                     void* rgb, int rgb_stride,
+                     int width, int height)
+{
+    _YUV420ToRGB32(_RowPairToRGB32_C, y, y_stride, u, v, uv_stride,
+                   uv_step, rgb, rgb_stride, width, height);
+}
+
+/* Converters for YUV 4:2:0 planar and interleaved frames, without padding.
+ * Y, U, and V point to Y, U, and V panes, dUV is the distance between two
+ * U samples.
+ */
 static void _YUV420SToRGB565(const uint8_t* Y,
                              const uint8_t* U,
                              const uint8_t* V,
@@ -33,26 +328,8 @@ static void _YUV420SToRGB565(const uint8_t* Y,
                              int width,
                              int height)
 {
-    const uint8_t* U_pos = U;
-    const uint8_t* V_pos = V;
-
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x += 2, U += dUV, V += dUV) {
-            const uint8_t nU = *U;
-            const uint8_t nV = *V;
-            *rgb = YUVToRGB565(*Y, nU, nV);
-            Y++; rgb++;
-            *rgb = YUVToRGB565(*Y, nU, nV);
-            Y++; rgb++;
-        }
-        if (y & 0x1) {
-            U_pos = U;
-            V_pos = V;
-        } else {
-            U = U_pos;
-            V = V_pos;
-        }
-    }
+    YUV420ToRGB565(Y, width, U, V, (width / 2) * dUV, dUV,
+                   rgb, width * 2, width, height);
 }
 
 static void _YUV420SToRGB32(const uint8_t* Y,
@@ -63,26 +340,8 @@ static void _YUV420SToRGB32(const uint8_t* Y,
                             int width,
                             int height)
 {
-    const uint8_t* U_pos = U;
-    const uint8_t* V_pos = V;
-
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x += 2, U += dUV, V += dUV) {
-            const uint8_t nU = *U;
-            const uint8_t nV = *V;
-            *rgb = YUVToRGB32(*Y, nU, nV);
-            Y++; rgb++;
-            *rgb = YUVToRGB32(*Y, nU, nV);
-            Y++; rgb++;
-        }
-        if (y & 0x1) {
-            U_pos = U;
-            V_pos = V;
-        } else {
-            U = U_pos;
-            V = V_pos;
-        }
-    }
+    YUV420ToRGB32(Y, width, U, V, (width / 2) * dUV, dUV,
+                  rgb, width * 4, width, height);
 }
 
 void YV12ToRGB565(const void* yv12, void* rgb, int width, int height)
@@ -170,4 +429,102 @@ void NV21ToRGB32(const void* nv21, void* rgb, int width, int height)
                  reinterpret_cast<uint32_t*>(rgb), width, height);
 }
 
+/* Swaps the bytes of each 16-bit sample of a row, 4 bytes at a time. */
+static void _SwapUVRow_C(const uint8_t* src, uint8_t* dst, int width)
+{
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        uint32_t w;
+        memcpy(&w, src + x, 4);
+        w = ((w & 0x00ff00ff) << 8) | ((w >> 8) & 0x00ff00ff);
+        memcpy(dst + x, &w, 4);
+    }
+    for (; x < width; x += 2) {
+        const uint8_t u = src[x];
+        dst[x] = src[x + 1];
+        dst[x + 1] = u;
+    }
+}
+
+#if defined(__ARM_NEON__)
+/* NEON version of the above, 64 bytes per iteration. Each block is loaded
+ * before it is stored, so swapping in place is fine. */
+static void _SwapUVRow_NEON(const uint8_t* src, uint8_t* dst, int width)
+{
+    int x = 0;
+    for (; x + 64 <= width; x += 64) {
+        uint8x16_t a = vld1q_u8(src + x);
+        uint8x16_t b = vld1q_u8(src + x + 16);
+        uint8x16_t c = vld1q_u8(src + x + 32);
+        uint8x16_t d = vld1q_u8(src + x + 48);
+        vst1q_u8(dst + x, vrev16q_u8(a));
+        vst1q_u8(dst + x + 16, vrev16q_u8(b));
+        vst1q_u8(dst + x + 32, vrev16q_u8(c));
+        vst1q_u8(dst + x + 48, vrev16q_u8(d));
+    }
+    for (; x + 16 <= width; x += 16) {
+        vst1q_u8(dst + x, vrev16q_u8(vld1q_u8(src + x)));
+    }
+    _SwapUVRow_C(src + x, dst + x, width - x);
+}
+#endif
+
+typedef void (*SwapUVRowFunc)(const uint8_t* src, uint8_t* dst, int width);
+
+static void _SwapUV(SwapUVRowFunc row, const uint8_t* src, int src_stride,
+                    uint8_t* dst, int dst_stride, int width, int rows)
+{
+    // a packed plane is swapped as one long row
+    if (src_stride == width && dst_stride == width) {
+        width *= rows;
+        rows = 1;
+    }
+    for (int r = 0; r < rows; r++) {
+        row(src, dst, width);
+        src += src_stride;
+        dst += dst_stride;
+    }
+}
+
+void SwapUV(const uint8_t* src, int src_stride,
+            uint8_t* dst, int dst_stride,
+            int width, int rows)
+{
+#if defined(__ARM_NEON__)
+    if (cpuHasNeon()) {
+        _SwapUV(_SwapUVRow_NEON, src, src_stride, dst, dst_stride, width, rows);
+        return;
+    }
+#endif
+    _SwapUV(_SwapUVRow_C, src, src_stride, dst, dst_stride, width, rows);
+}
+
+void SwapUV_C(const uint8_t* src, int src_stride,
+              uint8_t* dst, int dst_stride,
+              int width, int rows)
+{
+    _SwapUV(_SwapUVRow_C, src, src_stride, dst, dst_stride, width, rows);
+}
+
+void NV12ToNV21(const void* src, int src_stride,
+                void* dst, int dst_stride,
+                int width, int height)
+{
+    const uint8_t* in = reinterpret_cast<const uint8_t*>(src);
+    uint8_t* out = reinterpret_cast<uint8_t*>(dst);
+
+    if (in != out) {
+        if (src_stride == width && dst_stride == width) {
+            memcpy(out, in, width * height);
+        } else {
+            for (int r = 0; r < height; r++) {
+                memcpy(out + r * dst_stride, in + r * src_stride, width);
+            }
+        }
+    }
+
+    SwapUV(in + src_stride * height, src_stride,
+           out + dst_stride * height, dst_stride, width, height / 2);
+}
+
 }; /* namespace android */
@@ -18,6 +18,7 @@
 #define HW_EMULATOR_CAMERA_CONVERTERS_H
 
 #include <endian.h>
+#include <stdint.h>
 
 #ifndef __BYTE_ORDER
 #error "could not determine byte order"
@@ -254,6 +255,46 @@ struct YUVPixel {
     }
 };
 
+/* Converts an YUV 4:2:0 image with arbitrary strides to RGB565 framebuffer.
+ * Two rows are converted at once so they share the chroma terms. A region of
+ * interest is converted by offsetting the plane pointers to an even x, y.
+ * Param:
+ *  y - First Y sample.
+ *  y_stride - Bytes between two Y rows.
+ *  u, v - First U and V samples.
+ *  uv_stride - Bytes between two chroma rows.
+ *  uv_step - Bytes between two U samples of a row: 1 for planar images,
+ *      2 for semi-planar (NV12 / NV21) ones.
+ *  rgb - RGB565 framebuffer.
+ *  rgb_stride - Bytes between two framebuffer rows.
+ *  width, height - Dimensions of the converted region, width must be even.
+ */
+void YUV420ToRGB565(const uint8_t* y, int y_stride,
+                    const uint8_t* u, const uint8_t* v,
+                    int uv_stride, int uv_step,
+                    void* rgb, int rgb_stride,
+                    int width, int height);
+
+/* Same as above, for RGB32 framebuffer. */
+void YUV420ToRGB32(const uint8_t* y, int y_stride,
+                   const uint8_t* u, const uint8_t* v,
+                   int uv_stride, int uv_step,
+                   void* rgb, int rgb_stride,
+                   int width, int height);
+
+/* Portable C versions of the above, always available. The NEON versions are
+ * bit-exact with them. */
+void YUV420ToRGB565_C(const uint8_t* y, int y_stride,
+                      const uint8_t* u, const uint8_t* v,
+                      int uv_stride, int uv_step,
+                      void* rgb, int rgb_stride,
+                      int width, int height);
+void YUV420ToRGB32_C(const uint8_t* y, int y_stride,
+                     const uint8_t* u, const uint8_t* v,
+                     int uv_stride, int uv_step,
+                     void* rgb, int rgb_stride,
+                     int width, int height);
+
 /* Converts an YV12 framebuffer to RGB565 framebuffer.
  * Param:
  *  yv12 - YV12 framebuffer.
@@ -310,6 +351,38 @@ void NV21ToRGB565(const void* nv21, void* rgb, int width, int height);
  */
 void NV21ToRGB32(const void* nv21, void* rgb, int width, int height);
 
+/* Swaps the U and V samples of semi-planar chroma rows, which converts NV12
+ * chroma to NV21 and back. 'dst' may be 'src' to swap in place.
+ * Param:
+ *  src - First chroma row.
+ *  src_stride - Bytes between two source rows.
+ *  dst - First destination row.
+ *  dst_stride - Bytes between two destination rows.
+ *  width - Bytes of chroma per row, the image width. Must be even.
+ *  rows - Number of chroma rows, half the image height.
+ */
+void SwapUV(const uint8_t* src, int src_stride,
+            uint8_t* dst, int dst_stride,
+            int width, int rows);
+
+/* Portable C version of the above, always available. The NEON version is
+ * bit-exact with it. */
+void SwapUV_C(const uint8_t* src, int src_stride,
+              uint8_t* dst, int dst_stride,
+              int width, int rows);
+
+/* Converts an NV12 image to NV21, or an NV21 image to NV12.
+ * Param:
+ *  src - Source image, chroma plane right after 'height' luma rows.
+ *  src_stride - Bytes between two source rows, of both planes.
+ *  dst - Destination image, same layout.
+ *  dst_stride - Bytes between two destination rows.
+ *  width, height - Dimensions of the image, both must be even.
+ */
+void NV12ToNV21(const void* src, int src_stride,
+                void* dst, int dst_stride,
+                int width, int height);
+
 }; /* namespace android */
 
 #endif  /* HW_EMULATOR_CAMERA_CONVERTERS_H */
@@ -0,0 +1,605 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Contains implementation of a class FakeV4L2Backend, a synthetic V4L2
+ * capture device.
+ */
+
+#define LOG_TAG "Camera_FakeV4L2Backend"
+#include "CameraDebug.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <cutils/properties.h>
+#include "FakeV4L2Backend.h"
+
+namespace android {
+
+static const uint32_t kFormats[] = { V4L2_PIX_FMT_NV21, V4L2_PIX_FMT_NV12 };
+static const char* const kFormatNames[] = { "YUV 4:2:0 NV21", "YUV 4:2:0 NV12" };
+static const int kFormatCount = sizeof(kFormats) / sizeof(kFormats[0]);
+
+static const struct { int width, height; } kSizes[] = {
+    { 320, 240 }, { 640, 480 }, { 1280, 720 }, { 1600, 1200 },
+};
+static const int kSizeCount = sizeof(kSizes) / sizeof(kSizes[0]);
+
+/* Side of the square that moves across the pattern. */
+static const int kSquare = 64;
+
+static size_t PageAlign(size_t size)
+{
+    return (size + 4095) & ~4095;
+}
+
+FakeV4L2Backend::FakeV4L2Backend()
+    : mOpened(false),
+      mInput(0),
+      mWidth(640),
+      mHeight(480),
+      mFormat(V4L2_PIX_FMT_NV21),
+      mFrameSize(640 * 480 * 3 / 2),
+      mNumerator(1),
+      mDenominator(30),
+      mCaptureMode(0),
+      mFixedFps(0),
+      mJitter(0),
+      mMemory(V4L2_MEMORY_MMAP),
+      mBufferCount(0),
+      mQueued(0),
+      mDoneCount(0),
+      mStreaming(false),
+      mNextFrame(0),
+      mSequence(0),
+      mDropped(0),
+      mSeed(1),
+      mSourceFd(-1),
+      mSourceSize(0)
+{
+    memset(mBuffers, 0, sizeof(mBuffers));
+}
+
+FakeV4L2Backend::~FakeV4L2Backend()
+{
+    close();
+}
+
+int FakeV4L2Backend::open(const char* name)
+{
+    Mutex::Autolock locker(&mLock);
+    if (mOpened)
+    {
+        errno = EBUSY;
+        return -1;
+    }
+
+    char value[PROPERTY_VALUE_MAX];
+    property_get("camera.fake.fps", value, "0");
+    mFixedFps = atoi(value);
+    property_get("camera.fake.jitter", value, "0");
+    mJitter = (nsecs_t)atoi(value) * 1000;
+
+    property_get("camera.fake.file", value, "");
+    if (value[0] != 0)
+    {
+        mSourceFd = ::open(value, O_RDONLY);
+        if (mSourceFd < 0)
+        {
+            LOGW("%s: Unable to open %s: %s, using the pattern",
+                 __FUNCTION__, value, strerror(errno));
+        }
+        else
+        {
+            mSourceSize = lseek(mSourceFd, 0, SEEK_END);
+        }
+    }
+
+    mSeed = (unsigned int)systemTime();
+    mOpened = true;
+    LOGD("%s: %s, fps %d, jitter %lld us, source %s", __FUNCTION__, name,
+         mFixedFps, mJitter / 1000, (mSourceFd >= 0) ? value : "pattern");
+    return 0;
+}
+
+void FakeV4L2Backend::close()
+{
+    Mutex::Autolock locker(&mLock);
+    if (!mOpened)
+    {
+        return;
+    }
+
+    if (mDropped > 0)
+    {
+        LOGD("%s: %u frames, %u dropped without a queued buffer",
+             __FUNCTION__, mSequence, mDropped);
+    }
+    mStreaming = false;
+    freeBuffers();
+    if (mSourceFd >= 0)
+    {
+        ::close(mSourceFd);
+        mSourceFd = -1;
+    }
+    mOpened = false;
+}
+
+int FakeV4L2Backend::ioctl(int request, void* arg)
+{
+    Mutex::Autolock locker(&mLock);
+    if (!mOpened)
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    switch (request)
+    {
+    case VIDIOC_QUERYCAP:
+    {
+        struct v4l2_capability* cap = (struct v4l2_capability*)arg;
+        memset(cap, 0, sizeof(*cap));
+        strcpy((char*)cap->driver, "fake");
+        strcpy((char*)cap->card, "synthetic camera");
+        strcpy((char*)cap->bus_info, "virtual");
+        cap->version = 1;
+        cap->capabilities = V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_STREAMING;
+        return 0;
+    }
+
+    case VIDIOC_S_INPUT:
+        mInput = ((struct v4l2_input*)arg)->index;
+        return 0;
+
+    case VIDIOC_ENUM_FMT:
+    {
+        struct v4l2_fmtdesc* desc = (struct v4l2_fmtdesc*)arg;
+        if (desc->index >= (uint32_t)kFormatCount)
+        {
+            errno = EINVAL;
+            return -1;
+        }
+        desc->pixelformat = kFormats[desc->index];
+        strncpy((char*)desc->description, kFormatNames[desc->index],
+                sizeof(desc->description) - 1);
+        return 0;
+    }
+
+    case VIDIOC_ENUM_FRAMESIZES:
+    {
+        struct v4l2_frmsizeenum* size = (struct v4l2_frmsizeenum*)arg;
+        if (size->index >= (uint32_t)kSizeCount)
+        {
+            errno = EINVAL;
+            return -1;
+        }
+        size->type = V4L2_FRMSIZE_TYPE_DISCRETE;
+        size->discrete.width = kSizes[size->index].width;
+        size->discrete.height = kSizes[size->index].height;
+        return 0;
+    }
+
+    case VIDIOC_TRY_FMT:
+        return setFormat((struct v4l2_format*)arg, false);
+
+    case VIDIOC_S_FMT:
+        return setFormat((struct v4l2_format*)arg, true);
+
+    case VIDIOC_G_FMT:
+    {
+        struct v4l2_format* fmt = (struct v4l2_format*)arg;
+        fmt->fmt.pix.width = mWidth;
+        fmt->fmt.pix.height = mHeight;
+        fmt->fmt.pix.pixelformat = mFormat;
+        fmt->fmt.pix.field = V4L2_FIELD_NONE;
+        fmt->fmt.pix.bytesperline = mWidth;
+        fmt->fmt.pix.sizeimage = mFrameSize;
+        return 0;
+    }
+
+    case VIDIOC_S_PARM:
+    {
+        struct v4l2_streamparm* parm = (struct v4l2_streamparm*)arg;
+        const struct v4l2_fract* tpf = &parm->parm.capture.timeperframe;
+        if (tpf->numerator != 0 && tpf->denominator != 0)
+        {
+            mNumerator = tpf->numerator;
+            mDenominator = tpf->denominator;
+        }
+        mCaptureMode = parm->parm.capture.capturemode;
+        return 0;
+    }
+
+    case VIDIOC_G_PARM:
+    {
+        struct v4l2_streamparm* parm = (struct v4l2_streamparm*)arg;
+        parm->parm.capture.capability = V4L2_CAP_TIMEPERFRAME;
+        parm->parm.capture.capturemode = mCaptureMode;
+        parm->parm.capture.timeperframe.numerator = mFixedFps ? 1 : mNumerator;
+        parm->parm.capture.timeperframe.denominator = mFixedFps ? mFixedFps : mDenominator;
+        return 0;
+    }
+
+    case VIDIOC_REQBUFS:
+        return reqBufs((struct v4l2_requestbuffers*)arg);
+
+    case VIDIOC_QUERYBUF:
+        return queryBuf((struct v4l2_buffer*)arg);
+
+    case VIDIOC_QBUF:
+        return qBuf((struct v4l2_buffer*)arg);
+
+    case VIDIOC_DQBUF:
+        return dqBuf((struct v4l2_buffer*)arg);
+
+    case VIDIOC_STREAMON:
+        if (mBufferCount == 0)
+        {
+            errno = EINVAL;
+            return -1;
+        }
+        if (!mStreaming)
+        {
+            mStreaming = true;
+            mNextFrame = systemTime(SYSTEM_TIME_MONOTONIC) + nextInterval();
+        }
+        return 0;
+
+    case VIDIOC_STREAMOFF:
+        // all the buffers go back to the application
+        mStreaming = false;
+        for (int i = 0; i < mBufferCount; i++)
+        {
+            mBuffers[i].queued = false;
+            mBuffers[i].done = false;
+        }
+        mQueued = 0;
+        mDoneCount = 0;
+        return 0;
+
+    case VIDIOC_S_CTRL:
+        return 0;
+
+    case VIDIOC_G_CTRL:
+        ((struct v4l2_control*)arg)->value = 0;
+        return 0;
+
+    default:
+        errno = EINVAL;
+        return -1;
+    }
+}
+
+int FakeV4L2Backend::setFormat(struct v4l2_format* fmt, bool apply)
+{
+    struct v4l2_pix_format* pix = &fmt->fmt.pix;
+    bool supported = false;
+    for (int i = 0; i < kFormatCount; i++)
+    {
+        if (pix->pixelformat == kFormats[i])
+        {
+            supported = true;
+        }
+    }
+    if (!supported)
+    {
+        pix->pixelformat = V4L2_PIX_FMT_NV21;
+    }
+
+    int width = pix->width & ~1;
+    int height = pix->height & ~1;
+    width = (width < 2) ? 2 : (width > MAX_WIDTH) ? MAX_WIDTH : width;
+    height = (height < 2) ? 2 : (height > MAX_HEIGHT) ? MAX_HEIGHT : height;
+    pix->width = width;
+    pix->height = height;
+    pix->field = V4L2_FIELD_NONE;
+    pix->bytesperline = width;
+    pix->sizeimage = width * height * 3 / 2;
+
+    if (!apply)
+    {
+        return 0;
+    }
+    if (mStreaming)
+    {
+        errno = EBUSY;
+        return -1;
+    }
+
+    mWidth = width;
+    mHeight = height;
+    mFormat = pix->pixelformat;
+    mFrameSize = pix->sizeimage;
+    return 0;
+}
+
+void FakeV4L2Backend::freeBuffers()
+{
+    for (int i = 0; i < MAX_BUFFERS; i++)
+    {
+        free(mBuffers[i].mem);
+    }
+    memset(mBuffers, 0, sizeof(mBuffers));
+    mBufferCount = 0;
+    mQueued = 0;
+    mDoneCount = 0;
+}
+
+int FakeV4L2Backend::reqBufs(struct v4l2_requestbuffers* rb)
+{
+    if (mStreaming)
+    {
+        errno = EBUSY;
+        return -1;
+    }
+    if (rb->memory != V4L2_MEMORY_MMAP && rb->memory != V4L2_MEMORY_USERPTR)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    freeBuffers();
+    mMemory = rb->memory;
+    if (rb->count > MAX_BUFFERS)
+    {
+        rb->count = MAX_BUFFERS;
+    }
+
+    for (uint32_t i = 0; i < rb->count; i++)
+    {
+        Buffer* b = &mBuffers[i];
+        b->length = PageAlign(mFrameSize);
+        if (mMemory == V4L2_MEMORY_MMAP)
+        {
+            b->mem = (uint8_t*)malloc(b->length);
+            if (b->mem == NULL)
+            {
+                freeBuffers();
+                errno = ENOMEM;
+                return -1;
+            }
+        }
+    }
+    mBufferCount = rb->count;
+    return 0;
+}
+
+int FakeV4L2Backend::queryBuf(struct v4l2_buffer* buf)
+{
+    if (buf->index >= (uint32_t)mBufferCount)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    const Buffer* b = &mBuffers[buf->index];
+    buf->memory = mMemory;
+    buf->length = b->length;
+    buf->m.offset = buf->index * b->length;
+    buf->flags = b->queued ? V4L2_BUF_FLAG_QUEUED : 0;
+    return 0;
+}
+
+int FakeV4L2Backend::qBuf(struct v4l2_buffer* buf)
+{
+    if (buf->index >= (uint32_t)mBufferCount || buf->memory != (uint32_t)mMemory)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    Buffer* b = &mBuffers[buf->index];
+    if (b->queued || b->done)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    if (mMemory == V4L2_MEMORY_USERPTR)
+    {
+        if (buf->m.userptr == 0 || buf->length < mFrameSize)
+        {
+            errno = EINVAL;
+            return -1;
+        }
+        b->userptr = buf->m.userptr;
+        b->length = buf->length;
+    }
+
+    b->queued = true;
+    mQueue[mQueued++] = buf->index;
+    return 0;
+}
+
+int FakeV4L2Backend::dqBuf(struct v4l2_buffer* buf)
+{
+    produce(systemTime(SYSTEM_TIME_MONOTONIC));
+    if (mDoneCount == 0)
+    {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    const int index = mDone[0];
+    mDoneCount--;
+    memmove(mDone, mDone + 1, mDoneCount * sizeof(mDone[0]));
+
+    Buffer* b = &mBuffers[index];
+    b->done = false;
+
+    buf->index = index;
+    buf->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf->memory = mMemory;
+    buf->bytesused = mFrameSize;
+    buf->flags = 0;
+    buf->field = V4L2_FIELD_NONE;
+    buf->timestamp = b->timestamp;
+    buf->sequence = b->sequence;
+    buf->length = b->length;
+    if (mMemory == V4L2_MEMORY_USERPTR)
+    {
+        buf->m.userptr = b->userptr;
+    }
+    else
+    {
+        buf->m.offset = index * b->length;
+    }
+    return 0;
+}
+
+void* FakeV4L2Backend::mmap(size_t length, off_t offset)
+{
+    Mutex::Autolock locker(&mLock);
+    for (int i = 0; i < mBufferCount; i++)
+    {
+        const Buffer* b = &mBuffers[i];
+        if (b->mem != NULL && offset == (off_t)(i * b->length) && length <= b->length)
+        {
+            return b->mem;
+        }
+    }
+    errno = EINVAL;
+    return MAP_FAILED;
+}
+
+int FakeV4L2Backend::munmap(void* addr, size_t length)
+{
+    // the buffers live until the next VIDIOC_REQBUFS or close()
+    return 0;
+}
+
+int FakeV4L2Backend::waitFrame(int timeout_ms)
+{
+    const nsecs_t deadline = systemTime(SYSTEM_TIME_MONOTONIC) + (nsecs_t)timeout_ms * 1000000;
+    for (;;)
+    {
+        nsecs_t wake = deadline;
+        {
+            Mutex::Autolock locker(&mLock);
+            if (!mOpened)
+            {
+                errno = EBADF;
+                return -1;
+            }
+            produce(systemTime(SYSTEM_TIME_MONOTONIC));
+            if (mDoneCount > 0)
+            {
+                return 1;
+            }
+            if (mStreaming && mNextFrame < wake)
+            {
+                wake = mNextFrame;
+            }
+        }
+
+        const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        if (now >= deadline)
+        {
+            return 0;
+        }
+        if (wake > now)
+        {
+            usleep((wake - now + 999) / 1000);
+        }
+    }
+}
+
+nsecs_t FakeV4L2Backend::nextInterval()
+{
+    nsecs_t interval = mFixedFps
+        ? 1000000000LL / mFixedFps
+        : 1000000000LL * mNumerator / mDenominator;
+    if (mJitter > 0)
+    {
+        interval += (nsecs_t)(rand_r(&mSeed) % (2 * mJitter + 1)) - mJitter;
+    }
+    return (interval < 1000000) ? 1000000 : interval;
+}
+
+void FakeV4L2Backend::produce(nsecs_t now)
+{
+    if (!mStreaming)
+    {
+        return;
+    }
+
+    // after a long stall start over rather than catching up in a burst
+    if (now - mNextFrame > 1000000000LL)
+    {
+        mNextFrame = now;
+    }
+
+    while (now >= mNextFrame)
+    {
+        if (mQueued > 0)
+        {
+            const int index = mQueue[0];
+            mQueued--;
+            memmove(mQueue, mQueue + 1, mQueued * sizeof(mQueue[0]));
+
+            Buffer* b = &mBuffers[index];
+            uint8_t* dst = (mMemory == V4L2_MEMORY_USERPTR) ? (uint8_t*)b->userptr : b->mem;
+            fillFrame(dst, mSequence);
+            b->queued = false;
+            b->done = true;
+            b->sequence = mSequence;
+            // drivers stamp frames with gettimeofday
+            gettimeofday(&b->timestamp, NULL);
+            mDone[mDoneCount++] = index;
+        }
+        else
+        {
+            mDropped++;
+        }
+
+        mSequence++;
+        mNextFrame += nextInterval();
+    }
+}
+
+void FakeV4L2Backend::fillFrame(uint8_t* dst, uint32_t sequence)
+{
+    const int y_size = mWidth * mHeight;
+    if (mSourceFd >= 0 && mSourceSize >= (off_t)mFrameSize)
+    {
+        const off_t frames = mSourceSize / mFrameSize;
+        const off_t offset = (off_t)(sequence % frames) * mFrameSize;
+        if (pread(mSourceFd, dst, mFrameSize, offset) == (ssize_t)mFrameSize)
+        {
+            return;
+        }
+    }
+
+    // horizontal bands scrolling down, and a square crossing the frame
+    const int square_x = (sequence * 4) % (mWidth > kSquare ? mWidth - kSquare : 1);
+    const int square_y = (mHeight - kSquare) / 2;
+    for (int y = 0; y < mHeight; y++)
+    {
+        uint8_t* row = dst + y * mWidth;
+        memset(row, 16 + (((y + sequence * 2) >> 4) & 7) * 24, mWidth);
+        if (y >= square_y && y < square_y + kSquare && mWidth > kSquare)
+        {
+            memset(row + square_x, 235, kSquare);
+        }
+    }
+    memset(dst + y_size, 128, y_size / 2);
+}
+
+}; /* namespace android */
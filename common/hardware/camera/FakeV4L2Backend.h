@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HW_EMULATOR_CAMERA_FAKE_V4L2_BACKEND_H
+#define HW_EMULATOR_CAMERA_FAKE_V4L2_BACKEND_H
+
+/*
+ * Contains declaration of a class FakeV4L2Backend, a synthetic V4L2 capture
+ * device for running the camera HAL without a sensor.
+ */
+
+#include <stdint.h>
+#include <sys/time.h>
+#include <videodev2.h>
+#include <utils/threads.h>
+#include <utils/Timers.h>
+#include "V4L2Backend.h"
+
+namespace android {
+
+/* Behaves as a capture driver with NV21 / NV12 frames, MMAP and USERPTR
+ * buffers and non-blocking dequeue. Frames are produced at the rate set with
+ * VIDIOC_S_PARM, into the oldest queued buffer; a frame that finds no queued
+ * buffer is dropped, as a driver would.
+ *
+ * System properties, read on open:
+ *  - camera.fake.fps: frame rate, overrides VIDIOC_S_PARM
+ *  - camera.fake.jitter: each frame interval is moved by up to this many us
+ *  - camera.fake.file: raw frames of the capture size and format, played in
+ *    a loop instead of the generated pattern
+ */
+class FakeV4L2Backend : public V4L2Backend
+{
+public:
+    enum { MAX_BUFFERS = 8, MAX_WIDTH = 2592, MAX_HEIGHT = 1936 };
+
+    FakeV4L2Backend();
+    ~FakeV4L2Backend();
+
+    int open(const char* name);
+    void close();
+    int ioctl(int request, void* arg);
+    void* mmap(size_t length, off_t offset);
+    int munmap(void* addr, size_t length);
+    int waitFrame(int timeout_ms);
+
+    /* The offsets are made up, only user pointer buffers have a physical
+     * address. */
+    bool mmapIsPhysical() const { return false; }
+
+private:
+    struct Buffer {
+        uint8_t*        mem;            // V4L2_MEMORY_MMAP
+        unsigned long   userptr;        // V4L2_MEMORY_USERPTR
+        size_t          length;
+        bool            queued;
+        bool            done;
+        uint32_t        sequence;
+        struct timeval  timestamp;
+    };
+
+    int setFormat(struct v4l2_format* fmt, bool apply);
+    int reqBufs(struct v4l2_requestbuffers* rb);
+    int queryBuf(struct v4l2_buffer* buf);
+    int qBuf(struct v4l2_buffer* buf);
+    int dqBuf(struct v4l2_buffer* buf);
+    void freeBuffers();
+
+    /* Produces the frames due by 'now'. Called with the lock held. */
+    void produce(nsecs_t now);
+    void fillFrame(uint8_t* dst, uint32_t sequence);
+    nsecs_t nextInterval();
+
+    Mutex           mLock;
+    bool            mOpened;
+    int             mInput;
+
+    int             mWidth;
+    int             mHeight;
+    uint32_t        mFormat;
+    size_t          mFrameSize;
+    uint32_t        mNumerator;         // frame interval, in seconds
+    uint32_t        mDenominator;
+    uint32_t        mCaptureMode;
+    int             mFixedFps;          // camera.fake.fps, 0 if unset
+    nsecs_t         mJitter;            // camera.fake.jitter
+
+    int             mMemory;
+    Buffer          mBuffers[MAX_BUFFERS];
+    int             mBufferCount;
+    int             mQueue[MAX_BUFFERS];    // queued buffers, oldest first
+    int             mQueued;
+    int             mDone[MAX_BUFFERS];     // filled buffers, oldest first
+    int             mDoneCount;
+
+    bool            mStreaming;
+    nsecs_t         mNextFrame;         // CLOCK_MONOTONIC
+    uint32_t        mSequence;
+    uint32_t        mDropped;
+    unsigned int    mSeed;
+
+    int             mSourceFd;          // camera.fake.file, -1 if unset
+    off_t           mSourceSize;
+};
+
+}; /* namespace android */
+
+#endif  /* HW_EMULATOR_CAMERA_FAKE_V4L2_BACKEND_H */
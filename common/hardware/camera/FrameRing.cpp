@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Contains implementation of a class FrameRing.
+ */
+
+#define LOG_TAG "FrameRing"
+#include "CameraDebug.h"
+
+#include <string.h>
+#include <cutils/atomic.h>
+#include "FrameRing.h"
+
+namespace android {
+
+FrameRing::FrameRing()
+    : mHead(0),
+      mPushed(0),
+      mDropped(0),
+      mTail(0),
+      mWaiting(0),
+      mWakeups(0),
+      mWakeupRequest(false)
+{
+    memset(mSlots, 0, sizeof(mSlots));
+    pthread_mutex_init(&mMutex, NULL);
+    pthread_cond_init(&mCond, NULL);
+}
+
+FrameRing::~FrameRing()
+{
+    pthread_mutex_destroy(&mMutex);
+    pthread_cond_destroy(&mCond);
+}
+
+bool FrameRing::push(V4L2BUF_t* buf)
+{
+    const int32_t head = mHead;
+    const int32_t tail = android_atomic_acquire_load(&mTail);
+    if ((uint32_t)(head - tail) >= CAPACITY)
+    {
+        mDropped++;
+        return false;
+    }
+
+    mSlots[head & (CAPACITY - 1)] = buf;
+    android_atomic_release_store(head + 1, &mHead);
+    mPushed++;
+
+    // pairs with the barrier in waitPop(): either the consumer sees the new
+    // head, or we see it waiting
+    android_memory_barrier();
+    if (mWaiting)
+    {
+        pthread_mutex_lock(&mMutex);
+        pthread_cond_signal(&mCond);
+        pthread_mutex_unlock(&mMutex);
+    }
+
+    return true;
+}
+
+V4L2BUF_t* FrameRing::tryPop()
+{
+    const int32_t tail = mTail;
+    const int32_t head = android_atomic_acquire_load(&mHead);
+    if (head == tail)
+    {
+        return NULL;
+    }
+
+    V4L2BUF_t* buf = mSlots[tail & (CAPACITY - 1)];
+    android_atomic_release_store(tail + 1, &mTail);
+    return buf;
+}
+
+V4L2BUF_t* FrameRing::waitPop()
+{
+    V4L2BUF_t* buf = tryPop();
+    if (buf != NULL)
+    {
+        return buf;
+    }
+
+    pthread_mutex_lock(&mMutex);
+    mWaiting = 1;
+    android_memory_barrier();
+    while ((buf = tryPop()) == NULL && !mWakeupRequest)
+    {
+        pthread_cond_wait(&mCond, &mMutex);
+        mWakeups++;
+    }
+    mWaiting = 0;
+    mWakeupRequest = false;
+    pthread_mutex_unlock(&mMutex);
+
+    return buf;
+}
+
+void FrameRing::wakeup()
+{
+    pthread_mutex_lock(&mMutex);
+    mWakeupRequest = true;
+    pthread_cond_signal(&mCond);
+    pthread_mutex_unlock(&mMutex);
+}
+
+int FrameRing::count() const
+{
+    return android_atomic_acquire_load(&mHead) - android_atomic_acquire_load(&mTail);
+}
+
+}; /* namespace android */
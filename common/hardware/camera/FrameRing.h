@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HW_EMULATOR_CAMERA_FRAME_RING_H
+#define HW_EMULATOR_CAMERA_FRAME_RING_H
+
+/*
+ * Contains declaration of a class FrameRing that hands V4L2 frame descriptors
+ * from the capture thread to the preview thread.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <type_camera.h>
+
+namespace android {
+
+/* Fixed capacity, single producer / single consumer ring of V4L2BUF_t
+ * pointers. push() and tryPop() never take a lock; the consumer only sleeps
+ * on a condition when the ring is empty, and the producer only takes the
+ * lock to wake it up when the consumer is actually sleeping.
+ */
+class FrameRing {
+public:
+    /* Capacity, must be a power of 2 and not less than NB_BUFFER. */
+    enum { CAPACITY = 8 };
+
+    FrameRing();
+    ~FrameRing();
+
+    /* Producer side. Returns false if the ring is full. */
+    bool push(V4L2BUF_t* buf);
+
+    /* Consumer side. Returns NULL if the ring is empty. */
+    V4L2BUF_t* tryPop();
+
+    /* Consumer side. Waits until a frame is available, or wakeup() is
+     * called, in which case NULL is returned. */
+    V4L2BUF_t* waitPop();
+
+    /* Releases a consumer blocked in waitPop(), used on thread exit. */
+    void wakeup();
+
+    /* Number of frames in the ring, approximative if called from a thread
+     * other than the producer or the consumer. */
+    int count() const;
+
+    /* Statistics: frames pushed, pushes rejected because the ring was full
+     * and the number of times the consumer has been woken up. */
+    uint32_t getPushed() const { return mPushed; }
+    uint32_t getDropped() const { return mDropped; }
+    uint32_t getWakeups() const { return mWakeups; }
+
+private:
+    /* Keeps producer and consumer indexes on their own cache lines. */
+    enum { CACHE_LINE = 64 };
+
+    volatile int32_t    mHead;          // written by producer only
+    uint32_t            mPushed;
+    uint32_t            mDropped;
+    char                mPadHead[CACHE_LINE - sizeof(int32_t) - 2 * sizeof(uint32_t)];
+
+    volatile int32_t    mTail;          // written by consumer only
+    volatile int32_t    mWaiting;       // consumer sleeps on mCond
+    uint32_t            mWakeups;
+    char                mPadTail[CACHE_LINE - 3 * sizeof(int32_t)];
+
+    V4L2BUF_t*          mSlots[CAPACITY];
+
+    bool                mWakeupRequest;
+    pthread_mutex_t     mMutex;
+    pthread_cond_t      mCond;
+};
+
+}; /* namespace android */
+
+#endif  /* HW_EMULATOR_CAMERA_FRAME_RING_H */
@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Contains implementation of a class FrameScheduler that decides which
+ * captured frames are pushed to the SW preview window, from the backpressure
+ * of the frame consumers.
+ */
+
+#define LOG_TAG "Camera_FrameScheduler"
+#include "CameraDebug.h"
+
+#include <unistd.h>
+#include <utils/String8.h>
+#include "FrameScheduler.h"
+
+namespace android {
+
+/* Frame interval assumed until one is measured. */
+static const nsecs_t kDefaultInterval = 33333333LL;
+
+FrameScheduler::FrameScheduler()
+{
+    reset();
+}
+
+void FrameScheduler::reset()
+{
+    Mutex::Autolock locker(&mLock);
+    mStride = 1;
+    mCalmWindows = 0;
+    mFrame = 0;
+    mReason = "start";
+
+    mFrames = 0;
+    mDrops = 0;
+    mDepthSum = 0;
+    mQueued = 0;
+    mFirstQueued = 0;
+    mLastQueued = 0;
+    mCallbackTime = 0;
+    mCallbacks = 0;
+    mPreviewTime = 0;
+    mPreviews = 0;
+    mPreviewFailures = 0;
+
+    mLastInterval = 0;
+    mLastCallback = 0;
+    mLastPreview = 0;
+    mLastDepth10 = 0;
+
+    mTotalDrops = 0;
+    mTotalSkipped = 0;
+    mTotalFailures = 0;
+    mStrideChanges = 0;
+}
+
+void FrameScheduler::onQueued(int depth, bool dropped)
+{
+    const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    Mutex::Autolock locker(&mLock);
+    if (dropped)
+    {
+        mDrops++;
+        mTotalDrops++;
+    }
+    else
+    {
+        mDepthSum += depth;
+    }
+
+    if (mQueued++ == 0)
+    {
+        mFirstQueued = now;
+    }
+    mLastQueued = now;
+}
+
+bool FrameScheduler::shouldPreview()
+{
+    Mutex::Autolock locker(&mLock);
+    if (++mFrames >= WINDOW)
+    {
+        evaluate();
+    }
+
+    if ((mFrame++ % mStride) == 0)
+    {
+        return true;
+    }
+    mTotalSkipped++;
+    return false;
+}
+
+void FrameScheduler::onCallback(nsecs_t duration)
+{
+    Mutex::Autolock locker(&mLock);
+    mCallbackTime += duration;
+    mCallbacks++;
+}
+
+void FrameScheduler::onPreview(nsecs_t duration, bool ok)
+{
+    Mutex::Autolock locker(&mLock);
+    mPreviewTime += duration;
+    mPreviews++;
+    if (!ok)
+    {
+        mPreviewFailures++;
+        mTotalFailures++;
+    }
+}
+
+void FrameScheduler::evaluate()
+{
+    const nsecs_t interval = (mQueued > 1)
+        ? (mLastQueued - mFirstQueued) / (mQueued - 1) : kDefaultInterval;
+    const nsecs_t callback = mCallbacks ? mCallbackTime / mCallbacks : 0;
+    const nsecs_t preview = mPreviews ? mPreviewTime / mPreviews : 0;
+    const int queued = mQueued - mDrops;
+    const int depth10 = (queued > 0) ? mDepthSum * 10 / queued : 0;
+
+    // preview thread time per captured frame at the current stride
+    const nsecs_t load = callback + preview / mStride;
+
+    const char* pressure = NULL;
+    if (mDrops > 0)
+    {
+        pressure = "queue full";
+    }
+    else if (mPreviewFailures > 0)
+    {
+        pressure = "no preview buffer";
+    }
+    else if (depth10 >= 20)
+    {
+        pressure = "queue depth";
+    }
+    else if (load > interval * 9 / 10)
+    {
+        pressure = "preview thread load";
+    }
+
+    if (pressure != NULL)
+    {
+        mCalmWindows = 0;
+        if (mStride < MAX_STRIDE)
+        {
+            mStride++;
+            mStrideChanges++;
+            mReason = pressure;
+            LOGV("%s: preview stride %d, %s", __FUNCTION__, mStride, pressure);
+        }
+    }
+    else if (mStride > 1
+             && ++mCalmWindows >= 2
+             && callback + preview / (mStride - 1) < interval * 7 / 10)
+    {
+        mStride--;
+        mStrideChanges++;
+        mCalmWindows = 0;
+        mReason = "recovered";
+        LOGV("%s: preview stride %d, recovered", __FUNCTION__, mStride);
+    }
+
+    mLastInterval = interval;
+    mLastCallback = callback;
+    mLastPreview = preview;
+    mLastDepth10 = depth10;
+
+    mFrames = 0;
+    mDrops = 0;
+    mDepthSum = 0;
+    mQueued = 0;
+    mCallbackTime = 0;
+    mCallbacks = 0;
+    mPreviewTime = 0;
+    mPreviews = 0;
+    mPreviewFailures = 0;
+}
+
+void FrameScheduler::dump(int fd)
+{
+    String8 out;
+    {
+        Mutex::Autolock locker(&mLock);
+        out.appendFormat("Frame scheduler: preview 1 of %d frames (%s), callbacks every frame\n",
+                         mStride, mReason);
+        out.appendFormat("  last window: interval %lldus, callbacks %lldus, preview %lldus, "
+                         "queue depth %d.%d\n",
+                         mLastInterval / 1000, mLastCallback / 1000, mLastPreview / 1000,
+                         mLastDepth10 / 10, mLastDepth10 % 10);
+        out.appendFormat("  total: %u dropped (queue full), %u not previewed, "
+                         "%u preview buffer failures, %u stride changes\n",
+                         mTotalDrops, mTotalSkipped, mTotalFailures, mStrideChanges);
+    }
+    write(fd, out.string(), out.size());
+}
+
+}; /* namespace android */
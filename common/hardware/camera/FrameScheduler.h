@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HW_EMULATOR_CAMERA_FRAME_SCHEDULER_H
+#define HW_EMULATOR_CAMERA_FRAME_SCHEDULER_H
+
+/*
+ * Contains declaration of a class FrameScheduler that decides which captured
+ * frames are pushed to the SW preview window, from the backpressure of the
+ * frame consumers.
+ */
+
+#include <stdint.h>
+#include <utils/threads.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+/* Frame callbacks, which carry the recording frames, are never skipped. The
+ * preview window gets one frame out of 'stride'. Every WINDOW frames the
+ * stride is raised if frames were dropped because the preview queue was full,
+ * if the queue stayed deep, if the preview window failed to give a buffer, or
+ * if the callbacks plus the preview share of a frame no longer fit in the
+ * frame interval. It is lowered again once two windows in a row were calm and
+ * the lower stride is expected to fit with some margin.
+ */
+class FrameScheduler
+{
+public:
+    enum { MAX_STRIDE = 4, WINDOW = 30 };
+
+    FrameScheduler();
+
+    /* Starts over at full preview rate. */
+    void reset();
+
+    /* Capture thread: a frame was queued for the preview thread, or dropped
+     * because the queue was full. 'depth' is the queue depth after the push. */
+    void onQueued(int depth, bool dropped);
+
+    /* Preview thread, once per frame: returns true if this frame should be
+     * pushed to the preview window. */
+    bool shouldPreview();
+
+    /* Preview thread: time spent in the frame callbacks. */
+    void onCallback(nsecs_t duration);
+
+    /* Preview thread: time spent pushing a frame to the preview window, and
+     * whether a preview buffer could be obtained. */
+    void onPreview(nsecs_t duration, bool ok);
+
+    int getPreviewStride()
+    {
+        Mutex::Autolock locker(&mLock);
+        return mStride;
+    }
+
+    /* Prints the current decision and its inputs to a file descriptor. */
+    void dump(int fd);
+
+private:
+    void evaluate();
+
+    Mutex           mLock;
+    int             mStride;
+    int             mCalmWindows;       // windows in a row without pressure
+    uint32_t        mFrame;             // frames seen by shouldPreview()
+    const char*     mReason;            // why the stride last changed
+
+    /* Current window. */
+    int             mFrames;
+    int             mDrops;
+    int             mDepthSum;
+    int             mQueued;
+    nsecs_t         mFirstQueued;
+    nsecs_t         mLastQueued;
+    nsecs_t         mCallbackTime;
+    int             mCallbacks;
+    nsecs_t         mPreviewTime;
+    int             mPreviews;
+    int             mPreviewFailures;
+
+    /* Last evaluated window, for dump(). */
+    nsecs_t         mLastInterval;
+    nsecs_t         mLastCallback;
+    nsecs_t         mLastPreview;
+    int             mLastDepth10;       // average depth * 10
+
+    /* Since reset(). */
+    uint32_t        mTotalDrops;
+    uint32_t        mTotalSkipped;
+    uint32_t        mTotalFailures;
+    uint32_t        mStrideChanges;
+};
+
+}; /* namespace android */
+
+#endif  /* HW_EMULATOR_CAMERA_FRAME_SCHEDULER_H */
@@ -0,0 +1,276 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Contains implementation of a class FrameTracer that records when each
+ * captured frame goes through the stages of the camera HAL.
+ */
+
+#define LOG_TAG "Camera_FrameTracer"
+#include "CameraDebug.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <utils/String8.h>
+#include "FrameTracer.h"
+
+namespace android {
+
+static const char* const kStageNames[FrameTracer::STAGE_COUNT] = {
+    "dqbuf",
+    "queued",
+    "preview-thread",
+    "callback",
+    "preview",
+    "released",
+};
+
+/* Upper bounds of the histogram buckets, in microseconds. The last bucket
+ * gets everything above. */
+static const nsecs_t kBuckets[] = { 1000, 2000, 4000, 8000, 16000, 33000, 66000, 133000 };
+static const int kBucketCount = sizeof(kBuckets) / sizeof(kBuckets[0]) + 1;
+
+FrameTracer::FrameTracer()
+{
+    reset();
+}
+
+void FrameTracer::reset()
+{
+    Mutex::Autolock locker(&mLock);
+    memset(mRecords, 0, sizeof(mRecords));
+    for (int i = 0; i < MAX_BUFFERS; i++)
+    {
+        mSlots[i] = -1;
+    }
+    mSeq = 0;
+}
+
+void FrameTracer::start(int buffer)
+{
+    if (buffer < 0 || buffer >= MAX_BUFFERS)
+    {
+        return;
+    }
+
+    const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    Mutex::Autolock locker(&mLock);
+    const int slot = mSeq % MAX_FRAMES;
+
+    // the record being overwritten may still belong to a buffer
+    for (int i = 0; i < MAX_BUFFERS; i++)
+    {
+        if (mSlots[i] == slot)
+        {
+            mSlots[i] = -1;
+        }
+    }
+
+    Record* r = &mRecords[slot];
+    memset(r, 0, sizeof(*r));
+    r->seq = mSeq++;
+    r->buffer = buffer;
+    r->time[STAGE_DQBUF] = now;
+    mSlots[buffer] = slot;
+}
+
+FrameTracer::Record* FrameTracer::find(int buffer)
+{
+    if (buffer < 0 || buffer >= MAX_BUFFERS || mSlots[buffer] < 0)
+    {
+        return NULL;
+    }
+    return &mRecords[mSlots[buffer]];
+}
+
+void FrameTracer::mark(int buffer, int stage)
+{
+    const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    Mutex::Autolock locker(&mLock);
+    Record* r = find(buffer);
+    if (r == NULL)
+    {
+        return;
+    }
+
+    r->time[stage] = now;
+    if (stage == STAGE_RELEASED)
+    {
+        mSlots[buffer] = -1;
+    }
+}
+
+void FrameTracer::flag(int buffer, int flags)
+{
+    Mutex::Autolock locker(&mLock);
+    Record* r = find(buffer);
+    if (r != NULL)
+    {
+        r->flags |= flags;
+    }
+}
+
+static int Bucket(nsecs_t us)
+{
+    int i = 0;
+    while (i < kBucketCount - 1 && us >= kBuckets[i])
+    {
+        i++;
+    }
+    return i;
+}
+
+static void AppendHistogram(String8* out, const char* name, const uint32_t* hist,
+                            uint32_t count, nsecs_t total, nsecs_t max)
+{
+    out->appendFormat("  %-28s n=%-4u avg=%6lldus max=%6lldus |", name, count,
+                      count ? total / count : 0LL, max);
+    for (int i = 0; i < kBucketCount; i++)
+    {
+        out->appendFormat(" %4u", hist[i]);
+    }
+    out->append("\n");
+}
+
+void FrameTracer::dump(int fd)
+{
+    Record* records = (Record*)malloc(sizeof(mRecords));
+    if (records == NULL)
+    {
+        return;
+    }
+
+    uint32_t seq;
+    {
+        Mutex::Autolock locker(&mLock);
+        memcpy(records, mRecords, sizeof(mRecords));
+        seq = mSeq;
+    }
+
+    const uint32_t first = (seq > MAX_FRAMES) ? seq - MAX_FRAMES : 0;
+    String8 out;
+    out.appendFormat("Frame trace: %u frames, last %u kept\n", seq, seq - first);
+
+    out.append("  histogram buckets (ms):");
+    for (int i = 0; i < kBucketCount - 1; i++)
+    {
+        out.appendFormat(" <%lld", kBuckets[i] / 1000);
+    }
+    out.append(" more\n");
+
+    // time between consecutive stages, then from dequeue to release, then
+    // between two dequeued frames
+    enum { SPANS = STAGE_COUNT + 1 };
+    uint32_t hist[SPANS][kBucketCount];
+    uint32_t count[SPANS];
+    nsecs_t total[SPANS];
+    nsecs_t max[SPANS];
+    memset(hist, 0, sizeof(hist));
+    memset(count, 0, sizeof(count));
+    memset(total, 0, sizeof(total));
+    memset(max, 0, sizeof(max));
+
+    uint32_t skipped = 0, dropped = 0;
+    nsecs_t last_dqbuf = 0;
+    for (uint32_t s = first; s < seq; s++)
+    {
+        const Record* r = &records[s % MAX_FRAMES];
+        if (r->flags & FLAG_PREVIEW_SKIPPED)
+        {
+            skipped++;
+        }
+        if (r->flags & FLAG_DROPPED)
+        {
+            dropped++;
+        }
+
+        nsecs_t prev = r->time[STAGE_DQBUF];
+        for (int i = 1; i < STAGE_COUNT; i++)
+        {
+            if (r->time[i] == 0)
+            {
+                continue;
+            }
+            const int span = i - 1;
+            const nsecs_t us = (r->time[i] - prev) / 1000;
+            hist[span][Bucket(us)]++;
+            count[span]++;
+            total[span] += us;
+            if (us > max[span])
+            {
+                max[span] = us;
+            }
+            prev = r->time[i];
+        }
+
+        const nsecs_t spans[2] = {
+            r->time[STAGE_RELEASED] ? (r->time[STAGE_RELEASED] - r->time[STAGE_DQBUF]) / 1000 : -1,
+            last_dqbuf ? (r->time[STAGE_DQBUF] - last_dqbuf) / 1000 : -1,
+        };
+        for (int i = 0; i < 2; i++)
+        {
+            if (spans[i] < 0)
+            {
+                continue;
+            }
+            const int k = STAGE_COUNT - 1 + i;
+            hist[k][Bucket(spans[i])]++;
+            count[k]++;
+            total[k] += spans[i];
+            if (spans[i] > max[k])
+            {
+                max[k] = spans[i];
+            }
+        }
+        last_dqbuf = r->time[STAGE_DQBUF];
+    }
+
+    char name[64];
+    for (int i = 1; i < STAGE_COUNT; i++)
+    {
+        snprintf(name, sizeof(name), "-> %s", kStageNames[i]);
+        AppendHistogram(&out, name, hist[i - 1], count[i - 1], total[i - 1], max[i - 1]);
+    }
+    AppendHistogram(&out, "dqbuf -> released", hist[STAGE_COUNT - 1],
+                    count[STAGE_COUNT - 1], total[STAGE_COUNT - 1], max[STAGE_COUNT - 1]);
+    AppendHistogram(&out, "frame interval", hist[STAGE_COUNT],
+                    count[STAGE_COUNT], total[STAGE_COUNT], max[STAGE_COUNT]);
+    out.appendFormat("  preview skipped by pacing: %u, dropped (queue full): %u\n",
+                     skipped, dropped);
+
+    out.append("  frame,seq,buffer,flags");
+    for (int i = 0; i < STAGE_COUNT; i++)
+    {
+        out.appendFormat(",%s", kStageNames[i]);
+    }
+    out.append("\n");
+    for (uint32_t s = first; s < seq; s++)
+    {
+        const Record* r = &records[s % MAX_FRAMES];
+        out.appendFormat("  frame,%u,%d,%d", r->seq, r->buffer, r->flags);
+        for (int i = 0; i < STAGE_COUNT; i++)
+        {
+            out.appendFormat(",%lld", r->time[i] / 1000);
+        }
+        out.append("\n");
+    }
+
+    free(records);
+    write(fd, out.string(), out.size());
+}
+
+}; /* namespace android */
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HW_EMULATOR_CAMERA_FRAME_TRACER_H
+#define HW_EMULATOR_CAMERA_FRAME_TRACER_H
+
+/*
+ * Contains declaration of a class FrameTracer that records when each captured
+ * frame goes through the stages of the camera HAL.
+ */
+
+#include <stdint.h>
+#include <utils/threads.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+/* A record is started when a buffer is dequeued from the driver, and is then
+ * found by the buffer index until the buffer is queued back. The last
+ * MAX_FRAMES records are kept in a ring.
+ *
+ * dump() prints a histogram of the time spent between consecutive stages,
+ * followed by the raw records, one per line:
+ *
+ *     frame,<seq>,<buffer>,<flags>,<stage 0 us>,...,<stage N us>
+ *
+ * Times are CLOCK_MONOTONIC microseconds, 0 when the frame did not go through
+ * the stage, so a host tool can lay the frames out on a timeline.
+ */
+class FrameTracer
+{
+public:
+    enum Stage {
+        STAGE_DQBUF = 0,        // dequeued from the driver
+        STAGE_QUEUED,           // converted and queued for the preview thread
+        STAGE_PREVIEW_THREAD,   // picked up by the preview thread
+        STAGE_CALLBACK,         // frame callbacks done
+        STAGE_PREVIEW,          // pushed to the preview window
+        STAGE_RELEASED,         // queued back to the driver
+        STAGE_COUNT
+    };
+
+    enum Flags {
+        FLAG_PREVIEW_SKIPPED = 1,   // not previewed, too early
+        FLAG_DROPPED = 2,           // the preview queue was full
+    };
+
+    enum { MAX_FRAMES = 256, MAX_BUFFERS = 8 };
+
+    FrameTracer();
+
+    /* Starts the record of a frame just dequeued into 'buffer'. */
+    void start(int buffer);
+
+    /* Records that the frame in 'buffer' reached 'stage'. */
+    void mark(int buffer, int stage);
+
+    /* Sets 'flags' on the record of the frame in 'buffer'. */
+    void flag(int buffer, int flags);
+
+    /* Drops all records. */
+    void reset();
+
+    /* Prints the histograms and the records to a file descriptor. */
+    void dump(int fd);
+
+private:
+    struct Record {
+        uint32_t    seq;
+        int         buffer;
+        int         flags;
+        nsecs_t     time[STAGE_COUNT];
+    };
+
+    Record* find(int buffer);
+
+    Mutex       mLock;
+    Record      mRecords[MAX_FRAMES];
+    int         mSlots[MAX_BUFFERS];    // record of each buffer, -1 if none
+    uint32_t    mSeq;                   // records started
+};
+
+}; /* namespace android */
+
+#endif  /* HW_EMULATOR_CAMERA_FRAME_TRACER_H */
@@ -39,7 +39,9 @@ namespace android {
 HALCameraFactory::HALCameraFactory()
         : mHardwareCameras(NULL),
           mCameraHardwareNum(0),
-          mConstructedOK(false)
+          mConstructedOK(false),
+          mHardwareUsers(0),
+          mReserved(NULL)
 {
 	F_LOG;
 
@@ -68,6 +70,9 @@ HALCameraFactory::HALCameraFactory()
         memset(mHardwareCameras, 0, mCameraHardwareNum * sizeof(CameraHardware*));
     }
 
+    mReserved = new size_t[mCameraHardwareNum * CAMERA_MEM_POOLS];
+    memset(mReserved, 0, mCameraHardwareNum * CAMERA_MEM_POOLS * sizeof(size_t));
+
     /* Create, and initialize the fake camera */
 	for (int id = 0; id < mCameraHardwareNum; id++)
 	{
@@ -96,6 +101,7 @@ HALCameraFactory::~HALCameraFactory()
         }
         delete[] mHardwareCameras;
     }
+    delete[] mReserved;
 }
 
 /****************************************************************************
@@ -123,6 +129,21 @@ int HALCameraFactory::cameraDeviceOpen(int camera_id, hw_device_t** device)
         return -EINVAL;
     }
 
+	// cameras on the same device node share one CSI, only one of them can
+	// stream at a time
+	for (int id = 0; id < getCameraHardwareNum(); id++)
+	{
+		V4L2CameraDevice* dev = mHardwareCameras[id]->getCameraDevice();
+		if (id != camera_id && dev != NULL && dev->isConnected()
+			&& !strcmp(mHardwareCameras[id]->getDeviceName(),
+					   mHardwareCameras[camera_id]->getDeviceName()))
+		{
+			LOGE("%s: camera %d shares %s with the opened camera %d",
+				__FUNCTION__, camera_id, mHardwareCameras[id]->getDeviceName(), id);
+			return -EBUSY;
+		}
+	}
+
 	if (mHardwareCameras[camera_id]->Initialize() != NO_ERROR) 
 	{
 		LOGE("%s: Unable to Initialize camera class", __FUNCTION__);
@@ -150,6 +171,86 @@ int HALCameraFactory::getCameraInfo(int camera_id, struct camera_info* info)
     return mHardwareCameras[camera_id]->getCameraInfo(info);
 }
 
+/****************************************************************************
+ * Resources shared by the cameras streaming at the same time.
+ ***************************************************************************/
+
+status_t HALCameraFactory::acquireHardware()
+{
+    Mutex::Autolock locker(&mResourceLock);
+    if (mHardwareUsers == 0) {
+        if (cedarx_hardware_init(2) < 0) {  // CEDARX_HARDWARE_MODE_VIDEO
+            LOGE("%s: cedarx_hardware_init failed", __FUNCTION__);
+            return UNKNOWN_ERROR;
+        }
+        LOGV("cedarx_hardware_init ok");
+    }
+    mHardwareUsers++;
+    return NO_ERROR;
+}
+
+void HALCameraFactory::releaseHardware()
+{
+    Mutex::Autolock locker(&mResourceLock);
+    if (mHardwareUsers <= 0) {
+        LOGW("%s: not acquired", __FUNCTION__);
+        return;
+    }
+    if (--mHardwareUsers == 0) {
+        if (cedarx_hardware_exit(2) < 0) {  // CEDARX_HARDWARE_MODE_VIDEO
+            LOGE("%s: cedarx_hardware_exit failed", __FUNCTION__);
+        }
+        LOGD("cedarx_hardware_exit ok");
+    }
+}
+
+int HALCameraFactory::reserveBuffers(int camera_id, int pool, size_t buffer_size,
+                                     int wanted, int minimum)
+{
+    if (camera_id < 0 || camera_id >= getCameraHardwareNum()
+        || pool < 0 || pool >= CAMERA_MEM_POOLS || buffer_size == 0) {
+        return -1;
+    }
+
+    Mutex::Autolock locker(&mResourceLock);
+    const int slot = camera_id * CAMERA_MEM_POOLS + pool;
+    size_t used = 0;
+    for (int i = 0; i < getCameraHardwareNum() * CAMERA_MEM_POOLS; i++) {
+        if (i != slot) {
+            used += mReserved[i];
+        }
+    }
+
+    const size_t left = (used < CAMERA_MEM_BUDGET) ? CAMERA_MEM_BUDGET - used : 0;
+    int count = wanted;
+    if (count * buffer_size > left) {
+        count = left / buffer_size;
+    }
+    if (count < minimum) {
+        LOGE("%s: camera %d pool %d needs %d x %d bytes, %d left",
+             __FUNCTION__, camera_id, pool, minimum, (int)buffer_size, (int)left);
+        return -1;
+    }
+
+    if (count < wanted) {
+        LOGW("%s: camera %d pool %d gets %d of %d buffers, %d bytes used elsewhere",
+             __FUNCTION__, camera_id, pool, count, wanted, (int)used);
+    }
+    mReserved[slot] = count * buffer_size;
+    return count;
+}
+
+void HALCameraFactory::releaseBuffers(int camera_id, int pool)
+{
+    if (camera_id < 0 || camera_id >= getCameraHardwareNum()
+        || pool < 0 || pool >= CAMERA_MEM_POOLS) {
+        return;
+    }
+
+    Mutex::Autolock locker(&mResourceLock);
+    mReserved[camera_id * CAMERA_MEM_POOLS + pool] = 0;
+}
+
 /****************************************************************************
  * Camera HAL API callbacks.
  ***************************************************************************/
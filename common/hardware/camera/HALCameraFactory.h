@@ -20,6 +20,18 @@
 #include "CCameraConfig.h"
 #include "CameraHardware.h"
 
+/* Physically contiguous memory the capture buffers of all the cameras may
+ * take at once, out of the memory reserved for the video engine. */
+#define CAMERA_MEM_BUDGET		(32 * 1024 * 1024)
+
+/* What a camera reserves memory for, each with its own reservation. */
+enum {
+	CAMERA_MEM_CAPTURE = 0,		// capture buffers, and their NV21 copies
+	CAMERA_MEM_ZOOM,			// preview zoom buffer
+	CAMERA_MEM_SPARE,			// copies lent to a slow encoder
+	CAMERA_MEM_POOLS,
+};
+
 namespace android {
 
 /*
@@ -113,6 +125,25 @@ public:
         return mConstructedOK;
     }
 
+    /****************************************************************************
+     * Resources shared by the cameras streaming at the same time.
+     ***************************************************************************/
+
+    /* The video engine is set up by the first connected camera, and shut down
+     * with the last one.
+     */
+    status_t acquireHardware();
+    void releaseHardware();
+
+    /* Reserves physically contiguous memory for the buffers of 'pool'
+     * (CAMERA_MEM_xxx) of a camera, replacing its previous reservation for
+     * that pool. Returns how many of 'wanted' buffers of 'buffer_size' bytes
+     * fit in what the other reservations left of CAMERA_MEM_BUDGET, or -1 if
+     * not even 'minimum' do.
+     */
+    int reserveBuffers(int camera_id, int pool, size_t buffer_size, int wanted, int minimum);
+    void releaseBuffers(int camera_id, int pool);
+
     /****************************************************************************
      * Data members.
      ***************************************************************************/
@@ -132,6 +163,10 @@ private:
 
 	// Camera Config information
 	CCameraConfig *		mCameraConfig;
+
+	Mutex				mResourceLock;
+	int					mHardwareUsers;		// connected cameras
+	size_t *			mReserved;			// bytes of each camera and pool
 	
 public:
     /* Contains device open entry point, as required by HAL API. */
@@ -23,6 +23,7 @@
 #include "CameraDebug.h"
 
 #include "JpegCompressor.h"
+#include "StripeJpegEncoder.h"
 
 namespace android {
 
@@ -45,6 +46,21 @@ status_t NV21JpegCompressor::compressRawImage(const void* image,
                                               int quality)
 {
     LOGV("%s: %p[%dx%d]", __FUNCTION__, image, width, height);
+
+    /* Encode stripes of the image in parallel when there are several cores. */
+    const int threads = StripeJpegEncoder::getDefaultThreads();
+    if (threads > 1) {
+        StripeJpegEncoder encoder;
+        if (encoder.encode(image, width, height, quality, threads) == NO_ERROR) {
+            mStream.write(encoder.getData(), encoder.getSize());
+            LOGV("%s: Compressed JPEG on %d threads: %d[%dx%d] -> %d bytes",
+                 __FUNCTION__, threads, (width * height * 12) / 8, width, height,
+                 mStream.getOffset());
+            return NO_ERROR;
+        }
+        LOGW("%s: Stripe encoder failed, use single thread encoder", __FUNCTION__);
+    }
+
     void* pY = const_cast<void*>(image);
     int offsets[2];
     offsets[0] = 0;
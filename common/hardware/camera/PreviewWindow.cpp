@@ -34,38 +34,17 @@
 
 #include "V4L2Camera.h"
 #include "PreviewWindow.h"
+#include "Converters.h"
 
 namespace android {
 
-static void NV12ToNV21(const void* nv12, void* nv21, int width, int height)
-{	
-	char * src_uv = (char *)nv12 + width * height;
-	char * dst_uv = (char *)nv21 + width * height;
-
-	memcpy(nv21, nv12, width * height);
-
-	for(int i = 0; i < width * height / 2; i += 2)
-	{
-		*(dst_uv + i) = *(src_uv + i + 1);
-		*(dst_uv + i + 1) = *(src_uv + i);
-	}
-}
-
-static void NV12ToNV21_shift(const void* nv12, void* nv21, int width, int height)
-{	
-	char * src_uv = (char *)nv12 + width * height;
-	char * dst_uv = (char *)nv21 + width * height;
-
-	memcpy(nv21, nv12, width * height);
-	memcpy(dst_uv, src_uv + 1, width * height / 2 - 1);
-}
-
 PreviewWindow::PreviewWindow()
     : mPreviewWindow(NULL),
       mPreviewFrameWidth(0),
       mPreviewFrameHeight(0),
       mPreviewEnabled(false),
       mOverlayFirstFrame(true),
+      mOverlayLastTimestamp(0),
       mShouldAdjustDimensions(true),
       mLayerFormat(-1),
       mScreenID(0),
@@ -121,6 +100,7 @@ status_t PreviewWindow::startPreview()
     Mutex::Autolock locker(&mObjectLock);
     mPreviewEnabled = true;
 	mOverlayFirstFrame = true;
+	mOverlayLastTimestamp = 0;
 	
     return NO_ERROR;
 }
@@ -207,6 +187,16 @@ bool PreviewWindow::onNextFrameAvailableHW(const void* frame,
 	overlay_para.bTopFieldFirst = 1;
 	overlay_para.pVideoInfo.frame_rate = 25000;
 
+	// the hwcomposer paces the frames it queues at this rate, give it the
+	// one the sensor runs at
+	if (mOverlayLastTimestamp != 0
+		&& timestamp > mOverlayLastTimestamp
+		&& timestamp - mOverlayLastTimestamp < 1000000000LL)
+	{
+		overlay_para.pVideoInfo.frame_rate = (int)(1000000000000LL / (timestamp - mOverlayLastTimestamp));
+	}
+	mOverlayLastTimestamp = timestamp;
+
 	overlay_para.top_y 		= (unsigned int)pv4l2_buf->addrPhyY;
 	overlay_para.top_c 		= (unsigned int)pv4l2_buf->addrPhyY + mPreviewFrameWidth * mPreviewFrameHeight;
 	overlay_para.bottom_y 	= 0;
@@ -300,15 +290,11 @@ bool PreviewWindow::onNextFrameAvailableSW(const void* frame,
 	        return false;
 	    }
 
+		// frames are zoomed by the camera device already
 		mPreviewWindow->set_crop(mPreviewWindow, 
-			mRectCrop.left, mRectCrop.top, mRectCrop.right, mRectCrop.bottom);
+			0, 0, mPreviewFrameWidth, mPreviewFrameHeight);
 
 		mNewCrop = false;
-
-		LOGV("first sw: [%d, %d, %d, %d]", mRectCrop.left,
-										mRectCrop.top,
-										mRectCrop.right,
-										mRectCrop.bottom);
     }
 
     /*
@@ -352,21 +338,28 @@ bool PreviewWindow::onNextFrameAvailableSW(const void* frame,
         return false;
     }
 
-	if (mNewCrop)
+	// copied straight into the window buffer, row by row if it is padded
+	if (stride < mPreviewFrameWidth)
 	{
-		mPreviewWindow->set_crop(mPreviewWindow, 
-			mRectCrop.left, mRectCrop.top, mRectCrop.right, mRectCrop.bottom);
-
-		mNewCrop = false;
+		stride = mPreviewFrameWidth;
 	}
-
-	if (video_fmt == V4L2_PIX_FMT_NV21)
+	if (video_fmt == V4L2_PIX_FMT_NV21 && stride == mPreviewFrameWidth)
 	{
 		memcpy(img, frame, mPreviewFrameWidth * mPreviewFrameHeight * 3/2);
 	}
+	else if (video_fmt == V4L2_PIX_FMT_NV21)
+	{
+		const uint8_t* src = (const uint8_t*)frame;
+		uint8_t* dst = (uint8_t*)img;
+		for (int r = 0; r < mPreviewFrameHeight * 3 / 2; r++)
+		{
+			memcpy(dst + r * stride, src + r * mPreviewFrameWidth, mPreviewFrameWidth);
+		}
+	}
 	else
 	{
-		NV12ToNV21_shift(frame, img, mPreviewFrameWidth, mPreviewFrameHeight);
+		NV12ToNV21(frame, mPreviewFrameWidth, img, stride,
+				   mPreviewFrameWidth, mPreviewFrameHeight);
 	}
 	mPreviewWindow->enqueue_buffer(mPreviewWindow, buffer);
 
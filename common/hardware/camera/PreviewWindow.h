@@ -184,6 +184,7 @@ public:
 
 protected:
 	bool							mOverlayFirstFrame;
+	nsecs_t							mOverlayLastTimestamp;	// of the last frame sent to the overlay
 	bool							mShouldAdjustDimensions;
 	int								mLayerShowHW;
 	int								mLayerFormat;
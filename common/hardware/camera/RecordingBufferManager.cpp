@@ -0,0 +1,348 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Contains implementation of a class RecordingBufferManager.
+ */
+
+#define LOG_TAG "Camera_RecordingBufferManager"
+#include "CameraDebug.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <utils/String8.h>
+#include "CameraCommon.h"
+#include "HALCameraFactory.h"
+#include "RecordingBufferManager.h"
+
+namespace android {
+
+/* Upper bounds of the hold time histogram buckets, in us. */
+static const nsecs_t kBuckets[] = { 33000, 66000, 100000, 200000, 500000 };
+static const int kBucketCount = sizeof(kBuckets) / sizeof(kBuckets[0]) + 1;
+
+RecordingBufferManager::RecordingBufferManager()
+    : mActive(false),
+      mCameraId(-1),
+      mCount(0),
+      mEncoderHeld(0),
+      mZeroCopy(0),
+      mLent(0),
+      mSkipped(0),
+      mMaxEncoderHeld(0)
+{
+    memset(mBuffers, 0, sizeof(mBuffers));
+    memset(mLoans, 0, sizeof(mLoans));
+    memset(&mPreviewHold, 0, sizeof(mPreviewHold));
+    memset(&mEncoderHold, 0, sizeof(mEncoderHold));
+    memset(&mLoanHold, 0, sizeof(mLoanHold));
+    memset(mBufferHold, 0, sizeof(mBufferHold));
+}
+
+RecordingBufferManager::~RecordingBufferManager()
+{
+    for (int i = 0; i < MAX_LOANS; i++)
+    {
+        mLoans[i].busy = false;
+    }
+    freeLoans();
+}
+
+void RecordingBufferManager::start(int count, int camera_id)
+{
+    Mutex::Autolock locker(&mLock);
+    mActive = true;
+    mCameraId = camera_id;
+    mCount = (count > MAX_BUFFERS) ? MAX_BUFFERS : count;
+    memset(mBuffers, 0, sizeof(mBuffers));
+    mEncoderHeld = 0;
+
+    memset(&mPreviewHold, 0, sizeof(mPreviewHold));
+    memset(&mEncoderHold, 0, sizeof(mEncoderHold));
+    memset(&mLoanHold, 0, sizeof(mLoanHold));
+    memset(mBufferHold, 0, sizeof(mBufferHold));
+    mZeroCopy = 0;
+    mLent = 0;
+    mSkipped = 0;
+    mMaxEncoderHeld = 0;
+}
+
+void RecordingBufferManager::stop()
+{
+    Mutex::Autolock locker(&mLock);
+    if (!mActive)
+    {
+        return;
+    }
+
+    if (mEncoderHeld > 0 || mLent > 0 || mSkipped > 0)
+    {
+        LOGD("%s: %u frames zero-copy, %u lent, %u skipped, encoder held up to %d buffers",
+             __FUNCTION__, mZeroCopy, mLent, mSkipped, mMaxEncoderHeld);
+    }
+    mActive = false;
+    mCount = 0;
+    mEncoderHeld = 0;
+
+    // a loan still held by the encoder is freed when it comes back
+    freeLoans();
+}
+
+void RecordingBufferManager::onDequeued(int index)
+{
+    Mutex::Autolock locker(&mLock);
+    if (!mActive || index < 0 || index >= mCount)
+    {
+        return;
+    }
+
+    Buffer* b = &mBuffers[index];
+    LOGW_IF(b->holders != 0, "%s: buffer %d dequeued while held (%x)",
+            __FUNCTION__, index, b->holders);
+    b->holders = HOLDER_PREVIEW;
+    b->since = systemTime(SYSTEM_TIME_MONOTONIC);
+}
+
+const V4L2BUF_t* RecordingBufferManager::lendToEncoder(const V4L2BUF_t* frame)
+{
+    Mutex::Autolock locker(&mLock);
+    const int index = frame->index;
+    if (!mActive || index < 0 || index >= mCount)
+    {
+        return frame;
+    }
+
+    Buffer* b = &mBuffers[index];
+    if (mEncoderHeld + 1 <= mCount - MIN_AWAY_FROM_ENCODER)
+    {
+        b->holders |= HOLDER_ENCODER;
+        b->since = systemTime(SYSTEM_TIME_MONOTONIC);
+        mEncoderHeld++;
+        if (mEncoderHeld > mMaxEncoderHeld)
+        {
+            mMaxEncoderHeld = mEncoderHeld;
+        }
+        mZeroCopy++;
+        return frame;
+    }
+
+    // the encoder is behind, keep the capture buffer for the driver
+    const size_t size = frame->width * frame->height * 3 / 2;
+    Loan* loan = getLoan(size);
+    if (loan == NULL)
+    {
+        mSkipped++;
+        return NULL;
+    }
+
+    memcpy(loan->vir, (const void*)frame->addrVirY, size);
+    loan->busy = true;
+    loan->since = systemTime(SYSTEM_TIME_MONOTONIC);
+    loan->frame = *frame;
+    loan->frame.addrPhyY = loan->phy;
+    loan->frame.addrVirY = (unsigned int)loan->vir;
+    loan->frame.index = LOAN_INDEX_BASE + (loan - mLoans);
+    mLent++;
+    return &loan->frame;
+}
+
+bool RecordingBufferManager::release(int index, Holder holder)
+{
+    Mutex::Autolock locker(&mLock);
+    if (index >= LOAN_INDEX_BASE && index < LOAN_INDEX_BASE + MAX_LOANS)
+    {
+        Loan* loan = &mLoans[index - LOAN_INDEX_BASE];
+        if (loan->busy)
+        {
+            addHold(&mLoanHold, loan->since);
+            loan->busy = false;
+        }
+        if (!mActive)
+        {
+            freeLoans();
+        }
+        return false;
+    }
+
+    if (!mActive)
+    {
+        return false;
+    }
+    if (index < 0 || index >= mCount)
+    {
+        return false;
+    }
+
+    Buffer* b = &mBuffers[index];
+    if ((b->holders & holder) == 0)
+    {
+        // the encoder releasing a frame twice, or a frame of a past stream
+        return false;
+    }
+
+    b->holders &= ~holder;
+    if (holder == HOLDER_ENCODER)
+    {
+        mEncoderHeld--;
+        addHold(&mEncoderHold, b->since);
+        addHold(&mBufferHold[index], b->since);
+    }
+    else
+    {
+        addHold(&mPreviewHold, b->since);
+    }
+    return (b->holders == 0);
+}
+
+void RecordingBufferManager::addHold(HoldStats* stats, nsecs_t since)
+{
+    const nsecs_t us = (systemTime(SYSTEM_TIME_MONOTONIC) - since) / 1000;
+    int bucket = 0;
+    while (bucket < kBucketCount - 1 && us >= kBuckets[bucket])
+    {
+        bucket++;
+    }
+    stats->hist[bucket]++;
+    stats->count++;
+    stats->total += us;
+    if (us > stats->max)
+    {
+        stats->max = us;
+    }
+}
+
+RecordingBufferManager::Loan* RecordingBufferManager::getLoan(size_t size)
+{
+    for (int i = 0; i < MAX_LOANS; i++)
+    {
+        Loan* loan = &mLoans[i];
+        if (loan->busy)
+        {
+            continue;
+        }
+        if (loan->vir != NULL && loan->size != size)
+        {
+            cedara_phyfree_map(loan->vir);
+            loan->vir = NULL;
+            loan->size = 0;
+        }
+        if (loan->vir == NULL)
+        {
+            if (!chargeLoans(size))
+            {
+                chargeLoans(0);
+                return NULL;
+            }
+            // the encoder reads it by physical address
+            loan->vir = cedara_phymalloc_map(size, 1024);
+            if (loan->vir == NULL)
+            {
+                LOGE("%s: alloc %d bytes failed", __FUNCTION__, (int)size);
+                chargeLoans(0);
+                return NULL;
+            }
+            loan->phy = cedarv_address_vir2phy(loan->vir) | 0x40000000;
+            loan->size = size;
+        }
+        return loan;
+    }
+    return NULL;
+}
+
+/* Charges the allocated loans, and 'extra' bytes about to be, to the camera
+ * memory budget. */
+bool RecordingBufferManager::chargeLoans(size_t extra)
+{
+    size_t bytes = extra;
+    for (int i = 0; i < MAX_LOANS; i++)
+    {
+        if (mLoans[i].vir != NULL)
+        {
+            bytes += mLoans[i].size;
+        }
+    }
+    if (bytes == 0)
+    {
+        gEmulatedCameraFactory.releaseBuffers(mCameraId, CAMERA_MEM_SPARE);
+        return true;
+    }
+    return gEmulatedCameraFactory.reserveBuffers(mCameraId, CAMERA_MEM_SPARE, bytes, 1, 1) > 0;
+}
+
+void RecordingBufferManager::freeLoans()
+{
+    for (int i = 0; i < MAX_LOANS; i++)
+    {
+        Loan* loan = &mLoans[i];
+        if (loan->vir != NULL && !loan->busy)
+        {
+            cedara_phyfree_map(loan->vir);
+            loan->vir = NULL;
+            loan->phy = 0;
+            loan->size = 0;
+        }
+    }
+    chargeLoans(0);
+}
+
+static void AppendHold(String8* out, const char* name, uint32_t count,
+                       nsecs_t total, nsecs_t max, const uint32_t* hist)
+{
+    out->appendFormat("  %-20s n=%-5u avg=%6lldus max=%6lldus |", name, count,
+                      count ? total / count : 0LL, max);
+    for (int i = 0; i < kBucketCount && hist != NULL; i++)
+    {
+        out->appendFormat(" %4u", hist[i]);
+    }
+    out->append("\n");
+}
+
+void RecordingBufferManager::dump(int fd)
+{
+    String8 out;
+    {
+        Mutex::Autolock locker(&mLock);
+        out.appendFormat("Recording buffers: %d capture buffers, %d held by the encoder (max %d)\n",
+                         mCount, mEncoderHeld, mMaxEncoderHeld);
+        out.appendFormat("  to encoder: %u zero-copy, %u lent, %u skipped\n",
+                         mZeroCopy, mLent, mSkipped);
+
+        out.append("  hold histogram buckets (ms):");
+        for (int i = 0; i < kBucketCount - 1; i++)
+        {
+            out.appendFormat(" <%lld", kBuckets[i] / 1000);
+        }
+        out.append(" more\n");
+
+        AppendHold(&out, "preview", mPreviewHold.count, mPreviewHold.total,
+                   mPreviewHold.max, mPreviewHold.hist);
+        AppendHold(&out, "encoder", mEncoderHold.count, mEncoderHold.total,
+                   mEncoderHold.max, mEncoderHold.hist);
+        AppendHold(&out, "encoder, loans", mLoanHold.count, mLoanHold.total,
+                   mLoanHold.max, mLoanHold.hist);
+        for (int i = 0; i < mCount; i++)
+        {
+            char name[24];
+            snprintf(name, sizeof(name), "encoder, buffer %d", i);
+            AppendHold(&out, name, mBufferHold[i].count, mBufferHold[i].total,
+                       mBufferHold[i].max, NULL);
+        }
+    }
+    write(fd, out.string(), out.size());
+}
+
+}; /* namespace android */
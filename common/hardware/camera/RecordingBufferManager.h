@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HW_EMULATOR_CAMERA_RECORDING_BUFFER_MANAGER_H
+#define HW_EMULATOR_CAMERA_RECORDING_BUFFER_MANAGER_H
+
+/*
+ * Contains declaration of a class RecordingBufferManager that tracks who holds
+ * each capture buffer while recording in metadata buffer mode.
+ */
+
+#include <stdint.h>
+#include <utils/threads.h>
+#include <utils/Timers.h>
+#include <type_camera.h>
+
+namespace android {
+
+/* A capture buffer is with the driver until it is dequeued, then held by the
+ * preview thread and, when it is handed to the encoder, by the encoder as
+ * well. It goes back to the driver when the last holder lets it go.
+ *
+ * The encoder releases its frames whenever it is done with them, so a slow
+ * encoder would keep the driver without buffers and stall the preview. It is
+ * therefore never given more than 'buffer count - MIN_AWAY_FROM_ENCODER'
+ * capture buffers: past that, the frame is copied into one of MAX_LOANS spare
+ * buffers, and only skipped for the encoder when those are taken too, or do
+ * not fit in the memory budget of the cameras.
+ *
+ * Loaned frames carry the index LOAN_INDEX_BASE + slot, which comes back in
+ * releaseRecordingFrame like the index of a capture buffer.
+ */
+class RecordingBufferManager
+{
+public:
+    enum Holder {
+        HOLDER_PREVIEW = 1,
+        HOLDER_ENCODER = 2,
+    };
+
+    enum {
+        MAX_BUFFERS = 8,
+        MAX_LOANS = 2,
+        LOAN_INDEX_BASE = 0x100,
+        MIN_AWAY_FROM_ENCODER = 2,  // one being filled, one being previewed
+    };
+
+    RecordingBufferManager();
+    ~RecordingBufferManager();
+
+    /* Starts tracking 'count' capture buffers of camera 'camera_id', all
+     * queued to the driver. */
+    void start(int count, int camera_id);
+
+    /* Stops tracking; buffers released after this are not queued again.
+     * The loan buffers are freed. */
+    void stop();
+
+    /* The capture buffer 'index' was dequeued, the preview thread holds it. */
+    void onDequeued(int index);
+
+    /* Returns the frame to give the encoder for 'frame', which the preview
+     * thread holds: 'frame' itself, now also held by the encoder, a copy in
+     * a loan buffer, or NULL if the encoder should skip it. */
+    const V4L2BUF_t* lendToEncoder(const V4L2BUF_t* frame);
+
+    /* Drops the hold of 'holder' on the buffer 'index' (a capture buffer, or
+     * a loan for HOLDER_ENCODER). Returns true if 'index' is a capture buffer
+     * that has no holder left and must be queued to the driver. */
+    bool release(int index, Holder holder);
+
+    /* Prints the hold times and the lending counters to a file descriptor. */
+    void dump(int fd);
+
+private:
+    struct Buffer {
+        int         holders;        // Holder bits, 0 when with the driver
+        nsecs_t     since;          // dequeued, or lent to the encoder
+    };
+
+    struct Loan {
+        void*       vir;
+        unsigned int phy;
+        size_t      size;
+        bool        busy;
+        nsecs_t     since;
+        V4L2BUF_t   frame;
+    };
+
+    struct HoldStats {
+        uint32_t    count;
+        nsecs_t     total;          // us
+        nsecs_t     max;
+        uint32_t    hist[6];
+    };
+
+    void addHold(HoldStats* stats, nsecs_t since);
+    Loan* getLoan(size_t size);
+    bool chargeLoans(size_t extra);
+    void freeLoans();
+
+    Mutex           mLock;
+    bool            mActive;
+    int             mCameraId;
+    int             mCount;
+    Buffer          mBuffers[MAX_BUFFERS];
+    Loan            mLoans[MAX_LOANS];
+    int             mEncoderHeld;   // capture buffers held by the encoder
+
+    // statistics, since start()
+    HoldStats       mPreviewHold;
+    HoldStats       mEncoderHold;
+    HoldStats       mLoanHold;
+    HoldStats       mBufferHold[MAX_BUFFERS];   // encoder hold, per buffer
+    uint32_t        mZeroCopy;
+    uint32_t        mLent;
+    uint32_t        mSkipped;
+    int             mMaxEncoderHeld;
+};
+
+}; /* namespace android */
+
+#endif  /* HW_EMULATOR_CAMERA_RECORDING_BUFFER_MANAGER_H */
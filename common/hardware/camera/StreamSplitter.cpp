@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Contains implementation of a class StreamSplitter that derives several
+ * output streams of different sizes, formats and rates from one captured
+ * NV12 / NV21 frame.
+ */
+
+#define LOG_TAG "Camera_StreamSplitter"
+#include "CameraDebug.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <linux/videodev2.h>
+#include "Converters.h"
+#include "StreamSplitter.h"
+
+namespace android {
+
+StreamSplitter::StreamSplitter()
+    : mFormat(0),
+      mTimestamp(0)
+{
+    for (int i = 0; i < MAX_STREAMS; i++)
+    {
+        Stream* s = &mStreams[i];
+        s->width = s->height = 0;
+        s->format = 0;
+        s->interval = 0;
+        s->last = 0;
+        s->started = false;
+        s->due = false;
+        s->out = NULL;
+        s->buf = NULL;
+        s->buf_size = 0;
+        s->delivered = s->skipped = 0;
+    }
+
+    for (int i = 0; i <= MAX_LEVELS; i++)
+    {
+        Level* l = &mLevels[i];
+        l->width = l->height = 0;
+        l->buf = NULL;
+        l->buf_size = 0;
+        l->valid = false;
+    }
+}
+
+StreamSplitter::~StreamSplitter()
+{
+    reset();
+}
+
+void StreamSplitter::reset()
+{
+    for (int i = 0; i < MAX_STREAMS; i++)
+    {
+        Stream* s = &mStreams[i];
+        free(s->buf);
+        s->buf = NULL;
+        s->buf_size = 0;
+        s->width = s->height = 0;
+        s->started = false;
+        s->due = false;
+        s->out = NULL;
+    }
+
+    for (int i = 1; i <= MAX_LEVELS; i++)
+    {
+        Level* l = &mLevels[i];
+        free(l->buf);
+        l->buf = NULL;
+        l->buf_size = 0;
+        l->valid = false;
+    }
+    mLevels[0].buf = NULL;
+    mLevels[0].valid = false;
+}
+
+status_t StreamSplitter::setStream(int id, int width, int height,
+                                   uint32_t format, nsecs_t interval)
+{
+    if (id < 0 || id >= MAX_STREAMS || width < 0 || height < 0
+        || (width & 1) || (height & 1)
+        || (format != V4L2_PIX_FMT_NV12 && format != V4L2_PIX_FMT_NV21))
+    {
+        LOGE("%s: Invalid stream %d: %dx%d, format %.4s",
+             __FUNCTION__, id, width, height, reinterpret_cast<const char*>(&format));
+        return BAD_VALUE;
+    }
+
+    Stream* s = &mStreams[id];
+    if (s->width != width || s->height != height)
+    {
+        s->delivered = s->skipped = 0;
+    }
+    s->width = width;
+    s->height = height;
+    s->format = format;
+    if (s->interval != interval)
+    {
+        s->interval = interval;
+        s->started = false;
+    }
+    s->out = NULL;
+
+    return NO_ERROR;
+}
+
+void StreamSplitter::beginFrame(const void* frame, int width, int height,
+                                uint32_t format, nsecs_t timestamp)
+{
+    mLevels[0].buf = (uint8_t*)frame;
+    mLevels[0].width = width;
+    mLevels[0].height = height;
+    mLevels[0].valid = true;
+    for (int i = 1; i <= MAX_LEVELS; i++)
+    {
+        mLevels[i].valid = false;
+    }
+    mFormat = format;
+    mTimestamp = timestamp;
+
+    for (int i = 0; i < MAX_STREAMS; i++)
+    {
+        Stream* s = &mStreams[i];
+        s->out = NULL;
+        s->due = false;
+        if (s->width == 0)
+        {
+            continue;
+        }
+
+        if (s->interval == 0 || !s->started || timestamp - s->last >= s->interval)
+        {
+            s->due = true;
+        }
+        else
+        {
+            s->skipped++;
+        }
+    }
+}
+
+const uint8_t* StreamSplitter::getLevel(int level)
+{
+    Level* l = &mLevels[level];
+    if (l->valid)
+    {
+        return l->buf;
+    }
+
+    const uint8_t* src = getLevel(level - 1);
+    if (src == NULL)
+    {
+        return NULL;
+    }
+
+    const Level* p = &mLevels[level - 1];
+    l->width = (p->width / 2) & ~1;
+    l->height = (p->height / 2) & ~1;
+    const size_t size = l->width * l->height * 3 / 2;
+    if (l->buf_size < size)
+    {
+        free(l->buf);
+        l->buf = (uint8_t*)malloc(size);
+        l->buf_size = l->buf != NULL ? size : 0;
+        if (l->buf == NULL)
+        {
+            LOGE("%s: Unable to allocate level %d, %d bytes",
+                 __FUNCTION__, level, (int)size);
+            return NULL;
+        }
+    }
+
+    YUV420SPHalve(src, p->width, p->height, l->buf);
+    l->valid = true;
+    return l->buf;
+}
+
+uint8_t* StreamSplitter::getStreamBuffer(Stream* stream)
+{
+    const size_t size = stream->width * stream->height * 3 / 2;
+    if (stream->buf_size < size)
+    {
+        free(stream->buf);
+        stream->buf = (uint8_t*)malloc(size);
+        stream->buf_size = stream->buf != NULL ? size : 0;
+        if (stream->buf == NULL)
+        {
+            LOGE("%s: Unable to allocate %d bytes", __FUNCTION__, (int)size);
+        }
+    }
+    return stream->buf;
+}
+
+const void* StreamSplitter::getFrame(int id)
+{
+    if (id < 0 || id >= MAX_STREAMS)
+    {
+        return NULL;
+    }
+
+    Stream* s = &mStreams[id];
+    if (!s->due || !mLevels[0].valid)
+    {
+        return NULL;
+    }
+    if (s->out != NULL)
+    {
+        return s->out;
+    }
+
+    /* Deepest halving that is not smaller than the output, the bilinear pass
+     * then never reduces by 2 or more and does not skip source pixels. */
+    int level = 0;
+    while (level < MAX_LEVELS)
+    {
+        const int next_w = (mLevels[level].width / 2) & ~1;
+        const int next_h = (mLevels[level].height / 2) & ~1;
+        if (next_w < s->width || next_h < s->height || getLevel(level + 1) == NULL)
+        {
+            break;
+        }
+        level++;
+    }
+
+    const Level* l = &mLevels[level];
+    const uint8_t* out = l->buf;
+    if (l->width != s->width || l->height != s->height)
+    {
+        uint8_t* buf = getStreamBuffer(s);
+        if (buf == NULL)
+        {
+            return NULL;
+        }
+        if (s->scaler.scale(l->buf, l->width, l->height,
+                            0, 0, l->width, l->height,
+                            buf, s->width, s->height) != NO_ERROR)
+        {
+            return NULL;
+        }
+        out = buf;
+    }
+
+    if (s->format != mFormat)
+    {
+        uint8_t* buf = getStreamBuffer(s);
+        if (buf == NULL)
+        {
+            return NULL;
+        }
+        NV12ToNV21(out, s->width, buf, s->width, s->width, s->height);
+        out = buf;
+    }
+
+    s->out = out;
+    s->last = mTimestamp;
+    s->started = true;
+    s->delivered++;
+    return out;
+}
+
+size_t StreamSplitter::getFrameSize(int id) const
+{
+    return mStreams[id].width * mStreams[id].height * 3 / 2;
+}
+
+}; /* namespace android */
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HW_EMULATOR_CAMERA_STREAM_SPLITTER_H
+#define HW_EMULATOR_CAMERA_STREAM_SPLITTER_H
+
+/*
+ * Contains declaration of a class StreamSplitter that derives several output
+ * streams of different sizes, formats and rates from one captured NV12 / NV21
+ * frame.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <utils/Errors.h>
+#include <utils/Timers.h>
+#include "YUVScaler.h"
+
+namespace android {
+
+/* Outputs are produced lazily, on the first getFrame() call of a stream for
+ * the current frame. Downscaled outputs start from a chain of 2x2 box
+ * filtered halvings of the frame, which is built once per frame and shared by
+ * all streams, and are finished by a bilinear scale of the nearest halving
+ * that is still larger than the output. An output with the size and format of
+ * the frame is the frame itself.
+ */
+class StreamSplitter
+{
+public:
+    /* Maximum number of streams, and of halvings of a frame. */
+    enum { MAX_STREAMS = 3, MAX_LEVELS = 4 };
+
+    StreamSplitter();
+    ~StreamSplitter();
+
+    /* Configures a stream.
+     * Param:
+     *  id - Stream index, less than MAX_STREAMS.
+     *  width, height - Output dimensions, even values. 0 disables the stream.
+     *  format - Output format, V4L2_PIX_FMT_NV12 or V4L2_PIX_FMT_NV21.
+     *  interval - Minimum time between two outputs of the stream, in the units
+     *      of the frame timestamps. 0 outputs every frame.
+     * Return:
+     *  NO_ERROR on success, or an appropriate error status.
+     */
+    status_t setStream(int id, int width, int height, uint32_t format,
+                       nsecs_t interval);
+
+    /* Sets the frame the streams are derived from. The frame must stay valid
+     * until the next beginFrame() call.
+     * Param:
+     *  frame - NV12 / NV21 frame.
+     *  width, height - Frame dimensions.
+     *  format - Frame format, V4L2_PIX_FMT_NV12 or V4L2_PIX_FMT_NV21.
+     *  timestamp - Frame timestamp.
+     */
+    void beginFrame(const void* frame, int width, int height, uint32_t format,
+                    nsecs_t timestamp);
+
+    /* Returns the output of a stream for the current frame, or NULL if the
+     * stream is disabled or it is not time yet for its next output. The
+     * output is valid until the next beginFrame() call.
+     */
+    const void* getFrame(int id);
+
+    /* Size of an output of a stream, in bytes. */
+    size_t getFrameSize(int id) const;
+
+    int getWidth(int id) const
+    {
+        return mStreams[id].width;
+    }
+
+    int getHeight(int id) const
+    {
+        return mStreams[id].height;
+    }
+
+    /* Outputs delivered and frames skipped by the rate of a stream. */
+    uint32_t getDelivered(int id) const
+    {
+        return mStreams[id].delivered;
+    }
+
+    uint32_t getSkipped(int id) const
+    {
+        return mStreams[id].skipped;
+    }
+
+    /* Frees all buffers and disables all streams. */
+    void reset();
+
+private:
+    struct Stream {
+        int         width;
+        int         height;
+        uint32_t    format;
+        nsecs_t     interval;
+        nsecs_t     last;           // timestamp of the last output
+        bool        started;        // 'last' is valid
+        bool        due;            // an output is due for the current frame
+        const void* out;            // output for the current frame, or NULL
+        uint8_t*    buf;
+        size_t      buf_size;
+        YUVScaler   scaler;
+        uint32_t    delivered;
+        uint32_t    skipped;
+    };
+
+    struct Level {
+        int         width;
+        int         height;
+        uint8_t*    buf;
+        size_t      buf_size;
+        bool        valid;          // built for the current frame
+    };
+
+    const uint8_t* getLevel(int level);
+    uint8_t* getStreamBuffer(Stream* stream);
+
+    Stream          mStreams[MAX_STREAMS];
+    Level           mLevels[MAX_LEVELS + 1];    // [0] is the frame itself
+
+    uint32_t        mFormat;
+    nsecs_t         mTimestamp;
+};
+
+}; /* namespace android */
+
+#endif  /* HW_EMULATOR_CAMERA_STREAM_SPLITTER_H */
@@ -0,0 +1,498 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Contains implementation of a class StripeJpegEncoder that compresses an
+ * NV21 image into a baseline JPEG on several threads.
+ */
+
+#define LOG_TAG "Camera_StripeJPEG"
+#include "CameraDebug.h"
+
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <cutils/atomic.h>
+
+extern "C" {
+#include "jpeglib.h"
+#include "jerror.h"
+}
+
+#include "StripeJpegEncoder.h"
+
+namespace android {
+
+/* Rows of a 4:2:0 MCU. */
+#define MCU_ROWS                16
+
+/* Stripes smaller than this are not worth a thread. */
+#define MIN_STRIPE_MCU_ROWS     4
+
+/* JPEG markers used to join the stripes. */
+#define JPEG_MARKER_SOF0        0xc0
+#define JPEG_MARKER_RST0        0xd0
+#define JPEG_MARKER_EOI         0xd9
+#define JPEG_MARKER_SOS         0xda
+
+/****************************************************************************
+ * libjpeg error and destination managers
+ ***************************************************************************/
+
+struct StripeErrorMgr {
+    struct jpeg_error_mgr   pub;
+    jmp_buf                 jmp;
+};
+
+static void onJpegError(j_common_ptr cinfo)
+{
+    StripeErrorMgr* err = (StripeErrorMgr*)cinfo->err;
+    char msg[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, msg);
+    LOGE("libjpeg error: %s", msg);
+    longjmp(err->jmp, 1);
+}
+
+/* Grows a malloc'ed buffer as libjpeg fills it. */
+struct StripeDestMgr {
+    struct jpeg_destination_mgr pub;
+    uint8_t*                    buf;
+    size_t                      capacity;
+    size_t                      size;
+};
+
+static void initDestination(j_compress_ptr cinfo)
+{
+    StripeDestMgr* dest = (StripeDestMgr*)cinfo->dest;
+    dest->pub.next_output_byte = dest->buf;
+    dest->pub.free_in_buffer = dest->capacity;
+}
+
+static boolean emptyOutputBuffer(j_compress_ptr cinfo)
+{
+    StripeDestMgr* dest = (StripeDestMgr*)cinfo->dest;
+    const size_t old_capacity = dest->capacity;
+    uint8_t* buf = (uint8_t*)realloc(dest->buf, old_capacity * 2);
+    if (buf == NULL)
+    {
+        ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 0);
+    }
+    dest->buf = buf;
+    dest->capacity = old_capacity * 2;
+    dest->pub.next_output_byte = buf + old_capacity;
+    dest->pub.free_in_buffer = old_capacity;
+    return TRUE;
+}
+
+static void termDestination(j_compress_ptr cinfo)
+{
+    StripeDestMgr* dest = (StripeDestMgr*)cinfo->dest;
+    dest->size = dest->capacity - dest->pub.free_in_buffer;
+}
+
+/****************************************************************************
+ * JPEG stream helpers
+ ***************************************************************************/
+
+/* Returns the offset of the entropy coded data, just after the SOS segment,
+ * or 0 if the stream is not understood. 'sof' receives the offset of the
+ * SOF0 marker.
+ */
+static size_t findScanData(const uint8_t* data, size_t size, size_t* sof)
+{
+    size_t pos = 2;     // skip SOI
+    *sof = 0;
+    while (pos + 4 <= size)
+    {
+        if (data[pos] != 0xff)
+        {
+            return 0;
+        }
+        const uint8_t marker = data[pos + 1];
+        const size_t len = (data[pos + 2] << 8) | data[pos + 3];
+        if (marker == JPEG_MARKER_SOF0)
+        {
+            *sof = pos;
+        }
+        pos += 2 + len;
+        if (marker == JPEG_MARKER_SOS)
+        {
+            return (*sof != 0 && pos <= size) ? pos : 0;
+        }
+    }
+    return 0;
+}
+
+/* Copies entropy coded data, renumbering its restart markers from 'rst'.
+ * Returns the next restart marker number.
+ */
+static int copyScanData(uint8_t* dst, const uint8_t* src, size_t size, int rst)
+{
+    memcpy(dst, src, size);
+    for (size_t i = 0; i + 1 < size; i++)
+    {
+        if (dst[i] != 0xff)
+        {
+            continue;
+        }
+        // 0xff is followed by a stuffed 0 or by a marker
+        if ((dst[i + 1] & 0xf8) == JPEG_MARKER_RST0)
+        {
+            dst[i + 1] = JPEG_MARKER_RST0 + (rst++ & 7);
+        }
+        i++;
+    }
+    return rst;
+}
+
+/****************************************************************************
+ * StripeJpegEncoder
+ ***************************************************************************/
+
+StripeJpegEncoder::StripeJpegEncoder()
+    : mImage(NULL),
+      mWidth(0),
+      mHeight(0),
+      mQuality(90),
+      mStripeCount(0),
+      mNextStripe(0),
+      mData(NULL),
+      mSize(0)
+{
+    memset(mStripes, 0, sizeof(mStripes));
+}
+
+StripeJpegEncoder::~StripeJpegEncoder()
+{
+    freeStripes();
+    if (mData != NULL)
+    {
+        free(mData);
+    }
+}
+
+int StripeJpegEncoder::getDefaultThreads()
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1)
+    {
+        return 1;
+    }
+    return (cpus > MAX_STRIPES) ? MAX_STRIPES : (int)cpus;
+}
+
+status_t StripeJpegEncoder::encode(const void* image,
+                                   int width,
+                                   int height,
+                                   int quality,
+                                   int threads)
+{
+    if (image == NULL || width <= 0 || height <= 0 || (width & 1))
+    {
+        LOGE("%s: bad image %p[%dx%d]", __FUNCTION__, image, width, height);
+        return EINVAL;
+    }
+
+    freeStripes();
+    if (mData != NULL)
+    {
+        free(mData);
+        mData = NULL;
+    }
+    mSize = 0;
+
+    mImage = (const uint8_t*)image;
+    mWidth = width;
+    mHeight = height;
+    mQuality = quality;
+
+    // split the MCU rows evenly, earlier stripes get the remainder
+    const int mcu_rows = (height + MCU_ROWS - 1) / MCU_ROWS;
+    int count = mcu_rows / MIN_STRIPE_MCU_ROWS;
+    if (threads > MAX_STRIPES)
+    {
+        threads = MAX_STRIPES;
+    }
+    if (count > threads)
+    {
+        count = threads;
+    }
+    if (count < 1)
+    {
+        count = 1;
+    }
+
+    int mcu_row = 0;
+    for (int i = 0; i < count; i++)
+    {
+        const int rows = mcu_rows / count + (i < mcu_rows % count ? 1 : 0);
+        mStripes[i].first_row = mcu_row * MCU_ROWS;
+        mStripes[i].height = rows * MCU_ROWS;
+        mcu_row += rows;
+    }
+    mStripes[count - 1].height = height - mStripes[count - 1].first_row;
+    mStripeCount = count;
+    mNextStripe = 0;
+
+    // the calling thread encodes stripes too
+    pthread_t workers[MAX_STRIPES];
+    int worker_count = 0;
+    for (int i = 1; i < count; i++)
+    {
+        if (pthread_create(&workers[worker_count], NULL, workerThread, this) == 0)
+        {
+            worker_count++;
+        }
+    }
+    encodeStripes();
+    for (int i = 0; i < worker_count; i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        if (!mStripes[i].ok)
+        {
+            LOGE("%s: stripe %d failed", __FUNCTION__, i);
+            freeStripes();
+            return UNKNOWN_ERROR;
+        }
+    }
+
+    status_t res = stitch();
+    freeStripes();
+
+    LOGV("%s: %dx%d, %d stripes on %d threads -> %d bytes",
+         __FUNCTION__, width, height, count, worker_count + 1, mSize);
+    return res;
+}
+
+void* StripeJpegEncoder::workerThread(void* arg)
+{
+    ((StripeJpegEncoder*)arg)->encodeStripes();
+    return NULL;
+}
+
+void StripeJpegEncoder::encodeStripes()
+{
+    int i;
+    while ((i = android_atomic_inc(&mNextStripe)) < mStripeCount)
+    {
+        mStripes[i].ok = encodeStripe(&mStripes[i]);
+    }
+}
+
+bool StripeJpegEncoder::encodeStripe(Stripe* stripe)
+{
+    // libjpeg reads whole MCUs, rows are padded to 16 pixels
+    const int padded_w = (mWidth + 15) & ~15;
+    const int chroma_w = padded_w / 2;
+    uint8_t* rows = (uint8_t*)malloc(padded_w * MCU_ROWS + chroma_w * MCU_ROWS);
+    if (rows == NULL)
+    {
+        return false;
+    }
+    uint8_t* y_rows = rows;
+    uint8_t* cb_rows = y_rows + padded_w * MCU_ROWS;
+    uint8_t* cr_rows = cb_rows + chroma_w * (MCU_ROWS / 2);
+
+    StripeDestMgr dest;
+    memset(&dest, 0, sizeof(dest));
+    dest.capacity = mWidth * stripe->height / 4 + 4096;
+    dest.buf = (uint8_t*)malloc(dest.capacity);
+    if (dest.buf == NULL)
+    {
+        free(rows);
+        return false;
+    }
+    dest.pub.init_destination = initDestination;
+    dest.pub.empty_output_buffer = emptyOutputBuffer;
+    dest.pub.term_destination = termDestination;
+
+    struct jpeg_compress_struct cinfo;
+    StripeErrorMgr jerr;
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = onJpegError;
+    if (setjmp(jerr.jmp))
+    {
+        jpeg_destroy_compress(&cinfo);
+        free(dest.buf);
+        free(rows);
+        return false;
+    }
+
+    jpeg_create_compress(&cinfo);
+    cinfo.dest = &dest.pub;
+    cinfo.image_width = mWidth;
+    cinfo.image_height = stripe->height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_YCbCr;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, mQuality, TRUE);
+    jpeg_set_colorspace(&cinfo, JCS_YCbCr);
+    cinfo.raw_data_in = TRUE;
+    cinfo.dct_method = JDCT_IFAST;
+    cinfo.comp_info[0].h_samp_factor = 2;
+    cinfo.comp_info[0].v_samp_factor = 2;
+    cinfo.comp_info[1].h_samp_factor = 1;
+    cinfo.comp_info[1].v_samp_factor = 1;
+    cinfo.comp_info[2].h_samp_factor = 1;
+    cinfo.comp_info[2].v_samp_factor = 1;
+    // one restart interval per MCU row, so stripes can be joined
+    cinfo.restart_in_rows = 1;
+
+    jpeg_start_compress(&cinfo, TRUE);
+
+    JSAMPROW y[MCU_ROWS];
+    JSAMPROW cb[MCU_ROWS / 2];
+    JSAMPROW cr[MCU_ROWS / 2];
+    JSAMPARRAY planes[3] = { y, cb, cr };
+    const uint8_t* vu_plane = mImage + mWidth * mHeight;
+    const int last_row = stripe->first_row + stripe->height - 1;
+
+    while (cinfo.next_scanline < cinfo.image_height)
+    {
+        const int row = stripe->first_row + cinfo.next_scanline;
+
+        // rows past the end of the image repeat the last one
+        for (int i = 0; i < MCU_ROWS; i++)
+        {
+            const int r = (row + i < last_row) ? row + i : last_row;
+            const uint8_t* src = mImage + r * mWidth;
+            if (padded_w == mWidth)
+            {
+                y[i] = (JSAMPROW)src;
+            }
+            else
+            {
+                uint8_t* dst = y_rows + i * padded_w;
+                memcpy(dst, src, mWidth);
+                memset(dst + mWidth, src[mWidth - 1], padded_w - mWidth);
+                y[i] = dst;
+            }
+        }
+
+        for (int i = 0; i < MCU_ROWS / 2; i++)
+        {
+            const int r = (row + 2 * i < last_row) ? row + 2 * i : last_row;
+            const uint8_t* vu = vu_plane + (r >> 1) * mWidth;
+            uint8_t* u = cb_rows + i * chroma_w;
+            uint8_t* v = cr_rows + i * chroma_w;
+            int x;
+            for (x = 0; x < mWidth / 2; x++)
+            {
+                v[x] = vu[2 * x];
+                u[x] = vu[2 * x + 1];
+            }
+            for (; x < chroma_w; x++)
+            {
+                v[x] = v[x - 1];
+                u[x] = u[x - 1];
+            }
+            cb[i] = u;
+            cr[i] = v;
+        }
+
+        jpeg_write_raw_data(&cinfo, planes, MCU_ROWS);
+    }
+
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    free(rows);
+
+    stripe->data = dest.buf;
+    stripe->size = dest.size;
+    return true;
+}
+
+status_t StripeJpegEncoder::stitch()
+{
+    size_t scan[MAX_STRIPES];
+    size_t total = 0;
+    size_t sof = 0;
+
+    for (int i = 0; i < mStripeCount; i++)
+    {
+        const Stripe& s = mStripes[i];
+        scan[i] = findScanData(s.data, s.size, &sof);
+        if (scan[i] == 0
+            || s.size < scan[i] + 2
+            || s.data[s.size - 2] != 0xff
+            || s.data[s.size - 1] != JPEG_MARKER_EOI)
+        {
+            LOGE("%s: unexpected stream layout in stripe %d", __FUNCTION__, i);
+            return UNKNOWN_ERROR;
+        }
+        // entropy coded data, and the restart marker joining the next stripe
+        total += s.size - scan[i];
+    }
+    // header of the first stripe
+    total += scan[0];
+
+    mData = (uint8_t*)malloc(total);
+    if (mData == NULL)
+    {
+        return NO_MEMORY;
+    }
+
+    // header, with the height of the whole image
+    uint8_t* p = mData;
+    memcpy(p, mStripes[0].data, scan[0]);
+    findScanData(mStripes[0].data, mStripes[0].size, &sof);
+    mData[sof + 5] = (uint8_t)(mHeight >> 8);
+    mData[sof + 6] = (uint8_t)mHeight;
+    p += scan[0];
+
+    int rst = 0;
+    for (int i = 0; i < mStripeCount; i++)
+    {
+        const Stripe& s = mStripes[i];
+        const size_t len = s.size - 2 - scan[i];
+        rst = copyScanData(p, s.data + scan[i], len, rst);
+        p += len;
+        *p++ = 0xff;
+        if (i + 1 < mStripeCount)
+        {
+            *p++ = JPEG_MARKER_RST0 + (rst++ & 7);
+        }
+        else
+        {
+            *p++ = JPEG_MARKER_EOI;
+        }
+    }
+
+    mSize = p - mData;
+    return NO_ERROR;
+}
+
+void StripeJpegEncoder::freeStripes()
+{
+    for (int i = 0; i < MAX_STRIPES; i++)
+    {
+        if (mStripes[i].data != NULL)
+        {
+            free(mStripes[i].data);
+        }
+    }
+    memset(mStripes, 0, sizeof(mStripes));
+    mStripeCount = 0;
+}
+
+}; /* namespace android */
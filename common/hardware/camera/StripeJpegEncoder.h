@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HW_EMULATOR_CAMERA_STRIPE_JPEG_ENCODER_H
+#define HW_EMULATOR_CAMERA_STRIPE_JPEG_ENCODER_H
+
+/*
+ * Contains declaration of a class StripeJpegEncoder that compresses an NV21
+ * image into a baseline JPEG, encoding horizontal stripes of the image on
+ * several threads.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <utils/Errors.h>
+
+namespace android {
+
+/* Each stripe is encoded by libjpeg as a separate image, with a restart
+ * marker after every MCU row. Since all stripes use the same quantization
+ * and huffman tables, and DC prediction is reset at each restart marker, the
+ * entropy coded data of the stripes can be joined behind the header of the
+ * first stripe, once the restart markers are renumbered.
+ */
+class StripeJpegEncoder
+{
+public:
+    /* Maximum number of stripes, and of encoding threads. */
+    enum { MAX_STRIPES = 8 };
+
+    StripeJpegEncoder();
+    ~StripeJpegEncoder();
+
+    /* Compresses raw NV21 image into a JPEG.
+     * Param:
+     *  image - Raw NV21 image.
+     *  width, height - Image dimensions, width must be even.
+     *  quality - JPEG quality.
+     *  threads - Number of encoding threads, including the caller.
+     * Return:
+     *  NO_ERROR on success, or an appropriate error status.
+     */
+    status_t encode(const void* image,
+                    int width,
+                    int height,
+                    int quality,
+                    int threads);
+
+    /* Compressed JPEG, valid after a successful encode() call. */
+    const void* getData() const
+    {
+        return mData;
+    }
+
+    size_t getSize() const
+    {
+        return mSize;
+    }
+
+    /* Number of threads worth using on this CPU. */
+    static int getDefaultThreads();
+
+private:
+    struct Stripe {
+        int         first_row;      // first pixel row in the image
+        int         height;         // pixel rows
+        uint8_t*    data;           // complete JPEG of the stripe
+        size_t      size;
+        bool        ok;
+    };
+
+    static void* workerThread(void* arg);
+    void encodeStripes();
+    bool encodeStripe(Stripe* stripe);
+    status_t stitch();
+    void freeStripes();
+
+    const uint8_t*      mImage;
+    int                 mWidth;
+    int                 mHeight;
+    int                 mQuality;
+
+    Stripe              mStripes[MAX_STRIPES];
+    int                 mStripeCount;
+    volatile int32_t    mNextStripe;
+
+    uint8_t*            mData;
+    size_t              mSize;
+};
+
+}; /* namespace android */
+
+#endif  /* HW_EMULATOR_CAMERA_STRIPE_JPEG_ENCODER_H */
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Contains implementation of the V4L2 device node backend of V4L2CameraDevice,
+ * and the selection of the backend.
+ */
+
+#define LOG_TAG "Camera_V4L2Backend"
+#include "CameraDebug.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/select.h>
+#include "V4L2Backend.h"
+#include "FakeV4L2Backend.h"
+
+namespace android {
+
+/* Forwards every call to a V4L2 device node. */
+class V4L2DeviceBackend : public V4L2Backend
+{
+public:
+    V4L2DeviceBackend() : mFd(-1) {}
+    ~V4L2DeviceBackend() { close(); }
+
+    int open(const char* name)
+    {
+        mFd = ::open(name, O_RDWR | O_NONBLOCK, 0);
+        return (mFd < 0) ? -1 : 0;
+    }
+
+    void close()
+    {
+        if (mFd >= 0)
+        {
+            ::close(mFd);
+            mFd = -1;
+        }
+    }
+
+    int ioctl(int request, void* arg)
+    {
+        return ::ioctl(mFd, request, arg);
+    }
+
+    void* mmap(size_t length, off_t offset)
+    {
+        return ::mmap(0, length, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, offset);
+    }
+
+    int munmap(void* addr, size_t length)
+    {
+        return ::munmap(addr, length);
+    }
+
+    int waitFrame(int timeout_ms)
+    {
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(mFd, &fds);
+
+        struct timeval tv;
+        tv.tv_sec = timeout_ms / 1000;
+        tv.tv_usec = (timeout_ms % 1000) * 1000;
+        return select(mFd + 1, &fds, NULL, NULL, &tv);
+    }
+
+private:
+    int     mFd;
+};
+
+V4L2Backend* createV4L2Backend(const char* name)
+{
+    if (!strncmp(name, V4L2_FAKE_DEVICE_PREFIX, strlen(V4L2_FAKE_DEVICE_PREFIX)))
+    {
+        LOGD("%s: synthetic camera for %s", __FUNCTION__, name);
+        return new FakeV4L2Backend();
+    }
+    return new V4L2DeviceBackend();
+}
+
+}; /* namespace android */
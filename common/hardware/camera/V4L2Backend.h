@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HW_EMULATOR_CAMERA_V4L2_BACKEND_H
+#define HW_EMULATOR_CAMERA_V4L2_BACKEND_H
+
+/*
+ * Contains declaration of a class V4L2Backend that carries the capture calls
+ * of V4L2CameraDevice, either to a V4L2 device node or to a synthetic one.
+ */
+
+#include <sys/types.h>
+
+/* Device names starting with this prefix select the synthetic backend. */
+#define V4L2_FAKE_DEVICE_PREFIX     "fake"
+
+namespace android {
+
+/* The calls mirror the system calls made on a V4L2 device node: they return
+ * -1 and set errno on failure.
+ */
+class V4L2Backend
+{
+public:
+    virtual ~V4L2Backend() {}
+
+    /* Opens the device, non-blocking. */
+    virtual int open(const char* name) = 0;
+    virtual void close() = 0;
+
+    /* ioctl(2) on the device. */
+    virtual int ioctl(int request, void* arg) = 0;
+
+    /* Maps / unmaps a V4L2_MEMORY_MMAP buffer found with VIDIOC_QUERYBUF.
+     * mmap() returns MAP_FAILED on failure. */
+    virtual void* mmap(size_t length, off_t offset) = 0;
+    virtual int munmap(void* addr, size_t length) = 0;
+
+    /* Waits at most 'timeout_ms' until a buffer can be dequeued. Returns 1 if
+     * one can, 0 on timeout, -1 on error. */
+    virtual int waitFrame(int timeout_ms) = 0;
+
+    /* Whether the offset of a V4L2_MEMORY_MMAP buffer is its physical
+     * address, which the display, G2D and the encoders read it by. */
+    virtual bool mmapIsPhysical() const { return true; }
+};
+
+/* Returns the backend for the device 'name'. */
+V4L2Backend* createV4L2Backend(const char* name);
+
+}; /* namespace android */
+
+#endif  /* HW_EMULATOR_CAMERA_V4L2_BACKEND_H */
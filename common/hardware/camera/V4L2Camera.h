@@ -31,7 +31,11 @@
 
 namespace android {
 
-#define NB_BUFFER 4
+#define NB_BUFFER 6				// max buffers, used in zero shutter lag mode
+#define NB_BUFFER_PREVIEW 4		// buffers requested for normal preview
+#define NB_BUFFER_ZSL 2			// recent frames kept by zero shutter lag mode
+#define NB_BUFFER_BURST 3		// buffers requested for burst capture
+#define NB_BUFFER_MIN 3			// fewest buffers preview can stream with
 
 class CameraHardware;
 
@@ -145,6 +149,27 @@ public:
      */
     virtual status_t stopDeliveringFrames();
 
+    /* Hands a metadata frame to the video encoder.
+     * Param:
+     *  frame - V4L2BUF_t frame passed to onNextFrameCB.
+     * Return:
+     *  The frame to send to the encoder, which may be a copy of 'frame', or
+     *  NULL if the encoder should skip this frame. Every frame returned must
+     *  come back through releaseRecordingFrame.
+     */
+    virtual const void* lendRecordingFrame(const void* frame)
+    {
+        return frame;
+    }
+
+    /* Takes back a frame the encoder is done with.
+     * Param:
+     *  index - Index of the V4L2BUF_t frame returned by lendRecordingFrame.
+     */
+    virtual void releaseRecordingFrame(int index)
+    {
+    }
+
     /* Gets width of the frame obtained from the physical device.
      * Return:
      *  Width of the frame obtained from the physical device. Note that value
@@ -24,12 +24,15 @@
 
 #include <fcntl.h> 
 #include <sys/mman.h> 
+#include <utils/String8.h>
 #include <videodev2.h>
 #include <linux/videodev.h> 
 #include <g2d_driver.h>
 
 #include "CameraHardwareDevice.h"
+#include "HALCameraFactory.h"
 #include "V4L2CameraDevice.h"
+#include "YUYVConverters.h"
 
 namespace android {
 	
@@ -54,52 +57,6 @@ static void calculateCrop(Rect * rect, int new_zoom, int max_zoom, int width, in
 	// LOGD("crop: [%d, %d, %d, %d]", rect->left, rect->top, rect->right, rect->bottom);
 }
 
-static void YUYVToNV12(const void* yuyv, void *nv12, int width, int height)
-{
-	uint8_t* Y	= (uint8_t*)nv12;
-	uint8_t* UV = (uint8_t*)Y + width * height;
-	
-	for(int i = 0; i < height; i += 2)
-	{
-		for (int j = 0; j < width; j++)
-		{
-			*(uint8_t*)((uint8_t*)Y + i * width + j) = *(uint8_t*)((uint8_t*)yuyv + i * width * 2 + j * 2);
-			*(uint8_t*)((uint8_t*)Y + (i + 1) * width + j) = *(uint8_t*)((uint8_t*)yuyv + (i + 1) * width * 2 + j * 2);
-			*(uint8_t*)((uint8_t*)UV + ((i * width) >> 1) + j) = *(uint8_t*)((uint8_t*)yuyv + i * width * 2 + j * 2 + 1);
-		}
-	}
-}
-
-static void YUYVToNV21(const void* yuyv, void *nv21, int width, int height)
-{
-	uint8_t* Y	= (uint8_t*)nv21;
-	uint8_t* VU = (uint8_t*)Y + width * height;
-	
-	for(int i = 0; i < height; i += 2)
-	{
-		for (int j = 0; j < width; j++)
-		{
-			*(uint8_t*)((uint8_t*)Y + i * width + j) = *(uint8_t*)((uint8_t*)yuyv + i * width * 2 + j * 2);
-			*(uint8_t*)((uint8_t*)Y + (i + 1) * width + j) = *(uint8_t*)((uint8_t*)yuyv + (i + 1) * width * 2 + j * 2);
-
-			if (j % 2)
-			{
-				if (j < width - 1)
-				{
-					*(uint8_t*)((uint8_t*)VU + ((i * width) >> 1) + j) = *(uint8_t*)((uint8_t*)yuyv + i * width * 2 + (j + 1) * 2 + 1);
-				}
-			}
-			else
-			{
-				if (j > 1)
-				{
-					*(uint8_t*)((uint8_t*)VU + ((i * width) >> 1) + j) = *(uint8_t*)((uint8_t*)yuyv + i * width * 2 + (j - 1) * 2 + 1); 		
-				}
-			}
-		}
-	}
-}
-
 #if USE_MP_CONVERT
 void V4L2CameraDevice::YUYVToYUV420C(const void* yuyv, void *yuv420, int width, int height)
 {
@@ -142,14 +99,17 @@ void V4L2CameraDevice::YUYVToYUV420C(const void* yuyv, void *yuv420, int width,
 V4L2CameraDevice::V4L2CameraDevice(CameraHardwareDevice* camera_hal, int id)
     : V4L2Camera(camera_hal),
       mCameraID(id),
-      mCamFd(0),
+      mBackend(NULL),
       mDeviceID(-1),
       mCameraFacing(0),
-      mBufferCnt(NB_BUFFER),
+      mV4l2Memory(V4L2_MEMORY_MMAP),
+      mBufferCnt(NB_BUFFER_PREVIEW),
+      mFrameBytes(0),
       mPreviewUseHW(false),
       mLastPreviewed(0),
       mPreviewAfter(0),
       mUseHwEncoder(false),
+	  mCropZoom(-1),
 	  mNewZoom(0),
 	  mLastZoom(0),
 	  mMaxZoom(0xffffffff),
@@ -159,21 +119,53 @@ V4L2CameraDevice::V4L2CameraDevice(CameraHardwareDevice* camera_hal, int id)
 #if USE_MP_CONVERT
 	  ,mG2DHandle(0)
 #endif
-	  ,mCurrentV4l2buf(NULL)
 	  ,mFaceDetectionEnable(false)
+	  ,mFaceScratch(NULL)
+	  ,mFaceBufSize(0)
+	  ,mFaceScratchSize(0)
+	  ,mFaceWidth(0)
+	  ,mFaceHeight(0)
+	  ,mFaceReady(-1)
+	  ,mFaceReading(-1)
+	  ,mFaceFrameCount(0)
+	  ,mFaceStatsStart(0)
+	  ,mFaceRequests(0)
+	  ,mFaceFeedFrames(0)
+	  ,mFaceFeedSkipped(0)
+	  ,mFaceFeedTime(0)
+	  ,mZoomBuffer(NULL)
+	  ,mZoomBufferPhy(0)
+	  ,mZoomBufferSize(0)
+	  ,mZoomUseG2D(true)
+	  ,mZslRequest(false)
+	  ,mZslActive(false)
+	  ,mZslCount(0)
+	  ,mZslPictureBuf(NULL)
+	  ,mBurstNum(1)
+	  ,mBurstInterval(0)
+	  ,mBurstCaptured(0)
+	  ,mBurstEncoded(0)
+	  ,mBurstLastFrame(0)
+	  ,mBurstStartTime(0)
+	  ,mBurstCaptureTime(0)
+	  ,mBurstMaxDepth(0)
+	  ,mCapsCached(false)
+	  ,mOpenTime(0)
+	  ,mCapsTime(0)
+	  ,mCedarxTime(0)
 {
 	F_LOG;
 	memset(mDeviceName, 0, sizeof(mDeviceName));
-	
-	pthread_mutex_init(&mTakePhotoMutex, NULL);
-	pthread_cond_init(&mTakePhotoCond, NULL);
+	memset(&mMapMem, 0, sizeof(mMapMem));
+	memset(&mVideoBuffer, 0, sizeof(mVideoBuffer));
 
 	memset(&mRectCrop, 0, sizeof(Rect));
 
-	OSAL_QueueCreate(&mQueueBuffer, NB_BUFFER);
-	
-	pthread_mutex_init(&mPreviewMutex, NULL);
-	pthread_cond_init(&mPreviewCond, NULL);
+	mFaceBuf[0] = mFaceBuf[1] = NULL;
+	pthread_mutex_init(&mFaceMutex, NULL);
+
+	pthread_mutex_init(&mZslMutex, NULL);
+	pthread_cond_init(&mZslCond, NULL);
 	
 	mPreviewThread = new DoPreviewThread(this);
 	mPictureThread = new DoPictureThread(this);
@@ -185,28 +177,30 @@ V4L2CameraDevice::V4L2CameraDevice(CameraHardwareDevice* camera_hal, int id)
 V4L2CameraDevice::~V4L2CameraDevice()
 {
 	F_LOG;
-	OSAL_QueueTerminate(&mQueueBuffer);
-
 	if (mPreviewThread != NULL)
 	{
+		mPreviewThread->requestExit();
+		mFrameRing.wakeup();
 		mPreviewThread->stopThread();
-		pthread_cond_signal(&mPreviewCond);
 		mPreviewThread.clear();
 		mPreviewThread = 0;
 	}
 
 	if (mPictureThread != NULL)
 	{
+		mPictureThread->requestExit();
+		mPictureRing.wakeup();
 		mPictureThread->stopThread();
-		pthread_cond_signal(&mTakePhotoCond);
 		mPictureThread.clear();
 		mPictureThread = 0;
 	}
 
-	pthread_mutex_destroy(&mPreviewMutex);
-	pthread_cond_destroy(&mPreviewCond);
-	pthread_mutex_destroy(&mTakePhotoMutex);
-	pthread_cond_destroy(&mTakePhotoCond);
+	free(mFaceBuf[0]);
+	free(mFaceBuf[1]);
+	free(mFaceScratch);
+	pthread_mutex_destroy(&mFaceMutex);
+	pthread_mutex_destroy(&mZslMutex);
+	pthread_cond_destroy(&mZslCond);
 }
 
 // 
@@ -242,6 +236,7 @@ status_t V4L2CameraDevice::connectDevice()
 	{
 		return ret;
 	}
+	nsecs_t start = systemTime();
 	
 #if USE_MP_CONVERT
 	// open MP driver
@@ -249,18 +244,29 @@ status_t V4L2CameraDevice::connectDevice()
 	if (mG2DHandle < 0)
 	{
 		LOGE("open /dev/g2d failed");
+		mG2DHandle = NULL;
+		closeCameraDev();
 		return -1;
 	}
 	LOGV("open /dev/g2d OK");
 #endif 
 
-	ret = cedarx_hardware_init(2);// CEDARX_HARDWARE_MODE_VIDEO
-	if (ret < 0)
+	// shared with the other cameras streaming at the same time
+	ret = gEmulatedCameraFactory.acquireHardware();
+	if (ret != NO_ERROR)
 	{
-		LOGE("cedarx_hardware_init failed");
+#if USE_MP_CONVERT
+		close(mG2DHandle);
+		mG2DHandle = NULL;
+#endif
+		closeCameraDev();
 		return -1;
 	}
-	LOGV("cedarx_hardware_init ok");
+	mCedarxTime = systemTime() - start;
+
+	LOGD("connect %s: open %lld us, caps %lld us (%s), cedarx %lld us",
+		mDeviceName, mOpenTime / 1000, mCapsTime / 1000,
+		mCapsCached ? "cached" : "probed", mCedarxTime / 1000);
 
     /* There is no device to connect to. */
     mState = ECDS_CONNECTED;
@@ -293,12 +299,7 @@ status_t V4L2CameraDevice::disconnectDevice()
 	}
 #endif
 
-	int ret = cedarx_hardware_exit(2);// CEDARX_HARDWARE_MODE_VIDEO
-	if (ret < 0)
-	{
-		LOGE("cedarx_hardware_exit failed\n");
-	}
-	LOGD("cedarx_hardware_exit ok");
+	gEmulatedCameraFactory.releaseHardware();
 
     /* There is no device to disconnect from. */
     mState = ECDS_INITIALIZED;
@@ -324,8 +325,20 @@ status_t V4L2CameraDevice::startDevice(int width,
 	
 	mVideoFormat = pix_fmt;
 
-	mCurrentV4l2buf = NULL;
-	mFaceDetectionEnable = false;
+	// frame size may have changed
+	mCropZoom = -1;
+
+	// buffer indexes start over
+	mTracer.reset();
+	mScheduler.reset();
+
+	// zsl frames are kept from the video stream only
+	mZslActive = mZslRequest && !mTakingPicture;
+	mZslCount = 0;
+
+	mBurstCaptured = 0;
+	mBurstEncoded = 0;
+	mBurstMaxDepth = 0;
 
 	// set capture mode
 	struct v4l2_streamparm params;
@@ -349,12 +362,17 @@ status_t V4L2CameraDevice::startDevice(int width,
 	v4l2setCaptureParams(&params);
 	
 	// v4l2 request buffers
-	v4l2ReqBufs();
+	if (v4l2ReqBufs() == NO_MEMORY)
+	{
+		LOGE("%s: no memory left for the capture buffers", __FUNCTION__);
+		return NO_MEMORY;
+	}
 
 	// v4l2 query buffers
 	v4l2QueryBuf();
 	
 	// stream on the v4l2 device
+	mRecordBuffers.start(mBufferCnt, mCameraID);
 	v4l2StartStreaming();
 
     /* Initialize the base class. */
@@ -364,6 +382,15 @@ status_t V4L2CameraDevice::startDevice(int width,
 		mState = ECDS_STARTED;
     }
 	
+	// the face detector works on a reduced luma plane of the same aspect
+	pthread_mutex_lock(&mFaceMutex);
+	mFaceWidth = (mFrameWidth < FACE_FRAME_WIDTH) ? mFrameWidth : FACE_FRAME_WIDTH;
+	mFaceWidth &= ~1;
+	mFaceHeight = (mFaceWidth * mFrameHeight / mFrameWidth) & ~1;
+	mFaceReady = -1;
+	mFaceFrameCount = 0;
+	pthread_mutex_unlock(&mFaceMutex);
+
 	mPreviewAfter = 1000000 / 40;
 	if (mFrameWidth * mFrameHeight > 640 * 480)
 	{
@@ -390,20 +417,34 @@ status_t V4L2CameraDevice::stopDevice()
         return NO_ERROR;
     }
 	
-	mFaceDetectionEnable = false;
+	pthread_mutex_lock(&mFaceMutex);
+	mFaceReady = -1;
+	pthread_mutex_unlock(&mFaceMutex);
+
+	// wait for the zsl picture being encoded
+	pthread_mutex_lock(&mZslMutex);
+	while (mZslPictureBuf != NULL)
+	{
+		pthread_cond_wait(&mZslCond, &mZslMutex);
+	}
+	mZslCount = 0;
+	pthread_mutex_unlock(&mZslMutex);
 		
-	// v4l2 device stop stream
+	// v4l2 device stop stream, the buffers the encoder still holds are not
+	// queued again
+	mRecordBuffers.stop();
 	v4l2StopStreaming();
 
     V4L2Camera::commonStopDevice();
 
-	mCurrentV4l2buf = NULL;
-
 	// v4l2 device unmap buffers
     v4l2UnmapBuf();
+	gEmulatedCameraFactory.releaseBuffers(mCameraID, CAMERA_MEM_CAPTURE);
 
 	mPreviewUseHW = false;
 
+	freeZoomBuffer();
+
 	for(int i = 0; i < NB_BUFFER; i++)
 	{
 		memset(&mV4l2buf[i], 0, sizeof(V4L2BUF_t));
@@ -420,18 +461,10 @@ status_t V4L2CameraDevice::stopDevice()
 
 int V4L2CameraDevice::v4l2WaitCameraReady()
 {
-	fd_set fds;		
-	struct timeval tv;
 	int r;
 
-	FD_ZERO(&fds);
-	FD_SET(mCamFd, &fds);		
-	
-	/* Timeout */
-	tv.tv_sec  = 2;
-	tv.tv_usec = 0;
-	
-	r = select(mCamFd + 1, &fds, NULL, NULL, &tv);
+	/* Timeout 2s */
+	r = mBackend->waitFrame(2000);
 	if (r == -1) 
 	{
 		LOGE("select err");
@@ -469,9 +502,17 @@ bool V4L2CameraDevice::inWorkerThread()
 	/* Timestamp the current frame, and notify the camera HAL about new frame. */
 	// mCurFrameTimestamp = systemTime(SYSTEM_TIME_MONOTONIC);
 	mCurFrameTimestamp = (int64_t)((int64_t)buf.timestamp.tv_usec + (((int64_t)buf.timestamp.tv_sec) * 1000000));
+	mTracer.start(buf.index);
+	mRecordBuffers.onDequeued(buf.index);
 
-	calculateCrop(&mRectCrop, mNewZoom, mMaxZoom, mFrameWidth, mFrameHeight);
-	mCameraHAL->setCrop(&mRectCrop, mNewZoom);
+	// the crop rect only changes with the zoom
+	const int new_zoom = mNewZoom;
+	if (new_zoom != mCropZoom)
+	{
+		calculateCrop(&mRectCrop, new_zoom, mMaxZoom, mFrameWidth, mFrameHeight);
+		mCameraHAL->setCrop(&mRectCrop, new_zoom);
+		mCropZoom = new_zoom;
+	}
 
 	if (mCaptureFormat == V4L2_PIX_FMT_YUYV)
 	{
@@ -505,6 +546,11 @@ bool V4L2CameraDevice::inWorkerThread()
 		v4l2_buf.addrPhyY		= mVideoBuffer.buf_phy_addr[buf.index]; 
 		v4l2_buf.addrVirY		= mVideoBuffer.buf_vir_addr[buf.index]; 
 	}
+	else if (mV4l2Memory == V4L2_MEMORY_USERPTR)
+	{
+		v4l2_buf.addrPhyY		= mMapMem.phy[buf.index];
+		v4l2_buf.addrVirY		= (unsigned int)mMapMem.mem[buf.index];
+	}
 	else
 	{
 		v4l2_buf.addrPhyY		= buf.m.offset;
@@ -523,42 +569,62 @@ bool V4L2CameraDevice::inWorkerThread()
 	// LOGV("DQBUF: addrPhyY: %x, id: %d, time: %lld", v4l2_buf.addrPhyY, buf.index, mCurFrameTimestamp);
 	
 	memcpy(&mV4l2buf[v4l2_buf.index], &v4l2_buf, sizeof(V4L2BUF_t));
-	mCurrentV4l2buf = &mV4l2buf[v4l2_buf.index];
 	
 	if (mTakingPicture)
 	{
-		
-		if (mCaptureFormat == V4L2_PIX_FMT_YUYV)
+		// usb camera: the first frame is not stable, skip it
+		if (mCaptureFormat == V4L2_PIX_FMT_YUYV
+			&& ++mTakingPictureFrame < 2)
 		{
-			mTakingPictureFrame ++;
-			if(mTakingPictureFrame == 2)
-			{
-				pthread_cond_signal(&mTakePhotoCond);
-				return false;
-			}
 			releasePreviewFrame(v4l2_buf.index);
 			return true;
 		}
-		else
+
+		if (mBurstCaptured > 0
+			&& mCurFrameTimestamp - mBurstLastFrame < mBurstInterval)
 		{
-			pthread_cond_signal(&mTakePhotoCond);
-			return false;
+			releasePreviewFrame(v4l2_buf.index);
+			return true;
 		}
-		
+
+		if (!mPictureRing.push(&mV4l2buf[v4l2_buf.index]))
+		{
+			LOGW("picture queue full");
+			releasePreviewFrame(v4l2_buf.index);
+			return true;
+		}
+
+		mBurstCaptureTime = systemTime();
+		if (mBurstCaptured == 0)
+		{
+			mBurstStartTime = mBurstCaptureTime;
+		}
+		mBurstLastFrame = mCurFrameTimestamp;
+		mBurstCaptured++;
+
+		int depth = mPictureRing.count();
+		if (depth > mBurstMaxDepth)
+		{
+			mBurstMaxDepth = depth;
+		}
+
+		// stop capturing after the last picture of the burst
+		return (mBurstCaptured < mBurstNum);
 	}
 	else
 	{
-		ret = OSAL_Queue(&mQueueBuffer, &mV4l2buf[v4l2_buf.index]);
-		if (ret != 0)
+		if (!mFrameRing.push(&mV4l2buf[v4l2_buf.index]))
 		{
 			LOGW("queue full");
+			mTracer.flag(v4l2_buf.index, FrameTracer::FLAG_DROPPED);
+			mScheduler.onQueued(mFrameRing.count(), true);
 			releasePreviewFrame(v4l2_buf.index);
 		}
-		
-		pthread_mutex_lock(&mPreviewMutex);
-		pthread_cond_signal(&mPreviewCond);
-		mFaceDetectionEnable = true;
-		pthread_mutex_unlock(&mPreviewMutex);
+		else
+		{
+			mTracer.mark(v4l2_buf.index, FrameTracer::STAGE_QUEUED);
+			mScheduler.onQueued(mFrameRing.count(), false);
+		}
 	}
 	
     return true;
@@ -566,14 +632,51 @@ bool V4L2CameraDevice::inWorkerThread()
 
 bool V4L2CameraDevice::pictureThread()
 {
-	pthread_mutex_lock(&mTakePhotoMutex);
-	pthread_cond_wait(&mTakePhotoCond, &mTakePhotoMutex);
+	V4L2BUF_t * pbuf = mPictureRing.waitPop();
+	if (pbuf == NULL)
+	{
+		// woken up for exit
+		return true;
+	}
+
+	if (pbuf == mZslPictureBuf)
+	{
+		// zero shutter lag, the stream keeps running
+		int64_t lasttime = systemTime();
+		mCameraHAL->onTakingPicture(mZslPictureBuf, this, true);
+		LOGV("taking zsl picture use time : %lld(ms)", (systemTime() - lasttime)/1000000);
+
+		pthread_mutex_lock(&mZslMutex);
+		releasePreviewFrame(mZslPictureBuf->index);
+		mZslPictureBuf = NULL;
+		pthread_cond_signal(&mZslCond);
+		pthread_mutex_unlock(&mZslMutex);
+		return true;
+	}
+
 	int64_t lasttime = systemTime();
-	mCameraHAL->onTakingPicture(mCurrentV4l2buf, this, true);
+	mCameraHAL->onTakingPicture(pbuf, this, true);
 	int64_t nowtime = systemTime();
 	LOGV("taking picture use time : %lld(ms)", (nowtime - lasttime)/1000000);
-	lasttime = nowtime;
-	pthread_mutex_unlock(&mTakePhotoMutex);
+	mBurstEncoded++;
+
+	if (mBurstEncoded < mBurstNum)
+	{
+		// give the buffer back for the next picture of the burst
+		releasePreviewFrame(pbuf->index);
+		return true;
+	}
+
+	if (mBurstNum > 1)
+	{
+		int64_t capture_ms = (mBurstCaptureTime - mBurstStartTime) / 1000000;
+		int64_t total_ms = (nowtime - mBurstStartTime) / 1000000;
+		LOGD("burst: %d pictures in %lld ms, capture %lld ms (%d fps), encode %d fps, max queue depth %d",
+			mBurstEncoded, total_ms, capture_ms,
+			capture_ms > 0 ? (int)((mBurstCaptured - 1) * 1000 / capture_ms) : 0,
+			total_ms > 0 ? (int)(mBurstEncoded * 1000 / total_ms) : 0,
+			mBurstMaxDepth);
+	}
 	
 	pthread_mutex_lock(&mTakePhotoEndMutex);
 	mTakingPicture = false;
@@ -588,11 +691,10 @@ bool V4L2CameraDevice::pictureThread()
 bool V4L2CameraDevice::previewThread()
 {
 	bool ret = false;
-	V4L2BUF_t * pbuf = (V4L2BUF_t *)OSAL_Dequeue(&mQueueBuffer);
+	V4L2BUF_t * pbuf = mFrameRing.waitPop();
 	if (pbuf == NULL)
 	{
-		// LOGD("OSAL_Dequeue no buffer, sleep...");
-		pthread_cond_wait(&mPreviewCond, &mPreviewMutex);
+		// woken up for exit
 		return true;
 	}
 
@@ -601,6 +703,7 @@ bool V4L2CameraDevice::previewThread()
 	{
 		return true;
 	}
+	mTracer.mark(pbuf->index, FrameTracer::STAGE_PREVIEW_THREAD);
 
 	if (mVideoFormat != pbuf->format)
 	{
@@ -617,7 +720,14 @@ bool V4L2CameraDevice::previewThread()
 		return true;
 	}
 
+	if (mFaceDetectionEnable
+		&& (++mFaceFrameCount % FACE_FRAME_INTERVAL) == 0)
+	{
+		feedFaceFrame(pbuf);
+	}
+
 	// callback
+	nsecs_t start = systemTime();
 	if (mUseHwEncoder)
 	{
 		mCameraHAL->onNextFrameCB(pbuf, mCurFrameTimestamp, this, true);
@@ -626,6 +736,8 @@ bool V4L2CameraDevice::previewThread()
 	{
 		mCameraHAL->onNextFrameCB((void*)pbuf->addrVirY, mCurFrameTimestamp, this, false);
 	}
+	mScheduler.onCallback(systemTime() - start);
+	mTracer.mark(pbuf->index, FrameTracer::STAGE_CALLBACK);
 	
 	// preview
 	if (mPreviewUseHW)
@@ -637,23 +749,207 @@ bool V4L2CameraDevice::previewThread()
 			mPreviewUseHW = false;
 			return true;
 		}
+		mTracer.mark(pbuf->index, FrameTracer::STAGE_PREVIEW);
 	}
 	else
 	{
-		if (isPreviewTime())
+		// the stride adapts to the load, isPreviewTime() caps the rate
+		if (mScheduler.shouldPreview() && isPreviewTime())
 		{
 			// mCameraHAL->onNextFramePreview(mMapMem.mem[pbuf->index], pbuf->format, mCurFrameTimestamp, this, false);
-			mCameraHAL->onNextFramePreview((void*)pbuf->addrVirY, pbuf->format, mCurFrameTimestamp, this, false);
+			start = systemTime();
+			ret = mCameraHAL->onNextFramePreview(zoomPreviewFrame(pbuf), pbuf->format, mCurFrameTimestamp, this, false);
+			mScheduler.onPreview(systemTime() - start, ret);
+			mTracer.mark(pbuf->index, FrameTracer::STAGE_PREVIEW);
+		}
+		else
+		{
+			mTracer.flag(pbuf->index, FrameTracer::FLAG_PREVIEW_SKIPPED);
 		}
 	}
 	
-	releasePreviewFrame(pbuf->index);
+	// a frame given to the encoder is queued back once the encoder is done too
+	if (mZslActive && !mUseHwEncoder)
+	{
+		zslHoldFrame(pbuf->index);
+	}
+	else
+	{
+		releasePreviewFrame(pbuf->index);
+	}
 	
 	setThreadRunning(true);
 
 	return true;
 }
 
+void * V4L2CameraDevice::zoomPreviewFrame(V4L2BUF_t * pbuf)
+{
+	if (pbuf->crop_rect.width == pbuf->width
+		&& pbuf->crop_rect.height == pbuf->height)
+	{
+		return (void*)pbuf->addrVirY;
+	}
+
+	const int size = pbuf->width * pbuf->height * 3 / 2;
+	if (mZoomBuffer == NULL || mZoomBufferSize != size)
+	{
+		freeZoomBuffer();
+		if (gEmulatedCameraFactory.reserveBuffers(mCameraID, CAMERA_MEM_ZOOM, size, 1, 1) < 0)
+		{
+			LOGE("no memory left for the zoom buffer, preview without zoom");
+			return (void*)pbuf->addrVirY;
+		}
+		mZoomBuffer = cedara_phymalloc_map(size, 1024);
+		if (mZoomBuffer == NULL)
+		{
+			LOGE("alloc zoom buffer failed, preview without zoom");
+			gEmulatedCameraFactory.releaseBuffers(mCameraID, CAMERA_MEM_ZOOM);
+			return (void*)pbuf->addrVirY;
+		}
+		mZoomBufferPhy = cedarv_address_vir2phy(mZoomBuffer) | 0x40000000;
+		mZoomBufferSize = size;
+	}
+
+#if USE_MP_CONVERT
+	if (mZoomUseG2D && zoomFrameG2D(pbuf))
+	{
+		return mZoomBuffer;
+	}
+#endif
+
+	status_t res = mZoomScaler.scale((void*)pbuf->addrVirY, pbuf->width, pbuf->height,
+									 pbuf->crop_rect.left, pbuf->crop_rect.top,
+									 pbuf->crop_rect.width, pbuf->crop_rect.height,
+									 mZoomBuffer, pbuf->width, pbuf->height);
+	if (res != NO_ERROR)
+	{
+		return (void*)pbuf->addrVirY;
+	}
+
+	return mZoomBuffer;
+}
+
+#if USE_MP_CONVERT
+bool V4L2CameraDevice::zoomFrameG2D(V4L2BUF_t * pbuf)
+{
+	g2d_stretchblt	blit_para;
+	int				err;
+	int				seq = (pbuf->format == V4L2_PIX_FMT_NV12) ? G2D_SEQ_NORMAL : G2D_SEQ_VUVU;
+
+	memset(&blit_para, 0, sizeof(blit_para));
+	blit_para.src_image.addr[0]		= pbuf->addrPhyY;
+	blit_para.src_image.addr[1]		= pbuf->addrPhyY + pbuf->width * pbuf->height;
+	blit_para.src_image.w			= pbuf->width;
+	blit_para.src_image.h			= pbuf->height;
+	blit_para.src_image.format		= G2D_FMT_PYUV420UVC;
+	blit_para.src_image.pixel_seq	= (g2d_pixel_seq)seq;
+	blit_para.src_rect.x			= pbuf->crop_rect.left;
+	blit_para.src_rect.y			= pbuf->crop_rect.top;
+	blit_para.src_rect.w			= pbuf->crop_rect.width;
+	blit_para.src_rect.h			= pbuf->crop_rect.height;
+
+	blit_para.dst_image.addr[0]		= mZoomBufferPhy;
+	blit_para.dst_image.addr[1]		= mZoomBufferPhy + pbuf->width * pbuf->height;
+	blit_para.dst_image.w			= pbuf->width;
+	blit_para.dst_image.h			= pbuf->height;
+	blit_para.dst_image.format		= G2D_FMT_PYUV420UVC;
+	blit_para.dst_image.pixel_seq	= (g2d_pixel_seq)seq;
+	blit_para.dst_rect.x			= 0;
+	blit_para.dst_rect.y			= 0;
+	blit_para.dst_rect.w			= pbuf->width;
+	blit_para.dst_rect.h			= pbuf->height;
+	blit_para.color					= 0xff;
+	blit_para.alpha					= 0xff;
+	blit_para.flag					= G2D_BLT_NONE;
+
+	err = ioctl(mG2DHandle, G2D_CMD_STRETCHBLT, (unsigned long)&blit_para);
+	if (err < 0)
+	{
+		LOGW("ioctl, G2D_CMD_STRETCHBLT failed, zoom with CPU");
+		mZoomUseG2D = false;
+		return false;
+	}
+
+	return true;
+}
+#endif
+
+void V4L2CameraDevice::freeZoomBuffer()
+{
+	if (mZoomBuffer != NULL)
+	{
+		cedara_phyfree_map(mZoomBuffer);
+		mZoomBuffer = NULL;
+		mZoomBufferPhy = 0;
+		mZoomBufferSize = 0;
+		gEmulatedCameraFactory.releaseBuffers(mCameraID, CAMERA_MEM_ZOOM);
+	}
+}
+
+void V4L2CameraDevice::zslHoldFrame(int index)
+{
+	pthread_mutex_lock(&mZslMutex);
+	if (mZslCount == NB_BUFFER_ZSL)
+	{
+		releasePreviewFrame(mZslFrames[0]);
+		for (int i = 1; i < mZslCount; i++)
+		{
+			mZslFrames[i - 1] = mZslFrames[i];
+		}
+		mZslCount--;
+	}
+	mZslFrames[mZslCount++] = index;
+	pthread_mutex_unlock(&mZslMutex);
+}
+
+status_t V4L2CameraDevice::takeZslPicture()
+{
+	pthread_mutex_lock(&mZslMutex);
+	if (!mZslActive || mZslCount == 0 || mZslPictureBuf != NULL)
+	{
+		pthread_mutex_unlock(&mZslMutex);
+		return INVALID_OPERATION;
+	}
+
+	// frame timestamps are in us, taken by the driver with gettimeofday
+	timeval cur_time;
+	gettimeofday(&cur_time, NULL);
+	const int64_t shutter = cur_time.tv_sec * 1000000LL + cur_time.tv_usec;
+
+	int best = 0;
+	int64_t best_diff = -1;
+	for (int i = 0; i < mZslCount; i++)
+	{
+		int64_t diff = mV4l2buf[mZslFrames[i]].timeStamp - shutter;
+		if (diff < 0)
+		{
+			diff = -diff;
+		}
+		if (best_diff < 0 || diff < best_diff)
+		{
+			best = i;
+			best_diff = diff;
+		}
+	}
+
+	mZslPictureBuf = &mV4l2buf[mZslFrames[best]];
+	for (int i = best + 1; i < mZslCount; i++)
+	{
+		mZslFrames[i - 1] = mZslFrames[i];
+	}
+	mZslCount--;
+	pthread_mutex_unlock(&mZslMutex);
+
+	LOGV("zsl picture: index: %d, %lld us from shutter", mZslPictureBuf->index, best_diff);
+
+	// the capture thread does not push pictures while zsl is active, so
+	// the ring still has a single producer
+	mPictureRing.push(mZslPictureBuf);
+
+	return NO_ERROR;
+}
+
 int V4L2CameraDevice::getCurrentFaceFrame(void * frame)
 {
 	if (frame == NULL)
@@ -662,27 +958,164 @@ int V4L2CameraDevice::getCurrentFaceFrame(void * frame)
 		return -1;
 	}
 
-	if (mCurrentV4l2buf == NULL
-		|| mCurrentV4l2buf->addrVirY == 0)
+	pthread_mutex_lock(&mFaceMutex);
+	if (!mFaceDetectionEnable || mFaceReady < 0)
 	{
-		LOGW("preview thread dose not started");
+		LOGV("no face frame yet");
+		pthread_mutex_unlock(&mFaceMutex);
 		return -1;
 	}
-	
-	pthread_mutex_lock(&mPreviewMutex);
-	if (mFaceDetectionEnable)
+	const int index = mFaceReady;
+	mFaceReading = index;
+	pthread_mutex_unlock(&mFaceMutex);
+
+	// the feed writes the other buffer meanwhile
+	memcpy(frame, mFaceBuf[index], mFaceWidth * mFaceHeight);
+
+	pthread_mutex_lock(&mFaceMutex);
+	mFaceReading = -1;
+	mFaceRequests++;
+
+	nsecs_t now = systemTime();
+	if (now - mFaceStatsStart >= 5000000000LL)
 	{
-		memcpy(frame, (void*)mCurrentV4l2buf->addrVirY, mFrameWidth * mFrameHeight);
+		if (mFaceStatsStart != 0)
+		{
+			const float secs = (now - mFaceStatsStart) / 1000000000.0f;
+			LOGD("face detection: %.1f fps, feed %d frames, %lld us each, %d skipped",
+				mFaceRequests / secs, mFaceFeedFrames,
+				mFaceFeedFrames ? mFaceFeedTime / mFaceFeedFrames / 1000 : 0LL,
+				mFaceFeedSkipped);
+		}
+		mFaceStatsStart = now;
+		mFaceRequests = 0;
+		mFaceFeedFrames = 0;
+		mFaceFeedSkipped = 0;
+		mFaceFeedTime = 0;
 	}
-	else
+	pthread_mutex_unlock(&mFaceMutex);
+
+	return 0;
+}
+
+void V4L2CameraDevice::dump(int fd)
+{
+	String8 out;
+	out.appendFormat("V4L2 camera %s: %dx%d, preview every %u us, %s preview\n",
+		mDeviceName, mFrameWidth, mFrameHeight, mPreviewAfter,
+		mPreviewUseHW ? "hw" : "sw");
+	out.appendFormat("  last connect: open %lld us, caps %lld us (%s), cedarx %lld us\n",
+		mOpenTime / 1000, mCapsTime / 1000, mCapsCached ? "cached" : "probed",
+		mCedarxTime / 1000);
+	write(fd, out.string(), out.size());
+
+	mScheduler.dump(fd);
+	mRecordBuffers.dump(fd);
+	mTracer.dump(fd);
+}
+
+void V4L2CameraDevice::setFaceDetection(bool enable)
+{
+	LOGV("%s: %d", __FUNCTION__, enable);
+
+	pthread_mutex_lock(&mFaceMutex);
+	mFaceDetectionEnable = enable;
+	mFaceReady = -1;
+	mFaceFrameCount = 0;
+	mFaceStatsStart = 0;
+	pthread_mutex_unlock(&mFaceMutex);
+}
+
+void V4L2CameraDevice::feedFaceFrame(V4L2BUF_t * pbuf)
+{
+	const nsecs_t start = systemTime();
+	const int size = mFaceWidth * mFaceHeight;
+	const int scratch_size = (mFrameWidth / 2) * (mFrameHeight / 2) * 5 / 4;
+
+	pthread_mutex_lock(&mFaceMutex);
+	int index = -1;
+	for (int i = 0; i < 2; i++)
 	{
-		LOGW("face detection disable");
-		pthread_mutex_unlock(&mPreviewMutex);
-		return -1;
+		if (i != mFaceReady && i != mFaceReading)
+		{
+			index = i;
+			break;
+		}
 	}
-	pthread_mutex_unlock(&mPreviewMutex);
 
-	return 0;
+	// buffers only grow, and never while the detector reads one
+	if (index >= 0 && (mFaceBufSize < size || mFaceScratchSize < scratch_size))
+	{
+		if (mFaceReading >= 0)
+		{
+			index = -1;
+		}
+		else
+		{
+			free(mFaceBuf[0]);
+			free(mFaceBuf[1]);
+			free(mFaceScratch);
+			mFaceBuf[0] = (uint8_t *)malloc(size);
+			mFaceBuf[1] = (uint8_t *)malloc(size);
+			mFaceScratch = (uint8_t *)malloc(scratch_size);
+			if (mFaceBuf[0] == NULL || mFaceBuf[1] == NULL || mFaceScratch == NULL)
+			{
+				LOGE("%s: no memory for the face frames", __FUNCTION__);
+				mFaceBufSize = 0;
+				mFaceScratchSize = 0;
+				index = -1;
+			}
+			else
+			{
+				mFaceBufSize = size;
+				mFaceScratchSize = scratch_size;
+			}
+			mFaceReady = -1;
+		}
+	}
+
+	if (index < 0)
+	{
+		mFaceFeedSkipped++;
+		pthread_mutex_unlock(&mFaceMutex);
+		return;
+	}
+	pthread_mutex_unlock(&mFaceMutex);
+
+	// halve the luma plane while it stays at least twice the face frame,
+	// alternating between the two halves of the scratch buffer, then
+	// scale the rest of the way
+	const uint8_t * src = (const uint8_t *)pbuf->addrVirY;
+	int w = mFrameWidth;
+	int h = mFrameHeight;
+	int level = 0;
+	while (((w / 2) & ~1) >= mFaceWidth && ((h / 2) & ~1) >= mFaceHeight)
+	{
+		uint8_t * dst = mFaceScratch + ((level & 1) ? (mFrameWidth / 2) * (mFrameHeight / 2) : 0);
+		YPlaneHalve(src, w, h, dst);
+		src = dst;
+		w = (w / 2) & ~1;
+		h = (h / 2) & ~1;
+		level++;
+	}
+
+	if (w == mFaceWidth && h == mFaceHeight)
+	{
+		memcpy(mFaceBuf[index], src, size);
+	}
+	else if (mFaceScaler.scaleLuma(src, w, h, mFaceBuf[index], mFaceWidth, mFaceHeight) != NO_ERROR)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&mFaceMutex);
+	if (mFaceDetectionEnable)
+	{
+		mFaceReady = index;
+	}
+	mFaceFeedFrames++;
+	mFaceFeedTime += systemTime() - start;
+	pthread_mutex_unlock(&mFaceMutex);
 }
 
 
@@ -691,17 +1124,21 @@ int V4L2CameraDevice::getCurrentFaceFrame(void * frame)
 // -----------------------------------------------------------------------------
 int V4L2CameraDevice::openCameraDev()
 {
+	nsecs_t start = systemTime();
+
 	// open V4L2 device
-	mCamFd = open(mDeviceName, O_RDWR | O_NONBLOCK, 0);
-	if (mCamFd == -1) 
+	mBackend = createV4L2Backend(mDeviceName);
+	if (mBackend->open(mDeviceName) == -1) 
 	{ 
         LOGE("ERROR opening %s: %s", mDeviceName, strerror(errno)); 
+		delete mBackend;
+		mBackend = NULL;
 		return -1; 
 	} 
 
 	struct v4l2_input inp;
 	inp.index = mDeviceID;
-	if (-1 == ioctl (mCamFd, VIDIOC_S_INPUT, &inp))
+	if (-1 == mBackend->ioctl(VIDIOC_S_INPUT, &inp))
 	{
 		LOGE("VIDIOC_S_INPUT error!");
 		return -1;
@@ -710,7 +1147,7 @@ int V4L2CameraDevice::openCameraDev()
 	// check v4l2 device capabilities
 	int ret = -1;
 	struct v4l2_capability cap; 
-	ret = ioctl (mCamFd, VIDIOC_QUERYCAP, &cap); 
+	ret = mBackend->ioctl(VIDIOC_QUERYCAP, &cap); 
     if (ret < 0) 
 	{ 
         LOGE("Error opening device: unable to query device."); 
@@ -728,6 +1165,17 @@ int V4L2CameraDevice::openCameraDev()
         LOGE("Capture device does not support streaming i/o"); 
         return -1; 
     } 
+	mOpenTime = systemTime() - start;
+	start = systemTime();
+
+	// the formats and frame sizes only change with the driver, enumerate
+	// them when it is new to the cache
+	mCaps.setDevice(mDeviceName, mDeviceID, &cap);
+	mCapsCached = mCaps.load();
+	if (!mCapsCached)
+	{
+		probeFormats();
+	}
 	
 	// try to support this format: NV21, YUYV
 	// we do not support mjpeg camera now
@@ -747,6 +1195,25 @@ int V4L2CameraDevice::openCameraDev()
 		return -1;
 	}
 
+	// NV21/NV12 sensors write straight into our physically contiguous buffers,
+	// so preview and encoder get the frame without any copy. YUYV frames are
+	// converted into mVideoBuffer anyway, keep the driver buffers for them.
+	if (mCaptureFormat == V4L2_PIX_FMT_YUYV)
+	{
+		mV4l2Memory = V4L2_MEMORY_MMAP;
+	}
+	else
+	{
+		mV4l2Memory = V4L2_MEMORY_USERPTR;
+	}
+
+	if (!mCapsCached)
+	{
+		probeSizes(mCaptureFormat);
+		mCaps.store();
+	}
+	mCapsTime = systemTime() - start;
+
 	return OK;
 }
 
@@ -754,10 +1221,11 @@ void V4L2CameraDevice::closeCameraDev()
 {
 	F_LOG;
 	
-	if (mCamFd != NULL)
+	if (mBackend != NULL)
 	{
-		close(mCamFd);
-		mCamFd = NULL;
+		mBackend->close();
+		delete mBackend;
+		mBackend = NULL;
 	}
 }
 
@@ -783,7 +1251,7 @@ int V4L2CameraDevice::v4l2SetVideoParams(int width, int height, uint32_t pix_fmt
 	}
 	format.fmt.pix.field = V4L2_FIELD_NONE;
 	
-	ret = ioctl(mCamFd, VIDIOC_S_FMT, &format); 
+	ret = mBackend->ioctl(VIDIOC_S_FMT, &format); 
 	if (ret < 0) 
 	{ 
 		LOGE("VIDIOC_S_FMT Failed: %s", strerror(errno)); 
@@ -792,6 +1260,12 @@ int V4L2CameraDevice::v4l2SetVideoParams(int width, int height, uint32_t pix_fmt
 	
 	mFrameWidth = format.fmt.pix.width;
 	mFrameHeight= format.fmt.pix.height;
+	mFrameBytes = format.fmt.pix.sizeimage;
+	if (mFrameBytes == 0)
+	{
+		mFrameBytes = (mCaptureFormat == V4L2_PIX_FMT_YUYV)
+			? mFrameWidth * mFrameHeight * 2 : mFrameWidth * mFrameHeight * 3 / 2;
+	}
 	LOGV("camera params: w: %d, h: %d, pfmt: %d, pfield: %d", 
 		mFrameWidth, mFrameHeight, pix_fmt, V4L2_FIELD_NONE);
 
@@ -806,21 +1280,54 @@ int V4L2CameraDevice::v4l2ReqBufs()
 
 	if (mTakingPicture)
 	{
-		mBufferCnt = 1;
+		// burst: capture the next picture while the last one is encoded
+		mBufferCnt = (mBurstNum > 1) ? NB_BUFFER_BURST : 1;
 	}
-	else
+	else if (mZslActive)
 	{
 		mBufferCnt = NB_BUFFER;
 	}
+	else
+	{
+		mBufferCnt = NB_BUFFER_PREVIEW;
+	}
+
+	// the buffers of all the cameras streaming at once share the reserved
+	// memory, take fewer of them rather than failing
+	int buffer_len = captureBufferSize();
+	const int minimum = mTakingPicture ? 1 : NB_BUFFER_MIN;
+	const int granted = gEmulatedCameraFactory.reserveBuffers(mCameraID, CAMERA_MEM_CAPTURE,
+							buffer_len, mBufferCnt, (minimum < mBufferCnt) ? minimum : mBufferCnt);
+	if (granted < 0)
+	{
+		return NO_MEMORY;
+	}
+	if (granted < mBufferCnt)
+	{
+		if (mZslActive && granted < NB_BUFFER)
+		{
+			LOGW("not enough buffers for zero shutter lag");
+			mZslActive = false;
+		}
+		mBufferCnt = granted;
+	}
 
 	LOGV("TO VIDIOC_REQBUFS count: %d", mBufferCnt);
 	
 	memset(&rb, 0, sizeof(rb));
     rb.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE; 
-    rb.memory = V4L2_MEMORY_MMAP; 
+    rb.memory = mV4l2Memory; 
     rb.count  = mBufferCnt; 
 	
-	ret = ioctl(mCamFd, VIDIOC_REQBUFS, &rb); 
+	ret = mBackend->ioctl(VIDIOC_REQBUFS, &rb); 
+	if (ret < 0 && mV4l2Memory == V4L2_MEMORY_USERPTR && mBackend->mmapIsPhysical())
+	{
+		LOGW("VIDIOC_REQBUFS V4L2_MEMORY_USERPTR failed: %s, use V4L2_MEMORY_MMAP", strerror(errno));
+		mV4l2Memory = V4L2_MEMORY_MMAP;
+		rb.memory = V4L2_MEMORY_MMAP;
+		rb.count  = mBufferCnt;
+		ret = mBackend->ioctl(VIDIOC_REQBUFS, &rb); 
+	}
     if (ret < 0) 
 	{ 
         LOGE("Init: VIDIOC_REQBUFS failed: %s", strerror(errno)); 
@@ -833,14 +1340,140 @@ int V4L2CameraDevice::v4l2ReqBufs()
 		LOGD("VIDIOC_REQBUFS count: %d", mBufferCnt);
 	}
 
+	// charge what we got: the driver may round the count up, and its own
+	// buffers replace ours after the V4L2_MEMORY_MMAP fallback
+	if (mBufferCnt > granted || captureBufferSize() != buffer_len)
+	{
+		buffer_len = captureBufferSize();
+		if (gEmulatedCameraFactory.reserveBuffers(mCameraID, CAMERA_MEM_CAPTURE,
+				buffer_len, mBufferCnt, mBufferCnt) < 0)
+		{
+			v4l2ReleaseBufs();
+			gEmulatedCameraFactory.releaseBuffers(mCameraID, CAMERA_MEM_CAPTURE);
+			return NO_MEMORY;
+		}
+	}
+
 	return OK;
 }
 
+// physically contiguous bytes one capture buffer takes
+int V4L2CameraDevice::captureBufferSize()
+{
+	const int nv21_len = (mFrameWidth * mFrameHeight * 3 / 2 + 4095) & ~4095;
+	if (mV4l2Memory == V4L2_MEMORY_USERPTR)
+	{
+		return nv21_len;							// v4l2AllocUserBuf
+	}
+	int len = (mFrameBytes + 4095) & ~4095;			// the driver's buffer
+	if (mCaptureFormat == V4L2_PIX_FMT_YUYV)
+	{
+		len += nv21_len;							// its NV21 copy in mVideoBuffer
+	}
+	return len;
+}
+
+int V4L2CameraDevice::v4l2AllocUserBuf()
+{
+	F_LOG;
+	int ret = UNKNOWN_ERROR;
+	struct v4l2_buffer buf;
+
+	// page aligned, the driver maps the whole buffer
+	int buffer_len = (mFrameWidth * mFrameHeight * 3 / 2 + 4095) & ~4095;
+	
+	for (int i = 0; i < mBufferCnt; i++) 
+	{
+		mMapMem.mem[i] = cedara_phymalloc_map(buffer_len, 4096);
+		if (mMapMem.mem[i] == NULL)
+		{
+			LOGE("alloc user buffer failed, index: %d, len: %x", i, buffer_len);
+			v4l2ReleaseBufs();
+			v4l2FreeUserBuf();
+			return -1;
+		}
+		mMapMem.phy[i] = cedarv_address_vir2phy(mMapMem.mem[i]) | 0x40000000;
+		mMapMem.length = buffer_len;
+		LOGV("user buffer: index: %d, vir: %x, phy: %x, len: %x", 
+				i, (int)mMapMem.mem[i], mMapMem.phy[i], buffer_len);
+
+        memset (&buf, 0, sizeof (struct v4l2_buffer)); 
+		buf.type		= V4L2_BUF_TYPE_VIDEO_CAPTURE; 
+		buf.memory		= V4L2_MEMORY_USERPTR; 
+		buf.index		= i; 
+		buf.m.userptr	= (unsigned long)mMapMem.mem[i];
+		buf.length		= buffer_len;
+
+		// start with all buffers in queue
+        ret = mBackend->ioctl(VIDIOC_QBUF, &buf); 
+        if (ret < 0) 
+		{ 
+            LOGW("VIDIOC_QBUF V4L2_MEMORY_USERPTR Failed: %s", strerror(errno)); 
+			// the driver may hold the buffers queued so far, drop them first
+			v4l2ReleaseBufs();
+			v4l2FreeUserBuf();
+            return ret; 
+        } 
+	}
+
+	return OK;
+}
+
+// the driver lets go of all the buffers, before the memory behind them is freed
+void V4L2CameraDevice::v4l2ReleaseBufs()
+{
+	struct v4l2_requestbuffers rb;
+	memset(&rb, 0, sizeof(rb));
+	rb.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	rb.memory = mV4l2Memory;
+	rb.count  = 0;
+	if (mBackend->ioctl(VIDIOC_REQBUFS, &rb) < 0)
+	{
+		LOGW("VIDIOC_REQBUFS 0 failed: %s", strerror(errno));
+	}
+}
+
+void V4L2CameraDevice::v4l2FreeUserBuf()
+{
+	F_LOG;
+	for (int i = 0; i < NB_BUFFER; i++) 
+	{
+		if (mMapMem.mem[i] != NULL)
+		{
+			cedara_phyfree_map(mMapMem.mem[i]);
+			mMapMem.mem[i] = NULL;
+			mMapMem.phy[i] = 0;
+		}
+	}
+}
+
 int V4L2CameraDevice::v4l2QueryBuf()
 {
 	F_LOG;
 	int ret = UNKNOWN_ERROR;
 	struct v4l2_buffer buf;
+
+	if (mV4l2Memory == V4L2_MEMORY_USERPTR)
+	{
+		if (v4l2AllocUserBuf() == OK)
+		{
+			return OK;
+		}
+		if (!mBackend->mmapIsPhysical())
+		{
+			LOGE("user buffers refused, no mmap fallback for this device");
+			return UNKNOWN_ERROR;
+		}
+
+		// driver refused our buffers, v4l2AllocUserBuf released them
+		LOGW("driver refused user buffers, use V4L2_MEMORY_MMAP");
+		mV4l2Memory = V4L2_MEMORY_MMAP;
+		ret = v4l2ReqBufs();
+		if (ret != OK)
+		{
+			return ret;
+		}
+	}
 	
 	for (int i = 0; i < mBufferCnt; i++) 
 	{  
@@ -849,18 +1482,14 @@ int V4L2CameraDevice::v4l2QueryBuf()
 		buf.memory = V4L2_MEMORY_MMAP; 
 		buf.index  = i; 
 		
-		ret = ioctl (mCamFd, VIDIOC_QUERYBUF, &buf); 
+		ret = mBackend->ioctl(VIDIOC_QUERYBUF, &buf); 
         if (ret < 0) 
 		{ 
             LOGE("Unable to query buffer (%s)", strerror(errno)); 
             return ret; 
         } 
  
-        mMapMem.mem[i] = mmap (0, buf.length, 
-                            PROT_READ | PROT_WRITE, 
-                            MAP_SHARED, 
-                            mCamFd, 
-                            buf.m.offset); 
+        mMapMem.mem[i] = mBackend->mmap(buf.length, buf.m.offset); 
 		mMapMem.length = buf.length;
 		LOGV("index: %d, mem: %x, len: %x, offset: %x", i, (int)mMapMem.mem[i], buf.length, buf.m.offset);
  
@@ -871,13 +1500,18 @@ int V4L2CameraDevice::v4l2QueryBuf()
         } 
 
 		// start with all buffers in queue
-        ret = ioctl(mCamFd, VIDIOC_QBUF, &buf); 
+        ret = mBackend->ioctl(VIDIOC_QBUF, &buf); 
         if (ret < 0) 
 		{ 
             LOGE("VIDIOC_QBUF Failed"); 
             return ret; 
         } 
 
+		if (mCaptureFormat != V4L2_PIX_FMT_YUYV)
+		{
+			continue;
+		}
+
 		int buffer_len = mFrameWidth * mFrameHeight * 3 / 2;
 		mVideoBuffer.buf_vir_addr[i] = (int)cedara_phymalloc_map(buffer_len, 1024);
 		mVideoBuffer.buf_phy_addr[i] = cedarv_address_vir2phy((void*)mVideoBuffer.buf_vir_addr[i]);
@@ -899,7 +1533,7 @@ int V4L2CameraDevice::v4l2StartStreaming()
 	int ret = UNKNOWN_ERROR; 
 	enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE; 
 	
-  	ret = ioctl (mCamFd, VIDIOC_STREAMON, &type); 
+  	ret = mBackend->ioctl(VIDIOC_STREAMON, &type); 
 	if (ret < 0) 
 	{ 
 		LOGE("StartStreaming: Unable to start capture: %s", strerror(errno)); 
@@ -915,7 +1549,7 @@ int V4L2CameraDevice::v4l2StopStreaming()
 	int ret = UNKNOWN_ERROR; 
 	enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE; 
 	
-	ret = ioctl (mCamFd, VIDIOC_STREAMOFF, &type); 
+	ret = mBackend->ioctl(VIDIOC_STREAMOFF, &type); 
 	if (ret < 0) 
 	{ 
 		LOGE("StopStreaming: Unable to stop capture: %s", strerror(errno)); 
@@ -931,17 +1565,31 @@ int V4L2CameraDevice::v4l2UnmapBuf()
 	F_LOG;
 	int ret = UNKNOWN_ERROR;
 	
+	if (mV4l2Memory == V4L2_MEMORY_USERPTR)
+	{
+		v4l2ReleaseBufs();
+		v4l2FreeUserBuf();
+	}
+	
 	for (int i = 0; i < mBufferCnt; i++) 
 	{
-		ret = munmap(mMapMem.mem[i], mMapMem.length);
-        if (ret < 0) 
+		if (mV4l2Memory == V4L2_MEMORY_MMAP)
 		{
-            LOGE("v4l2CloseBuf Unmap failed"); 
-			return ret;
+			ret = mBackend->munmap(mMapMem.mem[i], mMapMem.length);
+			if (ret < 0) 
+			{
+				LOGE("v4l2CloseBuf Unmap failed"); 
+				return ret;
+			}
+			mMapMem.mem[i] = NULL;
 		}
 
-		cedara_phyfree_map((void*)mVideoBuffer.buf_vir_addr[i]);
-		mVideoBuffer.buf_phy_addr[i] = 0;
+		if (mVideoBuffer.buf_vir_addr[i] != 0)
+		{
+			cedara_phyfree_map((void*)mVideoBuffer.buf_vir_addr[i]);
+			mVideoBuffer.buf_vir_addr[i] = 0;
+			mVideoBuffer.buf_phy_addr[i] = 0;
+		}
 	}
 	mVideoBuffer.buf_unused = NB_BUFFER;
 	mVideoBuffer.read_id = 0;
@@ -951,17 +1599,44 @@ int V4L2CameraDevice::v4l2UnmapBuf()
 }
 
 void V4L2CameraDevice::releasePreviewFrame(int index)
+{
+	if (mRecordBuffers.release(index, RecordingBufferManager::HOLDER_PREVIEW))
+	{
+		v4l2QueueBuf(index);
+	}
+}
+
+const void* V4L2CameraDevice::lendRecordingFrame(const void* frame)
+{
+	return mRecordBuffers.lendToEncoder((const V4L2BUF_t *)frame);
+}
+
+void V4L2CameraDevice::releaseRecordingFrame(int index)
+{
+	if (mRecordBuffers.release(index, RecordingBufferManager::HOLDER_ENCODER))
+	{
+		v4l2QueueBuf(index);
+	}
+}
+
+void V4L2CameraDevice::v4l2QueueBuf(int index)
 {
 	int ret = UNKNOWN_ERROR;
 	struct v4l2_buffer buf;
 	
 	memset(&buf, 0, sizeof(v4l2_buffer));
 	buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE; 
-    buf.memory = V4L2_MEMORY_MMAP; 
+    buf.memory = mV4l2Memory; 
 	buf.index = index;
+	if (mV4l2Memory == V4L2_MEMORY_USERPTR)
+	{
+		buf.m.userptr	= (unsigned long)mMapMem.mem[index];
+		buf.length		= mMapMem.length;
+	}
 	
 	// LOGV("r ID: %d", buf.index);
-    ret = ioctl(mCamFd, VIDIOC_QBUF, &buf); 
+	mTracer.mark(index, FrameTracer::STAGE_RELEASED);
+    ret = mBackend->ioctl(VIDIOC_QBUF, &buf); 
     if (ret != 0) 
 	{
 		// comment for temp, to do
@@ -975,9 +1650,9 @@ int V4L2CameraDevice::getPreviewFrame(v4l2_buffer *buf)
 	int ret = UNKNOWN_ERROR;
 	
 	buf->type   = V4L2_BUF_TYPE_VIDEO_CAPTURE; 
-    buf->memory = V4L2_MEMORY_MMAP; 
+    buf->memory = mV4l2Memory; 
  
-    ret = ioctl(mCamFd, VIDIOC_DQBUF, buf); 
+    ret = mBackend->ioctl(VIDIOC_DQBUF, buf); 
     if (ret < 0) 
 	{ 
         LOGW("GetPreviewFrame: VIDIOC_DQBUF Failed"); 
@@ -987,27 +1662,27 @@ int V4L2CameraDevice::getPreviewFrame(v4l2_buffer *buf)
 	return OK;
 }
 
-int V4L2CameraDevice::tryFmt(int format)
+void V4L2CameraDevice::probeFormats()
 {	
 	struct v4l2_fmtdesc fmtdesc;
 	fmtdesc.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-	for(int i = 0; i < 12; i++)
+	for(int i = 0; i < CameraCapsCache::MAX_FORMATS; i++)
 	{
 		fmtdesc.index = i;
-		if (-1 == ioctl (mCamFd, VIDIOC_ENUM_FMT, &fmtdesc))
+		if (-1 == mBackend->ioctl(VIDIOC_ENUM_FMT, &fmtdesc))
 		{
 			break;
 		}
 		LOGV("format index = %d, name = %s, v4l2 pixel format = %x\n",
 			i, fmtdesc.description, fmtdesc.pixelformat);
 
-		if (fmtdesc.pixelformat == format)
-		{
-			return OK;
-		}
+		mCaps.addFormat(fmtdesc.pixelformat);
 	}
+}
 
-	return -1;
+int V4L2CameraDevice::tryFmt(int format)
+{	
+	return mCaps.hasFormat(format) ? OK : -1;
 }
 
 int V4L2CameraDevice::tryFmtSize(int * width, int * height)
@@ -1035,7 +1710,7 @@ int V4L2CameraDevice::tryFmtSize(int * width, int * height)
 	}
 	fmt.fmt.pix.field = V4L2_FIELD_NONE;
 
-	ret = ioctl(mCamFd, VIDIOC_TRY_FMT, &fmt); 
+	ret = mBackend->ioctl(VIDIOC_TRY_FMT, &fmt); 
 	if (ret < 0) 
 	{ 
 		LOGE("VIDIOC_TRY_FMT Failed: %s", strerror(errno)); 
@@ -1086,7 +1761,7 @@ int V4L2CameraDevice::getFrameRate()
 	struct v4l2_streamparm parms;
 	parms.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 
-	ret = ioctl (mCamFd, VIDIOC_G_PARM, &parms);
+	ret = mBackend->ioctl(VIDIOC_G_PARM, &parms);
 	if (ret < 0) 
 	{
 		LOGE("VIDIOC_G_PARM getFrameRate error\n");
@@ -1116,7 +1791,7 @@ int V4L2CameraDevice::setImageEffect(int effect)
 
 	ctrl.id = V4L2_CID_COLORFX;
 	ctrl.value = effect;
-	ret = ioctl(mCamFd, VIDIOC_S_CTRL, &ctrl);
+	ret = mBackend->ioctl(VIDIOC_S_CTRL, &ctrl);
 	if (ret < 0)
 		LOGV("setImageEffect failed!");
 	else 
@@ -1132,7 +1807,7 @@ int V4L2CameraDevice::setWhiteBalance(int wb)
 
 	ctrl.id = V4L2_CID_DO_WHITE_BALANCE;
 	ctrl.value = wb;
-	ret = ioctl(mCamFd, VIDIOC_S_CTRL, &ctrl);
+	ret = mBackend->ioctl(VIDIOC_S_CTRL, &ctrl);
 	if (ret < 0)
 		LOGV("setWhiteBalance failed!");
 	else 
@@ -1149,7 +1824,7 @@ int V4L2CameraDevice::setExposure(int exp)
 
 	ctrl.id = V4L2_CID_EXPOSURE;
 	ctrl.value = exp;
-	ret = ioctl(mCamFd, VIDIOC_S_CTRL, &ctrl);
+	ret = mBackend->ioctl(VIDIOC_S_CTRL, &ctrl);
 	if (ret < 0)
 		LOGV("setExposure failed!");
 	else 
@@ -1167,7 +1842,7 @@ int V4L2CameraDevice::setFlashMode(int mode)
 
 	ctrl.id = V4L2_CID_CAMERA_FLASH_MODE;
 	ctrl.value = mode;
-	ret = ioctl(mCamFd, VIDIOC_S_CTRL, &ctrl);
+	ret = mBackend->ioctl(VIDIOC_S_CTRL, &ctrl);
 	if (ret < 0)
 		LOGV("setFlashMode failed!");
 	else 
@@ -1176,38 +1851,47 @@ int V4L2CameraDevice::setFlashMode(int mode)
 	return ret;
 }
 
-int V4L2CameraDevice::enumSize(char * pSize, int len)
+void V4L2CameraDevice::probeSizes(uint32_t format)
 {
 	struct v4l2_frmsizeenum size_enum;
 	size_enum.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-	size_enum.pixel_format = mCaptureFormat;
-
-	if (pSize == NULL)
-	{
-		LOGE("error input params");
-		return -1;
-	}
+	size_enum.pixel_format = format;
 
+	char sizes[CameraCapsCache::SIZES_LENGTH];
 	char str[16];
-	memset(str, 0, 16);
-	memset(pSize, 0, len);
+	memset(sizes, 0, sizeof(sizes));
 	
 	for(int i = 0; i < 20; i++)
 	{
 		size_enum.index = i;
-		if (-1 == ioctl (mCamFd, VIDIOC_ENUM_FRAMESIZES, &size_enum))
+		if (-1 == mBackend->ioctl(VIDIOC_ENUM_FRAMESIZES, &size_enum))
 		{
 			break;
 		}
 		// LOGV("format index = %d, size_enum: %dx%d", i, size_enum.discrete.width, size_enum.discrete.height);
-		sprintf(str, "%dx%d", size_enum.discrete.width, size_enum.discrete.height);
-		if (i != 0)
+		snprintf(str, sizeof(str), "%s%dx%d", (i != 0) ? "," : "",
+			size_enum.discrete.width, size_enum.discrete.height);
+		if (strlen(sizes) + strlen(str) >= sizeof(sizes))
 		{
-			strcat(pSize, ",");
+			break;
 		}
-		strcat(pSize, str);
+		strcat(sizes, str);
 	}
 
+	mCaps.setSizes(format, sizes);
+}
+
+int V4L2CameraDevice::enumSize(char * pSize, int len)
+{
+	if (pSize == NULL || len <= 0)
+	{
+		LOGE("error input params");
+		return -1;
+	}
+
+	strncpy(pSize, mCaps.getSizes(mCaptureFormat), len - 1);
+	pSize[len - 1] = 0;
+
 	return OK;
 }
 
@@ -1220,7 +1904,7 @@ int V4L2CameraDevice::setAutoFocusMode(int af_mode)
 
 	ctrl.id = V4L2_CID_CAMERA_AF_MODE;
 	ctrl.value = af_mode;
-	ret = ioctl(mCamFd, VIDIOC_S_CTRL, &ctrl);
+	ret = mBackend->ioctl(VIDIOC_S_CTRL, &ctrl);
 	if (ret < 0)
 		LOGV("setAutoFocusMode failed!");
 	else 
@@ -1239,7 +1923,7 @@ int V4L2CameraDevice::setAutoFocusCtrl(int af_ctrl, void *areas)
 	ctrl.id = V4L2_CID_CAMERA_AF_CTRL;
 	ctrl.value = af_ctrl;
 	ctrl.user_pt = (unsigned int)areas;
-	ret = ioctl(mCamFd, VIDIOC_S_CTRL, &ctrl);
+	ret = mBackend->ioctl(VIDIOC_S_CTRL, &ctrl);
 	if (ret < 0)
 		LOGE("setAutoFocusCtrl failed!");
 	else 
@@ -1256,7 +1940,7 @@ int V4L2CameraDevice::getAutoFocusStatus(int af_ctrl)
 
 	ctrl.id = V4L2_CID_CAMERA_AF_CTRL;
 	ctrl.value = af_ctrl;
-	ret = ioctl(mCamFd, VIDIOC_G_CTRL, &ctrl);
+	ret = mBackend->ioctl(VIDIOC_G_CTRL, &ctrl);
 	if (ret >= 0)
 		LOGV("getAutoFocusCtrl ok");
 
@@ -1268,7 +1952,7 @@ int V4L2CameraDevice::v4l2setCaptureParams(struct v4l2_streamparm * params)
 	F_LOG;
 	int ret = -1;
 
-	ret = ioctl(mCamFd, VIDIOC_S_PARM, params);
+	ret = mBackend->ioctl(VIDIOC_S_PARM, params);
 	if (ret < 0)
 		LOGE("v4l2setCaptureParams failed!");
 	else 
@@ -25,9 +25,20 @@
 #include <ui/Rect.h>
 #include "Converters.h"
 #include "V4L2Camera.h"
-#include "OSAL_Queue.h"
+#include "FrameRing.h"
+#include "YUVScaler.h"
+#include "FrameTracer.h"
+#include "FrameScheduler.h"
+#include "CameraCapsCache.h"
+#include "V4L2Backend.h"
+#include "RecordingBufferManager.h"
 #include <type_camera.h>
 
+// face detection feed: width of the reduced luma plane given to the
+// detector, and number of previewed frames per published plane
+#define FACE_FRAME_WIDTH		320
+#define FACE_FRAME_INTERVAL		2
+
 namespace android {
 
 class CameraHardwareDevice;
@@ -74,6 +85,10 @@ public:
     /* Gets current preview fame into provided buffer. */
     status_t getPreviewFrame(void* buffer);
 
+    /* Hands frames to the encoder, and takes them back. */
+    const void* lendRecordingFrame(const void* frame);
+    void releaseRecordingFrame(int index);
+
     /***************************************************************************
      * Worker thread management overrides.
      * See declarations of these methods in V4L2Camera class for
@@ -157,10 +172,23 @@ public:
 	int setAutoFocusCtrl(int af_ctrl, void * areas);
 	int getAutoFocusStatus(int af_ctrl);
 	
-	void releasePreviewFrame(int index);			// Q buffer for encoder
+	void releasePreviewFrame(int index);			// done with a dequeued buffer
 
 	int getCurrentFaceFrame(void * frame);
 
+	// prints the frame pacing, the preview scheduling and the frame trace
+	void dump(int fd);
+
+	// starts / stops the face detection feed
+	void setFaceDetection(bool enable);
+
+	// size of the planes of the face detection feed, 0 if not started
+	inline void getFaceFrameSize(int * width, int * height)
+	{
+		*width = mFaceWidth;
+		*height = mFaceHeight;
+	}
+
 	inline void setCrop(int new_zoom, int max_zoom)
 	{
 		mLastZoom = mNewZoom;
@@ -177,19 +205,57 @@ public:
 	{
 		mUseHwEncoder = hw;
 	}
+
+	// zero shutter lag, applied on the next startDevice()
+	inline void setZsl(bool enable)
+	{
+		mZslRequest = enable;
+	}
+
+	inline bool isZslActive()
+	{
+		return mZslActive;
+	}
+
+	// encode the kept frame closest to now, preview keeps running
+	status_t takeZslPicture();
+
+	// burst capture, applied on the next takePicture
+	// num: pictures per shot, interval: minimum time between them in ms
+	inline void setBurst(int num, int interval)
+	{
+		mBurstNum = (num > 0) ? num : 1;
+		mBurstInterval = (interval > 0) ? (int64_t)interval * 1000 : 0;
+	}
 	
 private:
 	int openCameraDev();
 	void closeCameraDev();
+	void probeFormats();
+	void probeSizes(uint32_t format);
 	int v4l2SetVideoParams(int width, int height, uint32_t pix_fmt);
 	int v4l2setCaptureParams(struct v4l2_streamparm * params);
 	int v4l2ReqBufs();
+	int captureBufferSize();
 	int v4l2QueryBuf();
+	int v4l2AllocUserBuf();
+	void v4l2ReleaseBufs();
+	void v4l2FreeUserBuf();
 	int v4l2StartStreaming(); 
 	int v4l2StopStreaming(); 
+	void v4l2QueueBuf(int index);
 	int v4l2UnmapBuf();
 
 	int v4l2WaitCameraReady();
+
+	void zslHoldFrame(int index);
+
+	// scale the crop rect of the frame into mZoomBuffer for SW preview
+	void * zoomPreviewFrame(V4L2BUF_t * pbuf);
+	void freeZoomBuffer();
+#if USE_MP_CONVERT
+	bool zoomFrameG2D(V4L2BUF_t * pbuf);
+#endif
 	int getPreviewFrame(v4l2_buffer *buf);
 	
 	void dealWithVideoFrameSW(V4L2BUF_t * pBuf);
@@ -213,8 +279,8 @@ private:
 	// camera id
 	int								mCameraID;
 	
-	// v4l2 device handle
-	int								mCamFd; 
+	// v4l2 device, a device node or the synthetic camera
+	V4L2Backend *					mBackend; 
 
 	// device node name
 	char							mDeviceName[16];
@@ -229,13 +295,21 @@ private:
 
 	typedef struct v4l2_mem_map_t{
 		void *	mem[NB_BUFFER]; 
+		int		phy[NB_BUFFER];		// physical address, only for V4L2_MEMORY_USERPTR
 		int 	length;
 	}v4l2_mem_map_t;
 	v4l2_mem_map_t					mMapMem;
 
+	// V4L2_MEMORY_USERPTR: driver writes into our physically contiguous buffers,
+	// V4L2_MEMORY_MMAP: driver owns the buffers (fallback)
+	int								mV4l2Memory;
+
 	// actually buffer counts
 	int								mBufferCnt;
 
+	// bytes the driver writes per frame in the negotiated format
+	int								mFrameBytes;
+
 	// HW preview failed, should use SW preview
 	bool							mPreviewUseHW;
 	
@@ -257,10 +331,8 @@ private:
 		int			buf_unused;
 	}bufferManagerQ_t;
 
-	pthread_mutex_t					mTakePhotoMutex;
-	pthread_cond_t					mTakePhotoCond;
-	
 	Rect							mRectCrop;
+	int								mCropZoom;			// zoom of mRectCrop, -1 to recompute
 	int								mNewZoom;
 	int								mLastZoom;
 	int								mMaxZoom;
@@ -274,17 +346,76 @@ private:
 	int 							mG2DHandle;
 #endif
 
-	OSAL_QUEUE						mQueueBuffer;
+	FrameRing						mFrameRing;			// capture -> preview
+	FrameRing						mPictureRing;		// capture -> picture
+	FrameTracer						mTracer;			// per-frame stage times
+	FrameScheduler					mScheduler;			// SW preview frame stride
+	RecordingBufferManager			mRecordBuffers;		// holders of the dequeued buffers
 	V4L2BUF_t						mV4l2buf[NB_BUFFER];
 
 	sp<DoPreviewThread>				mPreviewThread;
 	sp<DoPictureThread>				mPictureThread;
 
-	V4L2BUF_t *						mCurrentV4l2buf;
-	bool							mFaceDetectionEnable;
+	// face detection feed: every FACE_FRAME_INTERVAL previewed frames a
+	// reduced luma plane is published into one of two buffers, the detector
+	// copies the last published one. The lock only guards the indexes.
+	void feedFaceFrame(V4L2BUF_t * pbuf);
 
-	pthread_mutex_t 				mPreviewMutex;
-	pthread_cond_t					mPreviewCond;
+	bool							mFaceDetectionEnable;
+	pthread_mutex_t 				mFaceMutex;
+	uint8_t *						mFaceBuf[2];
+	uint8_t *						mFaceScratch;		// halved luma planes
+	int								mFaceBufSize;
+	int								mFaceScratchSize;
+	int								mFaceWidth;
+	int								mFaceHeight;
+	int								mFaceReady;			// last published, -1 if none
+	int								mFaceReading;		// being copied, -1 if none
+	int								mFaceFrameCount;
+	YUVScaler						mFaceScaler;
+	nsecs_t							mFaceStatsStart;
+	int								mFaceRequests;		// planes given to the detector
+	int								mFaceFeedFrames;	// planes published
+	int								mFaceFeedSkipped;	// no free buffer
+	nsecs_t							mFaceFeedTime;		// preview thread time spent publishing
+
+	// SW preview digital zoom: the crop rect is scaled to a whole frame by
+	// the G2D, or by the CPU if the G2D fails
+	YUVScaler						mZoomScaler;
+	void *							mZoomBuffer;		// physically contiguous
+	int								mZoomBufferPhy;
+	int								mZoomBufferSize;
+	bool							mZoomUseG2D;
+
+	// zero shutter lag: the last NB_BUFFER_ZSL previewed frames are kept back
+	// from the driver, oldest first
+	bool							mZslRequest;
+	bool							mZslActive;
+	int								mZslFrames[NB_BUFFER_ZSL];
+	int								mZslCount;
+	V4L2BUF_t *						mZslPictureBuf;		// frame being encoded
+	pthread_mutex_t					mZslMutex;
+	pthread_cond_t					mZslCond;
+
+	// burst capture: capture and encoding overlap, each frame is given back
+	// to the driver as soon as it is encoded
+	int								mBurstNum;
+	int64_t							mBurstInterval;		// us
+	int								mBurstCaptured;
+	int								mBurstEncoded;
+	int64_t							mBurstLastFrame;	// timestamp of the last captured frame
+	nsecs_t							mBurstStartTime;
+	nsecs_t							mBurstCaptureTime;	// last frame captured
+	int								mBurstMaxDepth;		// max frames waiting for the encoder
+
+	// formats and frame sizes of the sensor, probed once per driver version
+	CameraCapsCache					mCaps;
+	bool							mCapsCached;		// last connect used the cache
+
+	// phases of the last connectDevice(), for dump()
+	nsecs_t							mOpenTime;			// open, select input, query caps
+	nsecs_t							mCapsTime;			// load or probe the capabilities
+	nsecs_t							mCedarxTime;		// cedarx_hardware_init
 };	
 
 }; /* namespace android */
@@ -0,0 +1,451 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Contains implementation of a class YUVScaler that scales a rectangle of a
+ * semi-planar YUV 4:2:0 image with bilinear filtering.
+ */
+
+#define LOG_TAG "Camera_YUVScaler"
+#include "CameraDebug.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "YUYVConverters.h"
+#include "YUVScaler.h"
+
+namespace android {
+
+/* Blends two rows: (r0 * (256 - f) + r1 * f + 128) >> 8, 0 < f < 256. */
+static void _BlendRows_C(const uint8_t* r0, const uint8_t* r1, int f,
+                         uint8_t* out, int n)
+{
+    const int f0 = 256 - f;
+    for (int i = 0; i < n; i++)
+    {
+        out[i] = (uint8_t)((r0[i] * f0 + r1[i] * f + 128) >> 8);
+    }
+}
+
+#if defined(__ARM_NEON__)
+/* NEON version of the above, bit-exact, 16 bytes per iteration. */
+static void _BlendRows_NEON(const uint8_t* r0, const uint8_t* r1, int f,
+                            uint8_t* out, int n)
+{
+    const uint8x8_t w0 = vdup_n_u8((uint8_t)(256 - f));
+    const uint8x8_t w1 = vdup_n_u8((uint8_t)f);
+    const int n16 = n & ~15;
+
+    for (int i = 0; i < n16; i += 16)
+    {
+        uint8x16_t a = vld1q_u8(r0 + i);
+        uint8x16_t b = vld1q_u8(r1 + i);
+        uint16x8_t lo = vmull_u8(vget_low_u8(a), w0);
+        uint16x8_t hi = vmull_u8(vget_high_u8(a), w0);
+        lo = vmlal_u8(lo, vget_low_u8(b), w1);
+        hi = vmlal_u8(hi, vget_high_u8(b), w1);
+        vst1q_u8(out + i, vcombine_u8(vrshrn_n_u16(lo, 8), vrshrn_n_u16(hi, 8)));
+    }
+
+    if (n16 < n)
+    {
+        _BlendRows_C(r0 + n16, r1 + n16, f, out + n16, n - n16);
+    }
+}
+#endif
+
+static void BlendRows(const uint8_t* r0, const uint8_t* r1, int f,
+                      uint8_t* out, int n)
+{
+#if defined(__ARM_NEON__)
+    if (cpuHasNeon())
+    {
+        _BlendRows_NEON(r0, r1, f, out, n);
+        return;
+    }
+#endif
+    _BlendRows_C(r0, r1, f, out, n);
+}
+
+/* Averages 2x2 blocks of two luma rows into 'n' pixels, and 2x2 blocks of
+ * U/V pairs of two chroma rows into 'n' pairs: (a + b + c + d + 2) >> 2.
+ */
+static void _HalveLumaRow_C(const uint8_t* r0, const uint8_t* r1, uint8_t* out, int n)
+{
+    for (int x = 0; x < n; x++)
+    {
+        out[x] = (uint8_t)((r0[2 * x] + r0[2 * x + 1] + r1[2 * x] + r1[2 * x + 1] + 2) >> 2);
+    }
+}
+
+static void _HalveChromaRow_C(const uint8_t* r0, const uint8_t* r1, uint8_t* out, int n)
+{
+    for (int x = 0; x < n; x++)
+    {
+        out[2 * x]     = (uint8_t)((r0[4 * x] + r0[4 * x + 2] + r1[4 * x] + r1[4 * x + 2] + 2) >> 2);
+        out[2 * x + 1] = (uint8_t)((r0[4 * x + 1] + r0[4 * x + 3] + r1[4 * x + 1] + r1[4 * x + 3] + 2) >> 2);
+    }
+}
+
+#if defined(__ARM_NEON__)
+/* NEON versions of the above, bit-exact, 8 output pixels / pairs per
+ * iteration. */
+static void _HalveLumaRow_NEON(const uint8_t* r0, const uint8_t* r1, uint8_t* out, int n)
+{
+    const int n8 = n & ~7;
+    for (int x = 0; x < n8; x += 8)
+    {
+        uint16x8_t sum = vpaddlq_u8(vld1q_u8(r0 + 2 * x));
+        sum = vpadalq_u8(sum, vld1q_u8(r1 + 2 * x));
+        vst1_u8(out + x, vrshrn_n_u16(sum, 2));
+    }
+
+    if (n8 < n)
+    {
+        _HalveLumaRow_C(r0 + 2 * n8, r1 + 2 * n8, out + n8, n - n8);
+    }
+}
+
+static void _HalveChromaRow_NEON(const uint8_t* r0, const uint8_t* r1, uint8_t* out, int n)
+{
+    const int n8 = n & ~7;
+    for (int x = 0; x < n8; x += 8)
+    {
+        uint8x16x2_t a = vld2q_u8(r0 + 4 * x);
+        uint8x16x2_t b = vld2q_u8(r1 + 4 * x);
+        uint16x8_t u = vpadalq_u8(vpaddlq_u8(a.val[0]), b.val[0]);
+        uint16x8_t v = vpadalq_u8(vpaddlq_u8(a.val[1]), b.val[1]);
+        uint8x8x2_t uv;
+        uv.val[0] = vrshrn_n_u16(u, 2);
+        uv.val[1] = vrshrn_n_u16(v, 2);
+        vst2_u8(out + 2 * x, uv);
+    }
+
+    if (n8 < n)
+    {
+        _HalveChromaRow_C(r0 + 4 * n8, r1 + 4 * n8, out + 2 * n8, n - n8);
+    }
+}
+#endif
+
+typedef void (*halve_row_func_t)(const uint8_t* r0, const uint8_t* r1, uint8_t* out, int n);
+
+static void _YUV420SPHalve(halve_row_func_t luma, halve_row_func_t chroma,
+                           const void* src, int src_w, int src_h, void* dst)
+{
+    const int dst_w = (src_w / 2) & ~1;
+    const int dst_h = (src_h / 2) & ~1;
+    const uint8_t* s = (const uint8_t*)src;
+    uint8_t* d = (uint8_t*)dst;
+
+    for (int y = 0; y < dst_h; y++)
+    {
+        const uint8_t* r0 = s + 2 * y * src_w;
+        luma(r0, r0 + src_w, d + y * dst_w, dst_w);
+    }
+
+    const uint8_t* sc = s + src_w * src_h;
+    uint8_t* dc = d + dst_w * dst_h;
+    for (int y = 0; y < dst_h / 2; y++)
+    {
+        const uint8_t* r0 = sc + 2 * y * src_w;
+        chroma(r0, r0 + src_w, dc + y * dst_w, dst_w / 2);
+    }
+}
+
+void YUV420SPHalve(const void* src, int src_w, int src_h, void* dst)
+{
+#if defined(__ARM_NEON__)
+    if (cpuHasNeon())
+    {
+        _YUV420SPHalve(_HalveLumaRow_NEON, _HalveChromaRow_NEON, src, src_w, src_h, dst);
+        return;
+    }
+#endif
+    _YUV420SPHalve(_HalveLumaRow_C, _HalveChromaRow_C, src, src_w, src_h, dst);
+}
+
+void YUV420SPHalve_C(const void* src, int src_w, int src_h, void* dst)
+{
+    _YUV420SPHalve(_HalveLumaRow_C, _HalveChromaRow_C, src, src_w, src_h, dst);
+}
+
+void YPlaneHalve(const void* src, int src_w, int src_h, void* dst)
+{
+    halve_row_func_t luma = _HalveLumaRow_C;
+#if defined(__ARM_NEON__)
+    if (cpuHasNeon())
+    {
+        luma = _HalveLumaRow_NEON;
+    }
+#endif
+
+    const int dst_w = (src_w / 2) & ~1;
+    const int dst_h = (src_h / 2) & ~1;
+    const uint8_t* s = (const uint8_t*)src;
+    uint8_t* d = (uint8_t*)dst;
+    for (int y = 0; y < dst_h; y++)
+    {
+        const uint8_t* r0 = s + 2 * y * src_w;
+        luma(r0, r0 + src_w, d + y * dst_w, dst_w);
+    }
+}
+
+/* Maps 'dst_len' destination positions on 'src_len' source ones, pixel
+ * centers aligned. Positions are relative to the start of the source range.
+ */
+static void BuildAxis(int src_len, int dst_len, int* index, uint8_t* frac)
+{
+    for (int i = 0; i < dst_len; i++)
+    {
+        int64_t pos = (((int64_t)(2 * i + 1) * src_len) << 16) / (2 * dst_len) - 32768;
+        if (pos < 0)
+        {
+            pos = 0;
+        }
+        int idx = (int)(pos >> 16);
+        int f = (int)(pos >> 8) & 0xff;
+        if (idx >= src_len - 1)
+        {
+            idx = src_len - 1;
+            f = 0;
+        }
+        index[i] = idx;
+        frac[i] = (uint8_t)f;
+    }
+}
+
+YUVScaler::YUVScaler()
+    : mSrcW(0),
+      mSrcH(0),
+      mCropX(0),
+      mCropY(0),
+      mCropW(0),
+      mCropH(0),
+      mDstW(0),
+      mDstH(0),
+      mLumaX(NULL),
+      mLumaXFrac(NULL),
+      mLumaY(NULL),
+      mLumaYFrac(NULL),
+      mChromaX(NULL),
+      mChromaXFrac(NULL),
+      mChromaY(NULL),
+      mChromaYFrac(NULL),
+      mRow(NULL)
+{
+}
+
+YUVScaler::~YUVScaler()
+{
+    release();
+}
+
+void YUVScaler::release()
+{
+    free(mLumaX);
+    free(mLumaY);
+    free(mRow);
+    mLumaX = NULL;
+    mLumaXFrac = NULL;
+    mLumaY = NULL;
+    mLumaYFrac = NULL;
+    mChromaX = NULL;
+    mChromaXFrac = NULL;
+    mChromaY = NULL;
+    mChromaYFrac = NULL;
+    mRow = NULL;
+    mDstW = mDstH = 0;
+}
+
+bool YUVScaler::setup(int src_w, int src_h,
+                      int crop_x, int crop_y, int crop_w, int crop_h,
+                      int dst_w, int dst_h)
+{
+    if (mRow != NULL
+        && src_w == mSrcW && src_h == mSrcH
+        && crop_x == mCropX && crop_y == mCropY
+        && crop_w == mCropW && crop_h == mCropH
+        && dst_w == mDstW && dst_h == mDstH)
+    {
+        return true;
+    }
+
+    release();
+
+    // one block per axis: indexes of luma then chroma, followed by weights
+    const int cdst_w = dst_w / 2;
+    const int cdst_h = dst_h / 2;
+    mLumaX = (int*)malloc((dst_w + cdst_w) * (sizeof(int) + 1));
+    mLumaY = (int*)malloc((dst_h + cdst_h) * (sizeof(int) + 1));
+    mRow = (uint8_t*)malloc(crop_w);
+    if (mLumaX == NULL || mLumaY == NULL || mRow == NULL)
+    {
+        LOGE("%s: no memory", __FUNCTION__);
+        release();
+        return false;
+    }
+    mChromaX = mLumaX + dst_w;
+    mLumaXFrac = (uint8_t*)(mChromaX + cdst_w);
+    mChromaXFrac = mLumaXFrac + dst_w;
+    mChromaY = mLumaY + dst_h;
+    mLumaYFrac = (uint8_t*)(mChromaY + cdst_h);
+    mChromaYFrac = mLumaYFrac + dst_h;
+
+    BuildAxis(crop_w, dst_w, mLumaX, mLumaXFrac);
+    BuildAxis(crop_h, dst_h, mLumaY, mLumaYFrac);
+    BuildAxis(crop_w / 2, cdst_w, mChromaX, mChromaXFrac);
+    BuildAxis(crop_h / 2, cdst_h, mChromaY, mChromaYFrac);
+
+    // chroma is stored in U/V pairs
+    for (int i = 0; i < cdst_w; i++)
+    {
+        mChromaX[i] *= 2;
+    }
+
+    mSrcW = src_w;
+    mSrcH = src_h;
+    mCropX = crop_x;
+    mCropY = crop_y;
+    mCropW = crop_w;
+    mCropH = crop_h;
+    mDstW = dst_w;
+    mDstH = dst_h;
+
+    LOGV("%s: [%d, %d, %d, %d] of %dx%d -> %dx%d", __FUNCTION__,
+         crop_x, crop_y, crop_w, crop_h, src_w, src_h, dst_w, dst_h);
+    return true;
+}
+
+void YUVScaler::scalePlane(const uint8_t* src, int src_stride,
+                           const int* y_index, const uint8_t* y_frac,
+                           const int* x_index, const uint8_t* x_frac,
+                           int pixel_bytes, int row_bytes,
+                           uint8_t* dst, int dst_stride, int dst_w, int dst_h)
+{
+    for (int y = 0; y < dst_h; y++)
+    {
+        const uint8_t* row = src + y_index[y] * src_stride;
+        if (y_frac[y] != 0)
+        {
+            BlendRows(row, row + src_stride, y_frac[y], mRow, row_bytes);
+            row = mRow;
+        }
+
+        uint8_t* d = dst + y * dst_stride;
+        if (pixel_bytes == 1)
+        {
+            for (int x = 0; x < dst_w; x++)
+            {
+                const uint8_t* p = row + x_index[x];
+                const int f = x_frac[x];
+                d[x] = (f == 0) ? p[0]
+                                : (uint8_t)((p[0] * (256 - f) + p[1] * f + 128) >> 8);
+            }
+        }
+        else
+        {
+            for (int x = 0; x < dst_w; x++)
+            {
+                const uint8_t* p = row + x_index[x];
+                const int f = x_frac[x];
+                if (f == 0)
+                {
+                    d[2 * x] = p[0];
+                    d[2 * x + 1] = p[1];
+                }
+                else
+                {
+                    d[2 * x] = (uint8_t)((p[0] * (256 - f) + p[2] * f + 128) >> 8);
+                    d[2 * x + 1] = (uint8_t)((p[1] * (256 - f) + p[3] * f + 128) >> 8);
+                }
+            }
+        }
+    }
+}
+
+status_t YUVScaler::scale(const void* src, int src_w, int src_h,
+                          int crop_x, int crop_y, int crop_w, int crop_h,
+                          void* dst, int dst_w, int dst_h)
+{
+    crop_x &= ~1;
+    crop_y &= ~1;
+    crop_w &= ~1;
+    crop_h &= ~1;
+    if (src == NULL || dst == NULL
+        || crop_w <= 0 || crop_h <= 0
+        || crop_x + crop_w > src_w || crop_y + crop_h > src_h
+        || dst_w < 2 || dst_h < 2)
+    {
+        LOGE("%s: bad geometry [%d, %d, %d, %d] of %dx%d -> %dx%d", __FUNCTION__,
+             crop_x, crop_y, crop_w, crop_h, src_w, src_h, dst_w, dst_h);
+        return BAD_VALUE;
+    }
+
+    if (!setup(src_w, src_h, crop_x, crop_y, crop_w, crop_h, dst_w, dst_h))
+    {
+        return NO_MEMORY;
+    }
+
+    const uint8_t* s = (const uint8_t*)src;
+    uint8_t* d = (uint8_t*)dst;
+
+    scalePlane(s + crop_y * src_w + crop_x, src_w,
+               mLumaY, mLumaYFrac, mLumaX, mLumaXFrac,
+               1, crop_w,
+               d, dst_w, dst_w, dst_h);
+
+    scalePlane(s + src_w * src_h + (crop_y / 2) * src_w + crop_x, src_w,
+               mChromaY, mChromaYFrac, mChromaX, mChromaXFrac,
+               2, crop_w,
+               d + dst_w * dst_h, dst_w, dst_w / 2, dst_h / 2);
+
+    return NO_ERROR;
+}
+
+status_t YUVScaler::scaleLuma(const void* src, int src_w, int src_h,
+                              void* dst, int dst_w, int dst_h)
+{
+    src_w &= ~1;
+    src_h &= ~1;
+    if (src == NULL || dst == NULL
+        || src_w <= 0 || src_h <= 0
+        || dst_w < 2 || dst_h < 2)
+    {
+        LOGE("%s: bad geometry %dx%d -> %dx%d", __FUNCTION__,
+             src_w, src_h, dst_w, dst_h);
+        return BAD_VALUE;
+    }
+
+    if (!setup(src_w, src_h, 0, 0, src_w, src_h, dst_w, dst_h))
+    {
+        return NO_MEMORY;
+    }
+
+    scalePlane((const uint8_t*)src, src_w,
+               mLumaY, mLumaYFrac, mLumaX, mLumaXFrac,
+               1, src_w,
+               (uint8_t*)dst, dst_w, dst_w, dst_h);
+
+    return NO_ERROR;
+}
+
+}; /* namespace android */
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HW_EMULATOR_CAMERA_YUV_SCALER_H
+#define HW_EMULATOR_CAMERA_YUV_SCALER_H
+
+/*
+ * Contains declaration of a class YUVScaler that scales a rectangle of a
+ * semi-planar YUV 4:2:0 (NV12 or NV21) image with bilinear filtering, used
+ * for digital zoom when the G2D can not be used, and of a box filter halving
+ * used to derive reduced streams from a frame.
+ */
+
+#include <stdint.h>
+#include <utils/Errors.h>
+
+namespace android {
+
+/* Halves a semi-planar YUV 4:2:0 image with a 2x2 box filter, rounded.
+ * Param:
+ *  src - Source NV12 / NV21 image.
+ *  src_w, src_h - Source dimensions.
+ *  dst - Destination image, same layout, (src_w / 2) & ~1 x (src_h / 2) & ~1.
+ */
+void YUV420SPHalve(const void* src, int src_w, int src_h, void* dst);
+
+/* Portable C version of the above, always available. */
+void YUV420SPHalve_C(const void* src, int src_w, int src_h, void* dst);
+
+/* Same as YUV420SPHalve, for a single 8 bit plane such as a luma plane. */
+void YPlaneHalve(const void* src, int src_w, int src_h, void* dst);
+
+class YUVScaler {
+public:
+    YUVScaler();
+    ~YUVScaler();
+
+    /* Scales a rectangle of the source image to the whole destination image.
+     * The interpolation tables are only rebuilt when the geometry changes.
+     * Param:
+     *  src - Source NV12 / NV21 image.
+     *  src_w, src_h - Source dimensions.
+     *  crop_x, crop_y, crop_w, crop_h - Source rectangle, even values.
+     *  dst - Destination image, same layout as the source.
+     *  dst_w, dst_h - Destination dimensions, even values.
+     * Return:
+     *  NO_ERROR on success, or an appropriate error status.
+     */
+    status_t scale(const void* src, int src_w, int src_h,
+                   int crop_x, int crop_y, int crop_w, int crop_h,
+                   void* dst, int dst_w, int dst_h);
+
+    /* Scales a whole single 8 bit plane, such as a luma plane.
+     * Param:
+     *  src - Source plane.
+     *  src_w, src_h - Source dimensions, even values.
+     *  dst - Destination plane.
+     *  dst_w, dst_h - Destination dimensions, even values.
+     * Return:
+     *  NO_ERROR on success, or an appropriate error status.
+     */
+    status_t scaleLuma(const void* src, int src_w, int src_h,
+                       void* dst, int dst_w, int dst_h);
+
+private:
+    bool setup(int src_w, int src_h,
+               int crop_x, int crop_y, int crop_w, int crop_h,
+               int dst_w, int dst_h);
+    void release();
+
+    void scalePlane(const uint8_t* src, int src_stride,
+                    const int* y_index, const uint8_t* y_frac,
+                    const int* x_index, const uint8_t* x_frac,
+                    int pixel_bytes, int row_bytes,
+                    uint8_t* dst, int dst_stride, int dst_w, int dst_h);
+
+    /* Cached geometry. */
+    int         mSrcW;
+    int         mSrcH;
+    int         mCropX;
+    int         mCropY;
+    int         mCropW;
+    int         mCropH;
+    int         mDstW;
+    int         mDstH;
+
+    /* Source position and 8 bit weight of the next pixel, for every
+     * destination column and row of the luma and chroma planes. */
+    int*        mLumaX;
+    uint8_t*    mLumaXFrac;
+    int*        mLumaY;
+    uint8_t*    mLumaYFrac;
+    int*        mChromaX;
+    uint8_t*    mChromaXFrac;
+    int*        mChromaY;
+    uint8_t*    mChromaYFrac;
+
+    /* One vertically filtered source row. */
+    uint8_t*    mRow;
+};
+
+}; /* namespace android */
+
+#endif  /* HW_EMULATOR_CAMERA_YUV_SCALER_H */
@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Contains implementation of YUYV to NV12 / NV21 conversion routines.
+ */
+
+#define LOG_TAG "Camera_YUYVConverter"
+#include "CameraDebug.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "YUYVConverters.h"
+
+namespace android {
+
+/* Same values as <asm/hwcap.h>, which is not exported by every toolchain. */
+#define CAMERA_AT_HWCAP			16
+#define CAMERA_HWCAP_NEON		4096
+
+typedef void (*row_pair_func_t)(const uint8_t* src0, const uint8_t* src1,
+								uint8_t* y0, uint8_t* y1, uint8_t* c,
+								int width, bool nv21);
+
+static pthread_once_t	sKernelOnce		= PTHREAD_ONCE_INIT;
+static bool				sHasNeon		= false;
+static row_pair_func_t	sRowPairFunc	= NULL;
+
+/* Converts two YUYV rows into two luma rows and one interleaved chroma row,
+ * chroma is the rounded average of both rows: (a + b + 1) >> 1.
+ * 'src1' may be equal to 'src0' for the last row of an odd height frame.
+ */
+static void _YUYVRowPairToYUV420SP_C(const uint8_t* src0,
+									 const uint8_t* src1,
+									 uint8_t* y0,
+									 uint8_t* y1,
+									 uint8_t* c,
+									 int width,
+									 bool nv21)
+{
+	const int u_pos = nv21 ? 1 : 0;
+	const int v_pos = nv21 ? 0 : 1;
+
+	for (int x = 0; x < width; x += 2)
+	{
+		y0[0] = src0[0];
+		y0[1] = src0[2];
+		y1[0] = src1[0];
+		y1[1] = src1[2];
+		c[u_pos] = (uint8_t)((src0[1] + src1[1] + 1) >> 1);
+		c[v_pos] = (uint8_t)((src0[3] + src1[3] + 1) >> 1);
+
+		src0 += 4; src1 += 4;
+		y0 += 2; y1 += 2; c += 2;
+	}
+}
+
+#if defined(__ARM_NEON__)
+/* NEON version of the above: 32 pixels of both rows per iteration, the
+ * remaining (width % 32) pixels are done by the C kernel.
+ */
+static void _YUYVRowPairToYUV420SP_NEON(const uint8_t* src0,
+										const uint8_t* src1,
+										uint8_t* y0,
+										uint8_t* y1,
+										uint8_t* c,
+										int width,
+										bool nv21)
+{
+	const int width32 = width & ~31;
+
+	for (int x = 0; x < width32; x += 32)
+	{
+		// val[0]: Y even, val[1]: U, val[2]: Y odd, val[3]: V
+		uint8x16x4_t r0 = vld4q_u8(src0);
+		uint8x16x4_t r1 = vld4q_u8(src1);
+
+		uint8x16x2_t luma0;
+		luma0.val[0] = r0.val[0];
+		luma0.val[1] = r0.val[2];
+		vst2q_u8(y0, luma0);
+
+		uint8x16x2_t luma1;
+		luma1.val[0] = r1.val[0];
+		luma1.val[1] = r1.val[2];
+		vst2q_u8(y1, luma1);
+
+		uint8x16_t u = vrhaddq_u8(r0.val[1], r1.val[1]);
+		uint8x16_t v = vrhaddq_u8(r0.val[3], r1.val[3]);
+		uint8x16x2_t chroma;
+		chroma.val[0] = nv21 ? v : u;
+		chroma.val[1] = nv21 ? u : v;
+		vst2q_u8(c, chroma);
+
+		src0 += 64; src1 += 64;
+		y0 += 32; y1 += 32; c += 32;
+	}
+
+	if (width32 < width)
+	{
+		_YUYVRowPairToYUV420SP_C(src0, src1, y0, y1, c, width - width32, nv21);
+	}
+}
+#endif
+
+static void selectKernel()
+{
+	sRowPairFunc = _YUYVRowPairToYUV420SP_C;
+
+#if defined(__ARM_NEON__)
+	int fd = open("/proc/self/auxv", O_RDONLY);
+	if (fd >= 0)
+	{
+		unsigned long entry[2];
+		while (read(fd, entry, sizeof(entry)) == sizeof(entry) && entry[0] != 0)
+		{
+			if (entry[0] == CAMERA_AT_HWCAP)
+			{
+				sHasNeon = (entry[1] & CAMERA_HWCAP_NEON) != 0;
+				break;
+			}
+		}
+		close(fd);
+	}
+
+	if (sHasNeon)
+	{
+		sRowPairFunc = _YUYVRowPairToYUV420SP_NEON;
+	}
+#endif
+
+	LOGV("YUYV converter use %s kernel", sHasNeon ? "NEON" : "C");
+}
+
+static void _YUYVToYUV420SP(row_pair_func_t func,
+							const void* yuyv,
+							void* yuv420sp,
+							int width,
+							int height,
+							bool nv21)
+{
+	const uint8_t* src = (const uint8_t*)yuyv;
+	uint8_t* Y = (uint8_t*)yuv420sp;
+	uint8_t* C = Y + width * height;
+	const int src_stride = width * 2;
+
+	for (int i = 0; i < height; i += 2)
+	{
+		const uint8_t* src0 = src + i * src_stride;
+		uint8_t* y0 = Y + i * width;
+
+		// odd height: the last row is paired with itself
+		const bool last = (i + 1 >= height);
+		const uint8_t* src1 = last ? src0 : src0 + src_stride;
+		uint8_t* y1 = last ? y0 : y0 + width;
+
+		func(src0, src1, y0, y1, C + (i >> 1) * width, width, nv21);
+	}
+}
+
+bool cpuHasNeon()
+{
+	pthread_once(&sKernelOnce, selectKernel);
+	return sHasNeon;
+}
+
+void YUYVToNV12(const void* yuyv, void* nv12, int width, int height)
+{
+	pthread_once(&sKernelOnce, selectKernel);
+	_YUYVToYUV420SP(sRowPairFunc, yuyv, nv12, width, height, false);
+}
+
+void YUYVToNV21(const void* yuyv, void* nv21, int width, int height)
+{
+	pthread_once(&sKernelOnce, selectKernel);
+	_YUYVToYUV420SP(sRowPairFunc, yuyv, nv21, width, height, true);
+}
+
+void YUYVToNV12_C(const void* yuyv, void* nv12, int width, int height)
+{
+	_YUYVToYUV420SP(_YUYVRowPairToYUV420SP_C, yuyv, nv12, width, height, false);
+}
+
+void YUYVToNV21_C(const void* yuyv, void* nv21, int width, int height)
+{
+	_YUYVToYUV420SP(_YUYVRowPairToYUV420SP_C, yuyv, nv21, width, height, true);
+}
+
+}; /* namespace android */
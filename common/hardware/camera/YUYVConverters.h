@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HW_EMULATOR_CAMERA_YUYV_CONVERTERS_H
+#define HW_EMULATOR_CAMERA_YUYV_CONVERTERS_H
+
+#include <stdint.h>
+
+/*
+ * Contains declaration of packed YUYV (YUV 4:2:2) to semi-planar YUV 4:2:0
+ * conversion routines, used for usb cameras which can only output YUYV.
+ *
+ * Chroma of the output is the rounded average of each pair of source rows,
+ * instead of only keeping the even rows. The NEON kernels and the portable
+ * C kernels produce bit-exact identical output; the kernel is selected once
+ * at runtime, depending on the CPU features.
+ */
+
+namespace android {
+
+/* Returns true if the CPU supports NEON and the NEON kernels are built in. */
+bool cpuHasNeon();
+
+/* Converts a YUYV framebuffer to NV12 framebuffer.
+ * Param:
+ *  yuyv - YUYV framebuffer.
+ *  nv12 - NV12 framebuffer.
+ *  width, height - Dimensions for both framebuffers, width must be even.
+ */
+void YUYVToNV12(const void* yuyv, void* nv12, int width, int height);
+
+/* Converts a YUYV framebuffer to NV21 framebuffer.
+ * Param:
+ *  yuyv - YUYV framebuffer.
+ *  nv21 - NV21 framebuffer.
+ *  width, height - Dimensions for both framebuffers, width must be even.
+ */
+void YUYVToNV21(const void* yuyv, void* nv21, int width, int height);
+
+/* Portable C versions of the above, always available. */
+void YUYVToNV12_C(const void* yuyv, void* nv12, int width, int height);
+void YUYVToNV21_C(const void* yuyv, void* nv21, int width, int height);
+
+}; /* namespace android */
+
+#endif  /* HW_EMULATOR_CAMERA_YUYV_CONVERTERS_H */
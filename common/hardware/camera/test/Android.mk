@@ -0,0 +1,90 @@
+LOCAL_PATH := $(call my-dir)
+
+# Tests and benchmarks of the camera HAL modules that run without a camera.
+# Build with "mmm device/allwinner/common/hardware/camera/test", then run
+# e.g. out/host/linux-x86/bin/camera_yuyv_test, or the same binary on the
+# device. The first argument is the number of benchmark iterations.
+
+camera_test_includes := \
+	$(LOCAL_PATH)/.. \
+	$(TOP)/frameworks/base/media/CedarX-Projects/CedarX/include/include_camera \
+	$(TOP)/frameworks/base/include/media/stagefright/openmax
+
+# YUYV to NV12 / NV21, reference, C and NEON kernels
+camera_test_name := camera_yuyv_test
+camera_test_src := YUYVConvertersTest.cpp ../YUYVConverters.cpp
+include $(LOCAL_PATH)/camera_test.mk
+
+# FrameRing, producer / consumer stress, handoff rate and latency against
+# the OSAL_Queue handoff it replaced
+camera_test_name := camera_framering_test
+camera_test_src := FrameRingTest.cpp ../FrameRing.cpp ../OSAL_Queue.c ../OSAL_Mutex.c
+include $(LOCAL_PATH)/camera_test.mk
+
+# StripeJpegEncoder, time and size per picture against the number of threads
+# and, on the device, the skia encoder; every output is decoded again
+camera_test_name := camera_stripejpeg_bench
+camera_test_src := StripeJpegEncoderBench.cpp ../StripeJpegEncoder.cpp
+camera_test_host_ldlibs := -ljpeg
+camera_test_shared_libs := libjpeg libutils libskia libandroid_runtime
+camera_test_target_includes := \
+	external/jpeg \
+	external/skia/include/core \
+	frameworks/base/core/jni/android/graphics
+camera_test_target_cflags := -DSTRIPE_BENCH_SKIA
+include $(LOCAL_PATH)/camera_test.mk
+
+# YUV 4:2:0 to RGB and NV12 / NV21 chroma swap, reference, C and NEON kernels
+camera_test_name := camera_converters_test
+camera_test_src := ConvertersTest.cpp ../Converters.cpp ../YUYVConverters.cpp
+include $(LOCAL_PATH)/camera_test.mk
+
+# The whole HAL on FakeV4L2Backend: preview, recording and pictures through
+# the camera module, fps, latency percentiles and CPU time per frame. Host
+# only, test/host/ stands in for CedarX, libfacedetection, gralloc and the
+# system properties. Run it from the top of the tree, the HAL reads
+# test/host/camera.cfg by the path it was built with.
+include $(CLEAR_VARS)
+LOCAL_MODULE := camera_hal_harness
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := \
+	CameraHalHarness.cpp \
+	host/HostStubs.cpp \
+	../CameraHal.cpp \
+	../HALCameraFactory.cpp \
+	../CameraHardware.cpp \
+	../V4L2Camera.cpp \
+	../CameraHardwareDevice.cpp \
+	../V4L2CameraDevice.cpp \
+	../Converters.cpp \
+	../PreviewWindow.cpp \
+	../CallbackNotifier.cpp \
+	../JpegCompressor.cpp \
+	../StripeJpegEncoder.cpp \
+	../CCameraConfig.cpp \
+	../YUYVConverters.cpp \
+	../FrameRing.cpp \
+	../FrameTracer.cpp \
+	../FrameScheduler.cpp \
+	../YUVScaler.cpp \
+	../StreamSplitter.cpp \
+	../CameraCapsCache.cpp \
+	../V4L2Backend.cpp \
+	../FakeV4L2Backend.cpp \
+	../RecordingBufferManager.cpp \
+	../OSAL_Mutex.c \
+	../OSAL_Queue.c
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH)/host \
+	$(camera_test_includes) \
+	frameworks/base/include/media/stagefright/openmax \
+	hardware/libhardware/include/hardware \
+	$(TARGET_HARDWARE_INCLUDE)
+# bionic's sys/types.h brings in the kernel types the display headers use
+LOCAL_CFLAGS := -fno-short-enums -include linux/types.h \
+	-DCAMERA_KEY_CONFIG_PATH=\"$(LOCAL_PATH)/host/camera.cfg\"
+# CameraParameters comes from libcamera_client, like it does for the HAL
+LOCAL_SHARED_LIBRARIES := libcamera_client
+LOCAL_STATIC_LIBRARIES := libutils libcutils liblog
+LOCAL_LDLIBS := -lpthread -lrt -ljpeg -ldl
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,738 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Drives the whole camera HAL on the host, on top of FakeV4L2Backend. The
+ * camera is opened through the module like the camera service does, then
+ *
+ *   preview   - frames into a preview window of the harness, fps and CPU
+ *               time per frame,
+ *   recording - video frame callbacks, fps and the latency from the capture
+ *               timestamp to the callback, the frames are released right
+ *               away or held like a slow encoder would,
+ *   pictures  - takePicture, shutter lag and time to the JPEG,
+ *   setParameters - calls per second with the preview running, zoom steps
+ *               on the path that applies only the changed keys against the
+ *               full parse every call took before it,
+ *
+ * and closed. The CedarX libraries and the rest of the device are stubbed in
+ * test/host/. The HAL reads test/host/camera.cfg by the path it was built
+ * with, so run it from the top of the tree:
+ *
+ *   out/host/linux-x86/bin/camera_hal_harness -t 5 -s 1280x720 -j 5
+ */
+
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <hardware/camera.h>
+#include <camera/CameraParameters.h>
+#include <cutils/properties.h>
+#include <ui/GraphicBufferMapper.h>
+#include <type_camera.h>
+
+#include "CameraTest.h"
+
+using namespace android;
+
+extern camera_module_t HAL_MODULE_INFO_SYM;
+
+enum { MAX_SAMPLES = 16384, WINDOW_BUFFERS = 8, MAX_HELD = 64 };
+
+struct Options {
+    int         seconds;        // of the preview and the recording phase
+    int         previewWidth;
+    int         previewHeight;
+    int         pictureWidth;
+    int         pictureHeight;
+    int         pictures;
+    int         parameterCalls; // setParameters calls of each case
+    int         holdMs;         // the encoder holds each video frame this long
+    bool        hwEncoder;      // V4L2BUF_t video frames, as to CedarX
+    bool        previewCallbacks;
+};
+
+/****************************************************************************
+ * Preview window, buffers in memory, the consumer takes them right back.
+ ***************************************************************************/
+
+struct HarnessWindow {
+    preview_stream_ops_t    ops;            // first, the HAL passes &ops
+    pthread_mutex_t         lock;
+    host_buffer_t           buffers[WINDOW_BUFFERS];
+    buffer_handle_t         handles[WINDOW_BUFFERS];
+    bool                    dequeued[WINDOW_BUFFERS];
+    int                     count;
+    int                     width;
+    int                     height;
+    int                     queued;         // frames shown
+};
+
+static HarnessWindow gWindow;
+
+static HarnessWindow* toWindow(const preview_stream_ops_t* w)
+{
+    return (HarnessWindow*)w;
+}
+
+static int windowFind(HarnessWindow* win, buffer_handle_t* buffer)
+{
+    for (int i = 0; i < win->count; i++) {
+        if (buffer == &win->handles[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void windowFree(HarnessWindow* win)
+{
+    for (int i = 0; i < WINDOW_BUFFERS; i++) {
+        free(win->buffers[i].bits);
+        win->buffers[i].bits = NULL;
+        win->dequeued[i] = false;
+    }
+}
+
+static int windowAlloc(HarnessWindow* win)
+{
+    windowFree(win);
+    for (int i = 0; i < win->count; i++) {
+        win->buffers[i].bits = malloc(win->width * win->height * 3 / 2);
+        if (win->buffers[i].bits == NULL) {
+            return -ENOMEM;
+        }
+        win->handles[i] = &win->buffers[i].handle;
+    }
+    return 0;
+}
+
+static int windowDequeue(preview_stream_ops_t* w, buffer_handle_t** buffer, int* stride)
+{
+    HarnessWindow* win = toWindow(w);
+    pthread_mutex_lock(&win->lock);
+    for (int i = 0; i < win->count; i++) {
+        if (!win->dequeued[i] && win->buffers[i].bits != NULL) {
+            win->dequeued[i] = true;
+            *buffer = &win->handles[i];
+            *stride = win->width;
+            pthread_mutex_unlock(&win->lock);
+            return 0;
+        }
+    }
+    pthread_mutex_unlock(&win->lock);
+    return -EBUSY;
+}
+
+static int windowEnqueue(preview_stream_ops_t* w, buffer_handle_t* buffer)
+{
+    HarnessWindow* win = toWindow(w);
+    pthread_mutex_lock(&win->lock);
+    const int i = windowFind(win, buffer);
+    CHECK(i >= 0 && win->dequeued[i]);
+    if (i >= 0) {
+        win->dequeued[i] = false;
+        win->queued++;
+    }
+    pthread_mutex_unlock(&win->lock);
+    return i >= 0 ? 0 : -EINVAL;
+}
+
+static int windowCancel(preview_stream_ops_t* w, buffer_handle_t* buffer)
+{
+    HarnessWindow* win = toWindow(w);
+    pthread_mutex_lock(&win->lock);
+    const int i = windowFind(win, buffer);
+    if (i >= 0) {
+        win->dequeued[i] = false;
+    }
+    pthread_mutex_unlock(&win->lock);
+    return i >= 0 ? 0 : -EINVAL;
+}
+
+static int windowSetCount(preview_stream_ops_t* w, int count)
+{
+    HarnessWindow* win = toWindow(w);
+    if (count <= 0 || count > WINDOW_BUFFERS) {
+        return -EINVAL;
+    }
+    pthread_mutex_lock(&win->lock);
+    win->count = count;
+    const int res = windowAlloc(win);
+    pthread_mutex_unlock(&win->lock);
+    return res;
+}
+
+static int windowSetGeometry(preview_stream_ops_t* w, int width, int height, int format)
+{
+    HarnessWindow* win = toWindow(w);
+    if (format != HAL_PIXEL_FORMAT_YCrCb_420_SP || width <= 0 || height <= 0) {
+        return -EINVAL;
+    }
+    pthread_mutex_lock(&win->lock);
+    win->width = width;
+    win->height = height;
+    const int res = windowAlloc(win);
+    pthread_mutex_unlock(&win->lock);
+    return res;
+}
+
+static int windowSetCrop(preview_stream_ops_t* w, int left, int top, int right, int bottom)
+{
+    return 0;
+}
+
+static int windowSetUsage(preview_stream_ops_t* w, int usage)
+{
+    return 0;
+}
+
+static int windowSetSwapInterval(preview_stream_ops_t* w, int interval)
+{
+    return 0;
+}
+
+static int windowMinUndequeued(const preview_stream_ops_t* w, int* count)
+{
+    *count = 1;
+    return 0;
+}
+
+static int windowLock(preview_stream_ops_t* w, buffer_handle_t* buffer)
+{
+    return windowFind(toWindow(w), buffer) >= 0 ? 0 : -EINVAL;
+}
+
+static int windowSetTimestamp(preview_stream_ops_t* w, int64_t timestamp)
+{
+    return 0;
+}
+
+/* Only the stock operations: without perform the HAL keeps the preview in
+ * software, which is what the host can run. */
+static void windowInit(HarnessWindow* win)
+{
+    memset(win, 0, sizeof(*win));
+    pthread_mutex_init(&win->lock, NULL);
+    win->ops.dequeue_buffer = windowDequeue;
+    win->ops.enqueue_buffer = windowEnqueue;
+    win->ops.cancel_buffer = windowCancel;
+    win->ops.set_buffer_count = windowSetCount;
+    win->ops.set_buffers_geometry = windowSetGeometry;
+    win->ops.set_crop = windowSetCrop;
+    win->ops.set_usage = windowSetUsage;
+    win->ops.set_swap_interval = windowSetSwapInterval;
+    win->ops.get_min_undequeued_buffer_count = windowMinUndequeued;
+    win->ops.lock_buffer = windowLock;
+    win->ops.set_timestamp = windowSetTimestamp;
+    win->count = 3;
+}
+
+static int windowQueued(HarnessWindow* win)
+{
+    pthread_mutex_lock(&win->lock);
+    const int queued = win->queued;
+    pthread_mutex_unlock(&win->lock);
+    return queued;
+}
+
+/****************************************************************************
+ * Camera callbacks.
+ ***************************************************************************/
+
+struct HarnessState {
+    pthread_mutex_t     lock;
+    pthread_cond_t      cond;
+    camera_device_t*    dev;
+    bool                hwEncoder;
+
+    int                 previewFrames;
+    int                 videoFrames;
+    int64_t             lastVideoTimestamp;
+    int                 videoOutOfOrder;
+    int64_t             latencyUs[MAX_SAMPLES];
+    int                 latencyCount;
+
+    // video frames the encoder holds, released by the encoder thread
+    int                 holdMs;
+    int                 heldIndex[MAX_HELD];
+    int64_t             heldUntil[MAX_HELD];
+    int                 heldCount;
+    bool                encoderExit;
+
+    int64_t             shutterUs;
+    int64_t             jpegUs;
+    bool                jpegOk;
+    int                 jpegSize;
+};
+
+static HarnessState gState;
+
+/* Wall clock, the clock of the V4L2 timestamps. */
+static int64_t wallUs()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void releaseMemory(camera_memory_t* mem)
+{
+    free(mem->data);
+    delete mem;
+}
+
+static camera_memory_t* getMemory(int fd, size_t buf_size, unsigned int num_bufs, void* user)
+{
+    camera_memory_t* mem = new camera_memory_t;
+    mem->size = buf_size * num_bufs;
+    mem->data = malloc(mem->size);
+    mem->handle = NULL;
+    mem->release = releaseMemory;
+    return mem;
+}
+
+static void notifyCallback(int32_t msg_type, int32_t ext1, int32_t ext2, void* user)
+{
+    if (msg_type == CAMERA_MSG_SHUTTER) {
+        pthread_mutex_lock(&gState.lock);
+        gState.shutterUs = testNowUs();
+        pthread_mutex_unlock(&gState.lock);
+    } else if (msg_type == CAMERA_MSG_ERROR) {
+        fprintf(stderr, "camera error %d, %d\n", ext1, ext2);
+        gTestFailures++;
+    }
+}
+
+static void dataCallback(int32_t msg_type, const camera_memory_t* data, unsigned int index,
+                         camera_frame_metadata_t* metadata, void* user)
+{
+    pthread_mutex_lock(&gState.lock);
+    if (msg_type == CAMERA_MSG_PREVIEW_FRAME) {
+        gState.previewFrames++;
+    } else if (msg_type == CAMERA_MSG_COMPRESSED_IMAGE) {
+        const uint8_t* d = (const uint8_t*)data->data;
+        const size_t n = data->size;
+        gState.jpegOk = d != NULL && n > 4 && d[0] == 0xff && d[1] == 0xd8
+            && d[n - 2] == 0xff && d[n - 1] == 0xd9;
+        gState.jpegSize = n;
+        gState.jpegUs = testNowUs();
+        pthread_cond_broadcast(&gState.cond);
+    }
+    pthread_mutex_unlock(&gState.lock);
+}
+
+static void dataTimestampCallback(int64_t timestamp, int32_t msg_type,
+                                  const camera_memory_t* data, unsigned int index, void* user)
+{
+    if (msg_type != CAMERA_MSG_VIDEO_FRAME) {
+        return;
+    }
+    // the HAL stamps the frames in microseconds
+    const int64_t latency = wallUs() - timestamp;
+
+    pthread_mutex_lock(&gState.lock);
+    gState.videoFrames++;
+    if (timestamp <= gState.lastVideoTimestamp) {
+        gState.videoOutOfOrder++;
+    }
+    gState.lastVideoTimestamp = timestamp;
+    if (gState.latencyCount < MAX_SAMPLES) {
+        gState.latencyUs[gState.latencyCount++] = latency;
+    }
+
+    // software frames are copies, only the V4L2BUF_t of the hardware
+    // encoder path holds a capture buffer
+    int frame_index = -1;
+    if (gState.hwEncoder) {
+        frame_index = ((const V4L2BUF_t*)data->data)->index;
+    }
+    if (frame_index >= 0 && gState.holdMs > 0 && gState.heldCount < MAX_HELD) {
+        gState.heldIndex[gState.heldCount] = frame_index;
+        gState.heldUntil[gState.heldCount] = testNowUs() + gState.holdMs * 1000;
+        gState.heldCount++;
+        pthread_cond_broadcast(&gState.cond);
+        frame_index = -1;
+    }
+    pthread_mutex_unlock(&gState.lock);
+
+    if (frame_index >= 0) {
+        gState.dev->ops->release_recording_frame(gState.dev, &frame_index);
+    }
+}
+
+/* The encoder: gives the frames back in order, holdMs after it got them. */
+static void* encoderThread(void* arg)
+{
+    pthread_mutex_lock(&gState.lock);
+    for (;;) {
+        if (gState.heldCount == 0) {
+            if (gState.encoderExit) {
+                break;
+            }
+            pthread_cond_wait(&gState.cond, &gState.lock);
+            continue;
+        }
+        const int64_t wait = gState.heldUntil[0] - testNowUs();
+        if (wait > 0 && !gState.encoderExit) {
+            pthread_mutex_unlock(&gState.lock);
+            usleep(wait < 2000 ? wait : 2000);
+            pthread_mutex_lock(&gState.lock);
+            continue;
+        }
+        int frame_index = gState.heldIndex[0];
+        gState.heldCount--;
+        memmove(&gState.heldIndex[0], &gState.heldIndex[1], gState.heldCount * sizeof(int));
+        memmove(&gState.heldUntil[0], &gState.heldUntil[1], gState.heldCount * sizeof(int64_t));
+        pthread_mutex_unlock(&gState.lock);
+        gState.dev->ops->release_recording_frame(gState.dev, &frame_index);
+        pthread_mutex_lock(&gState.lock);
+    }
+    pthread_mutex_unlock(&gState.lock);
+    return NULL;
+}
+
+/****************************************************************************
+ * Phases.
+ ***************************************************************************/
+
+static int64_t cpuUs()
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return (int64_t)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000
+        + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+static int compareUs(const void* a, const void* b)
+{
+    const int64_t x = *(const int64_t*)a;
+    const int64_t y = *(const int64_t*)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static int64_t percentile(const int64_t* sorted, int count, int p)
+{
+    return count > 0 ? sorted[(count - 1) * p / 100] : 0;
+}
+
+static bool setParameters(camera_device_t* dev, const Options& opt)
+{
+    char* flat = dev->ops->get_parameters(dev);
+    CameraParameters params;
+    params.unflatten(String8(flat));
+    dev->ops->put_parameters(dev, flat);
+
+    params.setPreviewSize(opt.previewWidth, opt.previewHeight);
+    params.setPictureSize(opt.pictureWidth, opt.pictureHeight);
+    params.set(CameraParameters::KEY_RECORDING_HINT,
+               opt.seconds > 0 ? CameraParameters::TRUE : CameraParameters::FALSE);
+    return dev->ops->set_parameters(dev, params.flatten().string()) == 0;
+}
+
+static void runPreview(camera_device_t* dev, const Options& opt)
+{
+    const int shown = windowQueued(&gWindow);
+    pthread_mutex_lock(&gState.lock);
+    const int callbacks = gState.previewFrames;
+    pthread_mutex_unlock(&gState.lock);
+    const int64_t start = testNowUs();
+    const int64_t cpu = cpuUs();
+
+    sleep(opt.seconds);
+
+    const int64_t us = testNowUs() - start;
+    const int frames = windowQueued(&gWindow) - shown;
+    pthread_mutex_lock(&gState.lock);
+    const int cb_frames = gState.previewFrames - callbacks;
+    pthread_mutex_unlock(&gState.lock);
+    const int64_t cpu_us = cpuUs() - cpu;
+
+    printf("preview %dx%d, %d s:\n", opt.previewWidth, opt.previewHeight, opt.seconds);
+    printf("  window     %7.2f fps\n", frames * 1e6 / us);
+    if (opt.previewCallbacks) {
+        printf("  callbacks  %7.2f fps\n", cb_frames * 1e6 / us);
+    }
+    printf("  cpu        %7.2f ms/frame, %.0f%% of a core\n",
+           frames > 0 ? cpu_us / 1000.0 / frames : 0.0, cpu_us * 100.0 / us);
+    CHECK(frames > 0);
+}
+
+static void runRecording(camera_device_t* dev, const Options& opt)
+{
+    pthread_t encoder;
+
+    pthread_mutex_lock(&gState.lock);
+    gState.videoFrames = 0;
+    gState.videoOutOfOrder = 0;
+    gState.lastVideoTimestamp = 0;
+    gState.latencyCount = 0;
+    gState.heldCount = 0;
+    gState.encoderExit = false;
+    pthread_mutex_unlock(&gState.lock);
+    pthread_create(&encoder, NULL, encoderThread, NULL);
+
+    dev->ops->enable_msg_type(dev, CAMERA_MSG_VIDEO_FRAME);
+    const int64_t cpu = cpuUs();
+    const int64_t start = testNowUs();
+    CHECK(dev->ops->start_recording(dev) == 0);
+
+    sleep(opt.seconds);
+
+    dev->ops->stop_recording(dev);
+    const int64_t us = testNowUs() - start;
+    const int64_t cpu_us = cpuUs() - cpu;
+    dev->ops->disable_msg_type(dev, CAMERA_MSG_VIDEO_FRAME);
+
+    pthread_mutex_lock(&gState.lock);
+    gState.encoderExit = true;
+    pthread_cond_broadcast(&gState.cond);
+    pthread_mutex_unlock(&gState.lock);
+    pthread_join(encoder, NULL);
+
+    pthread_mutex_lock(&gState.lock);
+    const int frames = gState.videoFrames;
+    const int count = gState.latencyCount;
+    qsort(gState.latencyUs, count, sizeof(int64_t), compareUs);
+    printf("recording %dx%d, %s, encoder holds %d ms, %d s:\n", opt.previewWidth,
+           opt.previewHeight, opt.hwEncoder ? "V4L2BUF_t" : "frame copies", opt.holdMs,
+           opt.seconds);
+    printf("  video      %7.2f fps\n", frames * 1e6 / us);
+    printf("  latency    p50 %.2f  p90 %.2f  p99 %.2f  max %.2f ms\n",
+           percentile(gState.latencyUs, count, 50) / 1000.0,
+           percentile(gState.latencyUs, count, 90) / 1000.0,
+           percentile(gState.latencyUs, count, 99) / 1000.0,
+           count > 0 ? gState.latencyUs[count - 1] / 1000.0 : 0.0);
+    printf("  cpu        %7.2f ms/frame\n", frames > 0 ? cpu_us / 1000.0 / frames : 0.0);
+    CHECK(frames > 0);
+    CHECK(gState.videoOutOfOrder == 0);
+    pthread_mutex_unlock(&gState.lock);
+}
+
+static void runPictures(camera_device_t* dev, const Options& opt)
+{
+    printf("pictures %dx%d:\n", opt.pictureWidth, opt.pictureHeight);
+    dev->ops->enable_msg_type(dev, CAMERA_MSG_SHUTTER | CAMERA_MSG_COMPRESSED_IMAGE);
+    for (int i = 0; i < opt.pictures; i++) {
+        pthread_mutex_lock(&gState.lock);
+        gState.shutterUs = 0;
+        gState.jpegUs = 0;
+        gState.jpegOk = false;
+        pthread_mutex_unlock(&gState.lock);
+
+        const int64_t start = testNowUs();
+        CHECK(dev->ops->take_picture(dev) == 0);
+
+        pthread_mutex_lock(&gState.lock);
+        while (gState.jpegUs == 0 && testNowUs() - start < 10000000) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec += 1;
+            pthread_cond_timedwait(&gState.cond, &gState.lock, &ts);
+        }
+        const int64_t shutter = gState.shutterUs;
+        const int64_t jpeg = gState.jpegUs;
+        const bool ok = gState.jpegOk;
+        const int size = gState.jpegSize;
+        pthread_mutex_unlock(&gState.lock);
+
+        CHECK(jpeg != 0 && ok);
+        printf("  #%d         shutter %.1f ms, jpeg %.1f ms, %d KB\n", i,
+               shutter ? (shutter - start) / 1000.0 : -1.0,
+               jpeg ? (jpeg - start) / 1000.0 : -1.0, size / 1024);
+
+        // the camera application restarts the preview after a picture
+        if (!dev->ops->preview_enabled(dev)) {
+            const int64_t restart = testNowUs();
+            CHECK(dev->ops->start_preview(dev) == 0);
+            printf("  restart    %.1f ms\n", (testNowUs() - restart) / 1000.0);
+        }
+    }
+    dev->ops->disable_msg_type(dev, CAMERA_MSG_SHUTTER | CAMERA_MSG_COMPRESSED_IMAGE);
+}
+
+/* Times set_parameters over 'steps', 'calls' calls in all. */
+static void benchParameters(camera_device_t* dev, const char* name, const String8* steps,
+                            int count, int calls)
+{
+    const int64_t start = testNowUs();
+    for (int i = 0; i < calls; i++) {
+        if (dev->ops->set_parameters(dev, steps[i % count].string()) != 0) {
+            fprintf(stderr, "%s: set_parameters failed\n", name);
+            gTestFailures++;
+            break;
+        }
+    }
+    const int64_t us = testNowUs() - start;
+    printf("  %-28s %9.0f calls/s  %7.2f us/call\n", name,
+           us > 0 ? calls * 1e6 / us : 0.0, (double)us / calls);
+}
+
+/* Pinch zoom: a zoom step per call. Changing the white balance with it sends
+ * every call down the full parse, which is what all calls cost before
+ * applyChangedParameters(). */
+static void runParameters(camera_device_t* dev, const Options& opt)
+{
+    char* flat = dev->ops->get_parameters(dev);
+    CameraParameters params;
+    params.unflatten(String8(flat));
+    dev->ops->put_parameters(dev, flat);
+
+    const int max_zoom = params.getInt(CameraParameters::KEY_MAX_ZOOM);
+    const int count = 2 * (max_zoom > 0 ? max_zoom : 1);
+    String8* zoom = new String8[count];
+    String8* full = new String8[count];
+    for (int i = 0; i < count; i++) {
+        params.set(CameraParameters::KEY_ZOOM, i % (max_zoom + 1));
+        params.set(CameraParameters::KEY_WHITE_BALANCE, CameraParameters::WHITE_BALANCE_AUTO);
+        zoom[i] = params.flatten();
+        params.set(CameraParameters::KEY_WHITE_BALANCE,
+                   (i & 1) ? CameraParameters::WHITE_BALANCE_DAYLIGHT
+                           : CameraParameters::WHITE_BALANCE_AUTO);
+        full[i] = params.flatten();
+    }
+
+    printf("setParameters, %d calls, %d bytes:\n", opt.parameterCalls, (int)zoom[0].length());
+    benchParameters(dev, "unchanged", zoom, 1, opt.parameterCalls);
+    benchParameters(dev, "zoom step", zoom, count, opt.parameterCalls);
+    benchParameters(dev, "zoom step, full parse", full, count, opt.parameterCalls);
+
+    // back to no zoom for the pictures
+    CHECK(dev->ops->set_parameters(dev, zoom[0].string()) == 0);
+    delete[] zoom;
+    delete[] full;
+}
+
+static bool parseSize(const char* arg, int* width, int* height)
+{
+    return sscanf(arg, "%dx%d", width, height) == 2 && *width > 0 && *height > 0;
+}
+
+static void usage(const char* name)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -t seconds   of preview and of recording, default 3\n"
+            "  -s WxH       preview size, default 640x480\n"
+            "  -c WxH       picture size, default 1600x1200\n"
+            "  -n count     pictures, default 2\n"
+            "  -p calls     setParameters calls of each case, default 2000\n"
+            "  -f fps       camera.fake.fps, default the rate the HAL asks for\n"
+            "  -j ms        camera.fake.jitter\n"
+            "  -i file      camera.fake.file, frames to play\n"
+            "  -e ms        the encoder holds each video frame this long\n"
+            "  -m           video frames as V4L2BUF_t for the hardware encoder\n"
+            "  -b           preview frame callbacks\n", name);
+}
+
+int main(int argc, char** argv)
+{
+    Options opt = { 3, 640, 480, 1600, 1200, 2, 2000, 0, false, false };
+    int c;
+
+    while ((c = getopt(argc, argv, "t:s:c:n:p:f:j:i:e:mb")) != -1) {
+        switch (c) {
+        case 't': opt.seconds = atoi(optarg); break;
+        case 'n': opt.pictures = atoi(optarg); break;
+        case 'p': opt.parameterCalls = atoi(optarg); break;
+        case 'e': opt.holdMs = atoi(optarg); break;
+        case 'm': opt.hwEncoder = true; break;
+        case 'b': opt.previewCallbacks = true; break;
+        case 'f': property_set("camera.fake.fps", optarg); break;
+        case 'j': property_set("camera.fake.jitter", optarg); break;
+        case 'i': property_set("camera.fake.file", optarg); break;
+        case 's':
+            if (!parseSize(optarg, &opt.previewWidth, &opt.previewHeight)) {
+                usage(argv[0]);
+                return 2;
+            }
+            break;
+        case 'c':
+            if (!parseSize(optarg, &opt.pictureWidth, &opt.pictureHeight)) {
+                usage(argv[0]);
+                return 2;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    pthread_mutex_init(&gState.lock, NULL);
+    pthread_cond_init(&gState.cond, NULL);
+    gState.hwEncoder = opt.hwEncoder;
+    gState.holdMs = opt.holdMs;
+    windowInit(&gWindow);
+
+    CHECK(HAL_MODULE_INFO_SYM.get_number_of_cameras() > 0);
+
+    int64_t start = testNowUs();
+    hw_device_t* device = NULL;
+    if (HAL_MODULE_INFO_SYM.common.methods->open(&HAL_MODULE_INFO_SYM.common, "0", &device) != 0
+        || device == NULL) {
+        fprintf(stderr, "cannot open camera 0\n");
+        gTestFailures++;
+        return testResult("CameraHalHarness");
+    }
+    camera_device_t* dev = (camera_device_t*)device;
+    gState.dev = dev;
+    printf("open         %.1f ms\n", (testNowUs() - start) / 1000.0);
+
+    CHECK(setParameters(dev, opt));
+    dev->ops->set_callbacks(dev, notifyCallback, dataCallback, dataTimestampCallback,
+                            getMemory, NULL);
+    if (opt.hwEncoder) {
+        CHECK(dev->ops->send_command(dev, CAMERA_CMD_SET_CEDARX_RECORDER, 0, 0) == 0);
+        CHECK(dev->ops->store_meta_data_in_buffers(dev, 1) == 0);
+    }
+    if (opt.previewCallbacks) {
+        dev->ops->enable_msg_type(dev, CAMERA_MSG_PREVIEW_FRAME);
+    }
+    CHECK(dev->ops->set_preview_window(dev, &gWindow.ops) == 0);
+
+    start = testNowUs();
+    CHECK(dev->ops->start_preview(dev) == 0);
+    printf("start        %.1f ms\n", (testNowUs() - start) / 1000.0);
+
+    if (opt.seconds > 0) {
+        runPreview(dev, opt);
+        runRecording(dev, opt);
+    }
+    if (opt.parameterCalls > 0) {
+        runParameters(dev, opt);
+    }
+    if (opt.pictures > 0) {
+        runPictures(dev, opt);
+    }
+
+    start = testNowUs();
+    dev->ops->stop_preview(dev);
+    dev->ops->set_preview_window(dev, NULL);
+    dev->common.close(&dev->common);
+    printf("close        %.1f ms\n", (testNowUs() - start) / 1000.0);
+    windowFree(&gWindow);
+
+    // The HAL lives in a process that does not exit: its static factory
+    // stops the command and auto focus threads while they wait on their
+    // conditions, so leave without running the static destructors.
+    const int res = testResult("CameraHalHarness");
+    fflush(stdout);
+    _exit(res);
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HW_CAMERA_TEST_H
+#define HW_CAMERA_TEST_H
+
+/*
+ * Helpers shared by the camera HAL tests and benchmarks. Each test is a plain
+ * executable: it prints what failed, then "PASS" or "FAIL", and exits non
+ * zero on failure. Benchmarks print one line per case.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static int gTestFailures = 0;
+
+#define CHECK(cond)                                                         \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n",                    \
+                    __FILE__, __LINE__, #cond);                             \
+            gTestFailures++;                                                \
+        }                                                                   \
+    } while (0)
+
+/* Prints the result, to be returned from main(). */
+static inline int testResult(const char* name)
+{
+    printf("%s: %s\n", name, gTestFailures ? "FAIL" : "PASS");
+    return gTestFailures ? 1 : 0;
+}
+
+static inline int64_t testNowUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* Deterministic pseudo random bytes, so a failure can be reproduced. */
+static inline void testFill(void* buf, size_t size, uint32_t seed)
+{
+    uint8_t* p = (uint8_t*)buf;
+    for (size_t i = 0; i < size; i++) {
+        seed = seed * 1103515245 + 12345;
+        p[i] = (uint8_t)(seed >> 16);
+    }
+}
+
+/* Iterations of each benchmark, the first argument of the test if given. */
+static inline int testIterations(int argc, char** argv, int def)
+{
+    if (argc > 1 && atoi(argv[1]) > 0) {
+        return atoi(argv[1]);
+    }
+    return def;
+}
+
+/* Prints the throughput of 'iterations' runs over a width x height frame. */
+static inline void testReportRate(const char* name, int width, int height,
+                                  int iterations, int64_t us)
+{
+    const double mpix = (double)width * height * iterations / 1e6;
+    printf("  %-28s %4dx%-4d %8.1f Mpixel/s  %7.3f ms/frame\n", name,
+           width, height, us > 0 ? mpix * 1e6 / us : 0.0,
+           (double)us / iterations / 1000.0);
+}
+
+#endif  /* HW_CAMERA_TEST_H */
@@ -0,0 +1,335 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Checks the YUV 4:2:0 to RGB converters: the C kernels against the per
+ * pixel conversion of Converters.h, the runtime selected kernels (NEON on
+ * the device) against the C ones, strides and regions of interest, then
+ * benchmarks them. Checks the NV12 / NV21 chroma swap the same way.
+ */
+
+#include "CameraTest.h"
+#include "Converters.h"
+#include "YUYVConverters.h"
+
+using namespace android;
+
+/* One pixel at a time, with YUVToRGB565() / YUVToRGB32(). */
+static void referenceToRGB(const uint8_t* y, int y_stride,
+                           const uint8_t* u, const uint8_t* v,
+                           int uv_stride, int uv_step,
+                           void* rgb, int rgb_stride,
+                           int width, int height, bool rgb32)
+{
+    for (int r = 0; r < height; r++) {
+        for (int x = 0; x < width; x++) {
+            const int Y = y[r * y_stride + x];
+            const int U = u[(r / 2) * uv_stride + (x / 2) * uv_step];
+            const int V = v[(r / 2) * uv_stride + (x / 2) * uv_step];
+            uint8_t* row = (uint8_t*)rgb + r * rgb_stride;
+            if (rgb32) {
+                ((uint32_t*)row)[x] = YUVToRGB32(Y, U, V);
+            } else {
+                ((uint16_t*)row)[x] = YUVToRGB565(Y, U, V);
+            }
+        }
+    }
+}
+
+typedef void (*convert_t)(const uint8_t*, int, const uint8_t*, const uint8_t*,
+                          int, int, void*, int, int, int);
+
+/* Converts a width x height region at (x0, y0) of a padded image, planar or
+ * semi-planar, with the reference, the C and the selected kernels. */
+static void testRegion(int img_w, int img_h, int x0, int y0, int width, int height,
+                       bool semi, bool rgb32)
+{
+    const int stride = img_w + 24;                  // padded rows
+    const int uv_stride = semi ? stride : stride / 2;
+    const int bpp = rgb32 ? 4 : 2;
+    const int rgb_stride = width * bpp + 12;
+    const size_t img_size = stride * img_h * 2;
+    const size_t rgb_size = rgb_stride * height;
+    uint8_t* img = (uint8_t*)malloc(img_size);
+    uint8_t* ref = (uint8_t*)malloc(rgb_size);
+    uint8_t* c = (uint8_t*)malloc(rgb_size);
+    uint8_t* fast = (uint8_t*)malloc(rgb_size);
+
+    testFill(img, img_size, img_w * 7 + width + semi);
+    memset(ref, 0xaa, rgb_size);
+    memset(c, 0xaa, rgb_size);
+    memset(fast, 0xaa, rgb_size);
+
+    const uint8_t* Y = img + y0 * stride + x0;
+    const uint8_t* chroma = img + stride * img_h;
+    const uint8_t *U, *V;
+    int uv_step;
+    if (semi) {
+        // NV21: V first
+        V = chroma + (y0 / 2) * uv_stride + x0;
+        U = V + 1;
+        uv_step = 2;
+    } else {
+        U = chroma + (y0 / 2) * uv_stride + x0 / 2;
+        V = U + uv_stride * (img_h / 2);
+        uv_step = 1;
+    }
+
+    convert_t conv_c = rgb32 ? YUV420ToRGB32_C : YUV420ToRGB565_C;
+    convert_t conv = rgb32 ? YUV420ToRGB32 : YUV420ToRGB565;
+    referenceToRGB(Y, stride, U, V, uv_stride, uv_step, ref, rgb_stride, width, height, rgb32);
+    conv_c(Y, stride, U, V, uv_stride, uv_step, c, rgb_stride, width, height);
+    conv(Y, stride, U, V, uv_stride, uv_step, fast, rgb_stride, width, height);
+
+    // the padding at the end of the rows must not be written either
+    if (memcmp(ref, c, rgb_size) != 0 || memcmp(c, fast, rgb_size) != 0) {
+        fprintf(stderr, "%s %s %dx%d at %d,%d of %dx%d: C %s reference, %s %s C\n",
+                semi ? "NV21" : "YU12", rgb32 ? "RGB32" : "RGB565",
+                width, height, x0, y0, img_w, img_h,
+                memcmp(ref, c, rgb_size) ? "differs from" : "matches",
+                cpuHasNeon() ? "NEON" : "C", memcmp(c, fast, rgb_size) ? "differs from" : "matches");
+        gTestFailures++;
+    }
+
+    free(img);
+    free(ref);
+    free(c);
+    free(fast);
+}
+
+/* The unpadded frame converters are wrappers of the same kernels. */
+static void testFrames()
+{
+    const int w = 176, h = 144;
+    uint8_t* img = (uint8_t*)malloc(w * h * 3 / 2);
+    uint32_t* a = (uint32_t*)malloc(w * h * 4);
+    uint32_t* b = (uint32_t*)malloc(w * h * 4);
+
+    testFill(img, w * h * 3 / 2, 3);
+    const uint8_t* C = img + w * h;
+
+    NV21ToRGB32(img, a, w, h);
+    referenceToRGB(img, w, C + 1, C, w, 2, b, w * 4, w, h, true);
+    CHECK(memcmp(a, b, w * h * 4) == 0);
+
+    NV12ToRGB565(img, a, w, h);
+    referenceToRGB(img, w, C, C + 1, w, 2, b, w * 2, w, h, false);
+    CHECK(memcmp(a, b, w * h * 2) == 0);
+
+    YV12ToRGB32(img, a, w, h);
+    referenceToRGB(img, w, C + w * h / 4, C, w / 2, 1, b, w * 4, w, h, true);
+    CHECK(memcmp(a, b, w * h * 4) == 0);
+
+    free(img);
+    free(a);
+    free(b);
+}
+
+/* Swaps U and V of one sample pair at a time. */
+static void referenceSwapUV(const uint8_t* src, int src_stride,
+                            uint8_t* dst, int dst_stride, int width, int rows)
+{
+    for (int r = 0; r < rows; r++) {
+        for (int x = 0; x < width; x += 2) {
+            const uint8_t u = src[r * src_stride + x];
+            const uint8_t v = src[r * src_stride + x + 1];
+            dst[r * dst_stride + x] = v;
+            dst[r * dst_stride + x + 1] = u;
+        }
+    }
+}
+
+static void testSwapUV(int width, int rows, int src_pad, int dst_pad)
+{
+    const int src_stride = width + src_pad;
+    const int dst_stride = width + dst_pad;
+    const size_t src_size = src_stride * rows;
+    const size_t dst_size = dst_stride * rows;
+    uint8_t* src = (uint8_t*)malloc(src_size);
+    uint8_t* ref = (uint8_t*)malloc(dst_size);
+    uint8_t* c = (uint8_t*)malloc(dst_size);
+    uint8_t* fast = (uint8_t*)malloc(dst_size);
+    uint8_t* copy = (uint8_t*)malloc(src_size);
+
+    testFill(src, src_size, width * 31 + rows);
+    memset(ref, 0x55, dst_size);
+    memset(c, 0x55, dst_size);
+    memset(fast, 0x55, dst_size);
+
+    referenceSwapUV(src, src_stride, ref, dst_stride, width, rows);
+    SwapUV_C(src, src_stride, c, dst_stride, width, rows);
+    SwapUV(src, src_stride, fast, dst_stride, width, rows);
+    if (memcmp(ref, c, dst_size) != 0 || memcmp(c, fast, dst_size) != 0) {
+        fprintf(stderr, "SwapUV %dx%d, strides %d/%d: C %s reference, %s %s C\n",
+                width, rows, src_stride, dst_stride,
+                memcmp(ref, c, dst_size) ? "differs from" : "matches",
+                cpuHasNeon() ? "NEON" : "C", memcmp(c, fast, dst_size) ? "differs from" : "matches");
+        gTestFailures++;
+    }
+
+    // in place, twice, gives the source back, padding included
+    memcpy(copy, src, src_size);
+    SwapUV(copy, src_stride, copy, src_stride, width, rows);
+    for (int r = 0; r < rows; r++) {
+        if (memcmp(copy + r * src_stride, c + r * dst_stride, width) != 0) {
+            fprintf(stderr, "SwapUV in place %dx%d, stride %d: row %d differs\n",
+                    width, rows, src_stride, r);
+            gTestFailures++;
+            break;
+        }
+    }
+    SwapUV(copy, src_stride, copy, src_stride, width, rows);
+    CHECK(memcmp(copy, src, src_size) == 0);
+
+    free(src);
+    free(ref);
+    free(c);
+    free(fast);
+    free(copy);
+}
+
+/* NV12ToNV21 copies the luma rows and swaps the chroma rows, strides apart. */
+static void testNV12ToNV21(int width, int height, int src_pad, int dst_pad)
+{
+    const int src_stride = width + src_pad;
+    const int dst_stride = width + dst_pad;
+    const size_t src_size = src_stride * height * 3 / 2;
+    const size_t dst_size = dst_stride * height * 3 / 2;
+    uint8_t* src = (uint8_t*)malloc(src_size);
+    uint8_t* dst = (uint8_t*)malloc(dst_size);
+    uint8_t* ref = (uint8_t*)malloc(dst_size);
+
+    testFill(src, src_size, width + height * 3);
+    memset(dst, 0x55, dst_size);
+    memset(ref, 0x55, dst_size);
+    for (int r = 0; r < height; r++) {
+        memcpy(ref + r * dst_stride, src + r * src_stride, width);
+    }
+    referenceSwapUV(src + src_stride * height, src_stride,
+                    ref + dst_stride * height, dst_stride, width, height / 2);
+
+    NV12ToNV21(src, src_stride, dst, dst_stride, width, height);
+    if (memcmp(dst, ref, dst_size) != 0) {
+        fprintf(stderr, "NV12ToNV21 %dx%d, strides %d/%d differs from reference\n",
+                width, height, src_stride, dst_stride);
+        gTestFailures++;
+    }
+
+    // in place, twice, gives the source back
+    uint8_t* copy = (uint8_t*)malloc(src_size);
+    memcpy(copy, src, src_size);
+    NV12ToNV21(copy, src_stride, copy, src_stride, width, height);
+    CHECK(copy[src_stride * height + 1] == src[src_stride * height]);     // swapped once
+    NV12ToNV21(copy, src_stride, copy, src_stride, width, height);
+    CHECK(memcmp(copy, src, src_size) == 0);
+
+    free(src);
+    free(dst);
+    free(ref);
+    free(copy);
+}
+
+/* Names the kernel YUV420ToRGB565() / YUV420ToRGB32() dispatch to, the
+ * converters are built with the same flags as the test. */
+static void runtimeName(char* name, size_t size, const char* what)
+{
+#if defined(__ARM_NEON__) && __BYTE_ORDER == __LITTLE_ENDIAN
+    const char* kernel = cpuHasNeon() ? "NEON" : "C";
+#else
+    const char* kernel = "C";
+#endif
+    snprintf(name, size, "%s, runtime %s", what, kernel);
+}
+
+static void bench(int width, int height, int iterations)
+{
+    char name[64];
+    uint8_t* img = (uint8_t*)malloc(width * height * 3 / 2);
+    uint32_t* rgb = (uint32_t*)malloc(width * height * 4);
+    const uint8_t* V = img + width * height;
+    int64_t start;
+
+    testFill(img, width * height * 3 / 2, 1);
+
+    start = testNowUs();
+    for (int i = 0; i < iterations; i++) {
+        YUV420ToRGB565_C(img, width, V + 1, V, width, 2, rgb, width * 2, width, height);
+    }
+    testReportRate("NV21 to RGB565, C", width, height, iterations, testNowUs() - start);
+
+    start = testNowUs();
+    for (int i = 0; i < iterations; i++) {
+        YUV420ToRGB565(img, width, V + 1, V, width, 2, rgb, width * 2, width, height);
+    }
+    runtimeName(name, sizeof(name), "NV21 to RGB565");
+    testReportRate(name, width, height, iterations, testNowUs() - start);
+
+    start = testNowUs();
+    for (int i = 0; i < iterations; i++) {
+        YUV420ToRGB32_C(img, width, V + 1, V, width, 2, rgb, width * 4, width, height);
+    }
+    testReportRate("NV21 to RGB32, C", width, height, iterations, testNowUs() - start);
+
+    start = testNowUs();
+    for (int i = 0; i < iterations; i++) {
+        YUV420ToRGB32(img, width, V + 1, V, width, 2, rgb, width * 4, width, height);
+    }
+    runtimeName(name, sizeof(name), "NV21 to RGB32");
+    testReportRate(name, width, height, iterations, testNowUs() - start);
+
+    uint8_t* nv21 = (uint8_t*)rgb;
+    start = testNowUs();
+    for (int i = 0; i < iterations; i++) {
+        NV12ToNV21(img, width, nv21, width, width, height);
+    }
+    testReportRate(cpuHasNeon() ? "NV12 to NV21, NEON" : "NV12 to NV21, C",
+                   width, height, iterations, testNowUs() - start);
+
+    free(img);
+    free(rgb);
+}
+
+int main(int argc, char** argv)
+{
+    static const int widths[] = { 2, 14, 16, 18, 30, 32, 34, 176, 318 };
+    const int iterations = testIterations(argc, argv, 50);
+
+    for (int semi = 0; semi < 2; semi++) {
+        for (int rgb32 = 0; rgb32 < 2; rgb32++) {
+            for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+                testRegion(widths[w], 10, 0, 0, widths[w], 10, semi, rgb32);
+                testRegion(widths[w], 11, 0, 0, widths[w], 11, semi, rgb32);
+                testRegion(widths[w] + 20, 24, 10, 6, widths[w], 12, semi, rgb32);
+            }
+        }
+    }
+    testFrames();
+
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+        testSwapUV(widths[w], 5, 0, 0);
+        testSwapUV(widths[w], 5, 6, 0);
+        testSwapUV(widths[w], 5, 0, 10);
+        testSwapUV(widths[w] + 64, 3, 32, 18);
+        testNV12ToNV21(widths[w], 8, 0, 0);
+        testNV12ToNV21(widths[w], 8, 12, 4);
+    }
+
+    printf("YUV 4:2:0 to RGB converters, %d iterations:\n", iterations);
+    bench(640, 480, iterations);
+    bench(1280, 720, iterations);
+
+    return testResult("ConvertersTest");
+}
@@ -0,0 +1,297 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Stress test of FrameRing with a producer and a consumer thread, and a
+ * benchmark of the frame handoff against the OSAL_Queue one it replaced.
+ */
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "CameraTest.h"
+#include "FrameRing.h"
+#include "OSAL_Queue.h"
+
+using namespace android;
+
+enum {
+    STRESS_FRAMES = 200000,
+    PACED_FRAMES = 1000,    // one every PACED_INTERVAL us
+    PACED_INTERVAL = 1000,
+};
+
+static void testSingleThread()
+{
+    FrameRing ring;
+    V4L2BUF_t bufs[FrameRing::CAPACITY + 1];
+
+    CHECK(ring.tryPop() == NULL);
+    for (int i = 0; i < FrameRing::CAPACITY; i++) {
+        bufs[i].index = i;
+        CHECK(ring.push(&bufs[i]));
+    }
+    CHECK(ring.count() == FrameRing::CAPACITY);
+    CHECK(!ring.push(&bufs[FrameRing::CAPACITY]));
+    CHECK(ring.getDropped() == 1);
+
+    for (int i = 0; i < FrameRing::CAPACITY; i++) {
+        V4L2BUF_t* buf = ring.tryPop();
+        CHECK(buf == &bufs[i]);
+    }
+    CHECK(ring.tryPop() == NULL);
+    CHECK(ring.count() == 0);
+    CHECK(ring.getPushed() == FrameRing::CAPACITY);
+}
+
+struct StressArgs {
+    FrameRing*  ring;
+    V4L2BUF_t*  bufs;
+    int         frames;
+    bool        pace;       // sleep now and then so the consumer waits
+};
+
+static void* stressProducer(void* arg)
+{
+    StressArgs* args = (StressArgs*)arg;
+    uint32_t seed = 1;
+
+    for (int i = 0; i < args->frames; ) {
+        args->bufs[i].index = i;
+        if (args->ring->push(&args->bufs[i])) {
+            i++;
+        } else {
+            sched_yield();
+        }
+        seed = seed * 1103515245 + 12345;
+        if (args->pace && ((seed >> 16) & 0xff) == 0) {
+            usleep(200);
+        }
+    }
+    return NULL;
+}
+
+/* Every frame arrives once, in order, whatever the interleaving. */
+static void testStress(bool pace)
+{
+    FrameRing ring;
+    StressArgs args;
+    pthread_t thread;
+    int expected = 0;
+
+    args.ring = &ring;
+    args.bufs = new V4L2BUF_t[STRESS_FRAMES];
+    args.frames = STRESS_FRAMES;
+    args.pace = pace;
+    pthread_create(&thread, NULL, stressProducer, &args);
+
+    while (expected < STRESS_FRAMES) {
+        V4L2BUF_t* buf = ring.waitPop();
+        if (buf == NULL) {
+            fprintf(stderr, "waitPop returned NULL without wakeup()\n");
+            gTestFailures++;
+            break;
+        }
+        if (buf->index != expected) {
+            fprintf(stderr, "frame %d received, %d expected\n", buf->index, expected);
+            gTestFailures++;
+            break;
+        }
+        expected++;
+    }
+
+    pthread_join(thread, NULL);
+    CHECK(ring.tryPop() == NULL);
+    CHECK(ring.getPushed() == (uint32_t)STRESS_FRAMES);
+    if (pace) {
+        // the consumer has waited and every wait ended with a frame
+        CHECK(ring.getWakeups() > 0);
+    }
+    printf("  stress%s: %u pushed, %u full, %u wakeups\n", pace ? ", paced" : "",
+           ring.getPushed(), ring.getDropped(), ring.getWakeups());
+    delete[] args.bufs;
+}
+
+struct WaitArgs {
+    FrameRing*  ring;
+    V4L2BUF_t*  result;
+    volatile int done;
+};
+
+static void* waitConsumer(void* arg)
+{
+    WaitArgs* args = (WaitArgs*)arg;
+    args->result = args->ring->waitPop();
+    args->done = 1;
+    return NULL;
+}
+
+/* A consumer asleep on an empty ring is woken by a push, and by wakeup(). */
+static void testWakeup()
+{
+    FrameRing ring;
+    V4L2BUF_t buf;
+    WaitArgs args;
+    pthread_t thread;
+
+    args.ring = &ring;
+    args.result = NULL;
+    args.done = 0;
+    pthread_create(&thread, NULL, waitConsumer, &args);
+    usleep(20000);
+    CHECK(!args.done);
+    buf.index = 7;
+    ring.push(&buf);
+    pthread_join(thread, NULL);
+    CHECK(args.result == &buf);
+
+    args.result = &buf;
+    args.done = 0;
+    pthread_create(&thread, NULL, waitConsumer, &args);
+    usleep(20000);
+    CHECK(!args.done);
+    ring.wakeup();
+    pthread_join(thread, NULL);
+    CHECK(args.result == NULL);
+}
+
+/* The handoff FrameRing replaced: OSAL_Queue, and a condition the consumer
+ * sleeps on while the queue is empty. */
+class OsalQueue {
+public:
+    OsalQueue()
+    {
+        // OSAL_Queue holds one element less than it is created with
+        OSAL_QueueCreate(&mQueue, FrameRing::CAPACITY + 1);
+        pthread_mutex_init(&mMutex, NULL);
+        pthread_cond_init(&mCond, NULL);
+    }
+    ~OsalQueue()
+    {
+        OSAL_QueueTerminate(&mQueue);
+        pthread_cond_destroy(&mCond);
+        pthread_mutex_destroy(&mMutex);
+    }
+    bool push(V4L2BUF_t* buf)
+    {
+        if (OSAL_Queue(&mQueue, buf) != 0) {
+            return false;
+        }
+        pthread_mutex_lock(&mMutex);
+        pthread_cond_signal(&mCond);
+        pthread_mutex_unlock(&mMutex);
+        return true;
+    }
+    V4L2BUF_t* waitPop()
+    {
+        V4L2BUF_t* buf;
+        pthread_mutex_lock(&mMutex);
+        while ((buf = (V4L2BUF_t*)OSAL_Dequeue(&mQueue)) == NULL) {
+            pthread_cond_wait(&mCond, &mMutex);
+        }
+        pthread_mutex_unlock(&mMutex);
+        return buf;
+    }
+
+private:
+    OSAL_QUEUE      mQueue;
+    pthread_mutex_t mMutex;
+    pthread_cond_t  mCond;
+};
+
+template <class Q>
+struct BenchArgs {
+    Q*          queue;
+    V4L2BUF_t*  bufs;
+    int         frames;
+    int         interval;   // us between frames, 0 for a burst
+};
+
+template <class Q>
+static void* benchProducer(void* arg)
+{
+    BenchArgs<Q>* args = (BenchArgs<Q>*)arg;
+
+    for (int i = 0; i < args->frames; ) {
+        args->bufs[i].timeStamp = testNowUs();
+        if (args->queue->push(&args->bufs[i])) {
+            i++;
+            if (args->interval) {
+                usleep(args->interval);
+            }
+        } else {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+/* Latency from push to pop, and the frame rate of a burst. */
+template <class Q>
+static void bench(const char* name, int frames, int interval)
+{
+    Q queue;
+    BenchArgs<Q> args;
+    pthread_t thread;
+    int64_t total = 0;
+    int64_t max = 0;
+    int64_t start = testNowUs();
+
+    args.queue = &queue;
+    args.bufs = new V4L2BUF_t[frames];
+    args.frames = frames;
+    args.interval = interval;
+    pthread_create(&thread, NULL, benchProducer<Q>, &args);
+
+    for (int i = 0; i < frames; i++) {
+        V4L2BUF_t* buf = queue.waitPop();
+        int64_t latency = testNowUs() - buf->timeStamp;
+        total += latency;
+        if (latency > max) {
+            max = latency;
+        }
+    }
+    const int64_t elapsed = testNowUs() - start;
+    pthread_join(thread, NULL);
+
+    if (interval) {
+        printf("  %-12s latency avg %lld us, max %lld us\n", name,
+               (long long)(total / frames), (long long)max);
+    } else {
+        printf("  %-12s %8.0f frames/s  %6.0f ns/frame\n", name,
+               elapsed > 0 ? frames * 1e6 / elapsed : 0.0, elapsed * 1000.0 / frames);
+    }
+    delete[] args.bufs;
+}
+
+int main(int argc, char** argv)
+{
+    const int iterations = testIterations(argc, argv, 2000000);
+
+    testSingleThread();
+    testWakeup();
+    testStress(false);
+    testStress(true);
+
+    printf("burst handoff, %d frames:\n", iterations);
+    bench<FrameRing>("FrameRing", iterations, 0);
+    bench<OsalQueue>("OSAL_Queue", iterations, 0);
+    printf("paced handoff, %d frames, one every %d us:\n", PACED_FRAMES, PACED_INTERVAL);
+    bench<FrameRing>("FrameRing", PACED_FRAMES, PACED_INTERVAL);
+    bench<OsalQueue>("OSAL_Queue", PACED_FRAMES, PACED_INTERVAL);
+
+    return testResult("FrameRingTest");
+}
@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Benchmarks StripeJpegEncoder with 1 to MAX_STRIPES threads, at preview and
+ * picture sizes of the sensors this HAL drives, against the single threaded
+ * skia encoder NV21JpegCompressor used before. Every output is decoded again
+ * and compared with the source image.
+ *
+ * The skia encoder lives in libandroid_runtime, the host build has no
+ * baseline (STRIPE_BENCH_SKIA is only defined for the device).
+ */
+
+#include <setjmp.h>
+#include <stdio.h>
+
+extern "C" {
+#include "jpeglib.h"
+#include "jerror.h"
+}
+
+#ifdef STRIPE_BENCH_SKIA
+#include <YuvToJpegEncoder.h>
+#endif
+
+#include "CameraTest.h"
+#include "StripeJpegEncoder.h"
+
+using namespace android;
+
+/* A camera-like NV21 image: gradients and some noise, so the entropy coder
+ * has work to do. */
+static void makeImage(uint8_t* img, int width, int height)
+{
+    uint8_t* C = img + width * height;
+
+    testFill(img, width * height * 3 / 2, width + height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            img[y * width + x] = (uint8_t)((x * 3 + y * 5) + (img[y * width + x] & 15));
+        }
+    }
+    for (int y = 0; y < height / 2; y++) {
+        for (int x = 0; x < width; x++) {
+            C[y * width + x] = (uint8_t)(112 + ((x + y) & 31) + (C[y * width + x] & 3));
+        }
+    }
+}
+
+struct DecodeErrorMgr {
+    struct jpeg_error_mgr   pub;
+    jmp_buf                 jmp;
+};
+
+static void onDecodeError(j_common_ptr cinfo)
+{
+    longjmp(((DecodeErrorMgr*)cinfo->err)->jmp, 1);
+}
+
+static void initSource(j_decompress_ptr cinfo) {}
+static void termSource(j_decompress_ptr cinfo) {}
+
+/* The whole JPEG is in memory, running out of it is an error. */
+static boolean fillInputBuffer(j_decompress_ptr cinfo)
+{
+    ERREXIT(cinfo, JERR_INPUT_EOF);
+    return FALSE;
+}
+
+static void skipInputData(j_decompress_ptr cinfo, long num_bytes)
+{
+    if (num_bytes > (long)cinfo->src->bytes_in_buffer) {
+        ERREXIT(cinfo, JERR_INPUT_EOF);
+    }
+    cinfo->src->next_input_byte += num_bytes;
+    cinfo->src->bytes_in_buffer -= num_bytes;
+}
+
+/* Decodes the JPEG with libjpeg and returns the mean absolute luma error
+ * against the NV21 source, or -1 if it does not decode to width x height. */
+static double decodeError(const void* jpeg, size_t size, const uint8_t* img,
+                          int width, int height)
+{
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_source_mgr src;
+    DecodeErrorMgr jerr;
+    uint8_t* row = NULL;
+    int64_t error = 0;
+
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = onDecodeError;
+    if (setjmp(jerr.jmp)) {
+        jpeg_destroy_decompress(&cinfo);
+        free(row);
+        return -1;
+    }
+    jpeg_create_decompress(&cinfo);
+    src.next_input_byte = (const JOCTET*)jpeg;
+    src.bytes_in_buffer = size;
+    src.init_source = initSource;
+    src.fill_input_buffer = fillInputBuffer;
+    src.skip_input_data = skipInputData;
+    src.resync_to_restart = jpeg_resync_to_restart;
+    src.term_source = termSource;
+    cinfo.src = &src;
+
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = JCS_YCbCr;
+    jpeg_start_decompress(&cinfo);
+    if ((int)cinfo.output_width != width || (int)cinfo.output_height != height
+        || cinfo.output_components != 3) {
+        jpeg_destroy_decompress(&cinfo);
+        return -1;
+    }
+    row = (uint8_t*)malloc(width * 3);
+    while (cinfo.output_scanline < cinfo.output_height) {
+        const int y = cinfo.output_scanline;
+        JSAMPROW rows[1] = { row };
+        jpeg_read_scanlines(&cinfo, rows, 1);
+        for (int x = 0; x < width; x++) {
+            error += abs(row[x * 3] - img[y * width + x]);
+        }
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    free(row);
+    return (double)error / ((double)width * height);
+}
+
+/* The output decodes to the source image, give or take the quantization. */
+static void checkDecode(const char* name, const void* jpeg, size_t size,
+                        const uint8_t* img, int width, int height)
+{
+    const double error = decodeError(jpeg, size, img, width, height);
+    if (error < 0 || error > 8.0) {
+        fprintf(stderr, "%s %dx%d: does not decode to the source, error %.2f\n",
+                name, width, height, error);
+        gTestFailures++;
+    }
+}
+
+#ifdef STRIPE_BENCH_SKIA
+/* What NV21JpegCompressor did on one thread before StripeJpegEncoder. */
+static void benchSkia(const uint8_t* img, int width, int height, int iterations)
+{
+    int strides[2] = { width, width };
+    int offsets[2] = { 0, width * height };
+    Yuv420SpToJpegEncoder encoder(strides);
+    SkDynamicMemoryWStream* stream = NULL;
+    int64_t start = testNowUs();
+
+    for (int i = 0; i < iterations; i++) {
+        delete stream;
+        stream = new SkDynamicMemoryWStream();
+        if (!encoder.encode(stream, (void*)img, width, height, offsets, 90)) {
+            fprintf(stderr, "%dx%d, skia: encode failed\n", width, height);
+            gTestFailures++;
+            break;
+        }
+    }
+    const int64_t us = testNowUs() - start;
+
+    const size_t size = stream->getOffset();
+    uint8_t* jpeg = (uint8_t*)malloc(size);
+    stream->copyTo(jpeg);
+    checkDecode("skia", jpeg, size, img, width, height);
+    free(jpeg);
+    delete stream;
+
+    char name[32];
+    snprintf(name, sizeof(name), "skia, 1 thread, %u KB", (unsigned)(size / 1024));
+    testReportRate(name, width, height, iterations, us);
+}
+#endif
+
+static void bench(int width, int height, int iterations)
+{
+    uint8_t* img = (uint8_t*)malloc(width * height * 3 / 2);
+
+    makeImage(img, width, height);
+#ifdef STRIPE_BENCH_SKIA
+    benchSkia(img, width, height, iterations);
+#endif
+    for (int threads = 1; threads <= StripeJpegEncoder::MAX_STRIPES; threads *= 2) {
+        StripeJpegEncoder encoder;
+        char name[32];
+        int64_t start = testNowUs();
+
+        for (int i = 0; i < iterations; i++) {
+            if (encoder.encode(img, width, height, 90, threads) != NO_ERROR) {
+                fprintf(stderr, "%dx%d, %d threads: encode failed\n", width, height, threads);
+                gTestFailures++;
+                break;
+            }
+        }
+        const int64_t us = testNowUs() - start;
+        checkDecode("stripes", encoder.getData(), encoder.getSize(), img, width, height);
+
+        snprintf(name, sizeof(name), "%d thread%s, %u KB", threads, threads > 1 ? "s" : "",
+                 (unsigned)(encoder.getSize() / 1024));
+        testReportRate(name, width, height, iterations, us);
+    }
+
+    free(img);
+}
+
+int main(int argc, char** argv)
+{
+    const int iterations = testIterations(argc, argv, 5);
+
+    printf("StripeJpegEncoder, quality 90, %d iterations, default threads %d:\n",
+           iterations, StripeJpegEncoder::getDefaultThreads());
+    bench(640, 480, iterations);
+    bench(1600, 1200, iterations);
+    bench(2592, 1936, iterations);
+
+    return testResult("StripeJpegEncoderBench");
+}
@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Checks the YUYV to NV12 / NV21 converters against a per pixel reference,
+ * and the runtime selected kernel (NEON on the device) against the C one,
+ * then benchmarks both against the scalar functions V4L2CameraDevice used
+ * before.
+ */
+
+#include "CameraTest.h"
+#include "YUYVConverters.h"
+
+using namespace android;
+
+/* Straightforward version of the conversion, one output sample at a time. */
+static void referenceYUYVToYUV420SP(const uint8_t* yuyv, uint8_t* out,
+                                    int width, int height, bool nv21)
+{
+    uint8_t* C = out + width * height;
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            out[y * width + x] = yuyv[y * width * 2 + x * 2];
+        }
+    }
+    for (int y = 0; y < height; y += 2) {
+        const int y1 = (y + 1 < height) ? y + 1 : y;
+        for (int x = 0; x < width; x += 2) {
+            const uint8_t* p0 = yuyv + y * width * 2 + x * 2;
+            const uint8_t* p1 = yuyv + y1 * width * 2 + x * 2;
+            const uint8_t u = (p0[1] + p1[1] + 1) >> 1;
+            const uint8_t v = (p0[3] + p1[3] + 1) >> 1;
+            C[(y / 2) * width + x] = nv21 ? v : u;
+            C[(y / 2) * width + x + 1] = nv21 ? u : v;
+        }
+    }
+}
+
+/* The functions V4L2CameraDevice.cpp had before YUYVConverters, as they
+ * were, for the benchmark only: they keep the chroma of the even rows, and
+ * the NV21 one swaps the wrong chroma bytes. */
+static void oldYUYVToNV12(const void* yuyv, void *nv12, int width, int height)
+{
+	uint8_t* Y	= (uint8_t*)nv12;
+	uint8_t* UV = (uint8_t*)Y + width * height;
+	
+	for(int i = 0; i < height; i += 2)
+	{
+		for (int j = 0; j < width; j++)
+		{
+			*(uint8_t*)((uint8_t*)Y + i * width + j) = *(uint8_t*)((uint8_t*)yuyv + i * width * 2 + j * 2);
+			*(uint8_t*)((uint8_t*)Y + (i + 1) * width + j) = *(uint8_t*)((uint8_t*)yuyv + (i + 1) * width * 2 + j * 2);
+			*(uint8_t*)((uint8_t*)UV + ((i * width) >> 1) + j) = *(uint8_t*)((uint8_t*)yuyv + i * width * 2 + j * 2 + 1);
+		}
+	}
+}
+
+static void oldYUYVToNV21(const void* yuyv, void *nv21, int width, int height)
+{
+	uint8_t* Y	= (uint8_t*)nv21;
+	uint8_t* VU = (uint8_t*)Y + width * height;
+	
+	for(int i = 0; i < height; i += 2)
+	{
+		for (int j = 0; j < width; j++)
+		{
+			*(uint8_t*)((uint8_t*)Y + i * width + j) = *(uint8_t*)((uint8_t*)yuyv + i * width * 2 + j * 2);
+			*(uint8_t*)((uint8_t*)Y + (i + 1) * width + j) = *(uint8_t*)((uint8_t*)yuyv + (i + 1) * width * 2 + j * 2);
+
+			if (j % 2)
+			{
+				if (j < width - 1)
+				{
+					*(uint8_t*)((uint8_t*)VU + ((i * width) >> 1) + j) = *(uint8_t*)((uint8_t*)yuyv + i * width * 2 + (j + 1) * 2 + 1);
+				}
+			}
+			else
+			{
+				if (j > 1)
+				{
+					*(uint8_t*)((uint8_t*)VU + ((i * width) >> 1) + j) = *(uint8_t*)((uint8_t*)yuyv + i * width * 2 + (j - 1) * 2 + 1); 		
+				}
+			}
+		}
+	}
+}
+
+static void testSize(int width, int height)
+{
+    const size_t in_size = width * height * 2;
+    const size_t out_size = width * ((height + 1) & ~1) * 3 / 2;
+    uint8_t* in = (uint8_t*)malloc(in_size);
+    uint8_t* ref = (uint8_t*)malloc(out_size);
+    uint8_t* c = (uint8_t*)malloc(out_size);
+    uint8_t* fast = (uint8_t*)malloc(out_size);
+
+    testFill(in, in_size, width * 1000 + height);
+    for (int nv21 = 0; nv21 < 2; nv21++) {
+        memset(ref, 0, out_size);
+        memset(c, 0, out_size);
+        memset(fast, 0, out_size);
+        referenceYUYVToYUV420SP(in, ref, width, height, nv21);
+        if (nv21) {
+            YUYVToNV21_C(in, c, width, height);
+            YUYVToNV21(in, fast, width, height);
+        } else {
+            YUYVToNV12_C(in, c, width, height);
+            YUYVToNV12(in, fast, width, height);
+        }
+        if (memcmp(ref, c, out_size) != 0 || memcmp(c, fast, out_size) != 0) {
+            fprintf(stderr, "%s %dx%d: C %s reference, %s %s C\n",
+                    nv21 ? "NV21" : "NV12", width, height,
+                    memcmp(ref, c, out_size) ? "differs from" : "matches",
+                    cpuHasNeon() ? "NEON" : "C", memcmp(c, fast, out_size) ? "differs from" : "matches");
+            gTestFailures++;
+        }
+    }
+
+    free(in);
+    free(ref);
+    free(c);
+    free(fast);
+}
+
+/* Pixel rate, and the memory traffic: 2 bytes read and 1.5 written a pixel. */
+static void report(const char* name, int width, int height, int iterations, int64_t us)
+{
+    const double pixels = (double)width * height * iterations;
+    printf("  %-24s %4dx%-4d %8.1f Mpixel/s %8.1f MB/s  %7.3f ms/frame\n", name,
+           width, height, us > 0 ? pixels / us : 0.0,
+           us > 0 ? pixels * 3.5 / us : 0.0, (double)us / iterations / 1000.0);
+}
+
+static void bench(int width, int height, int iterations)
+{
+    uint8_t* in = (uint8_t*)malloc(width * height * 2);
+    uint8_t* out = (uint8_t*)malloc(width * height * 3 / 2);
+    int64_t start;
+
+    testFill(in, width * height * 2, 1);
+
+    start = testNowUs();
+    for (int i = 0; i < iterations; i++) {
+        oldYUYVToNV12(in, out, width, height);
+    }
+    report("old YUYVToNV12", width, height, iterations, testNowUs() - start);
+
+    start = testNowUs();
+    for (int i = 0; i < iterations; i++) {
+        oldYUYVToNV21(in, out, width, height);
+    }
+    report("old YUYVToNV21", width, height, iterations, testNowUs() - start);
+
+    start = testNowUs();
+    for (int i = 0; i < iterations; i++) {
+        YUYVToNV21_C(in, out, width, height);
+    }
+    report("YUYVToNV21_C", width, height, iterations, testNowUs() - start);
+
+    start = testNowUs();
+    for (int i = 0; i < iterations; i++) {
+        YUYVToNV21(in, out, width, height);
+    }
+    report(cpuHasNeon() ? "YUYVToNV21 (NEON)" : "YUYVToNV21 (C)",
+           width, height, iterations, testNowUs() - start);
+
+    free(in);
+    free(out);
+}
+
+int main(int argc, char** argv)
+{
+    static const int widths[] = { 2, 30, 32, 34, 62, 64, 66, 158, 176, 320, 638, 640 };
+    static const int heights[] = { 1, 2, 3, 7, 16, 33, 120 };
+    const int iterations = testIterations(argc, argv, 50);
+
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+        for (size_t h = 0; h < sizeof(heights) / sizeof(heights[0]); h++) {
+            testSize(widths[w], heights[h]);
+        }
+    }
+
+    printf("YUYV converters, %d iterations:\n", iterations);
+    bench(640, 480, iterations);
+    bench(1280, 720, iterations);
+    bench(1600, 1200, iterations);
+
+    return testResult("YUYVConvertersTest");
+}
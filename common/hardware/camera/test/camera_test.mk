@@ -0,0 +1,38 @@
+# Builds one camera HAL test, for the host and for the device. The device
+# build is the one that exercises the NEON kernels.
+#
+# In:
+#   camera_test_name            - module name
+#   camera_test_src             - sources, relative to test/
+#   camera_test_cflags          - extra flags, optional
+#   camera_test_host_ldlibs     - host system libraries, optional
+#   camera_test_shared_libs     - device shared libraries, optional
+#   camera_test_target_includes - device include paths, optional
+#   camera_test_target_cflags   - extra device flags, optional
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := $(camera_test_name)
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := $(camera_test_src)
+LOCAL_C_INCLUDES := $(camera_test_includes)
+LOCAL_CFLAGS := -fno-short-enums $(camera_test_cflags)
+LOCAL_STATIC_LIBRARIES := libcutils liblog
+LOCAL_LDLIBS := -lpthread -lrt $(camera_test_host_ldlibs)
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := $(camera_test_name)
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := $(camera_test_src)
+LOCAL_C_INCLUDES := $(camera_test_includes) $(camera_test_target_includes)
+LOCAL_CFLAGS := -fno-short-enums $(camera_test_cflags) $(camera_test_target_cflags)
+LOCAL_SHARED_LIBRARIES := libcutils liblog $(camera_test_shared_libs)
+include $(BUILD_EXECUTABLE)
+
+camera_test_name :=
+camera_test_src :=
+camera_test_cflags :=
+camera_test_host_ldlibs :=
+camera_test_shared_libs :=
+camera_test_target_includes :=
+camera_test_target_cflags :=
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HW_CAMERA_HOST_FACE_DETECTION_API_H
+#define HW_CAMERA_HOST_FACE_DETECTION_API_H
+
+/*
+ * Host stand-in for libfacedetection: a detector that never finds a face.
+ */
+
+enum {
+    FACE_OPS_CMD_START = 0,
+    FACE_OPS_CMD_STOP,
+    FACE_OPS_CMD_REGISTE_USER,
+};
+
+enum {
+    FACE_NOTITY_CMD_REQUEST_FRAME = 0,
+    FACE_NOTITY_CMD_RESULT,
+    FACE_NOTITY_CMD_POSITION,
+};
+
+typedef int (*face_notify_cb)(int cmd, void* data, void* user);
+
+typedef struct FaceDetectionDev
+{
+    int (*ioctrl)(struct FaceDetectionDev* dev, int cmd, int arg0, int arg1);
+    int (*setCallback)(struct FaceDetectionDev* dev, face_notify_cb cb);
+} FaceDetectionDev;
+
+int CreateFaceDetectionDev(FaceDetectionDev** dev);
+
+#endif  /* HW_CAMERA_HOST_FACE_DETECTION_API_H */
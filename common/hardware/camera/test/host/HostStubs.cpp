@@ -0,0 +1,319 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host stand-ins for the CedarX libraries, libfacedetection, the system
+ * properties and the skia JPEG encoder the camera HAL links with.
+ *
+ * The physically contiguous memory of the video engine is a pool mapped once.
+ * Its physical addresses are the offsets in the pool with bit 30 set, as the
+ * HAL ORs 0x40000000 into what cedarv_address_vir2phy returns. JpegEnc reads
+ * the frames back through these addresses, so a HAL path that hands it a
+ * made-up address fails here as it would on the device.
+ */
+
+#define LOG_TAG "CameraHostStubs"
+#include "CameraDebug.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <cutils/properties.h>
+#include <type_camera.h>
+#include <FaceDetectionApi.h>
+#include <YuvToJpegEncoder.h>
+#include "StripeJpegEncoder.h"
+
+using namespace android;
+
+/****************************************************************************
+ * CedarX memory and hardware.
+ ***************************************************************************/
+
+#define POOL_SIZE           (128 * 1024 * 1024)
+#define POOL_MAX_BLOCKS     256
+#define PHY_BIT             0x40000000
+
+typedef struct pool_block_t
+{
+    unsigned int    offset;
+    unsigned int    size;
+} pool_block_t;
+
+static pthread_mutex_t gPoolLock = PTHREAD_MUTEX_INITIALIZER;
+static char* gPool = NULL;
+static pool_block_t gBlocks[POOL_MAX_BLOCKS];     // sorted by offset
+static int gBlockCount = 0;
+
+static bool poolInit()
+{
+    if (gPool != NULL) {
+        return true;
+    }
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+#ifdef MAP_32BIT
+    flags |= MAP_32BIT;     // the HAL keeps addresses in 32 bit integers
+#endif
+    void* pool = mmap(NULL, POOL_SIZE, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (pool == MAP_FAILED) {
+        LOGE("%s: mmap %d bytes failed", __FUNCTION__, POOL_SIZE);
+        return false;
+    }
+    gPool = (char*)pool;
+    return true;
+}
+
+extern "C" void* cedara_phymalloc_map(unsigned int size, int align)
+{
+    pthread_mutex_lock(&gPoolLock);
+    if (!poolInit() || gBlockCount == POOL_MAX_BLOCKS || size == 0) {
+        pthread_mutex_unlock(&gPoolLock);
+        return NULL;
+    }
+    if (align < 4096) {
+        align = 4096;
+    }
+
+    // first fit between the blocks
+    unsigned int offset = 0;
+    int i = 0;
+    for (; i <= gBlockCount; i++) {
+        offset = (offset + align - 1) & ~(align - 1);
+        const unsigned int end = (i < gBlockCount) ? gBlocks[i].offset : POOL_SIZE;
+        if (offset <= end && end - offset >= size) {
+            break;
+        }
+        if (i < gBlockCount) {
+            offset = gBlocks[i].offset + gBlocks[i].size;
+        }
+    }
+    if (i > gBlockCount) {
+        pthread_mutex_unlock(&gPoolLock);
+        LOGE("%s: no %u bytes left", __FUNCTION__, size);
+        return NULL;
+    }
+
+    memmove(&gBlocks[i + 1], &gBlocks[i], (gBlockCount - i) * sizeof(pool_block_t));
+    gBlocks[i].offset = offset;
+    gBlocks[i].size = size;
+    gBlockCount++;
+    pthread_mutex_unlock(&gPoolLock);
+    return gPool + offset;
+}
+
+extern "C" void cedara_phyfree_map(void* buf)
+{
+    pthread_mutex_lock(&gPoolLock);
+    for (int i = 0; i < gBlockCount; i++) {
+        if (gPool + gBlocks[i].offset == buf) {
+            memmove(&gBlocks[i], &gBlocks[i + 1], (gBlockCount - i - 1) * sizeof(pool_block_t));
+            gBlockCount--;
+            pthread_mutex_unlock(&gPoolLock);
+            return;
+        }
+    }
+    pthread_mutex_unlock(&gPoolLock);
+    LOGE("%s: %p was not allocated", __FUNCTION__, buf);
+}
+
+extern "C" unsigned int cedarv_address_vir2phy(void* addr)
+{
+    return (unsigned int)((char*)addr - gPool);
+}
+
+extern "C" unsigned int cedarv_address_phy2vir(void* addr)
+{
+    return (unsigned int)(uintptr_t)(gPool + ((uintptr_t)addr & ~PHY_BIT));
+}
+
+/* The pool memory at physical address 'phy', NULL if it is not in the pool. */
+static uint8_t* phyToVir(unsigned int phy, unsigned int size)
+{
+    if ((phy & PHY_BIT) == 0) {
+        return NULL;
+    }
+    phy &= ~PHY_BIT;
+    if (gPool == NULL || phy >= POOL_SIZE || POOL_SIZE - phy < size) {
+        return NULL;
+    }
+    return (uint8_t*)gPool + phy;
+}
+
+extern "C" int cedarx_hardware_init(int mode)
+{
+    return 0;
+}
+
+extern "C" int cedarx_hardware_exit(int mode)
+{
+    return 0;
+}
+
+/* The JPEG engine: NV12 at physical addresses in, the crop window scaled to
+ * the picture size. EXIF and the thumbnail are left out. */
+extern "C" int JpegEnc(void* pBufOut, int* bufSize, JPEG_ENC_t* jpeg_enc)
+{
+    const int src_w = jpeg_enc->src_w;
+    const int src_h = jpeg_enc->src_h;
+    const int pic_w = jpeg_enc->pic_w & ~1;
+    const int pic_h = jpeg_enc->pic_h & ~1;
+    int crop_x = 0, crop_y = 0, crop_w = src_w, crop_h = src_h;
+    if (jpeg_enc->enable_crop) {
+        crop_x = jpeg_enc->crop_x & ~1;
+        crop_y = jpeg_enc->crop_y & ~1;
+        crop_w = jpeg_enc->crop_w;
+        crop_h = jpeg_enc->crop_h;
+    }
+    const uint8_t* Y = phyToVir(jpeg_enc->addrY, src_w * src_h);
+    const uint8_t* C = phyToVir(jpeg_enc->addrC, src_w * src_h / 2);
+    if (Y == NULL || C == NULL || pic_w <= 0 || pic_h <= 0
+        || crop_x < 0 || crop_y < 0 || crop_w <= 0 || crop_h <= 0
+        || crop_x + crop_w > src_w || crop_y + crop_h > src_h) {
+        LOGE("%s: bad source %x / %x, %dx%d, crop [%d, %d, %d, %d]", __FUNCTION__,
+             jpeg_enc->addrY, jpeg_enc->addrC, src_w, src_h, crop_x, crop_y, crop_w, crop_h);
+        return -1;
+    }
+
+    // NV12 to NV21, nearest neighbour
+    uint8_t* img = (uint8_t*)malloc(pic_w * pic_h * 3 / 2);
+    if (img == NULL) {
+        return -1;
+    }
+    uint8_t* dst_c = img + pic_w * pic_h;
+    for (int y = 0; y < pic_h; y++) {
+        const uint8_t* src = Y + (crop_y + y * crop_h / pic_h) * src_w + crop_x;
+        for (int x = 0; x < pic_w; x++) {
+            img[y * pic_w + x] = src[x * crop_w / pic_w];
+        }
+    }
+    for (int y = 0; y < pic_h / 2; y++) {
+        const uint8_t* src = C + ((crop_y + y * 2 * crop_h / pic_h) / 2) * src_w + crop_x;
+        for (int x = 0; x < pic_w / 2; x++) {
+            const int sx = (x * 2 * crop_w / pic_w) & ~1;
+            dst_c[y * pic_w + x * 2] = src[sx + 1];
+            dst_c[y * pic_w + x * 2 + 1] = src[sx];
+        }
+    }
+
+    StripeJpegEncoder encoder;
+    status_t res = encoder.encode(img, pic_w, pic_h, jpeg_enc->quality,
+                                  StripeJpegEncoder::getDefaultThreads());
+    free(img);
+    if (res != NO_ERROR) {
+        return -1;
+    }
+    memcpy(pBufOut, encoder.getData(), encoder.getSize());
+    *bufSize = encoder.getSize();
+    return 0;
+}
+
+/****************************************************************************
+ * Face detection.
+ ***************************************************************************/
+
+static int faceIoctrl(FaceDetectionDev* dev, int cmd, int arg0, int arg1)
+{
+    return 0;
+}
+
+static int faceSetCallback(FaceDetectionDev* dev, face_notify_cb cb)
+{
+    return 0;
+}
+
+int CreateFaceDetectionDev(FaceDetectionDev** dev)
+{
+    static FaceDetectionDev face = { faceIoctrl, faceSetCallback };
+    *dev = &face;
+    return 0;
+}
+
+/****************************************************************************
+ * System properties.
+ ***************************************************************************/
+
+#define MAX_PROPERTIES      32
+
+static pthread_mutex_t gPropertyLock = PTHREAD_MUTEX_INITIALIZER;
+static char gPropertyKeys[MAX_PROPERTIES][PROPERTY_KEY_MAX];
+static char gPropertyValues[MAX_PROPERTIES][PROPERTY_VALUE_MAX];
+static int gPropertyCount = 0;
+
+extern "C" int host_property_get(const char* key, char* value, const char* default_value)
+{
+    pthread_mutex_lock(&gPropertyLock);
+    for (int i = 0; i < gPropertyCount; i++) {
+        if (!strcmp(gPropertyKeys[i], key)) {
+            strcpy(value, gPropertyValues[i]);
+            pthread_mutex_unlock(&gPropertyLock);
+            return strlen(value);
+        }
+    }
+    pthread_mutex_unlock(&gPropertyLock);
+
+    if (default_value == NULL) {
+        value[0] = 0;
+        return 0;
+    }
+    strncpy(value, default_value, PROPERTY_VALUE_MAX - 1);
+    value[PROPERTY_VALUE_MAX - 1] = 0;
+    return strlen(value);
+}
+
+extern "C" int host_property_set(const char* key, const char* value)
+{
+    if (strlen(key) >= PROPERTY_KEY_MAX || strlen(value) >= PROPERTY_VALUE_MAX) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&gPropertyLock);
+    int i = 0;
+    while (i < gPropertyCount && strcmp(gPropertyKeys[i], key)) {
+        i++;
+    }
+    if (i == MAX_PROPERTIES) {
+        pthread_mutex_unlock(&gPropertyLock);
+        return -1;
+    }
+    if (i == gPropertyCount) {
+        strcpy(gPropertyKeys[i], key);
+        gPropertyCount++;
+    }
+    strcpy(gPropertyValues[i], value);
+    pthread_mutex_unlock(&gPropertyLock);
+    return 0;
+}
+
+/****************************************************************************
+ * Skia JPEG encoder.
+ ***************************************************************************/
+
+bool Yuv420SpToJpegEncoder::encode(SkWStream* stream, void* image, int width, int height,
+                                   int* offsets, int quality)
+{
+    // JpegCompressor passes packed NV21
+    if (mStrides[0] != width || mStrides[1] != width || offsets[0] != 0
+        || offsets[1] != width * height) {
+        return false;
+    }
+
+    StripeJpegEncoder encoder;
+    if (encoder.encode(image, width, height, quality, 1) != NO_ERROR) {
+        return false;
+    }
+    return stream->write(encoder.getData(), encoder.getSize());
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HW_CAMERA_HOST_YUV_TO_JPEG_ENCODER_H
+#define HW_CAMERA_HOST_YUV_TO_JPEG_ENCODER_H
+
+/*
+ * Host stand-in for the skia YUV to JPEG encoder, on top of StripeJpegEncoder.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <utils/Errors.h>
+
+class SkWStream
+{
+public:
+    virtual ~SkWStream() {}
+    virtual bool write(const void* buffer, size_t size) = 0;
+};
+
+class SkDynamicMemoryWStream : public SkWStream
+{
+public:
+    SkDynamicMemoryWStream() : mData(NULL), mSize(0), mCapacity(0) {}
+    ~SkDynamicMemoryWStream() { free(mData); }
+
+    bool write(const void* buffer, size_t size)
+    {
+        if (mSize + size > mCapacity) {
+            size_t capacity = (mCapacity > 0) ? mCapacity * 2 : 64 * 1024;
+            while (capacity < mSize + size) {
+                capacity *= 2;
+            }
+            char* data = (char*)realloc(mData, capacity);
+            if (data == NULL) {
+                return false;
+            }
+            mData = data;
+            mCapacity = capacity;
+        }
+        memcpy(mData + mSize, buffer, size);
+        mSize += size;
+        return true;
+    }
+
+    size_t getOffset() const { return mSize; }
+    void copyTo(void* dst) const { memcpy(dst, mData, mSize); }
+    void reset() { mSize = 0; }
+
+private:
+    char*   mData;
+    size_t  mSize;
+    size_t  mCapacity;
+};
+
+/* Encodes NV21 images, like the skia encoder of the same name. */
+class Yuv420SpToJpegEncoder
+{
+public:
+    Yuv420SpToJpegEncoder(int* strides) : mStrides(strides) {}
+    virtual ~Yuv420SpToJpegEncoder() {}
+
+    bool encode(SkWStream* stream, void* image, int width, int height,
+                int* offsets, int quality);
+
+private:
+    int*    mStrides;
+};
+
+#endif  /* HW_CAMERA_HOST_YUV_TO_JPEG_ENCODER_H */
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HW_CAMERA_HOST_IPC_THREAD_STATE_H
+#define HW_CAMERA_HOST_IPC_THREAD_STATE_H
+
+/*
+ * Host stand-in for binder/IPCThreadState.h: the harness calls the HAL
+ * itself, so the caller is this process.
+ */
+
+#include <unistd.h>
+
+namespace android {
+
+class IPCThreadState
+{
+public:
+    static IPCThreadState* self()
+    {
+        static IPCThreadState state;
+        return &state;
+    }
+
+    int getCallingPid() const
+    {
+        return getpid();
+    }
+};
+
+}; /* namespace android */
+
+#endif  /* HW_CAMERA_HOST_IPC_THREAD_STATE_H */
@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HW_CAMERA_HOST_PROPERTIES_H
+#define HW_CAMERA_HOST_PROPERTIES_H
+
+/*
+ * Host stand-in for cutils/properties.h. The properties live in the process,
+ * the harness sets the camera.fake.* ones from its command line.
+ */
+
+#define PROPERTY_KEY_MAX    32
+#define PROPERTY_VALUE_MAX  92
+
+#define property_get        host_property_get
+#define property_set        host_property_set
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int host_property_get(const char* key, char* value, const char* default_value);
+int host_property_set(const char* key, const char* value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* HW_CAMERA_HOST_PROPERTIES_H */
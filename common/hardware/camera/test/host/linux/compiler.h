@@ -0,0 +1,28 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HW_CAMERA_HOST_LINUX_COMPILER_H
+#define HW_CAMERA_HOST_LINUX_COMPILER_H
+
+/*
+ * Host stand-in for the linux/compiler.h of the bionic kernel headers, which
+ * the videodev2.h of the sensor drivers includes. The host headers do not
+ * export it.
+ */
+
+#define __user
+
+#endif  /* HW_CAMERA_HOST_LINUX_COMPILER_H */
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HW_CAMERA_HOST_GRAPHIC_BUFFER_MAPPER_H
+#define HW_CAMERA_HOST_GRAPHIC_BUFFER_MAPPER_H
+
+/*
+ * Host stand-in for ui/GraphicBufferMapper.h. The preview window of the
+ * harness hands out host_buffer_t handles, locking one returns its pixels.
+ */
+
+#include <stdint.h>
+#include <utils/Errors.h>
+#include <hardware/gralloc.h>
+#include <ui/Rect.h>
+
+/* A preview window buffer of the harness. */
+typedef struct host_buffer_t
+{
+    native_handle_t     handle;
+    void*               bits;
+} host_buffer_t;
+
+namespace android {
+
+class GraphicBufferMapper
+{
+public:
+    static GraphicBufferMapper& get()
+    {
+        static GraphicBufferMapper mapper;
+        return mapper;
+    }
+
+    status_t lock(buffer_handle_t handle, int usage, const Rect& bounds, void** vaddr)
+    {
+        *vaddr = ((const host_buffer_t*)handle)->bits;
+        return NO_ERROR;
+    }
+
+    status_t unlock(buffer_handle_t handle)
+    {
+        return NO_ERROR;
+    }
+};
+
+}; /* namespace android */
+
+#endif  /* HW_CAMERA_HOST_GRAPHIC_BUFFER_MAPPER_H */
@@ -21,7 +21,8 @@ include $(CLEAR_VARS)
 
 LOCAL_MODULE_PATH := $(TARGET_OUT_SHARED_LIBRARIES)/hw
 LOCAL_SHARED_LIBRARIES := liblog libEGL libcutils
-LOCAL_SRC_FILES := hwcomposer.cpp
+LOCAL_SRC_FILES := hwcomposer.cpp \
+	hwc_planner.cpp
 LOCAL_C_INCLUDES += $(TARGET_HARDWARE_INCLUDE)
 LOCAL_MODULE := hwcomposer.$(TARGET_BOARD_PLATFORM)
 LOCAL_CFLAGS:= -DLOG_TAG=\"hwcomposer\"
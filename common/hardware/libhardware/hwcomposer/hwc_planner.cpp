@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//composition planner: which layers of a list go on the display engine and
+//the scaler window of the video layer. Only the planner's view of the
+//hardware is used here, no ioctl, so it can be run on any list.
+//
+//The video layer (one scaler mode layer per screen, under the UI layer) is
+//the only hardware layer this HAL drives; RGB layers come from gralloc
+//buffers the display engine can not scan out and stay with the GPU. Video
+//layers carry the frame parameters of the decoder or the camera, not pixels
+//the GPU could draw, so they stay overlays whatever the planner finds: a
+//window out of the scaler range is clamped, the rest is only logged.
+
+#include <string.h>
+
+#include "hwc_planner.h"
+
+static const char *hwc_plan_reasons[HWC_PLAN_REASON_NUM] =
+{
+    "overlay",
+    "gpu",
+    "skip layer",
+    "source cropped to the scaler line buffer",
+    "window clamped to the scaler range",
+    "no free scaler",
+    "no free layer",
+    "video layer in use",
+};
+
+static bool hwc_plan_is_video(uint32_t format)
+{
+    return (format == HWC_FORMAT_MBYUV420)
+        || (format == HWC_FORMAT_MBYUV422)
+        || (format == HWC_FORMAT_YUV420PLANAR)
+        || (format == HWC_FORMAT_DEFAULT);
+}
+
+static int hwc_plan_screens(uint32_t screens)
+{
+    return ((screens & 1) ? 1 : 0) + ((screens & 2) ? 1 : 0);
+}
+
+//narrows [*start, *end) to 'size', keeping its middle
+static void hwc_plan_narrow(int *start, int *end, int size)
+{
+    *start += (*end - *start - size) / 2;
+    *end = *start + size;
+}
+
+//clamps one axis of the scaler window: the source to 'max_src' if not 0,
+//then the ratio to the scaler range. Returns the reason, HWC_PLAN_OK if unchanged.
+static int hwc_plan_clamp_axis(int *src_start, int *src_end, int *dst_start, int *dst_end, int max_src)
+{
+    int src = *src_end - *src_start;
+    int dst = *dst_end - *dst_start;
+    int reason = HWC_PLAN_OK;
+
+    if(max_src > 0 && src > max_src)
+    {
+        //show the middle of the picture at the same scale
+        hwc_plan_narrow(dst_start, dst_end, (int)((int64_t)dst * max_src / src));
+        hwc_plan_narrow(src_start, src_end, max_src);
+        src = max_src;
+        dst = *dst_end - *dst_start;
+        reason = HWC_PLAN_CLAMP_SRC_SIZE;
+    }
+    if(dst <= 0)
+    {
+        return reason;
+    }
+    if(src > dst * HWC_PLAN_SCALER_MAX_DOWNSCALE)
+    {
+        hwc_plan_narrow(src_start, src_end, dst * HWC_PLAN_SCALER_MAX_DOWNSCALE);
+        reason = (reason == HWC_PLAN_OK) ? HWC_PLAN_CLAMP_SCALE : reason;
+    }
+    else if(dst > src * HWC_PLAN_SCALER_MAX_UPSCALE)
+    {
+        hwc_plan_narrow(dst_start, dst_end, src * HWC_PLAN_SCALER_MAX_UPSCALE);
+        reason = (reason == HWC_PLAN_OK) ? HWC_PLAN_CLAMP_SCALE : reason;
+    }
+    return reason;
+}
+
+//the scaler window of the video layer in plan->crop and plan->frame
+static int hwc_plan_window(const hwc_layer_t *layer, hwc_plan_t *plan)
+{
+    int reason_x, reason_y;
+
+    memcpy(&plan->crop, &layer->sourceCrop, sizeof(hwc_rect_t));
+    memcpy(&plan->frame, &layer->displayFrame, sizeof(hwc_rect_t));
+
+    //an empty window is not shown, hwc_set_rect leaves it alone
+    if(plan->crop.right <= plan->crop.left || plan->crop.bottom <= plan->crop.top)
+    {
+        return HWC_PLAN_OK;
+    }
+
+    reason_x = hwc_plan_clamp_axis(&plan->crop.left, &plan->crop.right,
+        &plan->frame.left, &plan->frame.right, HWC_PLAN_SCALER_MAX_SRC_WIDTH);
+    reason_y = hwc_plan_clamp_axis(&plan->crop.top, &plan->crop.bottom,
+        &plan->frame.top, &plan->frame.bottom, 0);
+    return (reason_x != HWC_PLAN_OK) ? reason_x : reason_y;
+}
+
+static int hwc_plan_check_video(const hwc_plan_config_t *config, const hwc_layer_t *layer)
+{
+    int screen_idx;
+
+    if(layer->flags & HWC_SKIP_LAYER)
+    {
+        return HWC_PLAN_SKIP;
+    }
+
+    //each screen showing the video needs its own scaler
+    if(hwc_plan_screens(config->screens) > config->free_scalers)
+    {
+        return HWC_PLAN_NO_SCALER;
+    }
+    for(screen_idx=0; screen_idx<2; screen_idx++)
+    {
+        if((config->screens & (1 << screen_idx)) && config->free_layers[screen_idx] < 1)
+        {
+            return HWC_PLAN_NO_LAYER;
+        }
+    }
+
+    return HWC_PLAN_OK;
+}
+
+int hwc_plan_layers(const hwc_plan_config_t *config, hwc_layer_list_t *list, hwc_plan_t *plan)
+{
+    int overlays = 0;
+
+    memset(plan, 0, sizeof(hwc_plan_t));
+    plan->num_layers = list->numHwLayers;
+    plan->video = -1;
+
+    for (size_t i=0 ; i<list->numHwLayers ; i++)
+    {
+        hwc_layer_t *layer = &list->hwLayers[i];
+        int reason;
+
+        if(!hwc_plan_is_video(layer->format))
+        {
+            layer->compositionType = HWC_FRAMEBUFFER;
+            reason = HWC_PLAN_GPU;
+        }
+        else if(plan->video >= 0)
+        {
+            //one video layer: a second video is not shown at all, the GPU
+            //can not draw it either, hwc_prepare warns about it
+            layer->compositionType = HWC_OVERLAY;
+            reason = HWC_PLAN_VIDEO_BUSY;
+            overlays++;
+        }
+        else
+        {
+            int clamp = hwc_plan_window(layer, plan);
+
+            layer->compositionType = HWC_OVERLAY;
+            plan->video = i;
+            reason = (clamp != HWC_PLAN_OK) ? clamp : hwc_plan_check_video(config, layer);
+            overlays++;
+        }
+
+        if(i < HWC_PLAN_MAX_LAYERS)
+        {
+            plan->reason[i] = reason;
+        }
+    }
+
+    return overlays;
+}
+
+bool hwc_plan_same(const hwc_plan_t *a, const hwc_plan_t *b)
+{
+    int num = a->num_layers < HWC_PLAN_MAX_LAYERS ? a->num_layers : HWC_PLAN_MAX_LAYERS;
+
+    if(a->num_layers != b->num_layers || a->video != b->video)
+    {
+        return false;
+    }
+    return memcmp(a->reason, b->reason, num) == 0;
+}
+
+const char *hwc_plan_reason_str(int reason)
+{
+    if(reason < 0 || reason >= HWC_PLAN_REASON_NUM)
+    {
+        return "unknown";
+    }
+    return hwc_plan_reasons[reason];
+}
@@ -0,0 +1,59 @@
+#ifndef __HWC_PLANNER_H__
+#define __HWC_PLANNER_H__
+
+#include <stdint.h>
+
+#include <hardware/hwcomposer.h>
+
+//sun4i display engine: two front end scalers shared by the screens, four
+//layers in the back end of each screen
+#define HWC_PLAN_SCALERS                2
+#define HWC_PLAN_LAYERS_PER_SCREEN      4
+#define HWC_PLAN_SCALER_MAX_SRC_WIDTH   2048    //scaler line buffer
+#define HWC_PLAN_SCALER_MAX_DOWNSCALE   16
+#define HWC_PLAN_SCALER_MAX_UPSCALE     32
+#define HWC_PLAN_MAX_LAYERS             16      //layers a plan keeps a reason for
+
+//why a layer is where it is, for the log only: every video layer stays an
+//overlay, the GPU can not draw its buffers
+enum
+{
+    HWC_PLAN_OK                 = 0,    //on the video layer
+    HWC_PLAN_GPU,                       //RGB, composed by the GPU into the framebuffer
+    HWC_PLAN_SKIP,                      //on the video layer, flagged HWC_SKIP_LAYER
+    HWC_PLAN_CLAMP_SRC_SIZE,            //on the video layer, source cropped to the scaler line buffer
+    HWC_PLAN_CLAMP_SCALE,               //on the video layer, window clamped to the scaler range
+    HWC_PLAN_NO_SCALER,                 //on the video layer, the framebuffers took the scalers
+    HWC_PLAN_NO_LAYER,                  //on the video layer, the framebuffers took the layers
+    HWC_PLAN_VIDEO_BUSY,                //overlay not shown, the video layer shows another layer
+    HWC_PLAN_REASON_NUM,
+};
+
+typedef struct hwc_plan_config
+{
+    uint32_t                screens;            //bit n: the video layer is shown on screen n
+    int                     width;              //size of the screen the list is laid out on
+    int                     height;
+    int                     free_scalers;       //scalers the framebuffers left
+    int                     free_layers[2];     //layers the framebuffers left, per screen
+}hwc_plan_config_t;
+
+typedef struct hwc_plan
+{
+    int                     num_layers;
+    int                     video;              //layer on the video layer, -1 if none
+    hwc_rect_t              crop;               //scaler window of the video layer, in the
+    hwc_rect_t              frame;              //scaler range
+    uint8_t                 reason[HWC_PLAN_MAX_LAYERS];
+}hwc_plan_t;
+
+//decides the composition type of every layer of 'list' and fills 'plan';
+//returns the number of overlays
+extern int hwc_plan_layers(const hwc_plan_config_t *config, hwc_layer_list_t *list, hwc_plan_t *plan);
+
+//true when 'a' and 'b' make the same decisions for the same layers
+extern bool hwc_plan_same(const hwc_plan_t *a, const hwc_plan_t *b);
+
+extern const char *hwc_plan_reason_str(int reason);
+
+#endif
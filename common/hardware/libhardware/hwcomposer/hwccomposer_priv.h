@@ -5,6 +5,7 @@
 
 #include <fcntl.h>
 #include <errno.h>
+#include <pthread.h>
 
 #include <cutils/log.h>
 #include <cutils/atomic.h>
@@ -13,6 +14,8 @@
 
 #include <EGL/egl.h>
 
+#include "hwc_planner.h"
+
 enum
 {
     HWC_STATUS_HAVE_FRAME       = 1,
@@ -21,6 +24,129 @@ enum
     HWC_STATUS_ALLOW_TO_OPEN    = 8,
 };
 
+/* what the driver was last given for the video layer of a screen, so that
+ * hwc_set only pushes the windows that changed */
+typedef struct hwc_layer_shadow
+{
+    bool                    valid;
+    uint32_t                hdl;        // layer the info belongs to
+    __disp_layer_info_t     info;
+}hwc_layer_shadow_t;
+
+/* xres / yres of a framebuffer, read once with FBIOGET_VSCREENINFO */
+typedef struct hwc_fb_shadow
+{
+    bool                    valid;
+    uint32_t                xres;
+    uint32_t                yres;
+}hwc_fb_shadow_t;
+
+/* sourceCrop / displayFrame of the video layer that the layer shadows of
+ * the screens were computed from */
+typedef struct hwc_rect_shadow
+{
+    bool                    valid;
+    hwc_rect_t              crop;
+    hwc_rect_t              frame;
+}hwc_rect_shadow_t;
+
+/* the frame the video layer of a screen was given and the one it shows, so
+ * that each screen is updated and released on its own when mirroring. A
+ * screen that lags is parked: its video layer is closed and given no frame
+ * until the video layer is set up again, so the buffers can be released
+ * without it */
+#define HWC_MIRROR_LAG_US       100000  // a screen this late on its frame is lagging
+
+typedef struct hwc_screen_frame
+{
+    bool                    valid;
+    __disp_video_fb_t       fb;             // last DISP_CMD_VIDEO_SET_FB
+    int                     id_shown;       // DISP_CMD_VIDEO_GET_FRAME_ID
+    int64_t                 id_changed;     // us, when id_shown last moved
+    bool                    parked;         // lagged, video layer closed, left out of the release id
+}hwc_screen_frame_t;
+
+#define HWC_STATS_IOCTL_CMDS    32      // display commands counted one by one
+#define HWC_STATS_SAMPLES       128     // rolling window of the histograms
+
+typedef struct hwc_ioctl_count
+{
+    uint32_t                cmd;
+    uint32_t                count;
+}hwc_ioctl_count_t;
+
+typedef struct hwc_stats
+{
+    uint32_t                sets;           // hwc_set calls
+    uint32_t                ioctls;         // display ioctls made by hwc_set
+    uint32_t                ioctls_saved;   // ioctls the shadow state avoided
+    int64_t                 set_time;       // us in hwc_set, without eglSwapBuffers
+    int64_t                 set_time_max;
+    int64_t                 swap_time;      // us in eglSwapBuffers
+    int64_t                 swap_time_max;
+    uint32_t                log_every;      // debug.hwc.stats, 0: no log
+    uint32_t                layers_overlay; // layers hwc_prepare put on the video layer
+    uint32_t                layers_fb;      // layers it left to the GPU
+    uint32_t                frames_set;     // video frames given to the display
+    uint32_t                frames_shown;   // new ids seen with DISP_CMD_VIDEO_GET_FRAME_ID
+    int                     last_frame_id;
+    int64_t                 last_frame_time;
+    uint32_t                mode_switches;  // HWC_LAYER_SETMODE that changed the mode
+    uint32_t                screen_changes; // HWC_LAYER_SET_SCREEN_PARA
+    hwc_ioctl_count_t       ioctl_cmds[HWC_STATS_IOCTL_CMDS];   // every ioctl on /dev/disp
+    uint32_t                ioctl_other;    // commands that found the table full
+    int32_t                 set_samples[HWC_STATS_SAMPLES];     // us, hwc_set with eglSwapBuffers
+    uint32_t                set_sample_num;
+    int32_t                 frame_samples[HWC_STATS_SAMPLES];   // us between two video frames
+    uint32_t                frame_sample_num;
+}hwc_stats_t;
+
+/* hwc_getparameter queries, next to the HWC_LAYER_* parameters of
+ * hardware/hwcomposer.h */
+enum
+{
+    HWC_STATS_GET_SETS          = 0x1000,
+    HWC_STATS_GET_SET_TIME_AVG,         // us, hwc_set without eglSwapBuffers
+    HWC_STATS_GET_SET_TIME_MAX,
+    HWC_STATS_GET_SWAP_TIME_AVG,        // us, eglSwapBuffers
+    HWC_STATS_GET_SWAP_TIME_MAX,
+    HWC_STATS_GET_IOCTLS,               // all the ioctls on /dev/disp
+    HWC_STATS_GET_LAYERS_OVERLAY,
+    HWC_STATS_GET_LAYERS_FB,
+    HWC_STATS_GET_FRAMES_SET,
+    HWC_STATS_GET_FRAMES_SHOWN,
+    HWC_STATS_GET_FRAMES_DROPPED,       // by the frame queue
+    HWC_STATS_GET_MODE_SWITCHES,
+};
+
+#define HWC_FRAME_QUEUE_DEPTH   4
+
+typedef struct hwc_queued_frame
+{
+    libhwclayerpara_t       para;
+    int64_t                 pts;            // us, CLOCK_MONOTONIC
+}hwc_queued_frame_t;
+
+/* frames of hwc_set_frame_para, put on the video layer at vsync by a thread
+ * instead of from the caller's binder thread */
+typedef struct hwc_frame_queue
+{
+    bool                    running;
+    bool                    quit;
+    pthread_t               thread;
+    pthread_cond_t          cond;
+    hwc_queued_frame_t      frames[HWC_FRAME_QUEUE_DEPTH];
+    int                     head;
+    int                     count;
+    int64_t                 last_pts;
+    int64_t                 period;         // us between vsyncs
+    bool                    vsync_ioctl;    // FBIO_WAITFORVSYNC works
+    uint32_t                shown;
+    uint32_t                early;          // queued more than a period ahead of their time
+    uint32_t                late;           // shown more than a vsync after their time
+    uint32_t                dropped;        // replaced by a newer frame before shown
+}hwc_frame_queue_t;
+
 typedef struct hwc_context_t 
 {
     hwc_composer_device_t 	device;
@@ -48,6 +174,15 @@ typedef struct hwc_context_t
     bool					cur_3denable;
 	libhwclayerpara_t       cur_frame_para;
 	bool					b_video_in_valid_area;
+	hwc_layer_shadow_t      layer_shadow[2];
+	hwc_fb_shadow_t         fb_shadow[2];
+	hwc_rect_shadow_t       rect_shadow;
+	hwc_screen_frame_t      screen_frame[2];
+	hwc_stats_t             stats;
+	bool                    fb_scaler[2];//framebuffer in scaler mode, from the init para
+	hwc_plan_t              plan;//last plan of hwc_prepare
+	pthread_mutex_t         lock;//hwc_set, hwc_prepare and hwc_setparameter against the frame queue
+	hwc_frame_queue_t       queue;
 }sun4i_hwc_context_t;
 
 #endif
@@ -32,6 +32,8 @@
 #include "hwccomposer_priv.h"
 #include <cutils/properties.h> 
 #include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
 
 /*****************************************************************************/
 static int hwc_device_open(const struct hw_module_t* module, const char* name,
@@ -56,6 +58,118 @@ hwc_module_t HAL_MODULE_INFO_SYM =
     }
 };
 
+static int64_t hwc_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+//every ioctl on /dev/disp goes through here, to be counted by command
+static int hwc_disp_ioctl(sun4i_hwc_context_t *ctx, unsigned long cmd, unsigned long *args)
+{
+    hwc_stats_t *stats = &ctx->stats;
+    int i;
+
+    for(i=0; i<HWC_STATS_IOCTL_CMDS; i++)
+    {
+        if(stats->ioctl_cmds[i].count == 0)
+        {
+            stats->ioctl_cmds[i].cmd = cmd;
+        }
+        if(stats->ioctl_cmds[i].cmd == cmd)
+        {
+            stats->ioctl_cmds[i].count++;
+            break;
+        }
+    }
+    if(i == HWC_STATS_IOCTL_CMDS)
+    {
+        stats->ioctl_other++;
+    }
+
+    return ioctl(ctx->dispfd, cmd, args);
+}
+
+//forget what the driver was given, the layers or the screens changed
+static void hwc_invalidate_shadow(sun4i_hwc_context_t *ctx)
+{
+    memset(ctx->layer_shadow, 0, sizeof(ctx->layer_shadow));
+    memset(ctx->fb_shadow, 0, sizeof(ctx->fb_shadow));
+    memset(&ctx->rect_shadow, 0, sizeof(ctx->rect_shadow));
+    memset(ctx->screen_frame, 0, sizeof(ctx->screen_frame));
+}
+
+static void hwc_get_fb_size(sun4i_hwc_context_t *ctx, int fb, int *width, int *height)
+{
+    hwc_fb_shadow_t *shadow = &ctx->fb_shadow[fb];
+
+    if(!shadow->valid)
+    {
+        struct fb_var_screeninfo    var;
+
+        ctx->stats.ioctls++;
+        if(ioctl(ctx->mFD_fb[fb], FBIOGET_VSCREENINFO, &var) == 0)
+        {
+            shadow->xres = var.xres;
+            shadow->yres = var.yres;
+            shadow->valid = true;
+        }
+    }
+    else
+    {
+        ctx->stats.ioctls_saved++;
+    }
+
+    *width = shadow->xres;
+    *height = shadow->yres;
+}
+
+static void hwc_add_sample(int32_t *samples, uint32_t *num, int64_t us)
+{
+    samples[*num % HWC_STATS_SAMPLES] = (us > 0x7fffffff) ? 0x7fffffff : (int32_t)us;
+    (*num)++;
+}
+
+static void hwc_update_stats(sun4i_hwc_context_t *ctx, int64_t swap_time, int64_t set_time)
+{
+    hwc_stats_t *stats = &ctx->stats;
+
+    stats->sets++;
+    stats->set_time += set_time;
+    if(set_time > stats->set_time_max)
+    {
+        stats->set_time_max = set_time;
+    }
+    stats->swap_time += swap_time;
+    if(swap_time > stats->swap_time_max)
+    {
+        stats->swap_time_max = swap_time;
+    }
+    hwc_add_sample(stats->set_samples, &stats->set_sample_num, swap_time + set_time);
+
+    if(stats->log_every != 0 && (stats->sets % stats->log_every) == 0)
+    {
+        LOGD("####hwc_set:%u calls, %u.%02u ioctls per call, %u saved, avg %lld us, max %lld us, eglSwapBuffers avg %lld us, max %lld us\n",
+            stats->sets, stats->ioctls / stats->sets, (stats->ioctls * 100 / stats->sets) % 100,
+            stats->ioctls_saved, stats->set_time / stats->sets, stats->set_time_max,
+            stats->swap_time / stats->sets, stats->swap_time_max);
+        if(ctx->queue.running)
+        {
+            LOGD("####frame queue:%u shown, %u early, %u late, %u dropped\n",
+                ctx->queue.shown, ctx->queue.early, ctx->queue.late, ctx->queue.dropped);
+        }
+    }
+}
+
+//forget the frames not shown yet, the video layer they were for is gone
+static void hwc_flush_frames(sun4i_hwc_context_t *ctx)
+{
+    ctx->queue.head = 0;
+    ctx->queue.count = 0;
+    ctx->queue.last_pts = 0;
+}
 
 static int hwc_release(sun4i_hwc_context_t *ctx)
 {
@@ -65,6 +179,17 @@ static int hwc_release(sun4i_hwc_context_t *ctx)
 
     LOGD("####hwc_release\n");
 
+    hwc_flush_frames(ctx);
+    if(ctx->queue.shown != 0)
+    {
+        LOGD("####frame queue:%u shown, %u early, %u late, %u dropped\n",
+            ctx->queue.shown, ctx->queue.early, ctx->queue.late, ctx->queue.dropped);
+        ctx->queue.shown = 0;
+        ctx->queue.early = 0;
+        ctx->queue.late = 0;
+        ctx->queue.dropped = 0;
+    }
+
     for(screen_idx=0; screen_idx<2; screen_idx++)
     {
         if(((screen_idx == 0) && (ctx->mode==HWC_MODE_SCREEN0 || ctx->mode==HWC_MODE_SCREEN0_AND_SCREEN1 || ctx->mode==HWC_MODE_SCREEN0_BE || ctx->mode==HWC_MODE_SCREEN0_GPU))
@@ -76,14 +201,14 @@ static int hwc_release(sun4i_hwc_context_t *ctx)
                 
                 args[0]                         = screen_idx;
                 args[1]                         = ctx->video_layerhdl[screen_idx];
-                ioctl(ctx->dispfd, DISP_CMD_LAYER_CLOSE,args);
+                hwc_disp_ioctl(ctx, DISP_CMD_LAYER_CLOSE, args);
 
                 args[0]                         = screen_idx;
                 args[1]                         = ctx->video_layerhdl[screen_idx];
-                ret = ioctl(ctx->dispfd, DISP_CMD_VIDEO_STOP, args);
+                ret = hwc_disp_ioctl(ctx, DISP_CMD_VIDEO_STOP, args);
 
                 args[0] = screen_idx;
-                hdmi_mode = (__disp_tv_mode_t)ioctl(ctx->dispfd,DISP_CMD_HDMI_GET_MODE,(unsigned long)args);
+                hdmi_mode = (__disp_tv_mode_t)hwc_disp_ioctl(ctx, DISP_CMD_HDMI_GET_MODE, args);
                 if(hdmi_mode == DISP_TV_MOD_1080P_24HZ_3D_FP || hdmi_mode == DISP_TV_MOD_720P_50HZ_3D_FP || hdmi_mode == DISP_TV_MOD_720P_60HZ_3D_FP)
                 {
                 	 __disp_layer_info_t         tmpLayerAttr;
@@ -91,7 +216,7 @@ static int hwc_release(sun4i_hwc_context_t *ctx)
                    args[0]                         = screen_idx;
                    args[1]                         = ctx->ui_layerhdl[screen_idx];
                    args[2]                         = (unsigned long) (&tmpLayerAttr);
-                   ret = ioctl(ctx->dispfd, DISP_CMD_LAYER_GET_PARA, args);
+                   ret = hwc_disp_ioctl(ctx, DISP_CMD_LAYER_GET_PARA, args);
 
                    tmpLayerAttr.scn_win.x = ctx->org_scn_win.x;
                    tmpLayerAttr.scn_win.y = ctx->org_scn_win.y;
@@ -101,23 +226,24 @@ static int hwc_release(sun4i_hwc_context_t *ctx)
                    args[0]                         = screen_idx;
                    args[1]                         = ctx->ui_layerhdl[screen_idx];
                    args[2]                         = (unsigned long) (&tmpLayerAttr);
-                   ret = ioctl(ctx->dispfd, DISP_CMD_LAYER_SET_PARA, args);
+                   ret = hwc_disp_ioctl(ctx, DISP_CMD_LAYER_SET_PARA, args);
                             
                     args[0] = screen_idx;
-                    ret = ioctl(ctx->dispfd,DISP_CMD_HDMI_OFF,(unsigned long)args);
+                    ret = hwc_disp_ioctl(ctx, DISP_CMD_HDMI_OFF, args);
             
                     args[0] = screen_idx;
                     args[1] = ctx->org_hdmi_mode;
-                    ioctl(ctx->dispfd,DISP_CMD_HDMI_SET_MODE,(unsigned long)args);
+                    hwc_disp_ioctl(ctx, DISP_CMD_HDMI_SET_MODE, args);
                     
                     args[0] = screen_idx;
-                    ret = ioctl(ctx->dispfd,DISP_CMD_HDMI_ON,(unsigned long)args);
+                    ret = hwc_disp_ioctl(ctx, DISP_CMD_HDMI_ON, args);
                 }
             }
         }
     }
     ctx->status[0] &= (~(HWC_STATUS_OPENED | HWC_STATUS_COMPOSITED));
     ctx->status[1] &= (~(HWC_STATUS_OPENED | HWC_STATUS_COMPOSITED));
+    hwc_invalidate_shadow(ctx);
     LOGV("####ctx->status[0]=%d in hwc_release", screen_idx,ctx->status[0]);
     LOGV("####ctx->status[1]=%d in hwc_release", screen_idx,ctx->status[1]);
     
@@ -128,11 +254,10 @@ static void hwc_computer_rect(sun4i_hwc_context_t *ctx, int screen_idx, hwc_rect
 {
     int							ret;
     unsigned long               args[4]={0};
-    unsigned int                screen_in_width;
-    unsigned int                screen_in_height;
+    int                         screen_in_width;
+    int                         screen_in_height;
     unsigned int temp_x,temp_y,temp_w,temp_h;
     int x,y,w,h,mid_x,mid_y;
-    struct fb_var_screeninfo    var;
 
     if(rect_in->left >= rect_in->right || rect_in->top >= rect_in->bottom)
     {
@@ -147,16 +272,7 @@ static void hwc_computer_rect(sun4i_hwc_context_t *ctx, int screen_idx, hwc_rect
     }
     else
     {
-        if(ctx->mode == HWC_MODE_SCREEN1)
-        {
-            ioctl(ctx->mFD_fb[1], FBIOGET_VSCREENINFO, &var);
-        }
-        else
-        {
-            ioctl(ctx->mFD_fb[0], FBIOGET_VSCREENINFO, &var);
-        }
-        screen_in_width                     = var.xres;
-        screen_in_height                    = var.yres;
+        hwc_get_fb_size(ctx, (ctx->mode == HWC_MODE_SCREEN1) ? 1 : 0, &screen_in_width, &screen_in_height);
     }
 
 
@@ -173,6 +289,12 @@ static void hwc_computer_rect(sun4i_hwc_context_t *ctx, int screen_idx, hwc_rect
     	return ;
     }
     
+    if(screen_in_width <= 0 || screen_in_height <= 0)
+    {
+        LOGV("screen size unknown in hwc_computer_rect\n");
+        return;
+    }
+
     temp_x = rect_in->left;
     temp_w = rect_in->right - rect_in->left;
     temp_y = rect_in->top;
@@ -198,7 +320,7 @@ static void hwc_computer_rect(sun4i_hwc_context_t *ctx, int screen_idx, hwc_rect
     {
     	if(!ctx->b_video_in_valid_area)
     	{
-        	if((screen_in_width == ctx->screen_para.width[screen_idx]) && (screen_in_height == ctx->screen_para.height[screen_idx]))
+        	if((screen_in_width == (int)ctx->screen_para.width[screen_idx]) && (screen_in_height == (int)ctx->screen_para.height[screen_idx]))
         	{
         	    rect_out->left = rect_in->left;
         	    rect_out->right = rect_in->right;
@@ -259,17 +381,25 @@ static int hwc_set_rect(hwc_composer_device_t *dev,hwc_layer_list_t* list)
     
 	for (size_t i=0 ; i<list->numHwLayers ; i++)         
     {         	  
-        if(list->hwLayers[i].compositionType == HWC_OVERLAY)
+        //hwc_prepare put at most one layer on the video layer
+        if((int)i == ctx->plan.video && list->hwLayers[i].compositionType == HWC_OVERLAY)
         {
             if((ctx->cur_3d_out == HWC_3D_OUT_MODE_2D) || (ctx->cur_3d_out == HWC_3D_OUT_MODE_ANAGLAGH) || (ctx->cur_3d_out == HWC_3D_OUT_MODE_ORIGINAL))
             {
                 hwc_rect_t croprect;
                 hwc_rect_t displayframe_src, displayframe_dst;
                 __disp_layer_info_t         layer_info;
+                bool                        rect_same;
 
-                memcpy(&croprect, &list->hwLayers[i].sourceCrop, sizeof(hwc_rect_t));
-                memcpy(&displayframe_src, &list->hwLayers[i].displayFrame, sizeof(hwc_rect_t));
+                //the window hwc_prepare clamped to the scaler range
+                memcpy(&croprect, &ctx->plan.crop, sizeof(hwc_rect_t));
+                memcpy(&displayframe_src, &ctx->plan.frame, sizeof(hwc_rect_t));
 
+                //the windows of a screen computed from this same geometry are
+                //still good, mirroring only redoes the screen that changed
+                rect_same = ctx->rect_shadow.valid
+                    && memcmp(&ctx->rect_shadow.crop, &croprect, sizeof(hwc_rect_t)) == 0
+                    && memcmp(&ctx->rect_shadow.frame, &displayframe_src, sizeof(hwc_rect_t)) == 0;
 
                 for(screen_idx=0; screen_idx<2; screen_idx++)
                 {
@@ -278,15 +408,15 @@ static int hwc_set_rect(hwc_composer_device_t *dev,hwc_layer_list_t* list)
                     {
                         int screen_in_width;
                         int screen_in_height;
-                        struct fb_var_screeninfo    var;
+                        __disp_rect_t               src_win;
+                        __disp_rect_t               scn_win;
+                        hwc_layer_shadow_t          *shadow = &ctx->layer_shadow[screen_idx];
 
-                        if(ctx->mode==HWC_MODE_SCREEN1)
-                        {
-                            ioctl(ctx->mFD_fb[1], FBIOGET_VSCREENINFO, &var);
-                        }
-                        else
+                        if(rect_same && shadow->valid && shadow->hdl == ctx->video_layerhdl[screen_idx])
                         {
-                            ioctl(ctx->mFD_fb[0], FBIOGET_VSCREENINFO, &var);
+                            ctx->stats.ioctls_saved += 2;
+                            ctx->status[screen_idx] |= HWC_STATUS_COMPOSITED;
+                            continue;
                         }
 
                         if(ctx->mode == HWC_MODE_SCREEN0_GPU)
@@ -296,8 +426,7 @@ static int hwc_set_rect(hwc_composer_device_t *dev,hwc_layer_list_t* list)
                         }
                         else
                         {
-                            screen_in_width                     = var.xres;
-                            screen_in_height                    = var.yres;
+                            hwc_get_fb_size(ctx, (ctx->mode==HWC_MODE_SCREEN1) ? 1 : 0, &screen_in_width, &screen_in_height);
                         }
 
                         LOGV("####0:hwc_set_rect, src_left:%d,src_top:%d,src_right:%d,src_bottom:%d,  dst_left:%d,dst_top:%d,dst_right:%d,dst_bottom:%d\n",
@@ -331,48 +460,96 @@ static int hwc_set_rect(hwc_composer_device_t *dev,hwc_layer_list_t* list)
                         LOGV("####2:hwc_set_rect, src_left:%d,src_top:%d,src_right:%d,src_bottom:%d,  dst_left:%d,dst_top:%d,dst_right:%d,dst_bottom:%d\n",
                             croprect.left,croprect.top,croprect.right,croprect.bottom,displayframe_dst.left,displayframe_dst.top,displayframe_dst.right,displayframe_dst.bottom);
 
-                    	args[0] 				= screen_idx;
-                    	args[1] 				= ctx->video_layerhdl[screen_idx];
-                    	args[2] 				= (unsigned long) (&layer_info);
-                    	args[3] 				= 0;
-                    	ret = ioctl(ctx->dispfd, DISP_CMD_LAYER_GET_PARA, args);
-                    	if(ret < 0)
-                    	{
-                    	    LOGV("####DISP_CMD_LAYER_GET_PARA fail in hwc_set_rect, screen_idx:%d,hdl:%d\n",screen_idx,ctx->video_layerhdl[screen_idx]);
-                    	}
-
-                    	layer_info.src_win.x = croprect.left;
-                    	layer_info.src_win.y = croprect.top;
-                    	layer_info.src_win.width = croprect.right - croprect.left;
-                    	layer_info.src_win.height = croprect.bottom - croprect.top;
+                    	src_win.x = croprect.left;
+                    	src_win.y = croprect.top;
+                    	src_win.width = croprect.right - croprect.left;
+                    	src_win.height = croprect.bottom - croprect.top;
                         if(ctx->cur_3d_out == HWC_3D_OUT_MODE_ANAGLAGH)
                         {
                             if(ctx->cur_3d_src == HWC_3D_SRC_MODE_SSF || ctx->cur_3d_src == HWC_3D_SRC_MODE_SSH)
                             {
-                                layer_info.src_win.x /=2;
-                                layer_info.src_win.width /=2;
+                                src_win.x /=2;
+                                src_win.width /=2;
                             }
                             if(ctx->cur_3d_src == HWC_3D_SRC_MODE_TB)
                             {
-                                layer_info.src_win.y /=2;
-                                layer_info.src_win.height /=2;
+                                src_win.y /=2;
+                                src_win.height /=2;
                             }
                         }
-                    	layer_info.scn_win.x = displayframe_dst.left;
-                    	layer_info.scn_win.y = displayframe_dst.top;
-                    	layer_info.scn_win.width = displayframe_dst.right - displayframe_dst.left;
-                    	layer_info.scn_win.height = displayframe_dst.bottom - displayframe_dst.top;
-                        
-                    	args[0] 				= screen_idx;
-                    	args[1] 				= ctx->video_layerhdl[screen_idx];
-                    	args[2] 				= (unsigned long) (&layer_info);
-                    	args[3] 				= 0;
-                    	ioctl(ctx->dispfd, DISP_CMD_LAYER_SET_PARA, args);
+                    	scn_win.x = displayframe_dst.left;
+                    	scn_win.y = displayframe_dst.top;
+                    	scn_win.width = displayframe_dst.right - displayframe_dst.left;
+                    	scn_win.height = displayframe_dst.bottom - displayframe_dst.top;
+
+                        if(shadow->valid && shadow->hdl == ctx->video_layerhdl[screen_idx])
+                        {
+                            //only push the windows that changed
+                            if(memcmp(&shadow->info.src_win, &src_win, sizeof(__disp_rect_t)) != 0)
+                            {
+                            	args[0] 				= screen_idx;
+                            	args[1] 				= ctx->video_layerhdl[screen_idx];
+                            	args[2] 				= (unsigned long) (&src_win);
+                            	args[3] 				= 0;
+                            	hwc_disp_ioctl(ctx, DISP_CMD_LAYER_SET_SRC_WINDOW, args);
+                                ctx->stats.ioctls++;
+                                shadow->info.src_win = src_win;
+                            }
+                            else
+                            {
+                                ctx->stats.ioctls_saved++;
+                            }
+
+                            if(memcmp(&shadow->info.scn_win, &scn_win, sizeof(__disp_rect_t)) != 0)
+                            {
+                            	args[0] 				= screen_idx;
+                            	args[1] 				= ctx->video_layerhdl[screen_idx];
+                            	args[2] 				= (unsigned long) (&scn_win);
+                            	args[3] 				= 0;
+                            	hwc_disp_ioctl(ctx, DISP_CMD_LAYER_SET_SCN_WINDOW, args);
+                                ctx->stats.ioctls++;
+                                shadow->info.scn_win = scn_win;
+                            }
+                            else
+                            {
+                                ctx->stats.ioctls_saved++;
+                            }
+                        }
+                        else
+                        {
+                        	args[0] 				= screen_idx;
+                        	args[1] 				= ctx->video_layerhdl[screen_idx];
+                        	args[2] 				= (unsigned long) (&layer_info);
+                        	args[3] 				= 0;
+                        	ret = hwc_disp_ioctl(ctx, DISP_CMD_LAYER_GET_PARA, args);
+                        	if(ret < 0)
+                        	{
+                        	    LOGV("####DISP_CMD_LAYER_GET_PARA fail in hwc_set_rect, screen_idx:%d,hdl:%d\n",screen_idx,ctx->video_layerhdl[screen_idx]);
+                        	}
+
+                            layer_info.src_win = src_win;
+                            layer_info.scn_win = scn_win;
+
+                        	args[0] 				= screen_idx;
+                        	args[1] 				= ctx->video_layerhdl[screen_idx];
+                        	args[2] 				= (unsigned long) (&layer_info);
+                        	args[3] 				= 0;
+                        	hwc_disp_ioctl(ctx, DISP_CMD_LAYER_SET_PARA, args);
+                            ctx->stats.ioctls += 2;
+
+                            memcpy(&shadow->info, &layer_info, sizeof(__disp_layer_info_t));
+                            shadow->hdl = ctx->video_layerhdl[screen_idx];
+                            shadow->valid = (ret >= 0);
+                        }
                     }
                     
                     ctx->status[screen_idx] |= HWC_STATUS_COMPOSITED;
                     LOGV("####ctx->status[%d]=%d in hwc_set_rect", screen_idx,ctx->status[screen_idx]);
                 }            
+
+                ctx->rect_shadow.crop = ctx->plan.crop;
+                ctx->rect_shadow.frame = ctx->plan.frame;
+                ctx->rect_shadow.valid = true;
                 
                 ctx->rect_in.left = list->hwLayers[i].sourceCrop.left;
                 ctx->rect_in.right = list->hwLayers[i].sourceCrop.right;
@@ -403,7 +580,8 @@ static int hwc_set_rect(hwc_composer_device_t *dev,hwc_layer_list_t* list)
 	    		    args[1] 					= ctx->video_layerhdl[screen_idx];
 	    		    args[2] 					= 0;
 	    		    args[3] 					= 0;
-	    		    ioctl(ctx->dispfd, DISP_CMD_LAYER_CLOSE,args);
+	    		    hwc_disp_ioctl(ctx, DISP_CMD_LAYER_CLOSE, args);
+	    		    ctx->stats.ioctls++;
 
 	    		    ctx->status[screen_idx] &= (~HWC_STATUS_OPENED);
 	    		    //LOGV("####ctx->status[%d]=%d in hwc_set_rect", screen_idx,ctx->status[screen_idx]);
@@ -411,7 +589,8 @@ static int hwc_set_rect(hwc_composer_device_t *dev,hwc_layer_list_t* list)
             }
 			else
 			{
-	            if((ctx->status[screen_idx] & (HWC_STATUS_OPENED | HWC_STATUS_HAVE_FRAME)) == HWC_STATUS_HAVE_FRAME)
+	            if((ctx->status[screen_idx] & (HWC_STATUS_OPENED | HWC_STATUS_HAVE_FRAME)) == HWC_STATUS_HAVE_FRAME
+	                && !ctx->screen_frame[screen_idx].parked)
 	            {
 	                //LOGD("####open layer in hwc_set_rect ............");
 	            
@@ -419,7 +598,8 @@ static int hwc_set_rect(hwc_composer_device_t *dev,hwc_layer_list_t* list)
 	    		    args[1] 					= ctx->video_layerhdl[screen_idx];
 	    		    args[2] 					= 0;
 	    		    args[3] 					= 0;
-	    		    ioctl(ctx->dispfd, DISP_CMD_LAYER_OPEN,args);
+	    		    hwc_disp_ioctl(ctx, DISP_CMD_LAYER_OPEN, args);
+	    		    ctx->stats.ioctls++;
 
 	    		    ctx->status[screen_idx] |= HWC_STATUS_OPENED;
 	    		    //LOGV("####ctx->status[%d]=%d in hwc_set_rect", screen_idx,ctx->status[screen_idx]);
@@ -447,6 +627,8 @@ static int hwc_set_init_para(sun4i_hwc_context_t *ctx,uint32_t value,int alway_u
 
     LOGD("####hwc_set_init_para,mode:%d,w:%d,h:%d,format:%d\n",ctx->mode,layer_info->w,layer_info->h,layer_info->format);
 
+    hwc_flush_frames(ctx);
+
 	ctx->status[0] &= (~(HWC_STATUS_OPENED | HWC_STATUS_HAVE_FRAME | HWC_STATUS_COMPOSITED));
 	ctx->status[1] &= (~(HWC_STATUS_OPENED | HWC_STATUS_HAVE_FRAME | HWC_STATUS_COMPOSITED));
 	//LOGV("####ctx->status[0]=%d in hwc_set_init_para", ctx->status[0]);
@@ -527,11 +709,11 @@ static int hwc_set_init_para(sun4i_hwc_context_t *ctx,uint32_t value,int alway_u
         {
             args[0]                         = screen_idx;
             args[1]                         = ctx->video_layerhdl[screen_idx];
-            ret = ioctl(ctx->dispfd, DISP_CMD_VIDEO_STOP, args);
+            ret = hwc_disp_ioctl(ctx, DISP_CMD_VIDEO_STOP, args);
             
             args[0]                         = screen_idx;
             args[1]                         = ctx->video_layerhdl[screen_idx];
-            ioctl(ctx->dispfd, DISP_CMD_LAYER_RELEASE,args);
+            hwc_disp_ioctl(ctx, DISP_CMD_LAYER_RELEASE, args);
 
             ctx->video_layerhdl[screen_idx] = 0;
         }
@@ -543,10 +725,11 @@ static int hwc_set_init_para(sun4i_hwc_context_t *ctx,uint32_t value,int alway_u
             hwc_rect_t rect_out;
                         
             args[0]                         = screen_idx;
-            ctx->video_layerhdl[screen_idx]          = (uint32_t)ioctl(ctx->dispfd, DISP_CMD_LAYER_REQUEST,args);
+            ctx->video_layerhdl[screen_idx]          = (uint32_t)hwc_disp_ioctl(ctx, DISP_CMD_LAYER_REQUEST, args);
             if(ctx->video_layerhdl[screen_idx] == 0)
             {
                 LOGE("request layer failed!\n");
+                hwc_invalidate_shadow(ctx);
                 return -1;
             }
 
@@ -570,11 +753,11 @@ static int hwc_set_init_para(sun4i_hwc_context_t *ctx,uint32_t value,int alway_u
         	args[1] 						= ctx->video_layerhdl[screen_idx];
         	args[2] 						= (unsigned long) (&tmpLayerAttr);
         	args[3] 						= 0;
-        	ioctl(ctx->dispfd, DISP_CMD_LAYER_SET_PARA, args);
+        	hwc_disp_ioctl(ctx, DISP_CMD_LAYER_SET_PARA, args);
 
             args[0]                         = screen_idx;
             args[1]                         = ctx->video_layerhdl[screen_idx];
-            ioctl(ctx->dispfd, DISP_CMD_LAYER_BOTTOM, args);
+            hwc_disp_ioctl(ctx, DISP_CMD_LAYER_BOTTOM, args);
             
             ck.ck_min.alpha                 = 0xff;
             ck.ck_min.red                   = 0x00; //0x01;
@@ -590,17 +773,17 @@ static int hwc_set_init_para(sun4i_hwc_context_t *ctx,uint32_t value,int alway_u
             ck.blue_match_rule              = 2;
             args[0]                         = screen_idx;
             args[1]                         = (unsigned long)&ck;
-            ioctl(ctx->dispfd,DISP_CMD_SET_COLORKEY,(void*)args);
+            hwc_disp_ioctl(ctx, DISP_CMD_SET_COLORKEY, args);
 
             args[0]                         = screen_idx;
             args[1]                         = ctx->ui_layerhdl[screen_idx];
-            ioctl(ctx->dispfd,DISP_CMD_LAYER_CK_OFF,(void*)args);
+            hwc_disp_ioctl(ctx, DISP_CMD_LAYER_CK_OFF, args);
 
         	args[0] 						= screen_idx;
         	args[1] 						= ctx->ui_layerhdl[screen_idx];
         	args[2] 						= (unsigned long) (&tmpLayerAttr);
         	args[3] 						= 0;
-        	ret = ioctl(ctx->dispfd, DISP_CMD_LAYER_GET_PARA, args);
+        	ret = hwc_disp_ioctl(ctx, DISP_CMD_LAYER_GET_PARA, args);
             if(ret < 0)
             {
                 LOGD("####DISP_CMD_LAYER_GET_PARA fail in hwc_set_init_para, screen_idx:%d,hdl:%d\n",screen_idx,ctx->ui_layerhdl[screen_idx]);
@@ -610,18 +793,18 @@ static int hwc_set_init_para(sun4i_hwc_context_t *ctx,uint32_t value,int alway_u
             {
                 args[0]                         = screen_idx;
                 args[1]                         = ctx->video_layerhdl[screen_idx];
-                ioctl(ctx->dispfd,DISP_CMD_LAYER_CK_ON,(void*)args);
+                hwc_disp_ioctl(ctx, DISP_CMD_LAYER_CK_ON, args);
             }
             else
             {
                 args[0]                         = screen_idx;
                 args[1]                         = ctx->video_layerhdl[screen_idx];
-                ioctl(ctx->dispfd,DISP_CMD_LAYER_CK_OFF,(void*)args);
+                hwc_disp_ioctl(ctx, DISP_CMD_LAYER_CK_OFF, args);
             }
 
             args[0]                         = screen_idx;
             args[1]                         = ctx->ui_layerhdl[screen_idx];
-            ioctl(ctx->dispfd, DISP_CMD_LAYER_ALPHA_OFF, args);
+            hwc_disp_ioctl(ctx, DISP_CMD_LAYER_ALPHA_OFF, args);
         }
     }
     
@@ -630,40 +813,50 @@ static int hwc_set_init_para(sun4i_hwc_context_t *ctx,uint32_t value,int alway_u
     ctx->h = layer_info->h;
     ctx->format = layer_info->format;
     ctx->screenid = layer_info->screenid;
+    hwc_invalidate_shadow(ctx);
 
 	return 0;
 }
 
-static int hwc_set_frame_para(sun4i_hwc_context_t *ctx,uint32_t value)
+static int hwc_show_frame(sun4i_hwc_context_t *ctx,libhwclayerpara_t *overlaypara)
 {
     __disp_video_fb_t      		tmpFrmBufAddr;
-    libhwclayerpara_t            *overlaypara;
     int                         ret;
     int                         screen_idx;
     unsigned long               args[4]={0};
+    bool                        sent = false;
+
+	//LOGV("####hwc_show_frame,frame_id:%d\n",overlaypara->number);
+
+    //the same for every screen, built once
+    memset(&tmpFrmBufAddr, 0, sizeof(__disp_video_fb_t));
+	tmpFrmBufAddr.interlace         = (overlaypara->bProgressiveSrc?0:1);
+	tmpFrmBufAddr.top_field_first   = overlaypara->bTopFieldFirst;
+	tmpFrmBufAddr.addr[0]           = overlaypara->top_y;
+	tmpFrmBufAddr.addr[1]           = overlaypara->top_c;
+	tmpFrmBufAddr.addr[2]			= overlaypara->bottom_y;
+	tmpFrmBufAddr.addr_right[0]     = overlaypara->bottom_y;
+	tmpFrmBufAddr.addr_right[1]     = overlaypara->bottom_c;
+	tmpFrmBufAddr.addr_right[2]	    = 0;
+	tmpFrmBufAddr.id                = overlaypara->number; 
+	tmpFrmBufAddr.maf_valid         = overlaypara->maf_valid;
+	tmpFrmBufAddr.pre_frame_valid   = overlaypara->pre_frame_valid;
+	tmpFrmBufAddr.flag_addr         = overlaypara->flag_addr;
+	tmpFrmBufAddr.flag_stride       = overlaypara->flag_stride;
     
     for(screen_idx=0; screen_idx<2; screen_idx++)
     {
         if(((screen_idx == 0) && (ctx->mode==HWC_MODE_SCREEN0 || ctx->mode==HWC_MODE_SCREEN0_FE_VAR || ctx->mode==HWC_MODE_SCREEN0_AND_SCREEN1 || ctx->mode==HWC_MODE_SCREEN0_BE || ctx->mode==HWC_MODE_SCREEN0_GPU))
             || ((screen_idx == 1) && (ctx->mode==HWC_MODE_SCREEN1 || ctx->mode==HWC_MODE_SCREEN0_TO_SCREEN1 || ctx->mode==HWC_MODE_SCREEN0_AND_SCREEN1)))
         {
-            overlaypara                     = (libhwclayerpara_t *)value;
-
-			//LOGV("####hwc_set_frame_para,frame_id:%d\n",overlaypara->number);
-
-        	tmpFrmBufAddr.interlace         = (overlaypara->bProgressiveSrc?0:1);
-        	tmpFrmBufAddr.top_field_first   = overlaypara->bTopFieldFirst;
-        	tmpFrmBufAddr.addr[0]           = overlaypara->top_y;
-        	tmpFrmBufAddr.addr[1]           = overlaypara->top_c;
-        	tmpFrmBufAddr.addr[2]			= overlaypara->bottom_y;
-        	tmpFrmBufAddr.addr_right[0]     = overlaypara->bottom_y;
-        	tmpFrmBufAddr.addr_right[1]     = overlaypara->bottom_c;
-        	tmpFrmBufAddr.addr_right[2]	    = 0;
-        	tmpFrmBufAddr.id                = overlaypara->number; 
-        	tmpFrmBufAddr.maf_valid         = overlaypara->maf_valid;
-        	tmpFrmBufAddr.pre_frame_valid   = overlaypara->pre_frame_valid;
-        	tmpFrmBufAddr.flag_addr         = overlaypara->flag_addr;
-        	tmpFrmBufAddr.flag_stride       = overlaypara->flag_stride;
+            hwc_screen_frame_t          *frame = &ctx->screen_frame[screen_idx];
+
+            //a parked screen must not be given buffers, they are released
+            //without it
+            if(frame->parked)
+            {
+                continue;
+            }
 
         	if((ctx->status[screen_idx] & HWC_STATUS_HAVE_FRAME) == 0)
         	{
@@ -675,7 +868,7 @@ static int hwc_set_frame_para(sun4i_hwc_context_t *ctx,uint32_t value)
             	args[1] 				= ctx->video_layerhdl[screen_idx];
             	args[2] 				= (unsigned long) (&layer_info);
             	args[3] 				= 0;
-            	ret = ioctl(ctx->dispfd, DISP_CMD_LAYER_GET_PARA, args);
+            	ret = hwc_disp_ioctl(ctx, DISP_CMD_LAYER_GET_PARA, args);
                 if(ret < 0)
                 {
                     LOGD("####DISP_CMD_LAYER_GET_PARA fail in hwc_set_frame_para, screen_idx:%d,hdl:%d\n",screen_idx,ctx->video_layerhdl[screen_idx]);
@@ -692,11 +885,11 @@ static int hwc_set_frame_para(sun4i_hwc_context_t *ctx,uint32_t value)
             	args[1] 				= ctx->video_layerhdl[screen_idx];
             	args[2] 				= (unsigned long) (&layer_info);
             	args[3] 				= 0;
-            	ret = ioctl(ctx->dispfd, DISP_CMD_LAYER_SET_PARA, args);
+            	ret = hwc_disp_ioctl(ctx, DISP_CMD_LAYER_SET_PARA, args);
             	
                 args[0]                         = screen_idx;
                 args[1]                         = ctx->video_layerhdl[screen_idx];
-                ret = ioctl(ctx->dispfd, DISP_CMD_VIDEO_START, args);
+                ret = hwc_disp_ioctl(ctx, DISP_CMD_VIDEO_START, args);
         	}
 
             //have been composited,and have not been opened
@@ -708,28 +901,246 @@ static int hwc_set_frame_para(sun4i_hwc_context_t *ctx,uint32_t value)
         		args[1] 					= ctx->video_layerhdl[screen_idx];
         		args[2] 					= 0;
         		args[3] 					= 0;
-        		ioctl(ctx->dispfd, DISP_CMD_LAYER_OPEN,args);
+        		hwc_disp_ioctl(ctx, DISP_CMD_LAYER_OPEN, args);
 
         		ctx->status[screen_idx] |= HWC_STATUS_OPENED;
         		LOGV("####ctx->status[%d]=%d in hwc_set_frame_para", screen_idx,ctx->status[screen_idx]);
         	}
 
-        	args[0]					= screen_idx;
-            args[1]                 = ctx->video_layerhdl[screen_idx];
-        	args[2]                 = (unsigned long)(&tmpFrmBufAddr);
-        	args[3]                 = 0;
-        	ret = ioctl(ctx->dispfd, DISP_CMD_VIDEO_SET_FB,args);
-            LOGV("####DISP_CMD_VIDEO_SET_FB,%d,%d,ret:%d\n", screen_idx,ctx->video_layerhdl[screen_idx],ret);
+            //a screen that has this frame already is left alone
+            if(frame->valid && memcmp(&frame->fb, &tmpFrmBufAddr, sizeof(__disp_video_fb_t)) == 0)
+            {
+                LOGV("####frame %d already on screen %d\n", tmpFrmBufAddr.id, screen_idx);
+            }
+            else
+            {
+            	args[0]					= screen_idx;
+                args[1]                 = ctx->video_layerhdl[screen_idx];
+            	args[2]                 = (unsigned long)(&tmpFrmBufAddr);
+            	args[3]                 = 0;
+            	ret = hwc_disp_ioctl(ctx, DISP_CMD_VIDEO_SET_FB, args);
+                LOGV("####DISP_CMD_VIDEO_SET_FB,%d,%d,ret:%d\n", screen_idx,ctx->video_layerhdl[screen_idx],ret);
+
+                memcpy(&frame->fb, &tmpFrmBufAddr, sizeof(__disp_video_fb_t));
+                frame->valid = (ret >= 0);
+                sent = true;
+            }
         
             memcpy(&ctx->cur_frame_para, overlaypara,sizeof(libhwclayerpara_t));
         }
         ctx->status[screen_idx] |= HWC_STATUS_HAVE_FRAME;
         LOGV("####ctx->status[%d]=%d in hwc_set_frame_para 1", screen_idx,ctx->status[screen_idx]);
     }
+
+    if(sent)
+    {
+        int64_t now = hwc_now_us();
+
+        ctx->stats.frames_set++;
+        if(ctx->stats.last_frame_time != 0)
+        {
+            hwc_add_sample(ctx->stats.frame_samples, &ctx->stats.frame_sample_num, now - ctx->stats.last_frame_time);
+        }
+        ctx->stats.last_frame_time = now;
+    }
     
     return 0;
 }
 
+static int64_t hwc_wait_vsync(sun4i_hwc_context_t *ctx)
+{
+    hwc_frame_queue_t           *queue = &ctx->queue;
+    int                         fb = (ctx->mode == HWC_MODE_SCREEN1 || ctx->mode == HWC_MODE_SCREEN0_TO_SCREEN1) ? 1 : 0;
+    unsigned int                crtc = 0;
+    int64_t                     now;
+
+    if(queue->vsync_ioctl)
+    {
+        if(ioctl(ctx->mFD_fb[fb], FBIO_WAITFORVSYNC, &crtc) == 0)
+        {
+            return hwc_now_us();
+        }
+        LOGW("####FBIO_WAITFORVSYNC fail, timing the frame queue with a timer\n");
+        queue->vsync_ioctl = false;
+    }
+
+    now = hwc_now_us();
+    usleep(queue->period - now % queue->period);
+    return hwc_now_us();
+}
+
+//put the newest frame that is due by 'vsync' on the video layer,
+//called with ctx->lock held
+static void hwc_frame_queue_submit(sun4i_hwc_context_t *ctx, int64_t vsync)
+{
+    hwc_frame_queue_t           *queue = &ctx->queue;
+    hwc_queued_frame_t          *frame = NULL;
+    //due when it would be late at the next vsync
+    int64_t                     due = vsync + queue->period / 2;
+
+    while(queue->count > 0 && queue->frames[queue->head].pts <= due)
+    {
+        if(frame != NULL)
+        {
+            queue->dropped++;
+        }
+        frame = &queue->frames[queue->head];
+        queue->head = (queue->head + 1) % HWC_FRAME_QUEUE_DEPTH;
+        queue->count--;
+    }
+
+    if(frame == NULL)
+    {
+        return;
+    }
+
+    if(vsync - frame->pts > queue->period)
+    {
+        queue->late++;
+    }
+    queue->shown++;
+    hwc_show_frame(ctx, &frame->para);
+}
+
+static void *hwc_frame_queue_loop(void *arg)
+{
+    sun4i_hwc_context_t         *ctx = (sun4i_hwc_context_t *)arg;
+    hwc_frame_queue_t           *queue = &ctx->queue;
+    int64_t                     vsync;
+    int64_t                     last_vsync = 0;
+
+    pthread_mutex_lock(&ctx->lock);
+    while(!queue->quit)
+    {
+        if(queue->count == 0)
+        {
+            pthread_cond_wait(&queue->cond, &ctx->lock);
+            last_vsync = 0;
+            continue;
+        }
+
+        pthread_mutex_unlock(&ctx->lock);
+        vsync = hwc_wait_vsync(ctx);
+        pthread_mutex_lock(&ctx->lock);
+
+        //two vsyncs in a row give the refresh period of the screen
+        if(last_vsync != 0 && vsync - last_vsync > 8000 && vsync - last_vsync < 45000)
+        {
+            queue->period = vsync - last_vsync;
+        }
+        last_vsync = vsync;
+
+        hwc_frame_queue_submit(ctx, vsync);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+
+    return NULL;
+}
+
+//called with ctx->lock held
+static int hwc_queue_frame(sun4i_hwc_context_t *ctx, libhwclayerpara_t *overlaypara)
+{
+    hwc_frame_queue_t           *queue = &ctx->queue;
+    hwc_queued_frame_t          *frame;
+    int64_t                     now = hwc_now_us();
+    int64_t                     pts = now;
+
+    if(queue->count == HWC_FRAME_QUEUE_DEPTH)
+    {
+        //the display is behind, the newest frame is replaced so that the
+        //older ones still come due
+        frame = &queue->frames[(queue->head + queue->count - 1) % HWC_FRAME_QUEUE_DEPTH];
+        memcpy(&frame->para, overlaypara, sizeof(libhwclayerpara_t));
+        queue->dropped++;
+        return 0;
+    }
+
+    //a burst of frames is spread at the frame rate, delaying none of them by
+    //more than two frames
+    if(overlaypara->pVideoInfo.frame_rate >= 1000 && overlaypara->pVideoInfo.frame_rate <= 120000)
+    {
+        int64_t frame_period = 1000000000LL / overlaypara->pVideoInfo.frame_rate;
+
+        if(queue->last_pts + frame_period > pts)
+        {
+            pts = queue->last_pts + frame_period;
+            if(pts > now + frame_period * 2)
+            {
+                pts = now + frame_period * 2;
+            }
+        }
+    }
+
+    frame = &queue->frames[(queue->head + queue->count) % HWC_FRAME_QUEUE_DEPTH];
+    memcpy(&frame->para, overlaypara, sizeof(libhwclayerpara_t));
+    frame->pts = pts;
+    queue->count++;
+    if(pts - now > queue->period)
+    {
+        queue->early++;
+    }
+    queue->last_pts = pts;
+
+    pthread_cond_signal(&queue->cond);
+
+    return 0;
+}
+
+static int hwc_set_frame_para(sun4i_hwc_context_t *ctx,uint32_t value)
+{
+    libhwclayerpara_t            *overlaypara = (libhwclayerpara_t *)value;
+
+    if(ctx->queue.running)
+    {
+        //the camera does not number its frames and queues the buffer back to
+        //the driver once this returns, so its frame goes on the screen now;
+        //frames still queued would come after it and are dropped
+        if(overlaypara->number != 0)
+        {
+            return hwc_queue_frame(ctx, overlaypara);
+        }
+        ctx->queue.dropped += ctx->queue.count;
+        hwc_flush_frames(ctx);
+    }
+
+    return hwc_show_frame(ctx, overlaypara);
+}
+
+static void hwc_frame_queue_start(sun4i_hwc_context_t *ctx)
+{
+    hwc_frame_queue_t           *queue = &ctx->queue;
+
+    queue->period = 16667;
+    queue->vsync_ioctl = true;
+    queue->quit = false;
+    pthread_cond_init(&queue->cond, NULL);
+    if(pthread_create(&queue->thread, NULL, hwc_frame_queue_loop, ctx) != 0)
+    {
+        LOGE("####create frame queue thread fail, frames are shown when they come\n");
+        pthread_cond_destroy(&queue->cond);
+        return;
+    }
+    queue->running = true;
+}
+
+static void hwc_frame_queue_stop(sun4i_hwc_context_t *ctx)
+{
+    hwc_frame_queue_t           *queue = &ctx->queue;
+
+    if(!queue->running)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&ctx->lock);
+    queue->quit = true;
+    pthread_cond_signal(&queue->cond);
+    pthread_mutex_unlock(&ctx->lock);
+
+    pthread_join(queue->thread, NULL);
+    pthread_cond_destroy(&queue->cond);
+    queue->running = false;
+}
 
 static int hwc_get_frame_id(sun4i_hwc_context_t *ctx)
 {
@@ -740,33 +1151,84 @@ static int hwc_get_frame_id(sun4i_hwc_context_t *ctx)
     {
     	args[0] = 0;
     	args[1] = ctx->video_layerhdl[0];
-    	ret = ioctl(ctx->dispfd, DISP_CMD_VIDEO_GET_FRAME_ID, args);
+    	ret = hwc_disp_ioctl(ctx, DISP_CMD_VIDEO_GET_FRAME_ID, args);
     }
     else if(ctx->mode==HWC_MODE_SCREEN0_TO_SCREEN1 || ctx->mode==HWC_MODE_SCREEN1)
     {
         args[0] = 1;
         args[1] = ctx->video_layerhdl[1];
-        ret = ioctl(ctx->dispfd, DISP_CMD_VIDEO_GET_FRAME_ID, args);
+        ret = hwc_disp_ioctl(ctx, DISP_CMD_VIDEO_GET_FRAME_ID, args);
     }
     else if(ctx->mode == HWC_MODE_SCREEN0_AND_SCREEN1)
     {
-        int ret0,ret1;
-        
-    	args[0] = 0;
-    	args[1] = ctx->video_layerhdl[0];
-    	ret0 = ioctl(ctx->dispfd, DISP_CMD_VIDEO_GET_FRAME_ID, args);
+        int64_t                 now = hwc_now_us();
+        int                     ids[2];
+        bool                    lagging[2];
+        int                     screen_idx;
+
+        //each screen is released on its own: one that has not moved on to
+        //the frame it was given for a while (a slow HDMI) is parked, then
+        //left out so that it does not hold the buffers back for the other
+        for(screen_idx=0; screen_idx<2; screen_idx++)
+        {
+            hwc_screen_frame_t  *frame = &ctx->screen_frame[screen_idx];
 
-        args[0] = 1;
-        args[1] = ctx->video_layerhdl[1];
-        ret1 = ioctl(ctx->dispfd, DISP_CMD_VIDEO_GET_FRAME_ID, args);
+            lagging[screen_idx] = false;
+            if(frame->parked)
+            {
+                ids[screen_idx] = -1;
+                continue;
+            }
+
+            args[0] = screen_idx;
+            args[1] = ctx->video_layerhdl[screen_idx];
+            ids[screen_idx] = hwc_disp_ioctl(ctx, DISP_CMD_VIDEO_GET_FRAME_ID, args);
 
-        ret = (ret0<ret1)?ret0:ret1;
+            if(ids[screen_idx] != frame->id_shown || frame->id_changed == 0)
+            {
+                frame->id_shown = ids[screen_idx];
+                frame->id_changed = now;
+            }
+
+            lagging[screen_idx] = frame->valid && (frame->id_shown != (int)frame->fb.id) && (now - frame->id_changed > HWC_MIRROR_LAG_US);
+        }
+
+        if(ctx->screen_frame[0].parked || ctx->screen_frame[1].parked)
+        {
+            ret = ctx->screen_frame[0].parked ? ids[1] : ids[0];
+        }
+        else
+        {
+            //the buffer the lagging screen shows is still read until the
+            //next vsync after the close, this id keeps it
+            ret = (ids[0]<ids[1])?ids[0]:ids[1];
+
+            if(lagging[0] != lagging[1])
+            {
+                screen_idx = lagging[0] ? 0 : 1;
+                LOGD("####screen %d lags, parking its video layer\n", screen_idx);
+
+                args[0] = screen_idx;
+                args[1] = ctx->video_layerhdl[screen_idx];
+                args[2] = 0;
+                args[3] = 0;
+                hwc_disp_ioctl(ctx, DISP_CMD_LAYER_CLOSE, args);
+                ctx->status[screen_idx] &= (~HWC_STATUS_OPENED);
+                ctx->screen_frame[screen_idx].parked = true;
+                ctx->screen_frame[screen_idx].valid = false;
+            }
+        }
     }
 
     if(ret <0)
     {
         LOGV("####hwc_get_frame_id return -1,mode:%d\n",ctx->mode);
     }
+    else if(ret != ctx->stats.last_frame_id)
+    {
+        ctx->stats.frames_shown++;
+        ctx->stats.last_frame_id = ret;
+    }
     return ret;
 }
 
@@ -792,7 +1254,7 @@ static int hwc_set3dmode(sun4i_hwc_context_t *ctx,int para)
             args[0] = screen_idx;
             args[1] = ctx->video_layerhdl[screen_idx];
             args[2] = (unsigned long)&layer_info;
-            ret = ioctl(ctx->dispfd, DISP_CMD_LAYER_GET_PARA, args);
+            ret = hwc_disp_ioctl(ctx, DISP_CMD_LAYER_GET_PARA, args);
             if(ret < 0)
             {
                 LOGD("####DISP_CMD_LAYER_GET_PARA fail in hwc_set3dmode, screen_idx:%d,hdl:%d\n",screen_idx,ctx->video_layerhdl[screen_idx]);
@@ -844,11 +1306,11 @@ static int hwc_set3dmode(sun4i_hwc_context_t *ctx,int para)
             }
 
             args[0] = screen_idx;
-            cur_out_type = (__disp_output_type_t)ioctl(ctx->dispfd,DISP_CMD_GET_OUTPUT_TYPE,(unsigned long)args);
+            cur_out_type = (__disp_output_type_t)hwc_disp_ioctl(ctx, DISP_CMD_GET_OUTPUT_TYPE, args);
             if(cur_out_type == DISP_OUTPUT_TYPE_HDMI)
             {
                 args[0] = screen_idx;
-                cur_hdmi_mode = (__disp_tv_mode_t)ioctl(ctx->dispfd,DISP_CMD_HDMI_GET_MODE,(unsigned long)args);
+                cur_hdmi_mode = (__disp_tv_mode_t)hwc_disp_ioctl(ctx, DISP_CMD_HDMI_GET_MODE, args);
 
                 if(cur_hdmi_mode == DISP_TV_MOD_1080P_24HZ_3D_FP || cur_hdmi_mode == DISP_TV_MOD_720P_50HZ_3D_FP || cur_hdmi_mode == DISP_TV_MOD_720P_60HZ_3D_FP)
                 {
@@ -859,7 +1321,7 @@ static int hwc_set3dmode(sun4i_hwc_context_t *ctx,int para)
                         args[0]                         = screen_idx;
                         args[1]                         = ctx->ui_layerhdl[screen_idx];
                         args[2]                         = (unsigned long) (&tmpLayerAttr);
-                        ret = ioctl(ctx->dispfd, DISP_CMD_LAYER_GET_PARA, args);
+                        ret = hwc_disp_ioctl(ctx, DISP_CMD_LAYER_GET_PARA, args);
 
                         tmpLayerAttr.scn_win.x = ctx->org_scn_win.x;
                         tmpLayerAttr.scn_win.y = ctx->org_scn_win.y;
@@ -869,17 +1331,17 @@ static int hwc_set3dmode(sun4i_hwc_context_t *ctx,int para)
                         args[0]                         = screen_idx;
                         args[1]                         = ctx->ui_layerhdl[screen_idx];
                         args[2]                         = (unsigned long) (&tmpLayerAttr);
-                        ret = ioctl(ctx->dispfd, DISP_CMD_LAYER_SET_PARA, args);
+                        ret = hwc_disp_ioctl(ctx, DISP_CMD_LAYER_SET_PARA, args);
                         
                         args[0] = screen_idx;
-                        ret = ioctl(ctx->dispfd,DISP_CMD_HDMI_OFF,(unsigned long)args);
+                        ret = hwc_disp_ioctl(ctx, DISP_CMD_HDMI_OFF, args);
 
                         args[0] = screen_idx;
                         args[1] = ctx->org_hdmi_mode;
-                        ioctl(ctx->dispfd,DISP_CMD_HDMI_SET_MODE,(unsigned long)args);
+                        hwc_disp_ioctl(ctx, DISP_CMD_HDMI_SET_MODE, args);
                         
                         args[0] = screen_idx;
-                        ret = ioctl(ctx->dispfd,DISP_CMD_HDMI_ON,(unsigned long)args);
+                        ret = hwc_disp_ioctl(ctx, DISP_CMD_HDMI_ON, args);
                     }
                 }
                 else
@@ -893,7 +1355,7 @@ static int hwc_set3dmode(sun4i_hwc_context_t *ctx,int para)
                         args[0]                         = screen_idx;
                         args[1]                         = ctx->ui_layerhdl[screen_idx];
                         args[2]                         = (unsigned long) (&tmpLayerAttr);
-                        ret = ioctl(ctx->dispfd, DISP_CMD_LAYER_GET_PARA, args);
+                        ret = hwc_disp_ioctl(ctx, DISP_CMD_LAYER_GET_PARA, args);
                         
                         ctx->org_scn_win.x = tmpLayerAttr.scn_win.x;
                         ctx->org_scn_win.y = tmpLayerAttr.scn_win.y;
@@ -915,10 +1377,10 @@ static int hwc_set3dmode(sun4i_hwc_context_t *ctx,int para)
                         args[0]                         = screen_idx;
                         args[1]                         = ctx->ui_layerhdl[screen_idx];
                         args[2]                         = (unsigned long) (&tmpLayerAttr);
-                        ret = ioctl(ctx->dispfd, DISP_CMD_LAYER_SET_PARA, args);
+                        ret = hwc_disp_ioctl(ctx, DISP_CMD_LAYER_SET_PARA, args);
                         
                         args[0] = screen_idx;
-                        ret = ioctl(ctx->dispfd,DISP_CMD_HDMI_OFF,(unsigned long)args);
+                        ret = hwc_disp_ioctl(ctx, DISP_CMD_HDMI_OFF, args);
                         
                         args[0] = screen_idx;
                         if(_3d_out == HWC_3D_OUT_MODE_HDMI_3D_1080P24_FP)
@@ -933,10 +1395,10 @@ static int hwc_set3dmode(sun4i_hwc_context_t *ctx,int para)
                         {
                             args[1] = DISP_TV_MOD_720P_60HZ_3D_FP;
                         }
-                        ioctl(ctx->dispfd,DISP_CMD_HDMI_SET_MODE,(unsigned long)args);
+                        hwc_disp_ioctl(ctx, DISP_CMD_HDMI_SET_MODE, args);
                         
                         args[0] = screen_idx;
-                        ret = ioctl(ctx->dispfd,DISP_CMD_HDMI_ON,(unsigned long)args);
+                        ret = hwc_disp_ioctl(ctx, DISP_CMD_HDMI_ON, args);
                     }
                 }
             }
@@ -975,8 +1437,8 @@ static int hwc_set3dmode(sun4i_hwc_context_t *ctx,int para)
                 unsigned int w,h;
                 
                 args[0] = screen_idx;
-                w = ioctl(ctx->dispfd,DISP_CMD_SCN_GET_WIDTH,(unsigned long)args);
-                h = ioctl(ctx->dispfd,DISP_CMD_SCN_GET_HEIGHT,(unsigned long)args);
+                w = hwc_disp_ioctl(ctx, DISP_CMD_SCN_GET_WIDTH, args);
+                h = hwc_disp_ioctl(ctx, DISP_CMD_SCN_GET_HEIGHT, args);
 
                 layer_info.scn_win.x = 0;
                 layer_info.scn_win.y = 0;
@@ -987,7 +1449,7 @@ static int hwc_set3dmode(sun4i_hwc_context_t *ctx,int para)
             args[0] = screen_idx;
             args[1] = ctx->video_layerhdl[screen_idx];
             args[2] = (unsigned long)&layer_info;
-            ioctl(ctx->dispfd, DISP_CMD_LAYER_SET_PARA, args);
+            hwc_disp_ioctl(ctx, DISP_CMD_LAYER_SET_PARA, args);
         }
     }
 
@@ -997,6 +1459,7 @@ static int hwc_set3dmode(sun4i_hwc_context_t *ctx,int para)
     ctx->cur_3d_src = _3d_info->src_mode;
     ctx->cur_3d_out = _3d_info->display_mode;
     ctx->cur_3denable = layer_info.b_trd_out;
+    hwc_invalidate_shadow(ctx);
     return 0;
 }
 
@@ -1018,7 +1481,7 @@ static int hwc_set_3d_parallax(sun4i_hwc_context_t *ctx,uint32_t value)
             args[0] = screen_idx;
             args[1] = ctx->video_layerhdl[screen_idx];
             args[2] = (unsigned long)&layer_info;
-            ret = ioctl(ctx->dispfd, DISP_CMD_LAYER_GET_PARA, args);
+            ret = hwc_disp_ioctl(ctx, DISP_CMD_LAYER_GET_PARA, args);
             if(ret < 0)
             {
                 LOGD("####DISP_CMD_LAYER_GET_PARA fail in hwc_set_3d_parallax, screen_idx:%d,hdl:%d\n",screen_idx,ctx->video_layerhdl[screen_idx]);
@@ -1029,7 +1492,7 @@ static int hwc_set_3d_parallax(sun4i_hwc_context_t *ctx,uint32_t value)
                 args[0] = screen_idx;
                 args[1] = ctx->video_layerhdl[screen_idx];
                 args[2] = (unsigned long)&layer_info;
-                ret = ioctl(ctx->dispfd, DISP_CMD_LAYER_SET_PARA, args);
+                ret = hwc_disp_ioctl(ctx, DISP_CMD_LAYER_SET_PARA, args);
             }
         }
     }
@@ -1040,21 +1503,57 @@ static int hwc_set_3d_parallax(sun4i_hwc_context_t *ctx,uint32_t value)
 
 static int hwc_prepare(hwc_composer_device_t *dev, hwc_layer_list_t* list) 
 {
+    sun4i_hwc_context_t   		*ctx = (sun4i_hwc_context_t *)dev;
+    hwc_plan_config_t           config;
+    hwc_plan_t                  plan;
+    int                         overlays;
+    int screen_idx;
 
-    for (size_t i=0 ; i<list->numHwLayers ; i++) 
+    pthread_mutex_lock(&ctx->lock);
+    memset(&config, 0, sizeof(hwc_plan_config_t));
+    for(screen_idx=0; screen_idx<2; screen_idx++)
     {
-        if((list->hwLayers[i].format == HWC_FORMAT_MBYUV420)
-            ||(list->hwLayers[i].format == HWC_FORMAT_MBYUV422)
-            ||(list->hwLayers[i].format == HWC_FORMAT_YUV420PLANAR)
-            ||(list->hwLayers[i].format == HWC_FORMAT_DEFAULT))
-    	{
-        	list->hwLayers[i].compositionType = HWC_OVERLAY;
-    	}
-    	else
-    	{
-        	list->hwLayers[i].compositionType = HWC_FRAMEBUFFER;
-    	}
+        if(((screen_idx == 0) && (ctx->mode==HWC_MODE_SCREEN0 || ctx->mode==HWC_MODE_SCREEN0_FE_VAR || ctx->mode==HWC_MODE_SCREEN0_AND_SCREEN1 || ctx->mode==HWC_MODE_SCREEN0_BE || ctx->mode==HWC_MODE_SCREEN0_GPU))
+            || ((screen_idx == 1) && (ctx->mode==HWC_MODE_SCREEN1 || ctx->mode==HWC_MODE_SCREEN0_TO_SCREEN1 || ctx->mode==HWC_MODE_SCREEN0_AND_SCREEN1)))
+        {
+            config.screens |= (1 << screen_idx);
+        }
+        //the UI layer of the screen
+        config.free_layers[screen_idx] = HWC_PLAN_LAYERS_PER_SCREEN - 1;
+    }
+    config.free_scalers = HWC_PLAN_SCALERS - (ctx->fb_scaler[0] ? 1 : 0) - (ctx->fb_scaler[1] ? 1 : 0);
+
+    if(ctx->mode == HWC_MODE_SCREEN0_GPU)
+    {
+        config.width = ctx->screen_para.app_width[0];
+        config.height = ctx->screen_para.app_height[0];
+    }
+    else
+    {
+        hwc_get_fb_size(ctx, (ctx->mode==HWC_MODE_SCREEN1) ? 1 : 0, &config.width, &config.height);
     }
+
+    overlays = hwc_plan_layers(&config, list, &plan);
+    ctx->stats.layers_overlay += overlays;
+    ctx->stats.layers_fb += plan.num_layers - overlays;
+
+    if(!hwc_plan_same(&plan, &ctx->plan))
+    {
+        LOGD("####hwc_prepare:%d layers, video layer:%d\n", plan.num_layers, plan.video);
+        for(int i=0; i<plan.num_layers && i<HWC_PLAN_MAX_LAYERS; i++)
+        {
+            if(plan.reason[i] == HWC_PLAN_VIDEO_BUSY)
+            {
+                LOGW("####layer %d is a second video, kept off the framebuffer and not shown\n", i);
+            }
+            else if(plan.reason[i] != HWC_PLAN_OK && plan.reason[i] != HWC_PLAN_GPU)
+            {
+                LOGD("####layer %d on the video layer: %s\n", i, hwc_plan_reason_str(plan.reason[i]));
+            }
+        }
+    }
+    memcpy(&ctx->plan, &plan, sizeof(hwc_plan_t));
+    pthread_mutex_unlock(&ctx->lock);
         
     return 0;
 }
@@ -1064,13 +1563,26 @@ static int hwc_set(hwc_composer_device_t *dev,
         hwc_surface_t sur,
         hwc_layer_list_t* list)
 {
+    sun4i_hwc_context_t   		*ctx = (sun4i_hwc_context_t *)dev;
+    int                         ret;
+    int64_t                     start;
+    int64_t                     swap_time;
+
+    start = hwc_now_us();
     EGLBoolean sucess = eglSwapBuffers((EGLDisplay)dpy, (EGLSurface)sur);
     if (!sucess) 
     {
         return HWC_EGL_ERROR;
     }
+    swap_time = hwc_now_us() - start;
+
+    pthread_mutex_lock(&ctx->lock);
+    start = hwc_now_us();
+    ret = hwc_set_rect(dev,list);
+    hwc_update_stats(ctx, swap_time, hwc_now_us() - start);
+    pthread_mutex_unlock(&ctx->lock);
 
-    return hwc_set_rect(dev,list);
+    return ret;
 }
 
 static int hwc_set_mode(sun4i_hwc_context_t *ctx,uint32_t value)
@@ -1090,9 +1602,11 @@ static int hwc_set_mode(sun4i_hwc_context_t *ctx,uint32_t value)
     layer_para.format = ctx->format;
     layer_para.screenid = ctx->screenid;
     ctx->mode = value;
+    ctx->stats.mode_switches++;
+    hwc_invalidate_shadow(ctx);
     hwc_set_init_para(ctx, (uint32_t)&layer_para, 1);
 
-    hwc_set_frame_para(ctx, (uint32_t)&ctx->cur_frame_para);
+    hwc_show_frame(ctx, &ctx->cur_frame_para);
 
     if(ctx->cur_3d_out == HWC_3D_OUT_MODE_ANAGLAGH)
     {
@@ -1118,6 +1632,10 @@ static int hwc_set_screen_para(sun4i_hwc_context_t *ctx,uint32_t value)
     screen_info->valid_width[0],screen_info->valid_height[0]);
     
     memcpy(&ctx->screen_para,screen_info,sizeof(screen_para_t));
+
+    //the output was switched or its resolution changed
+    hwc_invalidate_shadow(ctx);
+    ctx->stats.screen_changes++;
     
     return 0;
 }
@@ -1127,6 +1645,7 @@ static int hwc_setparameter(hwc_composer_device_t *dev,uint32_t param,uint32_t v
 	int 						ret = 0;
     sun4i_hwc_context_t   		*ctx = (sun4i_hwc_context_t *)dev;
 	
+    pthread_mutex_lock(&ctx->lock);
     if(param == HWC_LAYER_SETINITPARA)
     {
     	ret = hwc_set_init_para(ctx,value, 0);
@@ -1179,7 +1698,7 @@ static int hwc_setparameter(hwc_composer_device_t *dev,uint32_t param,uint32_t v
 						args[1] 					= ctx->video_layerhdl[screen_idx];
 						args[2] 					= 0;
 						args[3] 					= 0;
-						ioctl(ctx->dispfd, DISP_CMD_LAYER_CLOSE,args);
+						hwc_disp_ioctl(ctx, DISP_CMD_LAYER_CLOSE, args);
 		
 						ctx->status[screen_idx] &= (~HWC_STATUS_OPENED);
 						//LOGV("####ctx->status[%d]=%d in hwc_set_rect", screen_idx,ctx->status[screen_idx]);
@@ -1188,7 +1707,7 @@ static int hwc_setparameter(hwc_composer_device_t *dev,uint32_t param,uint32_t v
 			}
 		}
 	}
-
+    pthread_mutex_unlock(&ctx->lock);
 
     return ( ret );
 }
@@ -1196,7 +1715,154 @@ static int hwc_setparameter(hwc_composer_device_t *dev,uint32_t param,uint32_t v
 
 static uint32_t hwc_getparameter(hwc_composer_device_t *dev,uint32_t param)
 {
-    return 0;
+    sun4i_hwc_context_t         *ctx = (sun4i_hwc_context_t *)dev;
+    hwc_stats_t                 *stats = &ctx->stats;
+    uint32_t                    ret = 0;
+    int                         i;
+
+    pthread_mutex_lock(&ctx->lock);
+    switch(param)
+    {
+        case HWC_STATS_GET_SETS:
+            ret = stats->sets;
+            break;
+        case HWC_STATS_GET_SET_TIME_AVG:
+            ret = stats->sets ? (uint32_t)(stats->set_time / stats->sets) : 0;
+            break;
+        case HWC_STATS_GET_SET_TIME_MAX:
+            ret = (uint32_t)stats->set_time_max;
+            break;
+        case HWC_STATS_GET_SWAP_TIME_AVG:
+            ret = stats->sets ? (uint32_t)(stats->swap_time / stats->sets) : 0;
+            break;
+        case HWC_STATS_GET_SWAP_TIME_MAX:
+            ret = (uint32_t)stats->swap_time_max;
+            break;
+        case HWC_STATS_GET_IOCTLS:
+            ret = stats->ioctl_other;
+            for(i=0; i<HWC_STATS_IOCTL_CMDS; i++)
+            {
+                ret += stats->ioctl_cmds[i].count;
+            }
+            break;
+        case HWC_STATS_GET_LAYERS_OVERLAY:
+            ret = stats->layers_overlay;
+            break;
+        case HWC_STATS_GET_LAYERS_FB:
+            ret = stats->layers_fb;
+            break;
+        case HWC_STATS_GET_FRAMES_SET:
+            ret = stats->frames_set;
+            break;
+        case HWC_STATS_GET_FRAMES_SHOWN:
+            ret = stats->frames_shown;
+            break;
+        case HWC_STATS_GET_FRAMES_DROPPED:
+            ret = ctx->queue.dropped;
+            break;
+        case HWC_STATS_GET_MODE_SWITCHES:
+            ret = stats->mode_switches;
+            break;
+        default:
+            break;
+    }
+    pthread_mutex_unlock(&ctx->lock);
+
+    return ret;
+}
+
+//upper bounds of the histogram buckets, in us
+static const int32_t hwc_hist_buckets[] = {1000, 2000, 4000, 8000, 16667, 33333, 50000};
+#define HWC_HIST_BUCKETS    (sizeof(hwc_hist_buckets) / sizeof(hwc_hist_buckets[0]) + 1)
+
+//the last HWC_STATS_SAMPLES samples, bucketed
+static int hwc_dump_hist(char *buff, int buff_len, const char *name, const int32_t *samples, uint32_t num)
+{
+    uint32_t                    hist[HWC_HIST_BUCKETS] = {0};
+    uint32_t                    count = (num < HWC_STATS_SAMPLES) ? num : HWC_STATS_SAMPLES;
+    int32_t                     max = 0;
+    int                         len;
+
+    for(uint32_t i=0; i<count; i++)
+    {
+        uint32_t bucket = 0;
+
+        while(bucket < HWC_HIST_BUCKETS - 1 && samples[i] >= hwc_hist_buckets[bucket])
+        {
+            bucket++;
+        }
+        hist[bucket]++;
+        if(samples[i] > max)
+        {
+            max = samples[i];
+        }
+    }
+
+    len = snprintf(buff, buff_len, "  %-12s n=%-4u max=%6dus |", name, count, max);
+    for(uint32_t i=0; i<HWC_HIST_BUCKETS && len < buff_len; i++)
+    {
+        len += snprintf(buff + len, buff_len - len, " %4u", hist[i]);
+    }
+    if(len < buff_len)
+    {
+        len += snprintf(buff + len, buff_len - len, "\n");
+    }
+    return len;
+}
+
+static void hwc_dump(hwc_composer_device_t *dev, char *buff, int buff_len)
+{
+    sun4i_hwc_context_t         *ctx = (sun4i_hwc_context_t *)dev;
+    hwc_stats_t                 *stats = &ctx->stats;
+    uint32_t                    sets;
+    int                         len = 0;
+    int                         i;
+
+#define HWC_DUMP(...) \
+    do { if(len < buff_len) len += snprintf(buff + len, buff_len - len, __VA_ARGS__); } while(0)
+
+    pthread_mutex_lock(&ctx->lock);
+    sets = stats->sets ? stats->sets : 1;
+
+    HWC_DUMP("sun4i hwcomposer: mode %u, %s\n", ctx->mode, ctx->cur_3denable ? "3d" : "2d");
+    for(i=0; i<2; i++)
+    {
+        HWC_DUMP("  screen %d: status 0x%x, video layer %u, frame id %d%s\n", i, ctx->status[i],
+            ctx->video_layerhdl[i], ctx->screen_frame[i].id_shown, ctx->screen_frame[i].parked ? ", parked" : "");
+    }
+    HWC_DUMP("  hwc_set: %u calls, avg %lld us, max %lld us\n",
+        stats->sets, stats->set_time / sets, stats->set_time_max);
+    HWC_DUMP("  eglSwapBuffers: avg %lld us, max %lld us\n",
+        stats->swap_time / sets, stats->swap_time_max);
+    HWC_DUMP("  layers: %u overlay, %u framebuffer\n", stats->layers_overlay, stats->layers_fb);
+    HWC_DUMP("  plan: %d layers, video layer %d, window [%d,%d,%d,%d] -> [%d,%d,%d,%d]\n",
+        ctx->plan.num_layers, ctx->plan.video,
+        ctx->plan.crop.left, ctx->plan.crop.top, ctx->plan.crop.right, ctx->plan.crop.bottom,
+        ctx->plan.frame.left, ctx->plan.frame.top, ctx->plan.frame.right, ctx->plan.frame.bottom);
+    HWC_DUMP("  video frames: %u set, %u shown\n", stats->frames_set, stats->frames_shown);
+    HWC_DUMP("  frame queue: %s, %u shown, %u early, %u late, %u dropped, vsync %lld us\n",
+        ctx->queue.running ? "on" : "off", ctx->queue.shown, ctx->queue.early,
+        ctx->queue.late, ctx->queue.dropped, ctx->queue.period);
+    HWC_DUMP("  mode switches: %u, screen changes: %u\n", stats->mode_switches, stats->screen_changes);
+
+    HWC_DUMP("  ioctls: %u saved by the shadow state, %u not in the table\n", stats->ioctls_saved, stats->ioctl_other);
+    for(i=0; i<HWC_STATS_IOCTL_CMDS && stats->ioctl_cmds[i].count != 0; i++)
+    {
+        HWC_DUMP("    0x%04x: %u\n", stats->ioctl_cmds[i].cmd, stats->ioctl_cmds[i].count);
+    }
+
+    HWC_DUMP("  histogram buckets (ms): <1 <2 <4 <8 <16.7 <33.3 <50 more\n");
+    if(len < buff_len)
+    {
+        len += hwc_dump_hist(buff + len, buff_len - len, "set+swap", stats->set_samples, stats->set_sample_num);
+    }
+    if(len < buff_len)
+    {
+        len += hwc_dump_hist(buff + len, buff_len - len, "video frame", stats->frame_samples, stats->frame_sample_num);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+
+#undef HWC_DUMP
 }
 
 static int hwc_init(sun4i_hwc_context_t *ctx)
@@ -1228,15 +1894,15 @@ static int hwc_init(sun4i_hwc_context_t *ctx)
     ctx->mode = 0;
 
     arg[0] = (unsigned long)&init_para;
-    ioctl(ctx->dispfd,DISP_CMD_GET_DISP_INIT_PARA,(unsigned long)arg);
+    hwc_disp_ioctl(ctx, DISP_CMD_GET_DISP_INIT_PARA, arg);
 
     arg[0] = 0;
-    ctx->screen_para.app_width[0] = ioctl(ctx->dispfd,DISP_CMD_SCN_GET_WIDTH,(unsigned long)arg);
-    ctx->screen_para.app_height[0] = ioctl(ctx->dispfd,DISP_CMD_SCN_GET_HEIGHT,(unsigned long)arg);
-    ctx->screen_para.width[0] = ioctl(ctx->dispfd,DISP_CMD_SCN_GET_WIDTH,(unsigned long)arg);
-    ctx->screen_para.height[0] = ioctl(ctx->dispfd,DISP_CMD_SCN_GET_HEIGHT,(unsigned long)arg);
-    ctx->screen_para.valid_width[0] = ioctl(ctx->dispfd,DISP_CMD_SCN_GET_WIDTH,(unsigned long)arg);
-    ctx->screen_para.valid_height[0] = ioctl(ctx->dispfd,DISP_CMD_SCN_GET_HEIGHT,(unsigned long)arg);
+    ctx->screen_para.app_width[0] = hwc_disp_ioctl(ctx, DISP_CMD_SCN_GET_WIDTH, arg);
+    ctx->screen_para.app_height[0] = hwc_disp_ioctl(ctx, DISP_CMD_SCN_GET_HEIGHT, arg);
+    ctx->screen_para.width[0] = hwc_disp_ioctl(ctx, DISP_CMD_SCN_GET_WIDTH, arg);
+    ctx->screen_para.height[0] = hwc_disp_ioctl(ctx, DISP_CMD_SCN_GET_HEIGHT, arg);
+    ctx->screen_para.valid_width[0] = hwc_disp_ioctl(ctx, DISP_CMD_SCN_GET_WIDTH, arg);
+    ctx->screen_para.valid_height[0] = hwc_disp_ioctl(ctx, DISP_CMD_SCN_GET_HEIGHT, arg);
 
     if(init_para.disp_mode == DISP_INIT_MODE_SCREEN0)
     {
@@ -1250,11 +1916,25 @@ static int hwc_init(sun4i_hwc_context_t *ctx)
     {
     	ctx->mode = HWC_MODE_SCREEN0_GPU;
 	}
+    ctx->fb_scaler[0] = init_para.scaler_mode[0];
+    ctx->fb_scaler[1] = init_para.scaler_mode[1];
 	
     char value[PROPERTY_VALUE_MAX];
     int r = property_get("ro.sw.videotrimming", value, "0");
 	LOGD("####ro.sw.videotrimming is %s", value);
 	ctx->b_video_in_valid_area = atoi(value);
+
+    //log the hwc_set counters every that many calls
+    property_get("debug.hwc.stats", value, "0");
+    ctx->stats.log_every = atoi(value);
+
+    //put numbered video frames on the screen at vsync from a thread of our
+    //own, the camera's frames go on in line (see hwc_set_frame_para)
+    property_get("debug.hwc.framequeue", value, "1");
+    if(atoi(value) != 0)
+    {
+        hwc_frame_queue_start(ctx);
+    }
             
     return 0;
 }
@@ -1263,7 +1943,11 @@ static int hwc_device_close(struct hw_device_t *dev)
 {
     sun4i_hwc_context_t* ctx = (sun4i_hwc_context_t*)dev;
 
+    hwc_frame_queue_stop(ctx);
+
+    pthread_mutex_lock(&ctx->lock);
     hwc_release(ctx);
+    pthread_mutex_unlock(&ctx->lock);
 
     return 0;
 }
@@ -1279,6 +1963,7 @@ static int hwc_device_open(const struct hw_module_t* module, const char* name,
 
         /* initialize our state here */
         memset(dev, 0, sizeof(*dev));
+        pthread_mutex_init(&dev->lock, NULL);
 
         /* initialize the procs */
         dev->device.common.tag      = HARDWARE_DEVICE_TAG;
@@ -1290,6 +1975,7 @@ static int hwc_device_open(const struct hw_module_t* module, const char* name,
         dev->device.set             = hwc_set;
         dev->device.setparameter    = hwc_setparameter;
         dev->device.getparameter    = hwc_getparameter;
+        dev->device.dump            = hwc_dump;
 
         *device = &dev->device.common;
         status = 0;
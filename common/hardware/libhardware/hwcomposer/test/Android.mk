@@ -0,0 +1,26 @@
+LOCAL_PATH := $(call my-dir)
+
+# Host tests of the hwcomposer. Build with
+# "mmm device/allwinner/common/hardware/libhardware/hwcomposer/test", then
+# run e.g. out/host/linux-x86/bin/hwc_planner_test.
+
+# The composition planner on synthetic layer lists
+include $(CLEAR_VARS)
+LOCAL_MODULE := hwc_planner_test
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := HwcPlannerTest.cpp ../hwc_planner.cpp
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/.. $(TARGET_HARDWARE_INCLUDE)
+include $(BUILD_HOST_EXECUTABLE)
+
+# Video mirrored to both screens against a fake /dev/disp: the release frame
+# id and the parking of a lagging screen. The test builds hwcomposer.cpp in
+# and stands in for ioctl() and eglSwapBuffers().
+include $(CLEAR_VARS)
+LOCAL_MODULE := hwc_mirror_test
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := HwcMirrorTest.cpp ../hwc_planner.cpp
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/.. $(TARGET_HARDWARE_INCLUDE)
+LOCAL_CFLAGS := -DLOG_TAG=\"hwcomposer\"
+LOCAL_STATIC_LIBRARIES := libcutils liblog
+LOCAL_LDLIBS := -lpthread
+include $(BUILD_HOST_EXECUTABLE)
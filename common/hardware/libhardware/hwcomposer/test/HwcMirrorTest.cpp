@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//mirroring video to both screens against a fake /dev/disp: the frame id
+//released to the producer, and a lagging screen parked before it is left
+//out of that id.
+
+#include "HwcTest.h"
+#include "hwcomposer.cpp"
+
+#include <stdarg.h>
+
+//what the fake display driver was asked, per screen
+static int setfb[2];
+static int closes[2];
+static int opens[2];
+static int shown_id[2];
+
+extern "C" int ioctl(int fd, unsigned long cmd, ...)
+{
+    unsigned long   *args;
+    va_list         ap;
+
+    va_start(ap, cmd);
+    args = va_arg(ap, unsigned long *);
+    va_end(ap);
+
+    switch(cmd)
+    {
+        case DISP_CMD_VIDEO_SET_FB:
+            setfb[args[0]]++;
+            return 0;
+        case DISP_CMD_LAYER_CLOSE:
+            closes[args[0]]++;
+            return 0;
+        case DISP_CMD_LAYER_OPEN:
+            opens[args[0]]++;
+            return 0;
+        case DISP_CMD_LAYER_GET_PARA:
+            memset((void *)args[2], 0, sizeof(__disp_layer_info_t));
+            return 0;
+        case DISP_CMD_VIDEO_GET_FRAME_ID:
+            return shown_id[args[0]];
+    }
+    return 0;
+}
+
+EGLBoolean eglSwapBuffers(EGLDisplay dpy, EGLSurface surface)
+{
+    return EGL_TRUE;
+}
+
+static void init(sun4i_hwc_context_t *ctx)
+{
+    memset(ctx, 0, sizeof(sun4i_hwc_context_t));
+    memset(setfb, 0, sizeof(setfb));
+    memset(closes, 0, sizeof(closes));
+    memset(opens, 0, sizeof(opens));
+    memset(shown_id, 0, sizeof(shown_id));
+    pthread_mutex_init(&ctx->lock, NULL);
+    ctx->dispfd = -1;
+    ctx->mFD_fb[0] = -1;
+    ctx->mFD_fb[1] = -1;
+    ctx->mode = HWC_MODE_SCREEN0_AND_SCREEN1;
+    ctx->video_layerhdl[0] = 100;
+    ctx->video_layerhdl[1] = 101;
+    ctx->status[0] = HWC_STATUS_COMPOSITED;
+    ctx->status[1] = HWC_STATUS_COMPOSITED;
+}
+
+static void show(sun4i_hwc_context_t *ctx, int id)
+{
+    libhwclayerpara_t   para;
+
+    memset(&para, 0, sizeof(para));
+    para.number = id;
+    para.top_y = 0x1000 * id;
+    para.top_c = 0x1000 * id + 0x800;
+    hwc_show_frame(ctx, &para);
+}
+
+//both screens keep up: the frame both have moved past is released
+static void test_min()
+{
+    static sun4i_hwc_context_t ctx;
+
+    init(&ctx);
+    show(&ctx, 1);
+    show(&ctx, 2);
+    CHECK(setfb[0] == 2 && setfb[1] == 2);
+
+    shown_id[0] = 2;
+    shown_id[1] = 1;
+    CHECK(hwc_get_frame_id(&ctx) == 1);
+    shown_id[1] = 2;
+    CHECK(hwc_get_frame_id(&ctx) == 2);
+    CHECK(!ctx.screen_frame[0].parked && !ctx.screen_frame[1].parked);
+}
+
+//screen 1 stops moving: it keeps the release id until its video layer is
+//closed, then gets no more frames and is left out
+static void test_park()
+{
+    static sun4i_hwc_context_t ctx;
+    int                        opens_before;
+
+    init(&ctx);
+    show(&ctx, 1);
+    shown_id[0] = 1;
+    shown_id[1] = 1;
+    CHECK(hwc_get_frame_id(&ctx) == 1);
+
+    show(&ctx, 2);
+    show(&ctx, 3);
+    shown_id[0] = 3;
+    CHECK(hwc_get_frame_id(&ctx) == 1);
+    CHECK(closes[1] == 0);
+
+    //late for longer than HWC_MIRROR_LAG_US: parked, still held by this id
+    usleep(HWC_MIRROR_LAG_US + 20000);
+    CHECK(hwc_get_frame_id(&ctx) == 1);
+    CHECK(ctx.screen_frame[1].parked);
+    CHECK(!ctx.screen_frame[0].parked);
+    CHECK(closes[1] == 1 && closes[0] == 0);
+    CHECK((ctx.status[1] & HWC_STATUS_OPENED) == 0);
+
+    //from the next call on, released without it
+    CHECK(hwc_get_frame_id(&ctx) == 3);
+
+    //and given no buffer, nor opened again by hwc_set_rect
+    show(&ctx, 4);
+    CHECK(setfb[0] == 4);
+    CHECK(setfb[1] == 3);
+    shown_id[0] = 4;
+    CHECK(hwc_get_frame_id(&ctx) == 4);
+
+    opens_before = opens[1];
+    ctx.plan.video = 0;
+    {
+        hwc_layer_list_t *list = hwc_test_new_list(1);
+
+        list->numHwLayers = 1;
+        list->hwLayers[0].compositionType = HWC_OVERLAY;
+        list->hwLayers[0].format = HWC_FORMAT_MBYUV420;
+        hwc_set_rect(&ctx.device, list);
+        free(list);
+    }
+    CHECK(opens[1] == opens_before);
+
+    //set up again for the next video, the screen is back
+    hwc_invalidate_shadow(&ctx);
+    CHECK(!ctx.screen_frame[1].parked);
+    show(&ctx, 5);
+    CHECK(setfb[1] == 4);
+}
+
+//both screens late: neither is parked, the slower one holds the buffers
+static void test_both_late()
+{
+    static sun4i_hwc_context_t ctx;
+
+    init(&ctx);
+    show(&ctx, 1);
+    shown_id[0] = 1;
+    shown_id[1] = 1;
+    CHECK(hwc_get_frame_id(&ctx) == 1);
+
+    show(&ctx, 2);
+    usleep(HWC_MIRROR_LAG_US + 20000);
+    CHECK(hwc_get_frame_id(&ctx) == 1);
+    CHECK(!ctx.screen_frame[0].parked && !ctx.screen_frame[1].parked);
+    CHECK(closes[0] == 0 && closes[1] == 0);
+}
+
+int main(void)
+{
+    test_min();
+    test_park();
+    test_both_late();
+
+    return hwc_test_result("hwc_mirror_test");
+}
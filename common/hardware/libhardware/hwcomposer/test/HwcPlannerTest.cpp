@@ -0,0 +1,267 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//hwc_plan_layers on synthetic layer lists: the composition type of every
+//layer, the layer on the video layer, the reason logged and the scaler
+//window.
+
+#include "HwcTest.h"
+#include "hwc_planner.h"
+
+#define MAX_LAYERS      8
+
+//appends a layer showing 'src' of its buffer in 'dst' of a 1280x720 screen
+static hwc_layer_t *add_layer(hwc_layer_list_t *list, uint32_t format, int src_w, int src_h,
+    int dst_x, int dst_y, int dst_w, int dst_h)
+{
+    hwc_layer_t *layer = &list->hwLayers[list->numHwLayers++];
+
+    memset(layer, 0, sizeof(hwc_layer_t));
+    layer->compositionType = -1;
+    layer->format = format;
+    layer->blending = HWC_BLENDING_NONE;
+    hwc_test_set_rect(&layer->sourceCrop, 0, 0, src_w, src_h);
+    hwc_test_set_rect(&layer->displayFrame, dst_x, dst_y, dst_x + dst_w, dst_y + dst_h);
+    return layer;
+}
+
+//a new empty list in '*list', freeing the previous one
+static void init(hwc_layer_list_t **list, hwc_plan_config_t *config)
+{
+    free(*list);
+    *list = hwc_test_new_list(MAX_LAYERS);
+    memset(config, 0, sizeof(hwc_plan_config_t));
+    config->screens = 1;
+    config->width = 1280;
+    config->height = 720;
+    config->free_scalers = HWC_PLAN_SCALERS;
+    config->free_layers[0] = HWC_PLAN_LAYERS_PER_SCREEN - 1;
+    config->free_layers[1] = HWC_PLAN_LAYERS_PER_SCREEN - 1;
+}
+
+static void test_rgb_only()
+{
+    hwc_layer_list_t *t = NULL;
+    hwc_plan_config_t config;
+    hwc_plan_t plan;
+
+    init(&t, &config);
+    add_layer(t, HWC_FORMAT_RGBA_8888, 1280, 720, 0, 0, 1280, 720);
+    add_layer(t, HWC_FORMAT_RGBA_8888, 1280, 48, 0, 0, 1280, 48);
+
+    CHECK(hwc_plan_layers(&config, t, &plan) == 0);
+    CHECK(plan.num_layers == 2);
+    CHECK(plan.video == -1);
+    CHECK(t->hwLayers[0].compositionType == HWC_FRAMEBUFFER);
+    CHECK(t->hwLayers[1].compositionType == HWC_FRAMEBUFFER);
+    CHECK(plan.reason[0] == HWC_PLAN_GPU);
+    CHECK(plan.reason[1] == HWC_PLAN_GPU);
+
+    free(t);
+}
+
+static void test_video()
+{
+    static const uint32_t formats[] =
+    {
+        HWC_FORMAT_MBYUV420, HWC_FORMAT_MBYUV422, HWC_FORMAT_YUV420PLANAR, HWC_FORMAT_DEFAULT,
+    };
+    hwc_layer_list_t *t = NULL;
+    hwc_plan_config_t config;
+    hwc_plan_t plan;
+
+    for(size_t i=0; i<sizeof(formats)/sizeof(formats[0]); i++)
+    {
+        init(&t, &config);
+        add_layer(t, formats[i], 1920, 1080, 0, 0, 1280, 720);
+        add_layer(t, HWC_FORMAT_RGBA_8888, 1280, 48, 0, 672, 1280, 48);
+
+        CHECK(hwc_plan_layers(&config, t, &plan) == 1);
+        CHECK(plan.video == 0);
+        CHECK(t->hwLayers[0].compositionType == HWC_OVERLAY);
+        CHECK(t->hwLayers[1].compositionType == HWC_FRAMEBUFFER);
+        CHECK(plan.reason[0] == HWC_PLAN_OK);
+        CHECK(hwc_test_rect_is(&plan.crop, 0, 0, 1920, 1080));
+        CHECK(hwc_test_rect_is(&plan.frame, 0, 0, 1280, 720));
+    }
+
+    free(t);
+}
+
+//a window the scaler can not take is clamped, the video stays an overlay
+static void test_clamp()
+{
+    hwc_layer_list_t *t = NULL;
+    hwc_plan_config_t config;
+    hwc_plan_t plan;
+
+    //4096 wide: the middle 2048 columns, at the same scale
+    init(&t, &config);
+    add_layer(t, HWC_FORMAT_MBYUV420, 4096, 1024, 0, 0, 1280, 320);
+    CHECK(hwc_plan_layers(&config, t, &plan) == 1);
+    CHECK(t->hwLayers[0].compositionType == HWC_OVERLAY);
+    CHECK(plan.video == 0);
+    CHECK(plan.reason[0] == HWC_PLAN_CLAMP_SRC_SIZE);
+    CHECK(hwc_test_rect_is(&plan.crop, 1024, 0, 3072, 1024));
+    CHECK(hwc_test_rect_is(&plan.frame, 320, 0, 960, 320));
+    //the layer itself is left alone
+    CHECK(hwc_test_rect_is(&t->hwLayers[0].sourceCrop, 0, 0, 4096, 1024));
+
+    //more than 16 times down: the middle of the source
+    init(&t, &config);
+    add_layer(t, HWC_FORMAT_YUV420PLANAR, 1920, 1080, 100, 100, 100, 50);
+    CHECK(hwc_plan_layers(&config, t, &plan) == 1);
+    CHECK(t->hwLayers[0].compositionType == HWC_OVERLAY);
+    CHECK(plan.reason[0] == HWC_PLAN_CLAMP_SCALE);
+    CHECK(hwc_test_rect_is(&plan.crop, 160, 140, 1760, 940));
+    CHECK(hwc_test_rect_is(&plan.frame, 100, 100, 200, 150));
+
+    //more than 32 times up: the middle of the display frame
+    init(&t, &config);
+    add_layer(t, HWC_FORMAT_YUV420PLANAR, 16, 16, 0, 0, 1280, 720);
+    CHECK(hwc_plan_layers(&config, t, &plan) == 1);
+    CHECK(t->hwLayers[0].compositionType == HWC_OVERLAY);
+    CHECK(plan.reason[0] == HWC_PLAN_CLAMP_SCALE);
+    CHECK(hwc_test_rect_is(&plan.crop, 0, 0, 16, 16));
+    CHECK(hwc_test_rect_is(&plan.frame, 384, 104, 896, 616));
+
+    //the limits themselves are in range
+    init(&t, &config);
+    add_layer(t, HWC_FORMAT_MBYUV420, 2048, 1600, 0, 0, 128, 100);
+    CHECK(hwc_plan_layers(&config, t, &plan) == 1);
+    CHECK(plan.reason[0] == HWC_PLAN_OK);
+    CHECK(hwc_test_rect_is(&plan.crop, 0, 0, 2048, 1600));
+    CHECK(hwc_test_rect_is(&plan.frame, 0, 0, 128, 100));
+
+    //an empty window is not touched
+    init(&t, &config);
+    add_layer(t, HWC_FORMAT_MBYUV420, 0, 0, 0, 0, 1280, 720);
+    CHECK(hwc_plan_layers(&config, t, &plan) == 1);
+    CHECK(plan.reason[0] == HWC_PLAN_OK);
+    CHECK(hwc_test_rect_is(&plan.frame, 0, 0, 1280, 720));
+
+    free(t);
+}
+
+//what the planner finds wrong with the hardware is logged, the video stays
+//an overlay on the video layer
+static void test_reasons()
+{
+    hwc_layer_list_t *t = NULL;
+    hwc_plan_config_t config;
+    hwc_plan_t plan;
+
+    init(&t, &config);
+    add_layer(t, HWC_FORMAT_MBYUV420, 1280, 720, 0, 0, 1280, 720)->flags = HWC_SKIP_LAYER;
+    CHECK(hwc_plan_layers(&config, t, &plan) == 1);
+    CHECK(t->hwLayers[0].compositionType == HWC_OVERLAY);
+    CHECK(plan.video == 0);
+    CHECK(plan.reason[0] == HWC_PLAN_SKIP);
+
+    //both screens, one scaler left by the framebuffers
+    init(&t, &config);
+    config.screens = 3;
+    config.free_scalers = 1;
+    add_layer(t, HWC_FORMAT_MBYUV420, 1280, 720, 0, 0, 1280, 720);
+    CHECK(hwc_plan_layers(&config, t, &plan) == 1);
+    CHECK(t->hwLayers[0].compositionType == HWC_OVERLAY);
+    CHECK(plan.video == 0);
+    CHECK(plan.reason[0] == HWC_PLAN_NO_SCALER);
+
+    init(&t, &config);
+    config.screens = 2;
+    config.free_layers[1] = 0;
+    add_layer(t, HWC_FORMAT_MBYUV420, 1280, 720, 0, 0, 1280, 720);
+    CHECK(hwc_plan_layers(&config, t, &plan) == 1);
+    CHECK(t->hwLayers[0].compositionType == HWC_OVERLAY);
+    CHECK(plan.video == 0);
+    CHECK(plan.reason[0] == HWC_PLAN_NO_LAYER);
+
+    //a clamp is what changes the picture, it is the reason logged
+    init(&t, &config);
+    config.free_scalers = 0;
+    add_layer(t, HWC_FORMAT_MBYUV420, 4096, 1024, 0, 0, 1280, 320);
+    CHECK(hwc_plan_layers(&config, t, &plan) == 1);
+    CHECK(plan.reason[0] == HWC_PLAN_CLAMP_SRC_SIZE);
+
+    free(t);
+}
+
+//the first video gets the video layer, the others stay off the framebuffer
+static void test_two_videos()
+{
+    hwc_layer_list_t *t = NULL;
+    hwc_plan_config_t config;
+    hwc_plan_t plan;
+
+    init(&t, &config);
+    add_layer(t, HWC_FORMAT_RGBA_8888, 1280, 720, 0, 0, 1280, 720);
+    add_layer(t, HWC_FORMAT_MBYUV420, 1920, 1080, 0, 0, 640, 360);
+    add_layer(t, HWC_FORMAT_YUV420PLANAR, 640, 480, 640, 360, 640, 360);
+
+    CHECK(hwc_plan_layers(&config, t, &plan) == 2);
+    CHECK(plan.video == 1);
+    CHECK(t->hwLayers[0].compositionType == HWC_FRAMEBUFFER);
+    CHECK(t->hwLayers[1].compositionType == HWC_OVERLAY);
+    CHECK(t->hwLayers[2].compositionType == HWC_OVERLAY);
+    CHECK(plan.reason[0] == HWC_PLAN_GPU);
+    CHECK(plan.reason[1] == HWC_PLAN_OK);
+    CHECK(plan.reason[2] == HWC_PLAN_VIDEO_BUSY);
+    CHECK(hwc_test_rect_is(&plan.crop, 0, 0, 1920, 1080));
+    CHECK(hwc_test_rect_is(&plan.frame, 0, 0, 640, 360));
+
+    free(t);
+}
+
+static void test_same()
+{
+    hwc_layer_list_t *t = NULL;
+    hwc_plan_config_t config;
+    hwc_plan_t a, b;
+
+    init(&t, &config);
+    add_layer(t, HWC_FORMAT_MBYUV420, 1280, 720, 0, 0, 1280, 720);
+    add_layer(t, HWC_FORMAT_RGBA_8888, 1280, 48, 0, 0, 1280, 48);
+    hwc_plan_layers(&config, t, &a);
+    hwc_plan_layers(&config, t, &b);
+    CHECK(hwc_plan_same(&a, &b));
+
+    t->hwLayers[0].flags = HWC_SKIP_LAYER;
+    hwc_plan_layers(&config, t, &b);
+    CHECK(!hwc_plan_same(&a, &b));
+
+    t->hwLayers[0].flags = 0;
+    t->hwLayers[0].format = HWC_FORMAT_RGBA_8888;
+    hwc_plan_layers(&config, t, &b);
+    CHECK(!hwc_plan_same(&a, &b));
+
+    CHECK(strcmp(hwc_plan_reason_str(HWC_PLAN_OK), "overlay") == 0);
+    CHECK(strcmp(hwc_plan_reason_str(HWC_PLAN_REASON_NUM), "unknown") == 0);
+
+    free(t);
+}
+
+int main(void)
+{
+    test_rgb_only();
+    test_video();
+    test_clamp();
+    test_reasons();
+    test_two_videos();
+    test_same();
+
+    return hwc_test_result("hwc_planner_test");
+}
@@ -0,0 +1,53 @@
+#ifndef __HWC_TEST_H__
+#define __HWC_TEST_H__
+
+//helpers shared by the hwcomposer host tests. Each test is a plain
+//executable: it prints what failed, then "PASS" or "FAIL", and exits non
+//zero on failure.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <hardware/hwcomposer.h>
+
+static int hwc_test_failures = 0;
+
+#define CHECK(cond)                                                         \
+    do                                                                      \
+    {                                                                       \
+        if(!(cond))                                                         \
+        {                                                                   \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n",                    \
+                __FILE__, __LINE__, #cond);                                 \
+            hwc_test_failures++;                                            \
+        }                                                                   \
+    } while(0)
+
+//prints the result, to be returned from main()
+static inline int hwc_test_result(const char *name)
+{
+    printf("%s: %s\n", name, hwc_test_failures ? "FAIL" : "PASS");
+    return hwc_test_failures ? 1 : 0;
+}
+
+//an empty list with room for 'max_layers', as SurfaceFlinger allocates it
+static inline hwc_layer_list_t *hwc_test_new_list(size_t max_layers)
+{
+    return (hwc_layer_list_t *)calloc(1, sizeof(hwc_layer_list_t) + max_layers * sizeof(hwc_layer_t));
+}
+
+static inline void hwc_test_set_rect(hwc_rect_t *rect, int left, int top, int right, int bottom)
+{
+    rect->left = left;
+    rect->top = top;
+    rect->right = right;
+    rect->bottom = bottom;
+}
+
+static inline bool hwc_test_rect_is(const hwc_rect_t *rect, int left, int top, int right, int bottom)
+{
+    return rect->left == left && rect->top == top && rect->right == right && rect->bottom == bottom;
+}
+
+#endif